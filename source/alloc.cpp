@@ -0,0 +1,65 @@
+/**
+ * \file
+ * \brief Source file for heap allocation counters and peak memory usage
+*/
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <atomic>
+#include "alloc.hpp"
+
+
+/// glibc allocator entry points, replaced functions forward to them
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+
+static std::atomic<size_t> alloc_count(0);      ///< Number of allocation calls
+static std::atomic<size_t> alloc_bytes(0);      ///< Requested bytes
+
+
+/**
+ * \brief Adds one allocation of size bytes to counters
+*/
+static void count_alloc(size_t size);
+
+
+
+
+extern "C" void *malloc(size_t size) noexcept {
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+
+extern "C" void *calloc(size_t count, size_t size) noexcept {
+    count_alloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept {
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+
+AllocStats alloc_stats(void) {
+    return {alloc_count.load(std::memory_order_relaxed), alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+
+long peak_rss_kb(void) {
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage)) return 0;
+
+    // Linux reports max RSS in kilobytes
+    return usage.ru_maxrss;
+}
+
+
+static void count_alloc(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+}
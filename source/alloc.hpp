@@ -0,0 +1,33 @@
+/**
+ * \file
+ * \brief Header file for heap allocation counters and peak memory usage
+ * \note Counters work only in programs linked with alloc.o, it replaces malloc, calloc and realloc.
+ * Operator new of libstdc++ calls malloc, so C++ allocations of the program and libraries are counted too
+*/
+
+#ifndef ALLOC_HPP
+#define ALLOC_HPP
+
+#include <stddef.h>
+
+
+/// Heap usage since program start
+typedef struct {
+    size_t count = 0;                           ///< Number of allocation calls
+    size_t bytes = 0;                           ///< Requested bytes
+} AllocStats;
+
+
+/**
+ * \brief Returns heap usage since program start, all threads are counted
+*/
+AllocStats alloc_stats(void);
+
+
+/**
+ * \brief Returns peak resident set size of the process in kilobytes
+*/
+long peak_rss_kb(void);
+
+
+#endif
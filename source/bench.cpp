@@ -0,0 +1,1060 @@
+/**
+ * \file
+ * \brief Benchmark suite for computational kernels
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "alloc.hpp"
+#include "bignum.hpp"
+#include "kernel.hpp"
+#include "perturb.hpp"
+#include "resample.hpp"
+#include "raw.hpp"
+#include "grid.hpp"
+#include "stream.hpp"
+#include "session.hpp"
+#include "pool.hpp"
+
+
+const double BENCH_MIN_TIME = 0.2;      ///< Min time in seconds for one measurement
+const int ORBIT_BENCH_SIZE = 32;        ///< Width and height of orbit benchmark view
+const int ORBIT_BENCH_NMAX = 1 << 20;   ///< Max iteration number of orbit benchmark view
+const int FRAME_WARMUP = 3;             ///< Frames of frame benchmark that may allocate
+const int FRAME_MIN_COUNT = 12;         ///< Min number of measured frames in frame benchmark
+const int RESAMPLE_W = 1920;            ///< Output width of resampling benchmark
+const int RESAMPLE_H = 1080;            ///< Output height of resampling benchmark
+const int RAW_BENCH_NMAX = 1024;        ///< Max iteration number of raw planes benchmark view
+const int RAW_PASSES = 5;               ///< Number of measured raw planes passes
+const int QUALITY_MODES = 4;            ///< Number of approximate render modes
+const int SESSION_BENCH_VIEWS = 12;     ///< Views of session benchmark exploration path
+
+/// Session file of session benchmark, it is removed before and after the run
+const char *const SESSION_BENCH_FILE = "/tmp/mandelbrot-bench-session";
+
+/// Approximate render modes compared with exact perturbation render
+const char *const QUALITY_MODE_NAMES[QUALITY_MODES] = {"float", "half", "guess", "grid"};
+
+/// Period 3 minibrot nucleus, its orbit is periodic
+const char *NUCLEUS = "-1.75487766624669276004950889635852869189460661777279314398928397064608065512808109073822709284225";
+
+/// Point near seahorse valley spiral, its orbit is chaotic
+const char *SPIRAL_X = "-0.743643887037158704752191506114774";
+const char *SPIRAL_Y = "0.131825904205311970493132056385139";
+
+
+/// View of quality benchmark suite
+typedef struct {
+    const char *name = nullptr;         ///< View name
+    const char *x = nullptr;            ///< Center x
+    const char *y = nullptr;            ///< Center y
+    const char *span = nullptr;         ///< View width
+    int nmax = 0;                       ///< Max iteration number
+} QualityView;
+
+
+/// Buffers of approximate render modes
+typedef struct {
+    WorkerPool *pool = nullptr;         ///< Worker pool of perturbation renders
+    IterColor *color_table = nullptr;   ///< Palette
+    IterState state = {};               ///< Float kernel state
+    int *half = nullptr;                ///< Half resolution iterations
+    uint8_t *half_rgba = nullptr;       ///< Half resolution image
+    Resampler upscale = {};             ///< Upscale of half resolution image
+    int *pixels = nullptr;              ///< Pixel list of interpolated fill
+    int *snapped = nullptr;             ///< Iterations of view snapped to sample grid
+} QualityScratch;
+
+
+/// Benchmark description
+typedef struct {
+    const char *name = nullptr;         ///< Name used to select benchmark from command line
+    int (*run)(void) = nullptr;         ///< Runs benchmark and prints results, non zero value means failure
+} Benchmark;
+
+
+/**
+ * \brief Measures multiprecision arithmetic at 128 to 4096 bits
+*/
+int bench_bignum(void);
+
+
+/**
+ * \brief Measures throughput of float SIMD kernel and perturbation tiers at different zooms
+*/
+int bench_tiers(void);
+
+
+/**
+ * \brief Measures one perturbation tier on one view and prints results
+ * \param [in] view    View to render
+ * \param [in] tier    Delta precision tier
+ * \param [in] name    View name
+ * \param [in] iters   Iterations buffer that fits the view
+*/
+void bench_perturb_tier(const DeepView *view, PerturbTier tier, const char *name, int *iters);
+
+
+/**
+ * \brief Measures memory footprint and delta loop throughput of full and compressed reference orbits
+*/
+int bench_orbit(void);
+
+
+/**
+ * \brief Measures viewer frame pipeline without window and fails if steady state frames allocate
+*/
+int bench_frame(void);
+
+
+/**
+ * \brief Measures resampling filters on 2x downscale and 2x upscale in output megapixels per second
+*/
+int bench_resample(void);
+
+
+/**
+ * \brief Measures colorization and analysis passes over raw planes in planar and interleaved layouts
+*/
+int bench_raw(void);
+
+
+/**
+ * \brief Compares approximate render modes with exact render on view suite: speedup, PSNR, max iteration error, wrong pixels
+*/
+int bench_quality(void);
+
+
+/**
+ * \brief Measures when the first and the last tile of streamed render are ready compared with blocking render,
+ * and how fast cancelled render returns
+*/
+int bench_stream(void);
+
+
+/**
+ * \brief Stream callback that counts delivered tiles
+ * \param [in,out] arg     Counter of type std::atomic<int>
+ * \param [in]     tile    Finished tile
+*/
+void count_tile(void *arg, const StreamTile *tile);
+
+
+/**
+ * \brief Explores path of views with empty session, then with reopened one, and compares with rendering without session
+*/
+int bench_session(void);
+
+
+/**
+ * \brief Shows every view of the exploration path once
+ * \param [in,out] session Opened session, null means rendering without session
+ * \param [in,out] state   Screen iteration state
+ * \param [out]    hashes  Hashes of screen iterations, one per view
+ * \return Seconds taken
+*/
+double explore_path(Session *session, IterState *state, uint64_t *hashes);
+
+
+/**
+ * \brief Renders view of SCREEN_W * SCREEN_H pixels with approximate mode
+ * \param [in]     mode    Index in QUALITY_MODE_NAMES
+ * \param [in]     view    View to render
+ * \param [in,out] scratch Mode buffers
+ * \param [out]    iters   Iteration numbers
+ * \param [out]    rgba    Image
+ * \return Non zero value means error
+*/
+int render_approximate(int mode, const DeepView *view, QualityScratch *scratch, int *iters, uint8_t *rgba);
+
+
+/**
+ * \brief Compares render with the exact one
+ * \param [in]  iters       Iteration numbers
+ * \param [in]  exact       Exact iteration numbers
+ * \param [in]  rgba        Image
+ * \param [in]  exact_rgba  Exact image
+ * \param [in]  count       Number of pixels
+ * \param [out] psnr        PSNR of RGB channels in dB, infinity for equal images
+ * \param [out] max_error   Max iteration number difference, glitched pixels are skipped
+ * \param [out] wrong       Percentage of pixels with other iteration number
+*/
+void compare_renders(const int *iters, const int *exact, const uint8_t *rgba, const uint8_t *exact_rgba, int count,
+                     double *psnr, int *max_error, double *wrong);
+
+
+/**
+ * \brief Fills number with pseudo random fraction
+ * \param [out] num     Number to fill
+ * \param [in]  size    Number of limbs
+*/
+void random_bignum(BigNum *num, int size);
+
+
+const Benchmark BENCHMARKS[] = {
+    {"bignum", bench_bignum},
+    {"tiers", bench_tiers},
+    {"orbit", bench_orbit},
+    {"frame", bench_frame},
+    {"resample", bench_resample},
+    {"raw", bench_raw},
+    {"quality", bench_quality},
+    {"stream", bench_stream},
+    {"session", bench_session},
+};
+
+const size_t BENCHMARKS_NUMBER = sizeof(BENCHMARKS) / sizeof(Benchmark);
+
+
+
+
+int main(int argc, char *argv[]) {
+    int found = 0, failed = 0;
+
+    for (size_t i = 0; i < BENCHMARKS_NUMBER; i++) {
+        if (argc > 1 && strcmp(argv[1], BENCHMARKS[i].name)) continue;
+
+        printf("=== %s ===\n", BENCHMARKS[i].name);
+        AllocStats before = alloc_stats();
+
+        if (BENCHMARKS[i].run()) {
+            printf("FAILED\n");
+            failed = 1;
+        }
+
+        AllocStats after = alloc_stats();
+        printf("Allocations: %zu (%zu KB), peak RSS: %ld KB\n\n", after.count - before.count,
+               (after.bytes - before.bytes) / 1024, peak_rss_kb());
+
+        found = 1;
+    }
+
+    ASSERT(found, INVALID_ARG, "Unknown benchmark %s!\n", argv[1]);
+
+    return failed;
+}
+
+
+int bench_bignum(void) {
+    static BigNum a, b, res, x, y;
+
+    printf("%6s %12s %12s %12s %12s %12s\n", "bits", "school ns", "mul ns", "sqr ns", "step ns", "steps/s");
+
+    for (int bits = 128; bits <= BIGNUM_MAX_BITS; bits *= 2) {
+        int size = bignum_size_for_bits(bits);
+
+        random_bignum(&a, size);
+        random_bignum(&b, size);
+
+        static uint32_t product[2 * BIGNUM_MAX_LIMBS];
+        double ns[4] = {};
+
+        for (int test = 0; test < 4; test++) {
+            long count = 0;
+            double start = get_seconds(), elapsed = 0;
+
+            bignum_zero(&x, size);
+            bignum_zero(&y, size);
+
+            do {
+                for (int i = 0; i < 64; i++) {
+                    switch (test) {
+                        case 0:  limbs_mul(product, a.limbs, b.limbs, size, size + 1); break;
+                        case 1:  bignum_mul(&res, &a, &b); break;
+                        case 2:  bignum_sqr(&res, &a); break;
+                        // Orbit of c = a + bi stays bounded because a, b < 1/4
+                        case 3:  bignum_mandel_step(&x, &y, &a, &b); break;
+                        default: break;
+                    }
+                }
+
+                count += 64;
+                elapsed = get_seconds() - start;
+            } while (elapsed < BENCH_MIN_TIME);
+
+            ns[test] = 1e9 * elapsed / (double) count;
+        }
+
+        printf("%6d %12.1f %12.1f %12.1f %12.1f %12.0f\n", bits, ns[0], ns[1], ns[2], ns[3], 1e9 / ns[3]);
+    }
+
+    return OK;
+}
+
+
+void random_bignum(BigNum *num, int size) {
+    assert(num && "Can't fill null number!\n");
+
+    bignum_zero(num, size);
+
+    for (int i = 0; i < size - 1; i++)
+        num -> limbs[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+
+    // Keep value below 1/4
+    num -> limbs[size - 2] >>= 3;
+}
+
+
+int bench_tiers(void) {
+
+    printf("%-9s %-8s %10s %10s %10s %10s\n", "tier", "view", "ref ms", "render ms", "Mpix/s", "Miter/s");
+
+    static IterColor color_table[POSSIBLE_COLORS] = {};
+    static uint8_t pixels[SCREEN_W * SCREEN_H * 4] = {};
+
+    Transform transform = {};
+    int frames = 0;
+    double start = get_seconds(), elapsed = 0;
+
+    do {
+        set_pixels(color_table, pixels, &transform);
+        frames++;
+        elapsed = get_seconds() - start;
+    } while (elapsed < BENCH_MIN_TIME);
+
+    double frame_ms = 1e3 * elapsed / frames;
+    printf("%-9s %-8s %10s %10.2f %10.1f %10s\n", "float", "shallow", "-", frame_ms,
+           1e-3 * SCREEN_W * SCREEN_H / frame_ms, "-");
+
+    int *iters = (int *) calloc((size_t) SCREEN_W * SCREEN_H, sizeof(int));
+    ASSERT(iters, ALLOC_FAIL, "Can't allocate iterations buffer!\n");
+
+    static DeepView view = {};
+    view.width = SCREEN_W;
+    view.height = SCREEN_H;
+    view.nmax = NMAX;
+
+    deep_view_parse(&view, "-0.75", "0", "3.5");
+    bench_perturb_tier(&view, TIER_DOUBLE, "shallow", iters);
+    bench_perturb_tier(&view, TIER_FLOATEXP, "shallow", iters);
+
+    deep_view_parse(&view, NUCLEUS, "0", "1e-12");
+    bench_perturb_tier(&view, TIER_DOUBLE, "1e-12", iters);
+    bench_perturb_tier(&view, TIER_FLOATEXP, "1e-12", iters);
+
+    deep_view_parse(&view, NUCLEUS, "0", "1e-400");
+    bench_perturb_tier(&view, TIER_FLOATEXP, "1e-400", iters);
+
+    free(iters);
+    return OK;
+}
+
+
+void bench_perturb_tier(const DeepView *view, PerturbTier tier, const char *name, int *iters) {
+    assert(view && "Can't measure null view!\n");
+    assert(iters && "Can't measure with null buffer!\n");
+
+    RefOrbit orbit = {};
+
+    double start = get_seconds();
+    if (ref_orbit_create(&orbit, view, &view -> center_x, &view -> center_y, ORBIT_FULL)) return;
+    double ref_ms = 1e3 * (get_seconds() - start);
+
+    int frames = 0;
+    double elapsed = 0;
+    start = get_seconds();
+
+    do {
+        perturb_rows(&orbit, view, tier, 0, view -> height, iters);
+        frames++;
+        elapsed = get_seconds() - start;
+    } while (elapsed < BENCH_MIN_TIME);
+
+    double total_iters = 0;
+    for (long i = 0; i < (long) view -> width * view -> height; i++)
+        total_iters += (iters[i] > 0) ? iters[i] : 0;
+
+    double frame_ms = 1e3 * elapsed / frames;
+    printf("%-9s %-8s %10.2f %10.2f %10.1f %10.1f\n", (tier == TIER_DOUBLE) ? "double" : "floatexp", name, ref_ms,
+           frame_ms, 1e-3 * view -> width * view -> height / frame_ms, 1e-3 * total_iters / frame_ms);
+
+    ref_orbit_free(&orbit);
+}
+
+
+int bench_orbit(void) {
+    printf("%-8s %-11s %8s %10s %12s %10s %10s\n", "view", "storage", "length", "waypoints", "bytes", "ref ms", "Miter/s");
+
+    int *iters = (int *) calloc((size_t) ORBIT_BENCH_SIZE * ORBIT_BENCH_SIZE, sizeof(int));
+    ASSERT(iters, ALLOC_FAIL, "Can't allocate iterations buffer!\n");
+
+    static DeepView view = {};
+    view.width = ORBIT_BENCH_SIZE;
+    view.height = ORBIT_BENCH_SIZE;
+    view.nmax = ORBIT_BENCH_NMAX;
+
+    const char *names[] = {"nucleus", "spiral"};
+    const char *centers[][2] = {{NUCLEUS, "0"}, {SPIRAL_X, SPIRAL_Y}};
+
+    for (int v = 0; v < 2; v++) {
+        deep_view_parse(&view, centers[v][0], centers[v][1], "1e-30");
+
+        for (int storage = ORBIT_FULL; storage <= ORBIT_COMPRESSED; storage++) {
+            RefOrbit orbit = {};
+
+            double start = get_seconds();
+            if (ref_orbit_create(&orbit, &view, &view.center_x, &view.center_y, (OrbitStorage) storage)) break;
+            double ref_ms = 1e3 * (get_seconds() - start);
+
+            start = get_seconds();
+            perturb_rows(&orbit, &view, TIER_DOUBLE, 0, view.height, iters);
+            double elapsed = get_seconds() - start;
+
+            double total_iters = 0;
+            for (int i = 0; i < view.width * view.height; i++)
+                total_iters += (iters[i] > 0) ? iters[i] : 0;
+
+            printf("%-8s %-11s %8d %10d %12zu %10.1f %10.1f\n", names[v], (storage == ORBIT_FULL) ? "full" : "compressed",
+                   orbit.length, orbit.waypoints_count, ref_orbit_memory(&orbit), ref_ms, 1e-6 * total_iters / elapsed);
+
+            ref_orbit_free(&orbit);
+        }
+    }
+
+    free(iters);
+    return OK;
+}
+
+
+int bench_frame(void) {
+    IterColor *color_table = (IterColor *) calloc(POSSIBLE_COLORS, sizeof(IterColor));
+    uint8_t *pixels = (uint8_t *) calloc(SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
+    uint8_t *scratch = (uint8_t *) calloc(SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
+
+    IterState state = {};
+    int result = iter_state_create(&state);
+
+    if (result || !color_table || !pixels || !scratch) {
+        printf("Can't allocate frame buffers!\n");
+        result = ALLOC_FAIL;
+    }
+
+    static DirtyRegion dirty = {};
+    static DirtyRect rects[DIRTY_BANDS] = {};
+    dirty_clear(&dirty);
+
+    Transform transform = {};
+    int frames = 0, nmax = NMAX;
+    size_t allocating = 0, steady = 0;
+    double start = get_seconds(), elapsed = 0;
+
+    while (!result && (elapsed < BENCH_MIN_TIME || frames < FRAME_WARMUP + FRAME_MIN_COUNT)) {
+        AllocStats before = alloc_stats();
+
+        // Pan, raise limit and lower it back, so full and partial updates both happen
+        switch (frames % 3) {
+            case 0:  transform.center_x += MOVE_FACTOR * transform.set_w; break;
+            case 1:  nmax *= 2; break;
+            case 2:  nmax /= 2; break;
+            default: break;
+        }
+
+        if (iter_state_update(&state, &transform, nmax, &dirty))
+            colorize_dirty(color_table, state.iters, pixels, &dirty, nmax);
+
+        // Same packing as texture upload of the viewer
+        int count = dirty_rects(&dirty, rects);
+        for (int i = 0; i < count; i++) {
+            for (int y = 0; y < rects[i].height; y++)
+                memcpy(scratch + 4 * y * rects[i].width, pixels + 4 * ((rects[i].y + y) * SCREEN_W + rects[i].x),
+                       4 * (size_t) rects[i].width);
+        }
+
+        dirty_clear(&dirty);
+
+        if (frames >= FRAME_WARMUP) {
+            steady++;
+            if (alloc_stats().count != before.count) allocating++;
+        }
+
+        frames++;
+        elapsed = get_seconds() - start;
+    }
+
+    if (!result) {
+        printf("%10s %10s %12s\n", "frames", "frame ms", "allocating");
+        printf("%10zu %10.2f %12zu\n", steady, 1e3 * elapsed / frames, allocating);
+
+        if (allocating) {
+            printf("Steady state frames must not allocate!\n");
+            result = ALLOC_FAIL;
+        }
+    }
+
+    iter_state_free(&state);
+    free(scratch);
+    free(pixels);
+    free(color_table);
+
+    return result;
+}
+
+
+int bench_resample(void) {
+    const int big_w = 2 * RESAMPLE_W, big_h = 2 * RESAMPLE_H;
+    const int small_w = RESAMPLE_W / 2, small_h = RESAMPLE_H / 2;
+
+    float *big = (float *) calloc((size_t) big_w * big_h * 4, sizeof(float));
+    float *small = (float *) calloc((size_t) small_w * small_h * 4, sizeof(float));
+    float *out = (float *) calloc((size_t) RESAMPLE_W * RESAMPLE_H * 4, sizeof(float));
+    uint8_t *big_rgba = (uint8_t *) calloc((size_t) big_w * big_h * 4, sizeof(uint8_t));
+    uint8_t *out_rgba = (uint8_t *) calloc((size_t) RESAMPLE_W * RESAMPLE_H * 4, sizeof(uint8_t));
+
+    int result = OK;
+
+    if (!big || !small || !out || !big_rgba || !out_rgba) {
+        printf("Can't allocate resampling buffers!\n");
+        result = ALLOC_FAIL;
+    }
+
+    // Rings with fine detail, so filters do real work on every pixel
+    for (int i = 0; !result && i < big_w * big_h; i++) {
+        int x = i % big_w - big_w / 2, y = i / big_w - big_h / 2;
+        float value = 0.5f + 0.5f * sinf(1e-3f * (float) (x * x + y * y));
+
+        for (int c = 0; c < 3; c++) big[4 * i + c] = value;
+        big[4 * i + 3] = 1;
+
+        for (int c = 0; c < 4; c++) big_rgba[4 * i + c] = (uint8_t) (255 * big[4 * i + c]);
+    }
+
+    for (int i = 0; !result && i < small_w * small_h; i++)
+        memcpy(small + 4 * i, big + 4 * ((i / small_w) * 4 * big_w + (i % small_w) * 4), 4 * sizeof(float));
+
+    const char *names[] = {"box", "mitchell", "lanczos"};
+
+    if (!result) printf("%-9s %14s %14s %14s\n", "filter", "down MP/s", "up MP/s", "rgba down MP/s");
+
+    for (int filter = FILTER_BOX; !result && filter <= FILTER_LANCZOS; filter++) {
+        double mps[3] = {};
+
+        // Tables and buffers are made once per filter, as callers that resize every frame keep them
+        Resampler down = {}, up = {};
+        result = resampler_create(&down, big_w, big_h, RESAMPLE_W, RESAMPLE_H, (ResampleFilter) filter);
+        if (!result) result = resampler_create(&up, small_w, small_h, RESAMPLE_W, RESAMPLE_H, (ResampleFilter) filter);
+
+        for (int test = 0; test < 3 && !result; test++) {
+            // The first pass faults in pages of scratch buffers, it is not measured
+            int frames = -1;
+            double start = 0, elapsed = 0;
+
+            do {
+                if (frames == 0) start = get_seconds();
+
+                switch (test) {
+                    case 0:  resampler_linear(&down, big, out); break;
+                    case 1:  resampler_linear(&up, small, out); break;
+                    case 2:  resampler_rgba(&down, big_rgba, out_rgba); break;
+                    default: break;
+                }
+
+                frames++;
+                elapsed = (frames > 0) ? get_seconds() - start : 0;
+            } while (!result && (frames <= 0 || elapsed < BENCH_MIN_TIME));
+
+            mps[test] = 1e-6 * RESAMPLE_W * RESAMPLE_H * frames / elapsed;
+        }
+
+        resampler_free(&down);
+        resampler_free(&up);
+
+        if (!result) printf("%-9s %14.1f %14.1f %14.1f\n", names[filter], mps[0], mps[1], mps[2]);
+    }
+
+    free(big);
+    free(small);
+    free(out);
+    free(big_rgba);
+    free(out_rgba);
+
+    return result;
+}
+
+
+int bench_raw(void) {
+    const int count = SCREEN_W * SCREEN_H;
+
+    RawBuffer raws[2] = {};
+    IterColor *color_table = (IterColor *) calloc(POSSIBLE_COLORS, sizeof(IterColor));
+    uint8_t *rgba[2] = {(uint8_t *) calloc((size_t) count * 4, sizeof(uint8_t)), (uint8_t *) calloc((size_t) count * 4, sizeof(uint8_t))};
+    long *histogram[2] = {(long *) calloc(RAW_BENCH_NMAX + 1, sizeof(long)), (long *) calloc(RAW_BENCH_NMAX + 1, sizeof(long))};
+    int *pixels = (int *) calloc((size_t) count, sizeof(int));
+    float *re = (float *) calloc((size_t) count, sizeof(float));
+    float *im = (float *) calloc((size_t) count, sizeof(float));
+
+    int result = OK;
+
+    if (!color_table || !rgba[0] || !rgba[1] || !histogram[0] || !histogram[1] || !pixels || !re || !im) {
+        printf("Can't allocate raw planes buffers!\n");
+        result = ALLOC_FAIL;
+    }
+
+    for (int i = 0; !result && i < POSSIBLE_COLORS; i++)
+        color_table[i] = {(uint8_t) (16 * i), (uint8_t) (255 - 16 * i), (uint8_t) (97 * i)};
+
+    // Whole set, so a third of pixels reaches the limit and resume pass has work
+    for (int layout = RAW_PLANAR; !result && layout <= RAW_INTERLEAVED; layout++) {
+        result = raw_buffer_create(raws + layout, SCREEN_W, SCREEN_H, (RawLayout) layout);
+        if (!result) raw_buffer_render(raws + layout, -0.75, 0, 3, RAW_BENCH_NMAX);
+    }
+
+    const char *names[RAW_PASSES] = {"iters", "smooth", "distance", "histogram", "resume"};
+    int listed[2] = {};
+
+    if (!result) printf("%-10s %10s %10s %10s\n", "pass", "soa ms", "aos ms", "aos/soa");
+
+    for (int pass = 0; !result && pass < RAW_PASSES; pass++) {
+        double ms[2] = {};
+
+        for (int layout = RAW_PLANAR; layout <= RAW_INTERLEAVED; layout++) {
+            const RawBuffer *raw = raws + layout;
+
+            int frames = -1;
+            double start = 0, elapsed = 0;
+
+            do {
+                if (frames == 0) start = get_seconds();
+
+                switch (pass) {
+                    case 0:  raw_colorize_iters(raw, color_table, rgba[layout], RAW_BENCH_NMAX); break;
+                    case 1:  raw_colorize_smooth(raw, color_table, rgba[layout], RAW_BENCH_NMAX); break;
+                    case 2:  raw_shade_distance(raw, rgba[layout]); break;
+                    case 3:  raw_histogram(raw, RAW_BENCH_NMAX, histogram[layout]); break;
+                    case 4:  listed[layout] = raw_collect_resume(raw, RAW_BENCH_NMAX, pixels, re, im); break;
+                    default: break;
+                }
+
+                frames++;
+                elapsed = (frames > 0) ? get_seconds() - start : 0;
+            } while (frames <= 0 || elapsed < BENCH_MIN_TIME);
+
+            ms[layout] = 1e3 * elapsed / frames;
+        }
+
+        // Both layouts must give the same result
+        bool same = (pass == 3) ? !memcmp(histogram[0], histogram[1], (RAW_BENCH_NMAX + 1) * sizeof(long)) :
+                    (pass == 4) ? listed[0] == listed[1] : !memcmp(rgba[0], rgba[1], (size_t) count * 4);
+
+        printf("%-10s %10.3f %10.3f %10.2f\n", names[pass], ms[0], ms[1], ms[1] / ms[0]);
+
+        if (!same) {
+            printf("Layouts give different %s results!\n", names[pass]);
+            result = INVALID_FORMAT;
+        }
+    }
+
+    raw_buffer_free(raws);
+    raw_buffer_free(raws + 1);
+    free(color_table);
+    free(rgba[0]);
+    free(rgba[1]);
+    free(histogram[0]);
+    free(histogram[1]);
+    free(pixels);
+    free(re);
+    free(im);
+
+    return result;
+}
+
+
+int bench_quality(void) {
+    const int count = SCREEN_W * SCREEN_H;
+
+    const QualityView views[] = {
+        {"whole", "-0.75", "0", "3.5", 1024},
+        {"seahorse", "-0.7436", "0.1318", "1e-3", 1024},
+        {"spiral", SPIRAL_X, SPIRAL_Y, "1e-6", 1024},
+        {"deep", SPIRAL_X, SPIRAL_Y, "1e-9", 4096},
+    };
+
+    static WorkerPool pool = {};
+    if (pool_create(&pool, 0)) return ALLOC_FAIL;
+
+    QualityScratch scratch = {};
+    scratch.pool = &pool;
+
+    int result = load_color_table(COLOR_TABLE_FILE, &scratch.color_table);
+    if (!result) result = iter_state_create(&scratch.state);
+    if (!result) result = resampler_create(&scratch.upscale, SCREEN_W / 2, SCREEN_H / 2, SCREEN_W, SCREEN_H, FILTER_MITCHELL);
+
+    // Snapped view grows by less than a tile on every side
+    size_t snapped_count = (size_t) (SCREEN_W + 2 * TILE_CACHE_SIZE) * (size_t) (SCREEN_H + 2 * TILE_CACHE_SIZE);
+
+    int *exact = (int *) calloc((size_t) count, sizeof(int));
+    int *iters = (int *) calloc((size_t) count, sizeof(int));
+    uint8_t *exact_rgba = (uint8_t *) calloc((size_t) count * 4, sizeof(uint8_t));
+    uint8_t *rgba = (uint8_t *) calloc((size_t) count * 4, sizeof(uint8_t));
+    scratch.half = (int *) calloc((size_t) count / 4, sizeof(int));
+    scratch.half_rgba = (uint8_t *) calloc((size_t) count, sizeof(uint8_t));
+    scratch.pixels = (int *) calloc((size_t) count, sizeof(int));
+    scratch.snapped = (int *) calloc(snapped_count, sizeof(int));
+
+    if (!result && (!exact || !iters || !exact_rgba || !rgba || !scratch.half || !scratch.half_rgba || !scratch.pixels ||
+                    !scratch.snapped)) {
+        printf("Can't allocate quality buffers!\n");
+        result = ALLOC_FAIL;
+    }
+
+    if (!result) printf("%-9s %-6s %10s %9s %10s %9s %9s\n", "view", "mode", "exact ms", "speedup", "PSNR dB", "max err", "wrong %");
+
+    static DeepView view = {};
+    view.width = SCREEN_W;
+    view.height = SCREEN_H;
+
+    for (size_t v = 0; !result && v < sizeof(views) / sizeof(QualityView); v++) {
+        result = deep_view_parse(&view, views[v].x, views[v].y, views[v].span);
+        view.nmax = views[v].nmax;
+
+        int frames = 0;
+        double start = get_seconds(), elapsed = 0;
+
+        while (!result && (frames == 0 || elapsed < BENCH_MIN_TIME)) {
+            result = perturb_render(&view, exact, &pool, nullptr, nullptr, nullptr);
+            frames++;
+            elapsed = get_seconds() - start;
+        }
+
+        double exact_ms = 1e3 * elapsed / frames;
+        colorize(scratch.color_table, exact, exact_rgba, count, view.nmax);
+
+        for (int mode = 0; !result && mode < QUALITY_MODES; mode++) {
+            frames = 0;
+            start = get_seconds();
+            elapsed = 0;
+
+            while (!result && (frames == 0 || elapsed < BENCH_MIN_TIME)) {
+                result = render_approximate(mode, &view, &scratch, iters, rgba);
+                frames++;
+                elapsed = get_seconds() - start;
+            }
+
+            double psnr = 0, wrong = 0;
+            int max_error = 0;
+            compare_renders(iters, exact, rgba, exact_rgba, count, &psnr, &max_error, &wrong);
+
+            printf("%-9s %-6s %10.1f %9.2f %10.2f %9d %9.3f\n", views[v].name, QUALITY_MODE_NAMES[mode], exact_ms,
+                   exact_ms / (1e3 * elapsed / frames), psnr, max_error, wrong);
+        }
+    }
+
+    pool_destroy(&pool);
+    iter_state_free(&scratch.state);
+    resampler_free(&scratch.upscale);
+    if (scratch.color_table) free_color_table(&scratch.color_table);
+
+    free(exact);
+    free(iters);
+    free(exact_rgba);
+    free(rgba);
+    free(scratch.half);
+    free(scratch.half_rgba);
+    free(scratch.pixels);
+    free(scratch.snapped);
+
+    return result;
+}
+
+
+int render_approximate(int mode, const DeepView *view, QualityScratch *scratch, int *iters, uint8_t *rgba) {
+    assert(view && view -> width == SCREEN_W && view -> height == SCREEN_H && "Quality views are screen sized!\n");
+    assert(scratch && iters && rgba && "Can't render into null buffers!\n");
+
+    const int width = view -> width, height = view -> height;
+    int result = OK;
+
+    switch (mode) {
+        // Low precision preview: float SIMD kernel of the viewer
+        case 0: {
+            float span = (float) floatexp_to_double(view -> span);
+            Transform transform = {(float) bignum_to_double(&view -> center_x), (float) bignum_to_double(&view -> center_y),
+                                   span, span};
+
+            static DirtyRegion dirty = {};
+            scratch -> state.nmax = 0;
+            iter_state_update(&scratch -> state, &transform, view -> nmax, &dirty);
+
+            memcpy(iters, scratch -> state.iters, (size_t) width * height * sizeof(int));
+            break;
+        }
+
+        // Zoom resampling: half resolution render, iterations are replicated and image is upscaled
+        case 1: {
+            DeepView half = *view;
+            half.width = width / 2;
+            half.height = height / 2;
+
+            result = perturb_render(&half, scratch -> half, scratch -> pool, nullptr, nullptr, nullptr);
+            if (result) return result;
+
+            colorize(scratch -> color_table, scratch -> half, scratch -> half_rgba, half.width * half.height, view -> nmax);
+            resampler_rgba(&scratch -> upscale, scratch -> half_rgba, rgba);
+
+            for (int i = 0; i < width * height; i++)
+                iters[i] = scratch -> half[(i / width / 2) * half.width + (i % width) / 2];
+
+            return result;
+        }
+
+        // Interpolated fill: every second pixel of every second row, the rest is copied where these agree
+        case 2: {
+            int count = 0;
+            for (int y = 0; y < height; y += 2)
+                for (int x = 0; x < width; x += 2) scratch -> pixels[count++] = y * width + x;
+
+            result = perturb_render_pixels(view, iters, scratch -> pool, scratch -> pixels, count, nullptr, nullptr);
+            if (result) return result;
+
+            count = 0;
+
+            for (int y = 0; y < height; y++) {
+                int y0 = y & ~1, y1 = (y | 1) + 1 < height ? (y | 1) + 1 : y0;
+
+                for (int x = 0; x < width; x++) {
+                    if (!(x & 1) && !(y & 1)) continue;
+
+                    int x0 = x & ~1, x1 = (x | 1) + 1 < width ? (x | 1) + 1 : x0;
+                    int corner = iters[y0 * width + x0];
+
+                    if (corner != PIXEL_GLITCHED && iters[y0 * width + x1] == corner && iters[y1 * width + x0] == corner &&
+                        iters[y1 * width + x1] == corner)
+                        iters[y * width + x] = corner;
+                    else scratch -> pixels[count++] = y * width + x;
+                }
+            }
+
+            result = perturb_render_pixels(view, iters, scratch -> pool, scratch -> pixels, count, nullptr, nullptr);
+            break;
+        }
+
+        // Shared sample grid of the daemon: pixel size rounded to 8 mantissa bits and center moved by sub-pixel
+        case 3: {
+            static GridView snapped = {};
+
+            result = grid_snap(view, &snapped);
+            if (!result) result = perturb_render(&snapped.view, scratch -> snapped, scratch -> pool, nullptr, nullptr, nullptr);
+            if (!result) grid_crop(&snapped, scratch -> snapped, iters, width, height);
+            break;
+        }
+
+        default:
+            return INVALID_ARG;
+    }
+
+    if (!result) colorize(scratch -> color_table, iters, rgba, width * height, view -> nmax);
+
+    return result;
+}
+
+
+void compare_renders(const int *iters, const int *exact, const uint8_t *rgba, const uint8_t *exact_rgba, int count,
+                     double *psnr, int *max_error, double *wrong) {
+    assert(iters && exact && rgba && exact_rgba && "Can't compare null renders!\n");
+    assert(psnr && max_error && wrong && "Can't store null results!\n");
+
+    double squares = 0;
+    long different = 0;
+    *max_error = 0;
+
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) {
+            double diff = (double) rgba[4 * i + c] - (double) exact_rgba[4 * i + c];
+            squares += diff * diff;
+        }
+
+        if (iters[i] == exact[i]) continue;
+
+        different++;
+
+        int error = abs(iters[i] - exact[i]);
+        if (iters[i] != PIXEL_GLITCHED && exact[i] != PIXEL_GLITCHED && error > *max_error) *max_error = error;
+    }
+
+    double mse = squares / (3.0 * count);
+
+    *psnr = (mse > 0) ? 10 * log10(255.0 * 255.0 / mse) : INFINITY;
+    *wrong = 100.0 * (double) different / count;
+}
+
+
+int bench_stream(void) {
+    static IterColor color_table[POSSIBLE_COLORS] = {};
+    static uint8_t blocking[SCREEN_W * SCREEN_H * 4] = {};
+    static uint8_t streamed[SCREEN_W * SCREEN_H * 4] = {};
+    static uint8_t sent[SCREEN_W * SCREEN_H * 4] = {};
+
+    for (int i = 0; i < POSSIBLE_COLORS; i++) color_table[i] = {(uint8_t) i, (uint8_t) (7 * i), (uint8_t) (13 * i)};
+
+    static WorkerPool pool = {};
+    if (pool_create(&pool, 0)) return ALLOC_FAIL;
+
+    static StreamRender render = {};
+    Transform transform = {};
+
+    printf("%-9s %10s %10s %10s %8s\n", "mode", "first ms", "last ms", "return ms", "tiles");
+
+    int frames = 0;
+    double start = get_seconds(), elapsed = 0;
+
+    do {
+        set_pixels(color_table, blocking, &transform);
+        frames++;
+        elapsed = get_seconds() - start;
+    } while (elapsed < BENCH_MIN_TIME);
+
+    double frame_ms = 1e3 * elapsed / frames;
+    printf("%-9s %10.2f %10.2f %10.2f %8d\n", "blocking", frame_ms, frame_ms, frame_ms, 1);
+
+    // Consumer copies every tile as soon as it is ready, like upload or encoder would
+    double first = 0, last = 0, total = 0;
+    int result = OK;
+    frames = 0;
+
+    do {
+        start = get_seconds();
+        result = stream_render_start(&render, &pool, color_table, streamed, &transform, nullptr, nullptr);
+        if (result) break;
+
+        StreamTile tile = {};
+        for (int i = 0; stream_render_next(&render, &tile, true); i++) {
+            if (!i) first += get_seconds() - start;
+
+            for (int y = 0; y < tile.rect.height; y++) {
+                size_t offset = 4 * ((size_t) (tile.rect.y + y) * SCREEN_W + (size_t) tile.rect.x);
+                memcpy(sent + offset, streamed + offset, 4 * (size_t) tile.rect.width);
+            }
+        }
+
+        last += get_seconds() - start;
+        result = stream_render_finish(&render);
+        total += get_seconds() - start;
+        frames++;
+    } while (!result && total < BENCH_MIN_TIME);
+
+    if (!result) {
+        printf("%-9s %10.2f %10.2f %10.2f %8d\n", "queue", 1e3 * first / frames, 1e3 * last / frames,
+               1e3 * total / frames, STREAM_TILES);
+
+        if (memcmp(blocking, sent, sizeof(sent))) {
+            printf("Streamed frame differs from blocking one!\n");
+            result = INVALID_FORMAT;
+        }
+    }
+
+    std::atomic<int> delivered(0);
+    total = 0;
+    frames = 0;
+
+    while (!result && total < BENCH_MIN_TIME) {
+        start = get_seconds();
+        result = stream_render_start(&render, &pool, color_table, streamed, &transform, count_tile, &delivered);
+        if (!result) result = stream_render_finish(&render);
+        total += get_seconds() - start;
+        frames++;
+    }
+
+    if (!result) {
+        printf("%-9s %10s %10s %10.2f %8d\n", "callback", "-", "-", 1e3 * total / frames,
+               delivered.load() / frames);
+    }
+
+    if (!result) {
+        // Cancel right after the first tile, only tiles started before that are rendered
+        start = get_seconds();
+        result = stream_render_start(&render, &pool, color_table, streamed, &transform, nullptr, nullptr);
+
+        StreamTile tile = {};
+        if (!result && stream_render_next(&render, &tile, true)) first = get_seconds() - start;
+
+        stream_render_cancel(&render);
+        if (!result) result = stream_render_finish(&render);
+        last = get_seconds() - start;
+
+        if (result == CANCELLED) {
+            printf("%-9s %10.2f %10s %10.2f %8d\n", "cancel", 1e3 * first, "-", 1e3 * last, render.queued);
+            result = OK;
+        }
+    }
+
+    pool_destroy(&pool);
+
+    return result;
+}
+
+
+void count_tile(void *arg, const StreamTile *tile) {
+    ((std::atomic<int> *) arg) -> fetch_add(1, std::memory_order_relaxed);
+}
+
+
+int bench_session(void) {
+    IterState state = {};
+    if (iter_state_create(&state)) return ALLOC_FAIL;
+
+    remove(SESSION_BENCH_FILE);
+
+    static uint64_t plain[SESSION_BENCH_VIEWS] = {}, first[SESSION_BENCH_VIEWS] = {}, again[SESSION_BENCH_VIEWS] = {};
+
+    printf("%-10s %10s %8s %10s\n", "pass", "ms", "loaded", "calculated");
+
+    double seconds = explore_path(nullptr, &state, plain);
+    printf("%-10s %10.1f %8s %10s\n", "none", 1e3 * seconds, "-", "-");
+
+    Session session = {};
+    int result = session_open(&session, SESSION_BENCH_FILE);
+
+    // Second pass reopens the file, so the quadtree is rebuilt from disk like in the next viewer run
+    for (int pass = 0; pass < 2 && !result; pass++) {
+        seconds = explore_path(&session, &state, pass ? again : first);
+        printf("%-10s %10.1f %8ld %10ld\n", pass ? "reopened" : "empty", 1e3 * seconds, session.loaded, session.computed);
+
+        result = session_close(&session);
+        if (!result && !pass) result = session_open(&session, SESSION_BENCH_FILE);
+    }
+
+    if (!result && memcmp(first, again, sizeof(first))) {
+        printf("Screens from session differ from calculated ones!\n");
+        result = INVALID_FORMAT;
+    }
+
+    remove(SESSION_BENCH_FILE);
+    iter_state_free(&state);
+
+    return result;
+}
+
+
+double explore_path(Session *session, IterState *state, uint64_t *hashes) {
+    // Zooms into seahorse valley by halves with viewer steps of 5% of the screen between zooms
+    const int moves[SESSION_BENCH_VIEWS] = {0, 1, 1, 2, 2, 2, 3, 4, 4, 5, 6, 6};
+    const int steps[SESSION_BENCH_VIEWS] = {0, 0, 3, 0, 4, 8, 0, 0, 5, 0, 0, 7};
+
+    static DirtyRegion dirty = {};
+    state -> nmax = 0;
+    if (session) session -> level = -1;
+
+    double start = get_seconds();
+
+    for (int i = 0; i < SESSION_BENCH_VIEWS; i++) {
+        Transform transform = {};
+        transform.set_w = ldexpf(SET_W, -moves[i]);
+        transform.set_h = ldexpf(SET_H, -moves[i]);
+        transform.center_x = -0.7436f + (float) steps[i] * MOVE_FACTOR * transform.set_w;
+        transform.center_y = 0.1318f;
+
+        if (session) session_update(session, state, &transform, NMAX, &dirty);
+        else         iter_state_update(state, &transform, NMAX, &dirty);
+
+        uint64_t hash = 0xcbf29ce484222325;
+        for (int j = 0; j < SCREEN_W * SCREEN_H; j++) hash = (hash ^ (uint32_t) state -> iters[j]) * 0x100000001b3;
+
+        hashes[i] = hash;
+    }
+
+    return get_seconds() - start;
+}
@@ -0,0 +1,656 @@
+/**
+ * \file
+ * \brief Source file for fixed-limb multiprecision numbers
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "utils.hpp"
+#include "bignum.hpp"
+
+
+const int KARATSUBA_MIN_LIMBS = 4;                      ///< Karatsuba recursion does not shrink below that
+const int SCRATCH_LIMBS = 8 * BIGNUM_MAX_LIMBS;         ///< Karatsuba temporaries for all recursion levels
+
+
+/// Thread local temporaries, so arithmetic does not touch heap and does not waste stack
+typedef struct {
+    uint32_t product[2 * BIGNUM_MAX_LIMBS] = {};    ///< Full product of two numbers
+    uint32_t karatsuba[SCRATCH_LIMBS] = {};         ///< Karatsuba sums and middle products
+    BigNum x2 = {};                                 ///< Mandelbrot step x^2
+    BigNum y2 = {};                                 ///< Mandelbrot step y^2
+    BigNum sum = {};                                ///< Mandelbrot step (x + y)^2
+} Scratch;
+
+
+static thread_local Scratch scratch;
+
+
+/**
+ * \brief Calculates r = a + b for n limbs
+ * \return Carry
+*/
+static uint32_t limbs_add(uint32_t *r, const uint32_t *a, const uint32_t *b, int n);
+
+
+/**
+ * \brief Calculates r = a - b for n limbs
+ * \return Borrow
+*/
+static uint32_t limbs_sub(uint32_t *r, const uint32_t *a, const uint32_t *b, int n);
+
+
+/**
+ * \brief Calculates r = a + b where a has n limbs and b has m <= n limbs
+ * \return Carry
+*/
+static uint32_t limbs_add_short(uint32_t *r, const uint32_t *a, int n, const uint32_t *b, int m);
+
+
+/**
+ * \brief Calculates r -= b where r has n limbs and b has m <= n limbs
+*/
+static void limbs_sub_in_place(uint32_t *r, int n, const uint32_t *b, int m);
+
+
+/**
+ * \brief Calculates r += b where r has n limbs and b has m <= n limbs
+*/
+static void limbs_add_in_place(uint32_t *r, int n, const uint32_t *b, int m);
+
+
+/**
+ * \brief Compares magnitudes of n limbs
+ * \return Negative if a < b, zero if a == b, positive if a > b
+*/
+static int limbs_cmp(const uint32_t *a, const uint32_t *b, int n);
+
+
+/**
+ * \brief Schoolbook multiplication of n limbs into 2n limbs
+*/
+static void school_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n);
+
+
+/**
+ * \brief Schoolbook squaring of n limbs into 2n limbs, off-diagonal products are calculated once
+*/
+static void school_sqr(uint32_t *res, const uint32_t *a, int n);
+
+
+/**
+ * \brief Karatsuba multiplication of n limbs into 2n limbs
+ * \param [in] tmp Temporary buffer that fits all recursion levels
+*/
+static void karatsuba_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n, int threshold, uint32_t *tmp);
+
+
+/**
+ * \brief Karatsuba squaring of n limbs into 2n limbs
+ * \param [in] tmp Temporary buffer that fits all recursion levels
+*/
+static void karatsuba_sqr(uint32_t *res, const uint32_t *a, int n, int threshold, uint32_t *tmp);
+
+
+/**
+ * \brief Takes fixed point part of 2n limbs product and stores it into res
+*/
+static void take_product(BigNum *res, const uint32_t *product, int sign);
+
+
+/**
+ * \brief Divides magnitude by small number
+*/
+static void limbs_div_small(uint32_t *num, int n, uint32_t divisor);
+
+
+
+
+int bignum_size_for_bits(int bits) {
+    int size = (bits + 31) / 32 + 1;
+
+    if (size < 2) return 2;
+    if (size > BIGNUM_MAX_LIMBS) return BIGNUM_MAX_LIMBS;
+
+    return size;
+}
+
+
+void bignum_zero(BigNum *num, int size) {
+    assert(num && "Can't set null number!\n");
+    assert(0 < size && size <= BIGNUM_MAX_LIMBS && "Invalid number size!\n");
+
+    num -> sign = 0;
+    num -> size = size;
+    memset(num -> limbs, 0, (size_t) size * sizeof(uint32_t));
+}
+
+
+void bignum_set_double(BigNum *num, double value, int size) {
+    assert(num && "Can't set null number!\n");
+
+    bignum_zero(num, size);
+
+    num -> sign = (value < 0);
+    double mag = fabs(value);
+
+    double int_part = floor(mag);
+    num -> limbs[size - 1] = (uint32_t) int_part;
+
+    double frac = mag - int_part;
+    for (int i = size - 2; i >= 0 && frac > 0; i--) {
+        frac *= 4294967296.0;
+        double limb = floor(frac);
+        num -> limbs[i] = (uint32_t) limb;
+        frac -= limb;
+    }
+
+    if (!(mag > 0)) num -> sign = 0;
+}
+
+
+void bignum_set_double_exp(BigNum *num, double mantissa, int64_t exponent, int size) {
+    assert(num && "Can't set null number!\n");
+
+    bignum_zero(num, size);
+
+    int shift = 0;
+    double norm = frexp(fabs(mantissa), &shift);
+    if (!(norm > 0)) return;
+
+    // Value is bits * 2^(exponent + shift - 53), so bits are placed at that offset from the lowest limb
+    uint64_t bits = (uint64_t) ldexp(norm, 53);
+    int64_t offset = exponent + shift - 53 + 32 * (int64_t)(size - 1);
+
+    if (offset < 0) {
+        if (offset <= -64) return;
+
+        bits >>= -offset;
+        offset = 0;
+    }
+
+    int limb = (int)(offset / 32), bit = (int)(offset % 32);
+
+    uint32_t parts[3] = {
+        (uint32_t)(bits << bit),
+        (uint32_t)((bits << bit) >> 32),
+        (uint32_t)((bit) ? bits >> (64 - bit) : 0)
+    };
+
+    for (int i = 0; i < 3 && limb + i < size; i++)
+        num -> limbs[limb + i] = parts[i];
+
+    num -> sign = (mantissa < 0);
+}
+
+
+void bignum_resize(BigNum *num, int size) {
+    assert(num && "Can't resize null number!\n");
+    assert(0 < size && size <= BIGNUM_MAX_LIMBS && "Invalid number size!\n");
+
+    if (size > num -> size) {
+        int shift = size - num -> size;
+
+        memmove(num -> limbs + shift, num -> limbs, (size_t) num -> size * sizeof(uint32_t));
+        memset(num -> limbs, 0, (size_t) shift * sizeof(uint32_t));
+    }
+    else if (size < num -> size) {
+        int shift = num -> size - size;
+
+        memmove(num -> limbs, num -> limbs + shift, (size_t) size * sizeof(uint32_t));
+    }
+
+    num -> size = size;
+}
+
+
+void bignum_truncate(BigNum *num, int64_t exponent) {
+    assert(num && "Can't truncate null number!\n");
+
+    int64_t bit = exponent + 32 * (int64_t) (num -> size - 1);
+    if (bit <= 0) return;
+
+    if (bit >= 32 * (int64_t) num -> size) bit = 32 * (int64_t) num -> size;
+
+    int limb = (int) (bit / 32), rest = (int) (bit % 32);
+
+    memset(num -> limbs, 0, (size_t) limb * sizeof(uint32_t));
+    if (limb < num -> size) num -> limbs[limb] &= ~((1u << rest) - 1);
+
+    bool zero = true;
+    for (int i = 0; i < num -> size && zero; i++) zero = (num -> limbs[i] == 0);
+
+    if (zero) num -> sign = 0;
+}
+
+
+double bignum_to_double(const BigNum *num) {
+    assert(num && "Can't convert null number!\n");
+
+    double result = 0;
+    int used = 0;
+
+    for (int i = num -> size - 1; i >= 0 && used < 3; i--) {
+        if (num -> limbs[i] == 0 && used == 0) continue;
+
+        result += ldexp((double) num -> limbs[i], 32 * (i - num -> size + 1));
+        used++;
+    }
+
+    return (num -> sign) ? -result : result;
+}
+
+
+int bignum_from_string(BigNum *num, const char *str, int size) {
+    ASSERT(num, INVALID_ARG, "Can't parse into null number!\n");
+    ASSERT(str, INVALID_ARG, "Can't parse null string!\n");
+
+    bignum_zero(num, size);
+
+    const char *text = str;
+
+    int sign = 0;
+    if (*str == '-' || *str == '+') sign = (*str++ == '-');
+
+    // Integer part is the top limb, so larger values can't be represented
+    uint64_t int_part = 0;
+    const char *digit = str;
+    for (; '0' <= *digit && *digit <= '9'; digit++) {
+        int_part = int_part * 10 + (uint64_t)(*digit - '0');
+        ASSERT(int_part <= UINT32_MAX, INVALID_FORMAT, "Integer part of %s is too large!\n", text);
+    }
+
+    ASSERT(digit != str || *digit == '.', INVALID_FORMAT, "Invalid number %s!\n", text);
+
+    if (*digit == '.') {
+        const char *frac = digit + 1;
+        const char *end = frac;
+        for (; '0' <= *end && *end <= '9'; end++) {}
+
+        ASSERT(*end == '\0', INVALID_FORMAT, "Invalid number %s!\n", text);
+        ASSERT(digit != str || end != frac, INVALID_FORMAT, "Number %s has no digits!\n", text);
+
+        // Fraction is accumulated from the last digit: f = (d + f) / 10
+        for (const char *ptr = end - 1; ptr >= frac; ptr--) {
+            num -> limbs[size - 1] = (uint32_t)(*ptr - '0');
+            limbs_div_small(num -> limbs, size, 10);
+        }
+    }
+    else ASSERT(*digit == '\0', INVALID_FORMAT, "Invalid number %s!\n", text);
+
+    num -> limbs[size - 1] = (uint32_t) int_part;
+
+    for (int i = 0; i < size; i++) {
+        if (num -> limbs[i]) {
+            num -> sign = sign;
+            break;
+        }
+    }
+
+    return OK;
+}
+
+
+void bignum_to_string(const BigNum *num, char *str, int digits) {
+    assert(num && "Can't print null number!\n");
+    assert(str && "Can't print into null string!\n");
+
+    int size = num -> size;
+
+    str += sprintf(str, "%s%u.", (num -> sign) ? "-" : "", num -> limbs[size - 1]);
+
+    uint32_t *frac = scratch.product;
+    memcpy(frac, num -> limbs, (size_t)(size - 1) * sizeof(uint32_t));
+
+    for (int d = 0; d < digits; d++) {
+        uint64_t carry = 0;
+        for (int i = 0; i < size - 1; i++) {
+            uint64_t t = (uint64_t) frac[i] * 10 + carry;
+            frac[i] = (uint32_t) t;
+            carry = t >> 32;
+        }
+
+        *str++ = (char)('0' + carry);
+    }
+
+    *str = '\0';
+}
+
+
+void bignum_add(BigNum *res, const BigNum *a, const BigNum *b) {
+    assert(res && a && b && "Can't add null numbers!\n");
+    assert(a -> size == b -> size && "Numbers must have the same size!\n");
+
+    int size = a -> size;
+    int sign = a -> sign;
+
+    if (a -> sign == b -> sign)
+        limbs_add(res -> limbs, a -> limbs, b -> limbs, size);
+    else if (limbs_cmp(a -> limbs, b -> limbs, size) >= 0)
+        limbs_sub(res -> limbs, a -> limbs, b -> limbs, size);
+    else {
+        sign = b -> sign;
+        limbs_sub(res -> limbs, b -> limbs, a -> limbs, size);
+    }
+
+    res -> size = size;
+    res -> sign = 0;
+
+    if (sign) {
+        for (int i = 0; i < size; i++) {
+            if (res -> limbs[i]) {
+                res -> sign = 1;
+                break;
+            }
+        }
+    }
+}
+
+
+void bignum_sub(BigNum *res, const BigNum *a, const BigNum *b) {
+    assert(res && a && b && "Can't subtract null numbers!\n");
+    assert(a -> size == b -> size && "Numbers must have the same size!\n");
+
+    int size = a -> size;
+    int sign = a -> sign;
+
+    if (a -> sign != b -> sign)
+        limbs_add(res -> limbs, a -> limbs, b -> limbs, size);
+    else if (limbs_cmp(a -> limbs, b -> limbs, size) >= 0)
+        limbs_sub(res -> limbs, a -> limbs, b -> limbs, size);
+    else {
+        sign = !a -> sign;
+        limbs_sub(res -> limbs, b -> limbs, a -> limbs, size);
+    }
+
+    res -> size = size;
+    res -> sign = 0;
+
+    if (sign) {
+        for (int i = 0; i < size; i++) {
+            if (res -> limbs[i]) {
+                res -> sign = 1;
+                break;
+            }
+        }
+    }
+}
+
+
+void bignum_mul(BigNum *res, const BigNum *a, const BigNum *b) {
+    assert(res && a && b && "Can't multiply null numbers!\n");
+    assert(a -> size == b -> size && "Numbers must have the same size!\n");
+
+    res -> size = a -> size;
+
+    limbs_mul(scratch.product, a -> limbs, b -> limbs, a -> size, KARATSUBA_THRESHOLD);
+    take_product(res, scratch.product, a -> sign ^ b -> sign);
+}
+
+
+void bignum_sqr(BigNum *res, const BigNum *a) {
+    assert(res && a && "Can't square null numbers!\n");
+
+    res -> size = a -> size;
+
+    limbs_sqr(scratch.product, a -> limbs, a -> size, KARATSUBA_THRESHOLD);
+    take_product(res, scratch.product, 0);
+}
+
+
+double bignum_mandel_step(BigNum *x, BigNum *y, const BigNum *cx, const BigNum *cy) {
+    assert(x && y && cx && cy && "Can't iterate null numbers!\n");
+
+    BigNum *x2 = &scratch.x2, *y2 = &scratch.y2, *sum = &scratch.sum;
+
+    bignum_sqr(x2, x);
+    bignum_sqr(y2, y);
+    bignum_add(sum, x, y);
+    bignum_sqr(sum, sum);
+
+    double norm = bignum_to_double(x2) + bignum_to_double(y2);
+
+    bignum_sub(sum, sum, x2);
+    bignum_sub(sum, sum, y2);
+    bignum_add(y, sum, cy);
+
+    bignum_sub(x, x2, y2);
+    bignum_add(x, x, cx);
+
+    return norm;
+}
+
+
+void limbs_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n, int threshold) {
+    assert(res && a && b && "Can't multiply null limbs!\n");
+
+    if (threshold < KARATSUBA_MIN_LIMBS) threshold = KARATSUBA_MIN_LIMBS;
+
+    if (n < threshold) school_mul(res, a, b, n);
+    else karatsuba_mul(res, a, b, n, threshold, scratch.karatsuba);
+}
+
+
+void limbs_sqr(uint32_t *res, const uint32_t *a, int n, int threshold) {
+    assert(res && a && "Can't square null limbs!\n");
+
+    if (threshold < KARATSUBA_MIN_LIMBS) threshold = KARATSUBA_MIN_LIMBS;
+
+    if (n < threshold) school_sqr(res, a, n);
+    else karatsuba_sqr(res, a, n, threshold, scratch.karatsuba);
+}
+
+
+static uint32_t limbs_add(uint32_t *r, const uint32_t *a, const uint32_t *b, int n) {
+    uint64_t carry = 0;
+
+    for (int i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] + b[i] + carry;
+        r[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+
+    return (uint32_t) carry;
+}
+
+
+static uint32_t limbs_sub(uint32_t *r, const uint32_t *a, const uint32_t *b, int n) {
+    uint64_t borrow = 0;
+
+    for (int i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] - b[i] - borrow;
+        r[i] = (uint32_t) t;
+        borrow = (t >> 32) & 1;
+    }
+
+    return (uint32_t) borrow;
+}
+
+
+static uint32_t limbs_add_short(uint32_t *r, const uint32_t *a, int n, const uint32_t *b, int m) {
+    uint64_t carry = limbs_add(r, a, b, m);
+
+    for (int i = m; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] + carry;
+        r[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+
+    return (uint32_t) carry;
+}
+
+
+static void limbs_sub_in_place(uint32_t *r, int n, const uint32_t *b, int m) {
+    uint64_t borrow = limbs_sub(r, r, b, m);
+
+    for (int i = m; i < n && borrow; i++) {
+        uint64_t t = (uint64_t) r[i] - borrow;
+        r[i] = (uint32_t) t;
+        borrow = (t >> 32) & 1;
+    }
+}
+
+
+static void limbs_add_in_place(uint32_t *r, int n, const uint32_t *b, int m) {
+    uint64_t carry = limbs_add(r, r, b, m);
+
+    for (int i = m; i < n && carry; i++) {
+        uint64_t t = (uint64_t) r[i] + carry;
+        r[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+}
+
+
+static int limbs_cmp(const uint32_t *a, const uint32_t *b, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return (a[i] < b[i]) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static void school_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n) {
+    memset(res, 0, 2 * (size_t) n * sizeof(uint32_t));
+
+    for (int i = 0; i < n; i++) {
+        if (a[i] == 0) continue;
+
+        uint64_t carry = 0;
+        for (int j = 0; j < n; j++) {
+            uint64_t t = (uint64_t) a[i] * b[j] + res[i + j] + carry;
+            res[i + j] = (uint32_t) t;
+            carry = t >> 32;
+        }
+
+        res[i + n] = (uint32_t) carry;
+    }
+}
+
+
+static void school_sqr(uint32_t *res, const uint32_t *a, int n) {
+    memset(res, 0, 2 * (size_t) n * sizeof(uint32_t));
+
+    for (int i = 0; i < n; i++) {
+        uint64_t carry = 0;
+        for (int j = i + 1; j < n; j++) {
+            uint64_t t = (uint64_t) a[i] * a[j] + res[i + j] + carry;
+            res[i + j] = (uint32_t) t;
+            carry = t >> 32;
+        }
+
+        res[i + n] = (uint32_t) carry;
+    }
+
+    uint32_t top = 0;
+    for (int i = 0; i < 2 * n; i++) {
+        uint32_t next = res[i] >> 31;
+        res[i] = (res[i] << 1) | top;
+        top = next;
+    }
+
+    uint64_t carry = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] * a[i] + res[2 * i] + carry;
+        res[2 * i] = (uint32_t) t;
+
+        t = (uint64_t) res[2 * i + 1] + (t >> 32);
+        res[2 * i + 1] = (uint32_t) t;
+        carry = t >> 32;
+    }
+}
+
+
+static void karatsuba_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n, int threshold, uint32_t *tmp) {
+    if (n < threshold || n < KARATSUBA_MIN_LIMBS) {
+        school_mul(res, a, b, n);
+        return;
+    }
+
+    // a = a1 * B^h + a0, where a0 has h limbs and a1 has n1 >= h limbs
+    int h = n / 2, n1 = n - h;
+
+    uint32_t *sum_a = tmp;
+    uint32_t *sum_b = sum_a + n1 + 1;
+    uint32_t *middle = sum_b + n1 + 1;
+    uint32_t *next = middle + 2 * (n1 + 1);
+
+    assert(next <= scratch.karatsuba + SCRATCH_LIMBS && "Karatsuba scratch overflow!\n");
+
+    sum_a[n1] = limbs_add_short(sum_a, a + h, n1, a, h);
+    sum_b[n1] = limbs_add_short(sum_b, b + h, n1, b, h);
+
+    karatsuba_mul(res, a, b, h, threshold, next);
+    karatsuba_mul(res + 2 * h, a + h, b + h, n1, threshold, next);
+    karatsuba_mul(middle, sum_a, sum_b, n1 + 1, threshold, next);
+
+    limbs_sub_in_place(middle, 2 * (n1 + 1), res, 2 * h);
+    limbs_sub_in_place(middle, 2 * (n1 + 1), res + 2 * h, 2 * n1);
+
+    // Middle term is less than 2 * B^n, so its upper limbs are zero
+    int middle_len = 2 * (n1 + 1);
+    if (middle_len > 2 * n - h) middle_len = 2 * n - h;
+
+    limbs_add_in_place(res + h, 2 * n - h, middle, middle_len);
+}
+
+
+static void karatsuba_sqr(uint32_t *res, const uint32_t *a, int n, int threshold, uint32_t *tmp) {
+    if (n < threshold || n < KARATSUBA_MIN_LIMBS) {
+        school_sqr(res, a, n);
+        return;
+    }
+
+    int h = n / 2, n1 = n - h;
+
+    uint32_t *sum = tmp;
+    uint32_t *middle = sum + n1 + 1;
+    uint32_t *next = middle + 2 * (n1 + 1);
+
+    assert(next <= scratch.karatsuba + SCRATCH_LIMBS && "Karatsuba scratch overflow!\n");
+
+    sum[n1] = limbs_add_short(sum, a + h, n1, a, h);
+
+    karatsuba_sqr(res, a, h, threshold, next);
+    karatsuba_sqr(res + 2 * h, a + h, n1, threshold, next);
+    karatsuba_sqr(middle, sum, n1 + 1, threshold, next);
+
+    limbs_sub_in_place(middle, 2 * (n1 + 1), res, 2 * h);
+    limbs_sub_in_place(middle, 2 * (n1 + 1), res + 2 * h, 2 * n1);
+
+    int middle_len = 2 * (n1 + 1);
+    if (middle_len > 2 * n - h) middle_len = 2 * n - h;
+
+    limbs_add_in_place(res + h, 2 * n - h, middle, middle_len);
+}
+
+
+static void take_product(BigNum *res, const uint32_t *product, int sign) {
+    int size = res -> size;
+
+    // Product has 2 * (size - 1) fraction limbs, so drop lower size - 1 of them
+    memcpy(res -> limbs, product + size - 1, (size_t) size * sizeof(uint32_t));
+
+    res -> sign = 0;
+    if (sign) {
+        for (int i = 0; i < size; i++) {
+            if (res -> limbs[i]) {
+                res -> sign = 1;
+                break;
+            }
+        }
+    }
+}
+
+
+static void limbs_div_small(uint32_t *num, int n, uint32_t divisor) {
+    uint64_t rem = 0;
+
+    for (int i = n - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | num[i];
+        num[i] = (uint32_t)(cur / divisor);
+        rem = cur % divisor;
+    }
+}
@@ -0,0 +1,164 @@
+/**
+ * \file
+ * \brief Header file for fixed-limb multiprecision numbers used by reference orbits
+*/
+
+#ifndef BIGNUM_HPP
+#define BIGNUM_HPP
+
+#include <stdint.h>
+#include "configs.hpp"
+
+
+/**
+ * \brief Signed fixed point number with runtime precision
+ * \note Limbs are stored least significant first. The last used limb holds integer part,
+ * the rest hold fraction, so precision is 32 * (size - 1) bits
+*/
+typedef struct {
+    int sign = 0;                               ///< Non zero value means negative number
+    int size = 0;                               ///< Number of limbs in use
+    uint32_t limbs[BIGNUM_MAX_LIMBS] = {};      ///< Number magnitude
+} BigNum;
+
+
+/**
+ * \brief Returns number of limbs required to store number with given fraction precision
+ * \param [in] bits Fraction precision in bits
+ * \return Limbs number including integer limb
+*/
+int bignum_size_for_bits(int bits);
+
+
+/**
+ * \brief Sets number to zero with given size
+ * \param [out] num     Number to set
+ * \param [in]  size    Number of limbs
+*/
+void bignum_zero(BigNum *num, int size);
+
+
+/**
+ * \brief Converts double into number with given size
+ * \param [out] num     Number to set
+ * \param [in]  value   Source value, its integer part must fit in 32 bits
+ * \param [in]  size    Number of limbs
+*/
+void bignum_set_double(BigNum *num, double value, int size);
+
+
+/**
+ * \brief Converts mantissa * 2^exponent into number with given size, bits below precision are dropped
+ * \param [out] num         Number to set
+ * \param [in]  mantissa    Mantissa
+ * \param [in]  exponent    Binary exponent, value integer part must fit in 32 bits
+ * \param [in]  size        Number of limbs
+*/
+void bignum_set_double_exp(BigNum *num, double mantissa, int64_t exponent, int size);
+
+
+/**
+ * \brief Changes number precision keeping its value, lower fraction bits are dropped when size decreases
+ * \param [in,out] num     Number to resize
+ * \param [in]     size    New number of limbs
+*/
+void bignum_resize(BigNum *num, int size);
+
+
+/**
+ * \brief Clears bits below 2^exponent, so magnitude is rounded toward zero to a multiple of 2^exponent
+ * \param [in,out] num         Number to round
+ * \param [in]     exponent    Binary exponent of the lowest kept bit
+*/
+void bignum_truncate(BigNum *num, int64_t exponent);
+
+
+/**
+ * \brief Converts number into double
+ * \param [in] num  Number to convert
+ * \return Nearest double value (lower bits are truncated)
+*/
+double bignum_to_double(const BigNum *num);
+
+
+/**
+ * \brief Parses decimal string like "-0.7453" into number with given size
+ * \param [out] num     Number to set
+ * \param [in]  str     Source string
+ * \param [in]  size    Number of limbs
+ * \return Non zero value means error
+*/
+int bignum_from_string(BigNum *num, const char *str, int size);
+
+
+/**
+ * \brief Prints number as decimal string
+ * \param [in]  num     Number to print
+ * \param [out] str     Buffer to store string
+ * \param [in]  digits  Number of fraction digits to print, str must fit digits + 16 characters
+*/
+void bignum_to_string(const BigNum *num, char *str, int digits);
+
+
+/**
+ * \brief Calculates a + b
+ * \note All numbers must have the same size, res can be the same as a or b
+*/
+void bignum_add(BigNum *res, const BigNum *a, const BigNum *b);
+
+
+/**
+ * \brief Calculates a - b
+ * \note All numbers must have the same size, res can be the same as a or b
+*/
+void bignum_sub(BigNum *res, const BigNum *a, const BigNum *b);
+
+
+/**
+ * \brief Calculates a * b
+ * \note All numbers must have the same size, res can be the same as a or b
+*/
+void bignum_mul(BigNum *res, const BigNum *a, const BigNum *b);
+
+
+/**
+ * \brief Calculates a * a
+ * \note All numbers must have the same size, res can be the same as a
+*/
+void bignum_sqr(BigNum *res, const BigNum *a);
+
+
+/**
+ * \brief Calculates one step of Mandelbrot recurrence z = z^2 + c
+ * \note Uses three squares instead of two squares and a product, because 2xy = (x + y)^2 - x^2 - y^2
+ * \param [in,out]  x   Real part of z
+ * \param [in,out]  y   Imaginary part of z
+ * \param [in]      cx  Real part of c
+ * \param [in]      cy  Imaginary part of c
+ * \return Squared distance from center before the step
+*/
+double bignum_mandel_step(BigNum *x, BigNum *y, const BigNum *cx, const BigNum *cy);
+
+
+/**
+ * \brief Multiplies n limbs magnitudes into 2n limbs
+ * \param [out] res         Product buffer of 2n limbs, must not overlap with a or b
+ * \param [in]  a           First factor
+ * \param [in]  b           Second factor
+ * \param [in]  n           Factors length
+ * \param [in]  threshold   Karatsuba is used for lengths not less than threshold
+*/
+void limbs_mul(uint32_t *res, const uint32_t *a, const uint32_t *b, int n, int threshold);
+
+
+/**
+ * \brief Squares n limbs magnitude into 2n limbs
+ * \param [out] res         Product buffer of 2n limbs, must not overlap with a
+ * \param [in]  a           Factor
+ * \param [in]  n           Factor length
+ * \param [in]  threshold   Karatsuba is used for lengths not less than threshold
+*/
+void limbs_sqr(uint32_t *res, const uint32_t *a, int n, int threshold);
+
+
+#endif
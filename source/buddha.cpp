@@ -0,0 +1,661 @@
+/**
+ * \file
+ * \brief Renders Buddhabrot window with uniform or Metropolis-Hastings sampling of orbit start points
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "image.hpp"
+#include "pool.hpp"
+
+
+const double BUDDHA_RADIUS = 2;                 ///< Start points are taken from [-R, R] x [-R, R]
+const double BUDDHA_BAILOUT = 4;                ///< Squared escape radius
+const double BUDDHA_RANDOM_PROB = 0.2;          ///< Probability of uniform proposal instead of mutation
+const double BUDDHA_MUTATION_MIN = 1e-4;        ///< Smallest mutation radius in window spans
+const double BUDDHA_MUTATION_MAX = 1e-1;        ///< Biggest mutation radius in window spans
+const int BUDDHA_CLOCK_STEPS = 256;             ///< Orbits between deadline checks
+const int BUDDHA_BINS_SIDE = 8;                 ///< Window is split into side x side bins to measure sampling error
+const int BUDDHA_BINS = BUDDHA_BINS_SIDE * BUDDHA_BINS_SIDE;   ///< Number of error bins
+const int BUDDHA_BATCHES = 64;                  ///< Max batches of one chain, neighbour batches are merged when it is reached
+const long BUDDHA_BATCH_STEPS = 256;            ///< Initial batch length in orbits
+
+
+/// Start point samplers
+typedef enum {
+    SAMPLER_UNIFORM     = 0,        ///< Every start point is independent and uniform
+    SAMPLER_METROPOLIS  = 1,        ///< Markov chain with orbit contribution to the window as target density
+    SAMPLER_COMPARE     = 2,        ///< Runs both samplers for the same time, saves Metropolis-Hastings image
+} BuddhaSampler;
+
+
+/// Buddhabrot settings taken from command line
+typedef struct {
+    double center_x = -0.5;                     ///< Window center x
+    double center_y = 0;                        ///< Window center y
+    double span = 4;                            ///< Window width
+    int width = 800;                            ///< Image width
+    int height = 800;                           ///< Image height
+    int nmax = 1024;                            ///< Max iteration number
+    int min_iters = 16;                         ///< Shorter orbits are dropped
+    int threads = 0;                            ///< Number of threads, zero means all cores
+    double seconds = 10;                        ///< Sampling time of one sampler
+    BuddhaSampler sampler = SAMPLER_COMPARE;    ///< Start point sampler
+    const char *output = "buddha.ppm";          ///< Output image
+} BuddhaArgs;
+
+
+/// Window in plane coordinates, read only for chains
+typedef struct {
+    double left = 0;                            ///< X of the left image edge
+    double top = 0;                             ///< Y of the top image edge
+    double scale = 0;                           ///< Pixels per plane unit
+    int width = 0;                              ///< Image width
+    int height = 0;                             ///< Image height
+    int nmax = 0;                               ///< Max iteration number
+    int min_iters = 0;                          ///< Shorter orbits are dropped
+    const uint8_t *bins = nullptr;              ///< Error bin of every window pixel
+    double mutation_min = 0;                    ///< Smallest mutation radius
+    double mutation_max = 0;                    ///< Biggest mutation radius
+} BuddhaWindow;
+
+
+/// State of one chain, everything the hot loop touches is private to it
+typedef struct {
+    uint64_t random = 0;                        ///< Xorshift state
+    double *histogram = nullptr;                ///< Accumulated orbit density, width * height
+    int *current = nullptr;                     ///< Window pixels of the current orbit
+    int *proposal = nullptr;                    ///< Window pixels of the proposed orbit
+    int current_count = 0;                      ///< Number of window pixels of the current orbit
+    double current_x = 0;                       ///< Current start point x
+    double current_y = 0;                       ///< Current start point y
+    long orbits = 0;                            ///< Number of iterated orbits
+    long accepted = 0;                          ///< Number of distinct contributing orbits
+    long points = 0;                            ///< Number of deposited window points
+    double bins[BUDDHA_BINS] = {};              ///< Histogram sums of error bins in the current batch
+    double *batches = nullptr;                  ///< Bin sums of finished batches, BUDDHA_BATCHES x BUDDHA_BINS
+    int batches_count = 0;                      ///< Number of finished batches
+    long batch_steps = 0;                       ///< Batch length in orbits, doubles when batches are merged
+    long batch_step = 0;                        ///< Orbits of the current batch
+} BuddhaChain;
+
+
+/// Arguments of chain tasks
+typedef struct {
+    const BuddhaWindow *window = nullptr;       ///< Rendered window
+    BuddhaChain *chains = nullptr;              ///< Chain states, one per task
+    BuddhaSampler sampler = SAMPLER_UNIFORM;    ///< Start point sampler
+    double deadline = 0;                        ///< Time when chains stop
+} ChainTaskArgs;
+
+
+/// Totals of one sampler run
+typedef struct {
+    double seconds = 0;                         ///< Sampling time
+    long orbits = 0;                            ///< Number of iterated orbits
+    long accepted = 0;                          ///< Number of distinct contributing orbits
+    long points = 0;                            ///< Number of deposited window points
+    double effective[BUDDHA_BINS] = {};         ///< Effective samples of every error bin
+    double effective_median = 0;                ///< Median of effective samples over error bins
+} BuddhaStats;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], BuddhaArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Allocates chain buffers and seeds its generator
+ * \param [out] chain   Chain to create
+ * \param [in]  window  Rendered window
+ * \param [in]  seed    Generator seed, different for every chain
+ * \return Non zero value means error
+*/
+int buddha_chain_create(BuddhaChain *chain, const BuddhaWindow *window, uint64_t seed);
+
+
+/**
+ * \brief Frees chain buffers
+ * \param [in] chain    Chain to free
+*/
+void buddha_chain_free(BuddhaChain *chain);
+
+
+/**
+ * \brief Runs all chains with the sampler for the given time and sums their counters
+ * \param [in]  pool    Worker pool, one chain per thread
+ * \param [in]  args    Chain task arguments, deadline is set here
+ * \param [in]  count   Number of chains
+ * \param [in]  seconds Sampling time
+ * \param [out] stats   Run totals
+*/
+void buddha_run(WorkerPool *pool, ChainTaskArgs *args, int count, double seconds, BuddhaStats *stats);
+
+
+/**
+ * \brief Estimates effective samples of every error bin from batch means of all chains
+ * \note Effective samples of a bin are squared ratio of its sum to the standard error of the sum, so they count
+ * independent samples that give the same relative error and include autocorrelation of the chain
+ * \param [in]  chains  Chain states
+ * \param [in]  count   Number of chains
+ * \param [out] stats   Run totals to fill with effective samples
+*/
+void estimate_effective(const BuddhaChain *chains, int count, BuddhaStats *stats);
+
+
+/**
+ * \brief Prints run totals, effective samples are the median over error bins
+ * \param [in] name     Sampler name
+ * \param [in] stats    Run totals
+*/
+void print_stats(const char *name, const BuddhaStats *stats);
+
+
+/**
+ * \brief Prints how many times faster Metropolis-Hastings reaches the same relative error as uniform sampler
+ * \note Speedup is median over error bins that uniform sampler reached
+ * \param [in] uniform     Totals of uniform run
+ * \param [in] metropolis  Totals of Metropolis-Hastings run
+*/
+void print_speedup(const BuddhaStats *uniform, const BuddhaStats *metropolis);
+
+
+/**
+ * \brief Sums chain histograms and saves square root tone mapped grayscale image
+ * \param [in] args     Settings
+ * \param [in] chains   Chain states
+ * \param [in] count    Number of chains
+ * \return Non zero value means error
+*/
+int save_image(const BuddhaArgs *args, BuddhaChain *chains, int count);
+
+
+/**
+ * \brief Samples orbits with one chain until the deadline
+*/
+static void chain_task(void *arg, int index);
+
+
+/**
+ * \brief Iterates orbit of c and stores indices of window pixels it passes
+ * \return Number of stored pixels, zero for orbits that don't escape or are too short
+*/
+static int trace_orbit(const BuddhaWindow *window, double cx, double cy, int *pixels);
+
+
+/**
+ * \brief Tells whether c lies in main cardioid or period 2 bulb, such orbits never escape
+*/
+static bool in_main_bulbs(double cx, double cy);
+
+
+/**
+ * \brief Stores bin sums of the current batch, merges neighbour batches when all of them are used
+*/
+static void finish_batch(BuddhaChain *chain);
+
+
+/**
+ * \brief Returns pseudo random number in [0, 1)
+*/
+static double random_unit(uint64_t *state);
+
+
+/**
+ * \brief Compares doubles for qsort
+*/
+static int compare_doubles(const void *a, const void *b);
+
+
+
+
+int main(int argc, char *argv[]) {
+    BuddhaArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    BuddhaWindow window = {};
+    window.scale = args.width / args.span;
+    window.left = args.center_x - 0.5 * args.span;
+    window.top = args.center_y - 0.5 * args.height / window.scale;
+    window.width = args.width;
+    window.height = args.height;
+    window.nmax = args.nmax;
+    window.min_iters = args.min_iters;
+    window.mutation_min = BUDDHA_MUTATION_MIN * args.span;
+    window.mutation_max = BUDDHA_MUTATION_MAX * args.span;
+
+    uint8_t *bins = (uint8_t *) calloc((size_t) args.width * (size_t) args.height, sizeof(uint8_t));
+    ASSERT(bins, ALLOC_FAIL, "Can't allocate error bins!\n");
+
+    for (int y = 0; y < args.height; y++) {
+        for (int x = 0; x < args.width; x++)
+            bins[y * args.width + x] = (uint8_t) (y * BUDDHA_BINS_SIDE / args.height * BUDDHA_BINS_SIDE +
+                                                  x * BUDDHA_BINS_SIDE / args.width);
+    }
+
+    window.bins = bins;
+
+    WorkerPool pool = {};
+    ASSERT(!pool_create(&pool, args.threads), ALLOC_FAIL, "Can't start worker pool!\n");
+
+    int count = pool.threads_count;
+
+    BuddhaChain *chains = (BuddhaChain *) calloc((size_t) count, sizeof(BuddhaChain));
+    int result = chains ? OK : ALLOC_FAIL;
+
+    ChainTaskArgs task = {};
+    task.window = &window;
+
+    BuddhaStats uniform = {}, metropolis = {};
+
+    if (!result && args.sampler != SAMPLER_METROPOLIS) {
+        for (int i = 0; i < count && !result; i++) result = buddha_chain_create(&chains[i], &window, (uint64_t) i + 1);
+
+        if (!result) {
+            task.chains = chains;
+            task.sampler = SAMPLER_UNIFORM;
+
+            buddha_run(&pool, &task, count, args.seconds, &uniform);
+            print_stats("Uniform", &uniform);
+
+            if (args.sampler == SAMPLER_UNIFORM) result = save_image(&args, chains, count);
+        }
+
+        for (int i = 0; i < count; i++) buddha_chain_free(&chains[i]);
+    }
+
+    if (!result && args.sampler != SAMPLER_UNIFORM) {
+        for (int i = 0; i < count && !result; i++) result = buddha_chain_create(&chains[i], &window, (uint64_t) i + 1);
+
+        if (!result) {
+            task.chains = chains;
+            task.sampler = SAMPLER_METROPOLIS;
+
+            buddha_run(&pool, &task, count, args.seconds, &metropolis);
+            print_stats("Metropolis-Hastings", &metropolis);
+
+            result = save_image(&args, chains, count);
+        }
+
+        for (int i = 0; i < count; i++) buddha_chain_free(&chains[i]);
+    }
+
+    if (!result && args.sampler == SAMPLER_COMPARE) print_speedup(&uniform, &metropolis);
+
+    free(chains);
+    free(bins);
+    pool_destroy(&pool);
+
+    return result;
+}
+
+
+int parse_args(int argc, char *argv[], BuddhaArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-x")) args -> center_x = atof(value);
+        else if (!strcmp(argv[i - 1], "-y")) args -> center_y = atof(value);
+        else if (!strcmp(argv[i - 1], "-s")) args -> span = atof(value);
+        else if (!strcmp(argv[i - 1], "-w")) args -> width = atoi(value);
+        else if (!strcmp(argv[i - 1], "-h")) args -> height = atoi(value);
+        else if (!strcmp(argv[i - 1], "-n")) args -> nmax = atoi(value);
+        else if (!strcmp(argv[i - 1], "-l")) args -> min_iters = atoi(value);
+        else if (!strcmp(argv[i - 1], "-t")) args -> threads = atoi(value);
+        else if (!strcmp(argv[i - 1], "-d")) args -> seconds = atof(value);
+        else if (!strcmp(argv[i - 1], "-m")) {
+            if      (!strcmp(value, "uniform")) args -> sampler = SAMPLER_UNIFORM;
+            else if (!strcmp(value, "mh"))      args -> sampler = SAMPLER_METROPOLIS;
+            else if (!strcmp(value, "compare")) args -> sampler = SAMPLER_COMPARE;
+            else ASSERT(0, INVALID_ARG, "Unknown sampler %s!\n", value);
+        }
+        else if (!strcmp(argv[i - 1], "-o")) args -> output = value;
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(args -> span > 0, INVALID_ARG, "Invalid span!\n");
+    ASSERT(args -> width > 0 && args -> height > 0, INVALID_ARG, "Invalid image size!\n");
+    ASSERT(args -> nmax > 0, INVALID_ARG, "Invalid max iteration number!\n");
+    ASSERT(args -> min_iters >= 0 && args -> min_iters < args -> nmax, INVALID_ARG, "Invalid min orbit length!\n");
+    ASSERT(args -> threads >= 0, INVALID_ARG, "Invalid number of threads!\n");
+    ASSERT(args -> seconds > 0, INVALID_ARG, "Invalid sampling time!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: buddha.exe [-x center_x] [-y center_y] [-s span] [-w width] [-h height] [-n nmax] [-l min_iters] [-t threads] [-d seconds] [-m uniform|mh|compare] [-o output.ppm]\n");
+}
+
+
+int buddha_chain_create(BuddhaChain *chain, const BuddhaWindow *window, uint64_t seed) {
+    ASSERT(chain, INVALID_ARG, "Can't create null chain!\n");
+    ASSERT(window, INVALID_ARG, "Can't create chain without window!\n");
+
+    *chain = {};
+
+    // Splitmix step, so close seeds give unrelated streams
+    seed = (seed + 0x9e3779b97f4a7c15) * 0xbf58476d1ce4e5b9;
+    chain -> random = (seed ^ (seed >> 31)) | 1;
+
+    chain -> histogram = (double *) calloc((size_t) window -> width * (size_t) window -> height, sizeof(double));
+    chain -> current = (int *) calloc((size_t) window -> nmax, sizeof(int));
+    chain -> proposal = (int *) calloc((size_t) window -> nmax, sizeof(int));
+    chain -> batches = (double *) calloc(BUDDHA_BATCHES * BUDDHA_BINS, sizeof(double));
+    chain -> batch_steps = BUDDHA_BATCH_STEPS;
+
+    if (!chain -> histogram || !chain -> current || !chain -> proposal || !chain -> batches) {
+        buddha_chain_free(chain);
+
+        printf("Can't allocate chain buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    return OK;
+}
+
+
+void buddha_chain_free(BuddhaChain *chain) {
+    if (!chain) return;
+
+    free(chain -> histogram);
+    free(chain -> current);
+    free(chain -> proposal);
+    free(chain -> batches);
+
+    *chain = {};
+}
+
+
+void buddha_run(WorkerPool *pool, ChainTaskArgs *args, int count, double seconds, BuddhaStats *stats) {
+    double start = get_seconds();
+    args -> deadline = start + seconds;
+
+    pool_run(pool, chain_task, args, count);
+
+    *stats = {};
+    stats -> seconds = get_seconds() - start;
+
+    for (int i = 0; i < count; i++) {
+        stats -> orbits += args -> chains[i].orbits;
+        stats -> accepted += args -> chains[i].accepted;
+        stats -> points += args -> chains[i].points;
+    }
+
+    estimate_effective(args -> chains, count, stats);
+}
+
+
+void estimate_effective(const BuddhaChain *chains, int count, BuddhaStats *stats) {
+    for (int bin = 0; bin < BUDDHA_BINS; bin++) {
+        double sum = 0, variance = 0;
+
+        // Batches of different chains are independent, so variances of chain sums add up
+        for (int i = 0; i < count; i++) {
+            const BuddhaChain *chain = chains + i;
+
+            int batches = chain -> batches_count;
+            if (batches < 2) continue;
+
+            double chain_sum = 0, chain_sum2 = 0;
+            for (int j = 0; j < batches; j++) {
+                double value = chain -> batches[j * BUDDHA_BINS + bin];
+
+                chain_sum += value;
+                chain_sum2 += value * value;
+            }
+
+            double spread = (chain_sum2 - chain_sum * chain_sum / batches) / (batches - 1);
+
+            sum += chain_sum;
+            variance += batches * fmax(spread, 0);
+        }
+
+        stats -> effective[bin] = (variance > 0) ? sum * sum / variance : 0;
+    }
+
+    double sorted[BUDDHA_BINS] = {};
+    memcpy(sorted, stats -> effective, sizeof(sorted));
+    qsort(sorted, BUDDHA_BINS, sizeof(double), compare_doubles);
+
+    stats -> effective_median = sorted[BUDDHA_BINS / 2];
+}
+
+
+void print_stats(const char *name, const BuddhaStats *stats) {
+    double seconds = stats -> seconds;
+
+    printf("%s: %ld orbits (%.3g/s), %ld accepted (%.3f%%), %ld window points (%.3g/s), "
+           "%.3g effective samples per bin (%.3g/s)\n", name, stats -> orbits, (double) stats -> orbits / seconds,
+           stats -> accepted, stats -> orbits ? 100.0 * (double) stats -> accepted / (double) stats -> orbits : 0.0,
+           stats -> points, (double) stats -> points / seconds, stats -> effective_median,
+           stats -> effective_median / seconds);
+}
+
+
+void print_speedup(const BuddhaStats *uniform, const BuddhaStats *metropolis) {
+    double speedups[BUDDHA_BINS] = {};
+    int count = 0;
+
+    // Time to reach the same relative error is inversely proportional to effective samples per second
+    for (int bin = 0; bin < BUDDHA_BINS; bin++) {
+        if (uniform -> effective[bin] <= 0) continue;
+
+        speedups[count++] = (metropolis -> effective[bin] / metropolis -> seconds) /
+                            (uniform -> effective[bin] / uniform -> seconds);
+    }
+
+    if (!count) {
+        printf("Speedup at equal error: uniform sampler did not reach any error bin often enough\n");
+        return;
+    }
+
+    qsort(speedups, (size_t) count, sizeof(double), compare_doubles);
+
+    printf("Speedup at equal error: %.1fx, median over %d of %d bins reached by uniform sampler\n",
+           speedups[count / 2], count, BUDDHA_BINS);
+}
+
+
+int save_image(const BuddhaArgs *args, BuddhaChain *chains, int count) {
+    size_t pixels_count = (size_t) args -> width * (size_t) args -> height;
+
+    double *histogram = chains[0].histogram;
+    for (int i = 1; i < count; i++) {
+        for (size_t j = 0; j < pixels_count; j++) histogram[j] += chains[i].histogram[j];
+    }
+
+    double max = 0;
+    for (size_t j = 0; j < pixels_count; j++) max = fmax(max, histogram[j]);
+
+    uint8_t *pixels = (uint8_t *) calloc(pixels_count, 4);
+    ASSERT(pixels, ALLOC_FAIL, "Can't allocate image!\n");
+
+    for (size_t j = 0; j < pixels_count; j++) {
+        uint8_t value = (uint8_t) (max > 0 ? 255 * sqrt(histogram[j] / max) : 0);
+
+        pixels[4 * j + 0] = value;
+        pixels[4 * j + 1] = value;
+        pixels[4 * j + 2] = value;
+        pixels[4 * j + 3] = 255;
+    }
+
+    int result = write_ppm(args -> output, pixels, args -> width, args -> height);
+
+    free(pixels);
+    return result;
+}
+
+
+static void chain_task(void *arg, int index) {
+    const ChainTaskArgs *args = (const ChainTaskArgs *) arg;
+    const BuddhaWindow *window = args -> window;
+
+    // Local copy, so counters of neighbour chains never share cache line in the hot loop
+    BuddhaChain chain = args -> chains[index];
+    double *histogram = chain.histogram;
+
+    while (get_seconds() < args -> deadline) {
+        for (int step = 0; step < BUDDHA_CLOCK_STEPS; step++) {
+            double cx = 0, cy = 0;
+
+            // Mutation is symmetric and independent of the state, so acceptance is plain ratio of contributions
+            if (!chain.current_count || random_unit(&chain.random) < BUDDHA_RANDOM_PROB ||
+                args -> sampler == SAMPLER_UNIFORM) {
+                cx = BUDDHA_RADIUS * (2 * random_unit(&chain.random) - 1);
+                cy = BUDDHA_RADIUS * (2 * random_unit(&chain.random) - 1);
+            } else {
+                double radius = window -> mutation_max *
+                                pow(window -> mutation_min / window -> mutation_max, random_unit(&chain.random));
+                double angle = 2 * M_PI * random_unit(&chain.random);
+
+                cx = chain.current_x + radius * cos(angle);
+                cy = chain.current_y + radius * sin(angle);
+            }
+
+            int count = trace_orbit(window, cx, cy, chain.proposal);
+            chain.orbits++;
+
+            if (args -> sampler == SAMPLER_UNIFORM) {
+                if (!count) continue;
+
+                for (int i = 0; i < count; i++) {
+                    histogram[chain.proposal[i]] += 1;
+                    chain.bins[window -> bins[chain.proposal[i]]] += 1;
+                }
+
+                chain.accepted++;
+                chain.points += count;
+                continue;
+            }
+
+            if (count && (count >= chain.current_count ||
+                          random_unit(&chain.random) * chain.current_count < count)) {
+                int *swap = chain.current;
+                chain.current = chain.proposal;
+                chain.proposal = swap;
+
+                chain.current_count = count;
+                chain.current_x = cx;
+                chain.current_y = cy;
+
+                chain.accepted++;
+            }
+
+            if (!chain.current_count) continue;
+
+            // Target density is proportional to contribution, so 1 / f weight gives unbiased image
+            double weight = 1.0 / chain.current_count;
+            for (int i = 0; i < chain.current_count; i++) {
+                histogram[chain.current[i]] += weight;
+                chain.bins[window -> bins[chain.current[i]]] += weight;
+            }
+
+            chain.points += chain.current_count;
+        }
+
+        chain.batch_step += BUDDHA_CLOCK_STEPS;
+        if (chain.batch_step >= chain.batch_steps) finish_batch(&chain);
+    }
+
+    args -> chains[index] = chain;
+}
+
+
+static int trace_orbit(const BuddhaWindow *window, double cx, double cy, int *pixels) {
+    if (in_main_bulbs(cx, cy)) return 0;
+
+    double x = 0, y = 0;
+    int count = 0, n = 0;
+
+    for (; n < window -> nmax; n++) {
+        double x2 = x * x, y2 = y * y;
+        if (x2 + y2 > BUDDHA_BAILOUT) break;
+
+        y = 2 * x * y + cy;
+        x = x2 - y2 + cx;
+
+        // Points left of the window give negative offsets, so the comparison is done before truncation
+        double px = (x - window -> left) * window -> scale;
+        double py = (y - window -> top) * window -> scale;
+
+        if (px >= 0 && py >= 0 && px < window -> width && py < window -> height) {
+            pixels[count++] = (int) py * window -> width + (int) px;
+        }
+    }
+
+    if (n == window -> nmax || n < window -> min_iters) return 0;
+
+    return count;
+}
+
+
+static bool in_main_bulbs(double cx, double cy) {
+    double y2 = cy * cy;
+
+    double q = (cx - 0.25) * (cx - 0.25) + y2;
+    if (q * (q + (cx - 0.25)) <= 0.25 * y2) return true;
+
+    return (cx + 1) * (cx + 1) + y2 <= 0.0625;
+}
+
+
+static void finish_batch(BuddhaChain *chain) {
+    memcpy(chain -> batches + chain -> batches_count * BUDDHA_BINS, chain -> bins, sizeof(chain -> bins));
+    memset(chain -> bins, 0, sizeof(chain -> bins));
+
+    chain -> batch_step = 0;
+    if (++chain -> batches_count < BUDDHA_BATCHES) return;
+
+    // Batches must stay longer than autocorrelation of the chain, so their length grows with the run
+    for (int i = 0; i < BUDDHA_BATCHES / 2; i++) {
+        for (int bin = 0; bin < BUDDHA_BINS; bin++)
+            chain -> batches[i * BUDDHA_BINS + bin] = chain -> batches[2 * i * BUDDHA_BINS + bin] +
+                                                      chain -> batches[(2 * i + 1) * BUDDHA_BINS + bin];
+    }
+
+    chain -> batches_count = BUDDHA_BATCHES / 2;
+    chain -> batch_steps *= 2;
+}
+
+
+static double random_unit(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    // Xorshift64*, top 53 bits make the mantissa
+    return (double) ((x * 0x2545f4914f6cdd1d) >> 11) * 0x1.0p-53;
+}
+
+
+static int compare_doubles(const void *a, const void *b) {
+    double first = *(const double *) a, second = *(const double *) b;
+
+    return (first > second) - (first < second);
+}
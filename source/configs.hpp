@@ -3,6 +3,10 @@
  * \brief This file contains import constant values
 */
 
+#ifndef CONFIGS_HPP
+#define CONFIGS_HPP
+
+
 const int SCREEN_W = 1080;                      ///< Screen width in pixels
 const int SCREEN_H = 1080;                      ///< Screen height in pixels
 
@@ -23,5 +27,74 @@ const int POSSIBLE_COLORS = 16;                 ///< Possible non black colors
 const float CENTER_X = -0.75;                   ///< Initial X0 additional offset
 const float CENTER_Y = 0;                       ///< Initial Y0 additional offset
 
+const int DIRTY_BAND_ROWS = 24;                 ///< Rows of the screen band that is uploaded as one rectangle
+
+const float RAW_BAILOUT = 256;                  ///< Escape radius of raw planes render, large radius gives accurate smooth values
+const float RAW_DISTANCE_SCALE = 0.25f;         ///< Distance estimate in pixels that is shaded half gray
+
+const int FRAME_HISTORY = 240;                  ///< Frames kept for frame time graph and percentiles
+const float FRAME_GRAPH_HEIGHT = 160;           ///< Frame time graph height in pixels
+const float FRAME_GRAPH_MAX_MS = 50;            ///< Frame time at the top of the graph, longer frames are clipped
+const float FRAME_BUDGET_MS = 1000.0f / 60;     ///< Frame time of 60 FPS, drawn as a line on the graph
+
 const float SET_W = 3.5;                        ///< Initial X scale
 const float SET_H = 3.5;                        ///< Initial Y scale
+
+const int BIGNUM_MAX_BITS = 4096;               ///< Max reference orbit precision in bits
+const int BIGNUM_MAX_LIMBS = BIGNUM_MAX_BITS / 32 + 2;  ///< Fraction limbs, integer limb and guard limb
+const int KARATSUBA_THRESHOLD = 32;             ///< Min limbs number to multiply with Karatsuba
+
+const int PERTURB_GUARD_BITS = 64;              ///< Reference precision above pixel size
+const double PERTURB_GLITCH_TOL = 1e-6;         ///< Pixel is glitched if |z|^2 < tol * |Z|^2
+const int PERTURB_DOUBLE_MIN_LOG2 = -1000;      ///< Min log2 of pixel size for plain double deltas
+const int PERTURB_BAND_ROWS = 8;                ///< Rows rendered by one worker pool task
+const int PERTURB_MAX_ROUNDS = 16;              ///< Max number of glitch correction rounds
+const int PERTURB_MAX_CLUSTERS = 64;            ///< Max secondary references calculated in one round
+const int PERTURB_RESUME_CHUNK = 4096;          ///< Resumed pixels rendered by one worker pool task
+
+const int ORBIT_COMPRESS_MIN_LENGTH = 1 << 16;  ///< Reference orbits of that length are compressed by default
+const double ORBIT_COMPRESS_TOL = 1e-12;        ///< Max relative error of restored reference orbit point
+const int ORBIT_WAYPOINTS_MIN_CAPACITY = 64;    ///< Initial capacity of compressed orbit waypoints
+
+const int NUCLEUS_MAX_STEPS = 64;               ///< Max Newton steps at one precision
+const int NUCLEUS_MAX_REFINES = 8;              ///< Max precision increases after Newton converged
+const int NUCLEUS_STEP_GUARD_BITS = 16;         ///< Newton converged when step is that much above precision
+const double NUCLEUS_VIEW_SCALE = 8;            ///< View span that shows whole minibrot in nucleus sizes
+
+const int ESTIMATE_STRIDE = 16;                 ///< One pixel of every stride x stride cell is sampled by default
+const int ESTIMATE_RUN = 4;                     ///< Neighbour pixels sampled in a row, so lanes are as coherent as in render
+const int ESTIMATE_CHUNK = 1024;                ///< Sampled pixels rendered by one worker pool task
+const int ESTIMATE_CLUSTER_PIXELS = 16;         ///< Typical glitch cluster size, every cluster needs a secondary reference
+const double ESTIMATE_Z = 1.96;                 ///< Normal quantile of 95% error bound
+
+const int REMOTE_PORT = 7878;                   ///< Default TCP port of remote viewer back end
+const int REMOTE_TILE = 60;                     ///< Side of square screen tile that remote viewer compares and sends as one unit
+
+const int HTTP_PORT = 8080;                     ///< Default TCP port of HTTP tile server
+
+const int STREAM_TILE = 120;                    ///< Side of square tile that streamed render delivers as one unit, multiple of 8
+
+#define TILE_CACHE_NAME "/mandelbrot-tiles"     ///< Shared memory object of tile cache
+const int TILE_CACHE_SIZE = 64;                 ///< Side of cached square tile in pixels
+const int TILE_CACHE_SLOTS = 4096;              ///< Tiles in shared cache, about 64 MB
+const int TILE_CACHE_PROBES = 64;               ///< Max slots probed by one lookup or insertion
+const double TILE_CACHE_WAIT = 60;              ///< Max seconds to wait for tile that another render claimed
+const int TILE_CACHE_POLL_US = 1000;            ///< Microseconds between checks of claimed tiles
+const double TILE_CACHE_CHECK_INTERVAL = 0.1;   ///< Seconds between checks that claimers of waited tiles are alive
+const int TILE_CACHE_CLAIM_AGE = 600;           ///< Seconds after which claim is taken over even if its process looks alive
+
+const int GRID_MANTISSA_BITS = 8;               ///< Pixel size mantissa is rounded to that many bits, so close zooms share one grid
+const int GRID_ANCHOR_BITS = 24;                ///< Grid anchors are 2^24 pixels apart, views near one anchor share tiles
+
+const int TILE_LOG_MAX_TILES = 1 << 16;         ///< Tiles remembered by access log, less popular half is forgotten when it is full
+const double TILE_LOG_HALF_LIFE = 6 * 3600;     ///< Seconds after which tile access counts half in popularity
+const double TILE_LOG_SAVE_INTERVAL = 10;       ///< Seconds between saves of access log
+
+const int SESSION_TILE = 128;                   ///< Side of square tile of exploration session, multiple of 8
+const int SESSION_OUT_LEVELS = 8;               ///< Levels of the session quadtree above the initial view
+const int SESSION_MAX_LEVEL = 48;               ///< Deepest quadtree level, tile coordinates stay far from int64 limits
+
+#define COLOR_TABLE_FILE "assets/ColorTable.txt"    ///< Path to color table file
+
+
+#endif
@@ -0,0 +1,869 @@
+/**
+ * \file
+ * \brief Render daemon that takes batch jobs over Unix socket and runs them on one worker pool
+ * \note Protocol is one text command per line, every command gets one answer line:
+ * SUBMIT submitter x y span width height nmax format output -> OK id
+ * STATUS id -> id state progress submitter output
+ * CANCEL id -> OK id
+ * LIST -> status line of every known job, then END
+ * POOL -> queue metrics of every priority class
+ * CACHE -> counters of shared tile cache and share of job samples taken from it
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "kernel.hpp"
+#include "perturb.hpp"
+#include "pool.hpp"
+#include "tilecache.hpp"
+#include "grid.hpp"
+#include "tilelog.hpp"
+#include "image.hpp"
+
+
+const int DAEMON_MAX_JOBS = 1024;               ///< Number of job slots, finished jobs are overwritten by new ones
+const int DAEMON_MAX_SUBMITTERS = 64;           ///< Max number of submitters with queued or running jobs
+const int DAEMON_NAME_SIZE = 32;                ///< Max submitter name length
+const int DAEMON_PATH_SIZE = 256;               ///< Max output path length
+const int DAEMON_LINE_SIZE = 2 * BIGNUM_MAX_BITS + 2 * DAEMON_PATH_SIZE;    ///< Fits any command line
+const int DAEMON_STATUS_SIZE = DAEMON_NAME_SIZE + DAEMON_PATH_SIZE + 64;   ///< Fits any job status line
+const int DAEMON_REPLY_SIZE = DAEMON_MAX_JOBS * DAEMON_STATUS_SIZE + DAEMON_LINE_SIZE;  ///< Fits any answer, LIST is the longest
+const int DAEMON_BACKLOG = 16;                  ///< Pending connections queue length
+const int DAEMON_WARM_TILES = 1024;             ///< Default number of the most popular logged tiles warmed up on start
+const unsigned DAEMON_ACCEPT_BACKOFF = 100000;  ///< Microseconds main thread sleeps after failed accept
+
+
+/// Job states
+typedef enum {
+    JOB_FREE            = 0,        ///< Slot was never used
+    JOB_QUEUED          = 1,        ///< Waiting for a runner
+    JOB_RUNNING         = 2,        ///< Rendered now
+    JOB_DONE            = 3,        ///< Image is saved
+    JOB_FAILED          = 4,        ///< Render or save failed
+    JOB_CANCELLED       = 5,        ///< Cancelled by user
+} JobState;
+
+const char *const JOB_STATE_NAMES[] = {"free", "queued", "running", "done", "failed", "cancelled"};
+
+
+/// Batch render job
+typedef struct {
+    int id = 0;                                 ///< Job id
+    JobState state = JOB_FREE;                  ///< Job state
+    int submitter = 0;                          ///< Submitter index
+    char name[DAEMON_NAME_SIZE] = "";           ///< Submitter name, its index may be reclaimed after the job ends
+    DeepView view = {};                         ///< Rendered view
+    char output[DAEMON_PATH_SIZE] = "";         ///< Output image path
+    PerturbControl control = {};                ///< Progress and cancel flag
+} Job;
+
+
+/// Client that submits jobs, fair share is counted per submitter
+typedef struct {
+    char name[DAEMON_NAME_SIZE] = "";           ///< Name given in SUBMIT
+    long served = 0;                            ///< Pixels of started jobs, new submitters start at the lowest active value
+    int active = 0;                             ///< Number of queued and running jobs
+    int last = 0;                               ///< Id of the last job submitted, idle submitter used least recently is reclaimed
+} Submitter;
+
+
+/// Answer to one command, formatted under daemon lock and written to client after the lock is released
+typedef struct {
+    char *text = nullptr;                       ///< Answer text of DAEMON_REPLY_SIZE bytes
+    size_t length = 0;                          ///< Formatted length
+} Reply;
+
+
+/// Daemon settings taken from command line
+typedef struct {
+    const char *socket = "/tmp/mandelbrot.sock";    ///< Unix socket path
+    int threads = 0;                            ///< Number of worker threads, zero means CPU limits
+    int runners = 2;                            ///< Number of jobs rendered at the same time
+    const char *cache = TILE_CACHE_NAME;        ///< Shared tile cache name, "off" disables it
+    bool grid = true;                           ///< Snap jobs to shared sample grid, so overlapping jobs share tiles
+    const char *log = "off";                    ///< Access log file, "off" disables logging and warm-up
+    int warm = DAEMON_WARM_TILES;               ///< Number of the most popular tiles warmed up on start
+} DaemonArgs;
+
+
+/// State shared by connection and runner threads
+typedef struct {
+    std::mutex lock = {};                       ///< Protects jobs and submitters
+    std::condition_variable queued = {};        ///< Signals new queued jobs
+    Job jobs[DAEMON_MAX_JOBS] = {};             ///< Job slots, job id is stored in slot id % DAEMON_MAX_JOBS
+    int next_id = 1;                            ///< Id of the next job
+    Submitter submitters[DAEMON_MAX_SUBMITTERS] = {};   ///< Known submitters
+    int submitters_count = 0;                   ///< Number of known submitters
+    WorkerPool pool = {};                       ///< Pool shared by all jobs
+    IterColor *color_table = nullptr;           ///< Palette
+    TileCache cache = {};                       ///< Tile cache shared with other processes, not mapped if disabled
+    bool grid = true;                           ///< Snap jobs to shared sample grid
+    TileLog log = {};                           ///< Access log of grid tiles, not opened if disabled
+    long samples = 0;                           ///< Pixels of cached job renders
+    long reused = 0;                            ///< Pixels of cached job renders taken from cache
+} Daemon;
+
+
+/// Warm-up task argument
+typedef struct {
+    Daemon *daemon = nullptr;                   ///< Daemon with opened cache and access log
+    int count = 0;                              ///< Number of tiles to warm up
+} WarmUp;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], DaemonArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Creates listening Unix socket, stale socket file is removed
+ * \param [in] path Socket path
+ * \return Socket descriptor or -1 on error
+*/
+int open_socket(const char *path);
+
+
+/**
+ * \brief Reads commands from client until it disconnects
+ * \param [in,out] daemon  Daemon state
+ * \param [in]     fd      Client socket
+*/
+void serve_client(Daemon *daemon, int fd);
+
+
+/**
+ * \brief Executes one command line and formats answer
+ * \param [in,out] daemon  Daemon state
+ * \param [out]    reply   Answer to fill
+ * \param [in,out] line    Command line, it is split into words
+*/
+void run_command(Daemon *daemon, Reply *reply, char *line);
+
+
+/**
+ * \brief Parses SUBMIT arguments and queues job
+ * \param [in,out] daemon  Daemon state
+ * \param [out]    reply   Answer to fill
+*/
+void submit_job(Daemon *daemon, Reply *reply);
+
+
+/**
+ * \brief Appends formatted text to answer
+*/
+void reply_printf(Reply *reply, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+
+/**
+ * \brief Writes whole answer to client and empties it, client that disconnected is ignored
+ * \param [in]     fd      Client socket
+ * \param [in,out] reply   Answer to write
+*/
+void write_reply(int fd, Reply *reply);
+
+
+/**
+ * \brief Appends job status line to answer
+ * \note Daemon lock must be held
+*/
+void print_job(Reply *reply, const Job *job);
+
+
+/**
+ * \brief Returns job with id, null if its slot was reused or never used
+ * \note Daemon lock must be held
+*/
+Job *find_job(Daemon *daemon, int id);
+
+
+/**
+ * \brief Returns submitter index by name, adds new submitter
+ * \note Daemon lock must be held. When the table is full, the least recently used submitter without queued or running
+ * jobs is replaced
+ * \return Submitter index or -1 if every submitter has active jobs
+*/
+int find_submitter(Daemon *daemon, const char *name);
+
+
+/**
+ * \brief Takes queued job of the submitter that was served least, older jobs go first
+ * \note Daemon lock must be held
+ * \return Job or null if nothing is queued
+*/
+Job *take_fair_job(Daemon *daemon);
+
+
+/**
+ * \brief Runner thread body, renders jobs one by one
+*/
+void runner_loop(Daemon *daemon);
+
+
+/**
+ * \brief Renders job view and saves image
+ * \param [in,out] daemon      Daemon
+ * \param [in,out] job         Job to render
+ * \param [out]    cache_stats Cache use, stays zero if cache is off
+ * \return Non zero value means error, CANCELLED if job was cancelled
+*/
+int render_job(Daemon *daemon, Job *job, TileCacheStats *cache_stats);
+
+
+/**
+ * \brief Renders job view snapped to shared sample grid and expanded to whole tiles, then crops it
+ * \note Cache stats count samples of the expanded view
+ * \return Non zero value means error, CANCELLED if job was cancelled
+*/
+int render_snapped(Daemon *daemon, Job *job, int *iters, TileCacheStats *cache_stats);
+
+
+/**
+ * \brief Saver thread body, saves access log every TILE_LOG_SAVE_INTERVAL seconds
+ * \note Daemon killed between saves loses only the accesses of the last interval
+*/
+void save_log_loop(Daemon *daemon);
+
+
+/**
+ * \brief Warm-up thread body, queues warm-up as one speculative task and waits for it
+ * \param [in,out] daemon  Daemon with opened cache and access log
+ * \param [in]     count   Number of tiles to warm up
+*/
+void warm_up(Daemon *daemon, int count);
+
+
+/**
+ * \brief Renders the most popular logged tiles that are not in cache below job priority
+ * \param [in,out] arg     WarmUp argument
+ * \param [in]     index   Task index, unused
+*/
+void warm_up_task(void *arg, int index);
+
+
+
+
+int main(int argc, char *argv[]) {
+    DaemonArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    static Daemon daemon;
+    if (load_color_table(COLOR_TABLE_FILE, &daemon.color_table)) return FILE_NOT_FOUND;
+
+    // Jobs are batch work, interactive viewers sharing the machine keep their latency
+    daemon.pool.idle_background = true;
+    if (pool_create(&daemon.pool, args.threads)) return ALLOC_FAIL;
+
+    // Jobs still run without cache if it can't be opened
+    if (strcmp(args.cache, "off") && tile_cache_open(&daemon.cache, args.cache)) printf("Running without tile cache\n");
+    daemon.grid = args.grid;
+
+    // Only grid tiles can be rendered again without their request, so the log needs cache and grid
+    if (strcmp(args.log, "off") && (!daemon.cache.slots || !daemon.grid)) printf("Access log needs tile cache and grid\n");
+    else if (strcmp(args.log, "off") && tile_log_open(&daemon.log, args.log)) printf("Running without access log\n");
+
+    int listener = open_socket(args.socket);
+    if (listener < 0) return FILE_NOT_FOUND;
+
+    // Client that disconnects before answer must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < args.runners; i++) std::thread(runner_loop, &daemon).detach();
+
+    if (daemon.log.entries) std::thread(save_log_loop, &daemon).detach();
+    if (daemon.log.entries && args.warm > 0) std::thread(warm_up, &daemon, args.warm).detach();
+
+    printf("Listening on %s with %d runners\n", args.socket, args.runners);
+    fflush(stdout);
+
+    bool failing = false;
+
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+
+        // Out of descriptors or memory persists until some client is done, so retrying at once would spin
+        if (fd < 0 && errno != EINTR && errno != ECONNABORTED) {
+            if (!failing) {
+                printf("Can't accept clients: %s, retrying every %u ms\n", strerror(errno), DAEMON_ACCEPT_BACKOFF / 1000);
+                fflush(stdout);
+            }
+
+            failing = true;
+            usleep(DAEMON_ACCEPT_BACKOFF);
+        }
+
+        if (fd < 0) continue;
+
+        if (failing) {
+            printf("Accepting clients again\n");
+            fflush(stdout);
+        }
+
+        failing = false;
+        std::thread(serve_client, &daemon, fd).detach();
+    }
+}
+
+
+int parse_args(int argc, char *argv[], DaemonArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-s")) args -> socket = value;
+        else if (!strcmp(argv[i - 1], "-t")) args -> threads = atoi(value);
+        else if (!strcmp(argv[i - 1], "-j")) args -> runners = atoi(value);
+        else if (!strcmp(argv[i - 1], "-c")) args -> cache = value;
+        else if (!strcmp(argv[i - 1], "-l")) args -> log = value;
+        else if (!strcmp(argv[i - 1], "-w")) args -> warm = atoi(value);
+        else if (!strcmp(argv[i - 1], "-g")) {
+            ASSERT(!strcmp(value, "on") || !strcmp(value, "off"), INVALID_ARG, "Grid must be on or off!\n");
+            args -> grid = !strcmp(value, "on");
+        }
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(args -> threads >= 0, INVALID_ARG, "Invalid threads number!\n");
+    ASSERT(args -> runners > 0, INVALID_ARG, "Invalid runners number!\n");
+    ASSERT(args -> warm >= 0, INVALID_ARG, "Invalid warm-up tiles number!\n");
+    ASSERT(strlen(args -> socket) < sizeof(sockaddr_un::sun_path), INVALID_ARG, "Socket path is too long!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: daemon.exe [-s socket] [-t threads] [-j concurrent_jobs] [-c cache|off] [-g on|off]\n"
+           "                  [-l access_log|off] [-w warm_tiles]\n");
+}
+
+
+int open_socket(const char *path) {
+    assert(path && "Can't open null socket path!\n");
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    unlink(path);
+
+    if (bind(fd, (const sockaddr *) &address, sizeof(address)) || listen(fd, DAEMON_BACKLOG)) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+void serve_client(Daemon *daemon, int fd) {
+    assert(daemon && "Can't serve without daemon!\n");
+
+    FILE *input = fdopen(fd, "r");
+    if (!input) {
+        close(fd);
+        return;
+    }
+
+    static thread_local char line[DAEMON_LINE_SIZE] = "";
+
+    // LIST answer doesn't fit the stack
+    Reply reply = {};
+    reply.text = (char *) calloc(DAEMON_REPLY_SIZE, sizeof(char));
+
+    // Answer is written after command releases daemon lock, so slow client doesn't stall runners
+    while (reply.text && fgets(line, DAEMON_LINE_SIZE, input)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        run_command(daemon, &reply, line);
+        write_reply(fd, &reply);
+    }
+
+    free(reply.text);
+    fclose(input);
+}
+
+
+void run_command(Daemon *daemon, Reply *reply, char *line) {
+    assert(daemon && "Can't run command without daemon!\n");
+    assert(line && "Can't run null command!\n");
+
+    const char *command = strtok(line, " \t");
+    if (!command) return;
+
+    if (!strcmp(command, "SUBMIT")) {
+        submit_job(daemon, reply);
+        return;
+    }
+
+    if (!strcmp(command, "POOL")) {
+        PoolClassStats stats[POOL_PRIORITIES] = {};
+        pool_metrics(&daemon -> pool, stats);
+
+        for (int i = 0; i < POOL_PRIORITIES; i++)
+            reply_printf(reply, "class %d queued %d peak %d jobs %ld tasks %ld wait %.3f\n", i, stats[i].queued,
+                    stats[i].peak_queued, stats[i].jobs, stats[i].tasks, stats[i].wait);
+        return;
+    }
+
+    if (!strcmp(command, "CACHE")) {
+        const TileCacheHeader *header = daemon -> cache.header;
+
+        if (!header) reply_printf(reply, "ERROR cache is off\n");
+        else {
+            std::lock_guard<std::mutex> guard(daemon -> lock);
+
+            reply_printf(reply, "stored %lu hits %lu misses %lu dropped %lu samples %ld reused %ld ratio %.3f\n",
+                    (unsigned long) header -> stored.load(), (unsigned long) header -> hits.load(),
+                    (unsigned long) header -> misses.load(), (unsigned long) header -> dropped.load(), daemon -> samples,
+                    daemon -> reused, (daemon -> samples) ? (double) daemon -> reused / (double) daemon -> samples : 0.0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(daemon -> lock);
+
+    if (!strcmp(command, "LIST")) {
+        for (int i = 0; i < DAEMON_MAX_JOBS; i++)
+            if (daemon -> jobs[i].state != JOB_FREE) print_job(reply, daemon -> jobs + i);
+
+        reply_printf(reply, "END\n");
+        return;
+    }
+
+    const char *id_str = strtok(nullptr, " \t");
+    Job *job = (id_str) ? find_job(daemon, atoi(id_str)) : nullptr;
+
+    if (!strcmp(command, "STATUS") || !strcmp(command, "CANCEL")) {
+        if (!job) {
+            reply_printf(reply, "ERROR unknown job\n");
+            return;
+        }
+
+        if (!strcmp(command, "STATUS")) {
+            print_job(reply, job);
+            return;
+        }
+
+        // Running job stops at the next band, its runner marks it cancelled
+        if (job -> state == JOB_QUEUED) {
+            job -> state = JOB_CANCELLED;
+            daemon -> submitters[job -> submitter].active--;
+        }
+        else if (job -> state == JOB_RUNNING) {
+            job -> control.cancel = true;
+        }
+
+        reply_printf(reply, "OK %d\n", job -> id);
+        return;
+    }
+
+    reply_printf(reply, "ERROR unknown command %s\n", command);
+}
+
+
+void submit_job(Daemon *daemon, Reply *reply) {
+    assert(daemon && "Can't submit without daemon!\n");
+
+    const char *words[9] = {};
+    for (int i = 0; i < 9; i++) {
+        words[i] = strtok(nullptr, " \t");
+
+        if (!words[i]) {
+            reply_printf(reply, "ERROR usage: SUBMIT submitter x y span width height nmax format output\n");
+            return;
+        }
+    }
+
+    const char *name = words[0], *format = words[7], *output = words[8];
+    int width = atoi(words[4]), height = atoi(words[5]), nmax = atoi(words[6]);
+
+    if (strcmp(format, "ppm")) {
+        reply_printf(reply, "ERROR unsupported format %s\n", format);
+        return;
+    }
+
+    if (width <= 0 || height <= 0 || nmax <= 0) {
+        reply_printf(reply, "ERROR invalid size or nmax\n");
+        return;
+    }
+
+    if (strlen(name) >= DAEMON_NAME_SIZE || strlen(output) >= DAEMON_PATH_SIZE) {
+        reply_printf(reply, "ERROR name or output path is too long\n");
+        return;
+    }
+
+    static thread_local DeepView view = {};
+    if (deep_view_parse(&view, words[1], words[2], words[3])) {
+        reply_printf(reply, "ERROR invalid view\n");
+        return;
+    }
+
+    view.width = width;
+    view.height = height;
+    view.nmax = nmax;
+
+    {
+        std::lock_guard<std::mutex> guard(daemon -> lock);
+
+        Job *job = daemon -> jobs + daemon -> next_id % DAEMON_MAX_JOBS;
+        if (job -> state == JOB_QUEUED || job -> state == JOB_RUNNING) {
+            reply_printf(reply, "ERROR queue is full\n");
+            return;
+        }
+
+        int submitter = find_submitter(daemon, name);
+        if (submitter < 0) {
+            reply_printf(reply, "ERROR too many submitters\n");
+            return;
+        }
+
+        job -> id = daemon -> next_id++;
+        job -> state = JOB_QUEUED;
+        job -> submitter = submitter;
+        strcpy(job -> name, name);
+        job -> view = view;
+        strcpy(job -> output, output);
+
+        job -> control.done = 0;
+        job -> control.total = 0;
+        job -> control.cancel = false;
+
+        daemon -> submitters[submitter].active++;
+
+        reply_printf(reply, "OK %d\n", job -> id);
+    }
+
+    daemon -> queued.notify_one();
+}
+
+
+void reply_printf(Reply *reply, const char *format, ...) {
+    assert(reply && reply -> text && "Can't format null reply!\n");
+
+    va_list args;
+    va_start(args, format);
+
+    size_t left = DAEMON_REPLY_SIZE - reply -> length;
+    int length = vsnprintf(reply -> text + reply -> length, left, format, args);
+
+    va_end(args);
+
+    if (length > 0) reply -> length += ((size_t) length < left) ? (size_t) length : left - 1;
+}
+
+
+void write_reply(int fd, Reply *reply) {
+    assert(reply && reply -> text && "Can't write null reply!\n");
+
+    const char *text = reply -> text;
+    size_t size = reply -> length;
+
+    while (size) {
+        ssize_t written = write(fd, text, size);
+
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) break;
+
+        text += written;
+        size -= (size_t) written;
+    }
+
+    reply -> length = 0;
+}
+
+
+void print_job(Reply *reply, const Job *job) {
+    assert(job && "Can't print null job!\n");
+
+    long done = job -> control.done, total = job -> control.total;
+
+    double progress = (job -> state == JOB_DONE) ? 100 : 0;
+    if (job -> state == JOB_RUNNING && total > 0) progress = 100.0 * (double) done / (double) total;
+
+    reply_printf(reply, "%d %s %.1f %s %s\n", job -> id, JOB_STATE_NAMES[job -> state], progress,
+            job -> name, job -> output);
+}
+
+
+Job *find_job(Daemon *daemon, int id) {
+    assert(daemon && "Can't find job without daemon!\n");
+
+    if (id <= 0) return nullptr;
+
+    Job *job = daemon -> jobs + id % DAEMON_MAX_JOBS;
+
+    return (job -> id == id && job -> state != JOB_FREE) ? job : nullptr;
+}
+
+
+int find_submitter(Daemon *daemon, const char *name) {
+    assert(daemon && "Can't find submitter without daemon!\n");
+    assert(name && "Can't find submitter with null name!\n");
+
+    long lowest = -1;
+    int reclaimed = -1;
+
+    for (int i = 0; i < daemon -> submitters_count; i++) {
+        Submitter *submitter = daemon -> submitters + i;
+
+        if (!strcmp(submitter -> name, name)) {
+            submitter -> last = daemon -> next_id;
+            return i;
+        }
+
+        if (submitter -> active && (lowest < 0 || submitter -> served < lowest)) lowest = submitter -> served;
+        if (!submitter -> active && (reclaimed < 0 || submitter -> last < daemon -> submitters[reclaimed].last))
+            reclaimed = i;
+    }
+
+    // Jobs keep submitter name, so idle entry is forgotten without changing their status lines
+    int index = (daemon -> submitters_count < DAEMON_MAX_SUBMITTERS) ? daemon -> submitters_count++ : reclaimed;
+    if (index < 0) return -1;
+
+    // Newcomer does not get the whole daemon until it catches up with the history of others
+    Submitter *submitter = daemon -> submitters + index;
+    strcpy(submitter -> name, name);
+    submitter -> served = (lowest > 0) ? lowest : 0;
+    submitter -> active = 0;
+    submitter -> last = daemon -> next_id;
+
+    return index;
+}
+
+
+Job *take_fair_job(Daemon *daemon) {
+    assert(daemon && "Can't take job without daemon!\n");
+
+    Job *best = nullptr;
+
+    for (int i = 0; i < DAEMON_MAX_JOBS; i++) {
+        Job *job = daemon -> jobs + i;
+        if (job -> state != JOB_QUEUED) continue;
+
+        if (!best) {
+            best = job;
+            continue;
+        }
+
+        long served = daemon -> submitters[job -> submitter].served;
+        long best_served = daemon -> submitters[best -> submitter].served;
+
+        if (served < best_served || (served == best_served && job -> id < best -> id)) best = job;
+    }
+
+    if (!best) return nullptr;
+
+    best -> state = JOB_RUNNING;
+    daemon -> submitters[best -> submitter].served += (long) best -> view.width * best -> view.height;
+
+    return best;
+}
+
+
+void runner_loop(Daemon *daemon) {
+    assert(daemon && "Can't run jobs without daemon!\n");
+
+    pool_set_priority(POOL_BACKGROUND);
+
+    for (;;) {
+        Job *job = nullptr;
+
+        {
+            std::unique_lock<std::mutex> guard(daemon -> lock);
+            while (!(job = take_fair_job(daemon))) daemon -> queued.wait(guard);
+        }
+
+        printf("Job %d started: %dx%d, nmax %d\n", job -> id, job -> view.width, job -> view.height, job -> view.nmax);
+        fflush(stdout);
+
+        double start = get_seconds();
+
+        TileCacheStats cache_stats = {};
+        int result = render_job(daemon, job, &cache_stats);
+
+        {
+            std::lock_guard<std::mutex> guard(daemon -> lock);
+
+            job -> state = (result == OK) ? JOB_DONE : (result == CANCELLED) ? JOB_CANCELLED : JOB_FAILED;
+            daemon -> submitters[job -> submitter].active--;
+
+            printf("Job %d %s in %.3f s\n", job -> id, JOB_STATE_NAMES[job -> state], get_seconds() - start);
+
+            if (cache_stats.samples) {
+                daemon -> samples += cache_stats.samples;
+                daemon -> reused += cache_stats.reused;
+
+                printf("Job %d samples %ld reused %ld (%.1f%%), %d tiles waited for\n", job -> id, cache_stats.samples,
+                       cache_stats.reused, 100.0 * (double) cache_stats.reused / (double) cache_stats.samples,
+                       cache_stats.waited);
+            }
+            fflush(stdout);
+        }
+    }
+}
+
+
+int render_job(Daemon *daemon, Job *job, TileCacheStats *cache_stats) {
+    assert(daemon && job && cache_stats && "Can't render null job!\n");
+
+    size_t pixels_count = (size_t) job -> view.width * (size_t) job -> view.height;
+
+    int *iters = (int *) calloc(pixels_count, sizeof(int));
+    uint8_t *pixels = (uint8_t *) calloc(pixels_count * 4, sizeof(uint8_t));
+
+    int result = OK;
+
+    if (!iters || !pixels) {
+        printf("Can't allocate buffers of job %d!\n", job -> id);
+        result = ALLOC_FAIL;
+    }
+
+    if (!result && daemon -> cache.slots && daemon -> grid)
+        result = render_snapped(daemon, job, iters, cache_stats);
+    else if (!result && daemon -> cache.slots)
+        result = tile_cache_render(&daemon -> cache, &job -> view, nullptr, iters, &daemon -> pool, nullptr, &job -> control,
+                                   cache_stats);
+    else if (!result)
+        result = perturb_render(&job -> view, iters, &daemon -> pool, nullptr, nullptr, &job -> control);
+
+    if (!result) {
+        colorize(daemon -> color_table, iters, pixels, (int) pixels_count, job -> view.nmax);
+        result = write_ppm(job -> output, pixels, job -> view.width, job -> view.height);
+    }
+
+    free(iters);
+    free(pixels);
+
+    return result;
+}
+
+
+int render_snapped(Daemon *daemon, Job *job, int *iters, TileCacheStats *cache_stats) {
+    assert(daemon && job && iters && cache_stats && "Can't render null job!\n");
+
+    GridView snapped = {};
+    int result = grid_snap(&job -> view, &snapped);
+    if (result) return result;
+
+    // Cancelled jobs are counted too, they were still asked for
+    if (daemon -> log.entries) tile_log_record(&daemon -> log, &snapped);
+
+    int *rendered = (int *) calloc((size_t) snapped.view.width * (size_t) snapped.view.height, sizeof(int));
+    if (!rendered) {
+        printf("Can't allocate snapped buffer of job %d!\n", job -> id);
+        return ALLOC_FAIL;
+    }
+
+    result = tile_cache_render(&daemon -> cache, &snapped.view, &snapped.grid, rendered, &daemon -> pool, nullptr,
+                               &job -> control, cache_stats);
+
+    if (!result) grid_crop(&snapped, rendered, iters, job -> view.width, job -> view.height);
+
+    free(rendered);
+
+    return result;
+}
+
+
+void save_log_loop(Daemon *daemon) {
+    assert(daemon && daemon -> log.entries && "Can't save log that is not opened!\n");
+
+    for (;;) {
+        sleep((unsigned) TILE_LOG_SAVE_INTERVAL);
+        tile_log_save(&daemon -> log);
+    }
+}
+
+
+void warm_up(Daemon *daemon, int count) {
+    assert(daemon && daemon -> log.entries && daemon -> cache.slots && "Can't warm up without log and cache!\n");
+
+    // Whole warm-up runs on an idle worker, so its reference orbits get SCHED_IDLE too and this thread only waits
+    WarmUp warm = {daemon, count};
+
+    pool_set_priority(POOL_SPECULATIVE);
+    pool_run(&daemon -> pool, warm_up_task, &warm, 1);
+}
+
+
+void warm_up_task(void *arg, int index) {
+    assert(arg && "Can't warm up without argument!\n");
+    (void) index;
+
+    Daemon *daemon = ((WarmUp *) arg) -> daemon;
+    int count = ((WarmUp *) arg) -> count;
+
+    // Pool starts warm-up tasks only when no job task is queued, so jobs never wait behind them
+    GridView *tiles = (GridView *) calloc((size_t) count, sizeof(GridView));
+    int *iters = (int *) calloc(TILE_CACHE_SIZE * TILE_CACHE_SIZE, sizeof(int));
+
+    if (!tiles || !iters) {
+        printf("Can't allocate warm-up buffers!\n");
+
+        free(tiles);
+        free(iters);
+        return;
+    }
+
+    count = tile_log_hottest(&daemon -> log, tiles, count);
+
+    printf("Warm-up of %d tiles started\n", count);
+    fflush(stdout);
+
+    double start = get_seconds();
+    int cached = 0, rendered = 0, failed = 0;
+
+    for (int i = 0; i < count; i++) {
+        TileCacheStats stats = {};
+
+        // Tiles that outlived the daemon in shared memory are only looked up
+        int result = tile_cache_render(&daemon -> cache, &tiles[i].view, &tiles[i].grid, iters, &daemon -> pool, nullptr,
+                                       nullptr, &stats);
+
+        if (result) failed++;
+        else if (stats.hits) cached++;
+        else rendered++;
+    }
+
+    printf("Warm-up of %d tiles done in %.3f s: %d were cached, %d rendered, %d failed\n", count, get_seconds() - start,
+           cached, rendered, failed);
+    fflush(stdout);
+
+    free(tiles);
+    free(iters);
+}
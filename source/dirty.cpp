@@ -0,0 +1,82 @@
+/**
+ * \file
+ * \brief Source file for tracking screen areas that changed since the last texture upload
+*/
+
+#include <assert.h>
+#include "dirty.hpp"
+
+
+
+
+void dirty_clear(DirtyRegion *dirty) {
+    assert(dirty && "Can't clear null dirty region!\n");
+
+    for (int i = 0; i < DIRTY_BANDS; i++) {
+        dirty -> left[i] = SCREEN_W;
+        dirty -> right[i] = 0;
+    }
+}
+
+
+void dirty_all(DirtyRegion *dirty) {
+    assert(dirty && "Can't mark null dirty region!\n");
+
+    for (int i = 0; i < DIRTY_BANDS; i++) {
+        dirty -> left[i] = 0;
+        dirty -> right[i] = SCREEN_W;
+    }
+}
+
+
+void dirty_add(DirtyRegion *dirty, int x, int y, int width) {
+    assert(dirty && "Can't mark null dirty region!\n");
+    assert(0 <= y && y < SCREEN_H && "Row is out of screen!\n");
+
+    int band = y / DIRTY_BAND_ROWS;
+
+    if (x < dirty -> left[band]) dirty -> left[band] = x;
+    if (x + width > dirty -> right[band]) dirty -> right[band] = x + width;
+}
+
+
+bool dirty_is_clean(const DirtyRegion *dirty) {
+    assert(dirty && "Can't check null dirty region!\n");
+
+    for (int i = 0; i < DIRTY_BANDS; i++)
+        if (dirty -> left[i] < dirty -> right[i]) return false;
+
+    return true;
+}
+
+
+int dirty_rects(const DirtyRegion *dirty, DirtyRect *rects) {
+    assert(dirty && "Can't split null dirty region!\n");
+    assert(rects && "Can't store rectangles in null buffer!\n");
+
+    int count = 0;
+    bool merging = false;
+
+    for (int i = 0; i < DIRTY_BANDS; i++) {
+        int y = i * DIRTY_BAND_ROWS;
+        int height = (y + DIRTY_BAND_ROWS < SCREEN_H) ? DIRTY_BAND_ROWS : SCREEN_H - y;
+
+        if (dirty -> left[i] >= dirty -> right[i]) {
+            merging = false;
+            continue;
+        }
+
+        bool full = (dirty -> left[i] == 0 && dirty -> right[i] == SCREEN_W);
+
+        // Full width bands are contiguous in the frame buffer, so they are uploaded as one rectangle
+        if (full && merging) {
+            rects[count - 1].height += height;
+            continue;
+        }
+
+        rects[count++] = {dirty -> left[i], y, dirty -> right[i] - dirty -> left[i], height};
+        merging = full;
+    }
+
+    return count;
+}
@@ -0,0 +1,68 @@
+/**
+ * \file
+ * \brief Header file for tracking screen areas that changed since the last texture upload
+*/
+
+#ifndef DIRTY_HPP
+#define DIRTY_HPP
+
+#include "configs.hpp"
+
+
+const int DIRTY_BANDS = (SCREEN_H + DIRTY_BAND_ROWS - 1) / DIRTY_BAND_ROWS;    ///< Number of row bands on the screen
+
+
+/// Changed columns range of every row band, band is clean when left >= right
+typedef struct {
+    int left[DIRTY_BANDS] = {};                 ///< First changed column of the band
+    int right[DIRTY_BANDS] = {};                ///< Column after the last changed one
+} DirtyRegion;
+
+
+/// Rectangle of the screen in pixels
+typedef struct {
+    int x = 0;                                  ///< Left column
+    int y = 0;                                  ///< Top row
+    int width = 0;                              ///< Width in pixels
+    int height = 0;                             ///< Height in pixels
+} DirtyRect;
+
+
+/**
+ * \brief Marks the whole screen as clean
+*/
+void dirty_clear(DirtyRegion *dirty);
+
+
+/**
+ * \brief Marks the whole screen as changed
+*/
+void dirty_all(DirtyRegion *dirty);
+
+
+/**
+ * \brief Marks pixels of the row as changed
+ * \param [out] dirty   Region to update
+ * \param [in]  x       First changed column
+ * \param [in]  y       Row
+ * \param [in]  width   Number of changed pixels
+*/
+void dirty_add(DirtyRegion *dirty, int x, int y, int width);
+
+
+/**
+ * \brief Returns true if nothing changed
+*/
+bool dirty_is_clean(const DirtyRegion *dirty);
+
+
+/**
+ * \brief Splits changed area into rectangles, neighbour full width bands are merged into one rectangle
+ * \param [in]  dirty   Changed area
+ * \param [out] rects   Buffer of DIRTY_BANDS rectangles
+ * \return Number of rectangles
+*/
+int dirty_rects(const DirtyRegion *dirty, DirtyRect *rects);
+
+
+#endif
@@ -5,125 +5,127 @@
 
 #include <SFML/Graphics.hpp>
 #include <assert.h>
-#include <immintrin.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
 #include "configs.hpp"
+#include "utils.hpp"
+#include "alloc.hpp"
+#include "kernel.hpp"
+#include "session.hpp"
+#include "input.hpp"
+#include "remote.hpp"
+#include "frametime.hpp"
 #include "draw.hpp"
 
 
-const size_t FPS_BUFFER_SIZE = 100;
-const size_t FPS_TEXT_SIZE = 30;
-const size_t TEST_NUMBER = 100;
+const size_t FPS_TEXT_SIZE = 512;
+const size_t TEST_NUMBER = 100;                 ///< Calculations of every frame in benchmark mode
 
+const float GRAPH_X = 10;                       ///< Left edge of frame time graph
+const float GRAPH_BAR = 2;                      ///< Width of one frame bar
+const int GRAPH_VERTICES = 4 * (FRAME_HISTORY * FRAME_PHASES + 1);     ///< Quads of phase bars and budget line
 
-/// Possible functions exit codes
-typedef enum {
-    OK                  = 0,        ///< OK
-    INVALID_ARG         = 1,        ///< Invalid argument passed to the function
-    ALLOC_FAIL          = 2,        ///< Allocation failed
-    FILE_NOT_FOUND      = 3,        ///< File not found
-    INVALID_FORMAT      = 4,        ///< Color table file has invalid format
-} EXIT_CODES;
-
-
-/// Contains information about Mandelbrot set offset and scale
-typedef struct {
-    float center_x = CENTER_X;      ///< Offset x
-    float center_y = CENTER_Y;      ///< Offset y
-    float set_w = SET_W;            ///< Scale x
-    float set_h = SET_H;            ///< Scale y
-} Transform;
-
-
-typedef union {
-    __m256 float_vec;
-    __m256i int_vec;
-    float float_arr[8];
-    int int_arr[8];
-} VecToArr;
-
-
-/// Contains information about color in RGB format
-typedef struct {
-    uint8_t red = 0;
-    uint8_t green = 0;
-    uint8_t blue = 0;
-} IterColor;
+const sf::Color GRAPH_COLORS[FRAME_PHASES] = {
+    sf::Color(230, 80, 60), sf::Color(240, 200, 50), sf::Color(60, 160, 240), sf::Color(120, 220, 120)
+};
 
 
 typedef struct {
     sf::Window  *window = nullptr;      ///< Application window
     Transform   *transform = nullptr;   ///< Mandelbrot set transformation
+    int         *nmax = nullptr;        ///< Max iteration number
+    int         socket = -1;            ///< Back end socket, input is sent there if it is not negative
+    bool        *graph = nullptr;       ///< Frame time graph is shown, F1 toggles it
 } EventArgs;
 
 
-#define ASSERT(condition, exit_code, ...)       \
-do {                                            \
-    if (!(condition)) {                         \
-        printf(__VA_ARGS__);                    \
-        return exit_code;                       \
-    }                                           \
-} while (0)                                     \
+/// Texture upload traffic and heap allocations of frames
+typedef struct {
+    size_t frame_bytes = 0;             ///< Bytes uploaded in the last frame
+    size_t total_bytes = 0;             ///< Bytes uploaded since start
+    size_t full_bytes = 0;              ///< Bytes that whole frame uploads would take since start
+    size_t frame_allocs = 0;            ///< Allocations of the last frame
+    size_t allocating_frames = 0;       ///< Number of frames that allocated
+    size_t frames = 0;                  ///< Number of frames
+    size_t frame_net_bytes = 0;         ///< Bytes received from back end in the last frame
+    size_t total_net_bytes = 0;         ///< Bytes received from back end since start
+    size_t full_net_bytes = 0;          ///< Bytes that whole received frames would take since start
+} FrameStats;
 
 
 /**
- * \brief Set pixels colors in buffer accroding to Mandelbrot formula
- * \param [in]  color_table Containts rgb color for each iteration number
- * \param [out] buffer      Buffer to store pixels colors
- * \param [in]  transform   Mandelbrot set offset and scale
+ * \brief Translates user input into view command
+ * \param [in] event   To handle input
+ * \return Command or INPUT_NONE if the event does not change the view
 */
-void set_pixels(const IterColor *color_table, uint8_t *buffer, const Transform *transform);
+ViewInput event_to_input(sf::Event event);
 
 
 /**
- * \brief Set pixel color in buffer based on iterations number and position
- * \param [out] buffer  Buffer to store pixel color
- * \param [in]  N       Number of iterations
- * \param [in]  x       Pixel x coordinate
- * \param [in]  y       Pixel y coordinate
+ * \brief Applies all frames that back end has sent since the last call
+ * \param [in]     socket  Back end socket
+ * \param [out]    message Buffer of remote_message_capacity() bytes
+ * \param [in,out] pixels  Screen buffer in RGBA format
+ * \param [out]    dirty   Received tiles are added to it
+ * \param [out]    nmax    Max iteration number of the last frame
+ * \param [in,out] stats   Network traffic to update
+ * \return Non zero value means error
 */
-void set_pixel_color(const IterColor *color_table, uint8_t *buffer, int N, float x, float y);
+int receive_frames(int socket, uint8_t *message, uint8_t *pixels, DirtyRegion *dirty, int *nmax, FrameStats *stats);
 
 
 /**
- * \brief Loads color table from file into allocated buffer
- * \param [in]  filename    Path to color table source file
- * \param [out] buffer      Buffer to allocate and fill with colors
- * \return Non zero value means error 
+ * \brief Uploads changed screen rectangles into texture
+ * \param [out]    texture Screen texture
+ * \param [in]     pixels  Screen buffer in RGBA format
+ * \param [out]    scratch Buffer of screen size to pack rectangles narrower than the screen
+ * \param [in]     dirty   Changed pixels
+ * \param [in,out] stats   Upload traffic to update
 */
-int load_color_table(const char *filename, IterColor **buffer);
+void upload_dirty(sf::Texture *texture, const uint8_t *pixels, uint8_t *scratch, const DirtyRegion *dirty, FrameStats *stats);
 
 
 /**
- * \brief Free color table buffer
- * \param [out] buffer  Buffer to free
- * \return Non zero value means error
+ * \brief Prints fps, iteration limit, upload and network traffic and memory usage, with graph also phase percentiles
+ * \param [out]    status      Text class to fill with FPS
+ * \param [out]    string      Reused string of status text
+ * \param [in]     clock       Clock class to get time passed
+ * \param [out]    prev_time   Required to calculate FPS
+ * \param [in,out] times       Frame times, percentiles are printed if graph is shown
+ * \param [in]     graph       Frame time graph is shown
+ * \param [in]     nmax        Max iteration number
+ * \param [in]     stats       Frame stats
+ * \param [in]     scale       Number of calculations per frame, FPS is multiplied by it
 */
-int free_color_table(IterColor **buffer);
+void print_fps(sf::Text *status, sf::String *string, sf::Clock *clock, sf::Time *prev_time, FrameTimes *times, bool graph,
+               int nmax, const FrameStats *stats, size_t scale);
 
 
 /**
- * \brief Change Mandelbrot Transform according to the user input
- * \brief [in]  event       To handle input
- * \param [out] transform   Transform to change
+ * \brief Fills vertices of frame time graph, one stacked bar per kept frame, newest on the right
+ * \note Vertex array keeps its size, so the graph costs one vertex pass and one draw call per frame
+ * \param [out] vertices    Vertex array of GRAPH_VERTICES quad vertices
+ * \param [in]  times       Frame times
 */
-void transform_input(sf::Event event, Transform *transform);
+void update_frame_graph(sf::VertexArray *vertices, const FrameTimes *times);
 
 
 /**
- * \brief Prints fps and store FPS into FPS buffer
- * \param [out] status      Text class to fill with FPS
- * \param [in]  clock       Clock class to get time passed
- * \param [out] prev_time   Required to calculate FPS
- * \param [out] fps_buffer  FPS buffer to store FPS value
+ * \brief Sets text without heap allocations once string capacity is large enough
+ * \note Characters are appended one by one, single character strings fit in small string buffer
+ * \param [out] text    Text to change
+ * \param [out] string  Reused string
+ * \param [in]  str     New ASCII text
 */
-void print_fps(sf::Text *status, sf::Clock *clock, sf::Time *prev_time, int *fps_buffer);
+void set_text(sf::Text *text, sf::String *string, const char *str);
 
 
 /**
- * \brief Prints what FPS buffer contains
- * \param [in] fps_buffer   FPS buffer
+ * \brief Prints percentiles of every frame phase over kept frames
+ * \param [in,out] times   Frame times
 */
-void show_fps_buffer(int *fps_buffer);
+void show_frame_times(FrameTimes *times);
 
 
 /**
@@ -135,13 +137,14 @@ int event_parser(EventArgs *args);
 
 
 
-int draw_mandelbrot(void) {
+int draw_mandelbrot(int socket, const char *session_path, bool benchmark) {
     sf::RenderWindow window(sf::VideoMode(SCREEN_W, SCREEN_H), "Mandelbrot3000");
 
     sf::Font font;
     ASSERT(font.loadFromFile(FONT_FILE), FILE_NOT_FOUND, "Can't open %s!\n", FONT_FILE);
 
-    sf::Text status(sf::String("FPS: 0"), font, FONT_SIZE);
+    sf::String status_string("FPS: 0");
+    sf::Text status(status_string, font, FONT_SIZE);
 
     sf::Clock clock;
     sf::Time prev_time = clock.getElapsedTime();
@@ -149,239 +152,339 @@ int draw_mandelbrot(void) {
     uint8_t *pixels = (uint8_t *) calloc(SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
     ASSERT(pixels, ALLOC_FAIL, "Can't allocate buffer for pixels colors!\n");
 
+    // Remote front end only shows tiles of the back end, it does not calculate anything
     IterColor *color_table = nullptr;
-    if (load_color_table("assets/ColorTable.txt", &color_table)) return 1;
+    if (socket < 0 && load_color_table(COLOR_TABLE_FILE, &color_table)) return 1;
+
+    uint8_t *message = nullptr;
+    if (socket >= 0) {
+        message = (uint8_t *) calloc(remote_message_capacity(), sizeof(uint8_t));
+        ASSERT(message, ALLOC_FAIL, "Can't allocate buffer for frame messages!\n");
+    }
+
+    uint8_t *scratch = (uint8_t *) calloc(SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
+    ASSERT(scratch, ALLOC_FAIL, "Can't allocate buffer for texture uploads!\n");
 
-    sf::Image image;
     sf::Texture texture;
+    ASSERT(texture.create(SCREEN_W, SCREEN_H), ALLOC_FAIL, "Can't create screen texture!\n");
+
+    sf::Sprite sprite(texture);
+
+    DirtyRegion dirty = {};
+    dirty_clear(&dirty);
+
+    FrameStats stats = {};
 
     Transform transform = {};
+    int nmax = NMAX;
+
+    IterState state = {};
+    if (socket < 0 && iter_state_create(&state)) return ALLOC_FAIL;
 
-    int *fps_buffer = (int *) calloc(FPS_BUFFER_SIZE, sizeof(int));
-    ASSERT(fps_buffer, ALLOC_FAIL, "Failed to allocate FPS Buffer!\n");
+    // Remote back end has its own calculations, session keeps only local ones
+    Session session = {};
+    if (socket < 0 && session_path && session_open(&session, session_path)) return FILE_NOT_FOUND;
 
-    EventArgs event_args = {&window, &transform};
+    FrameTimes times = {};
+    if (frame_times_create(&times)) return ALLOC_FAIL;
 
+    bool graph = false;
+    sf::VertexArray graph_vertices(sf::Quads, GRAPH_VERTICES);
+
+    EventArgs event_args = {&window, &transform, &nmax, socket, &graph};
+
+    // Frame loop reuses all buffers, texture, sprite, status string and graph vertices, so it does not allocate
     while (window.isOpen()) {
+        AllocStats frame_start = alloc_stats();
+
         if (event_parser(&event_args)) break;
 
-        for (size_t i = 0; i < TEST_NUMBER; i++) set_pixels(color_table, pixels, &transform);
+        frame_times_begin(&times);
+
+        // Unchanged view is not recalculated, raised limit continues only pixels that reached the old one
+        if (socket >= 0) {
+            if (receive_frames(socket, message, pixels, &dirty, &nmax, &stats)) break;
+            frame_times_mark(&times, PHASE_COMPUTE);
+        }
+        else if (benchmark) {
+            // Kernel speed as measured in README: frame overhead is spread over TEST_NUMBER full calculations
+            for (size_t i = 0; i < TEST_NUMBER; i++) set_pixels(color_table, pixels, &transform);
+
+            dirty_all(&dirty);
+            frame_times_mark(&times, PHASE_COMPUTE);
+        }
+        else if (session.file ? session_update(&session, &state, &transform, nmax, &dirty) :
+                                iter_state_update(&state, &transform, nmax, &dirty)) {
+            frame_times_mark(&times, PHASE_COMPUTE);
+
+            colorize_dirty(color_table, state.iters, pixels, &dirty, nmax);
+            frame_times_mark(&times, PHASE_COLORIZE);
+        }
+        else frame_times_mark(&times, PHASE_COMPUTE);
 
-        image.create(SCREEN_W, SCREEN_H, pixels);
-        texture.loadFromImage(image);
-        sf::Sprite sprite(texture);
+        upload_dirty(&texture, pixels, scratch, &dirty, &stats);
+        dirty_clear(&dirty);
+        frame_times_mark(&times, PHASE_UPLOAD);
 
-        print_fps(&status, &clock, &prev_time, fps_buffer);
+        print_fps(&status, &status_string, &clock, &prev_time, &times, graph, nmax, &stats,
+                  (benchmark && socket < 0) ? TEST_NUMBER : 1);
+        if (graph) update_frame_graph(&graph_vertices, &times);
 
         window.clear();
         window.draw(sprite);
         window.draw(status);
+        if (graph) window.draw(graph_vertices);
         window.display();
+
+        frame_times_mark(&times, PHASE_PRESENT);
+        frame_times_end(&times);
+
+        stats.frame_allocs = alloc_stats().count - frame_start.count;
+        stats.allocating_frames += (stats.frame_allocs > 0);
+        stats.frames++;
+    }
+
+    show_frame_times(&times);
+    printf("Frames with allocations: %zu of %zu, peak RSS: %ld KB\n", stats.allocating_frames, stats.frames, peak_rss_kb());
+    frame_times_free(&times);
+
+    if (socket >= 0) {
+        printf("Received %zu KB instead of %zu KB of whole frames\n", stats.total_net_bytes / 1024,
+               stats.full_net_bytes / 1024);
+        close(socket);
+    }
+
+    if (session.file) {
+        printf("Session: %ld tiles loaded, %ld calculated, %d stored\n", session.loaded, session.computed, session.tiles_count);
+        session_close(&session);
     }
 
-    show_fps_buffer(fps_buffer);
-    free(fps_buffer);
+    iter_state_free(&state);
 
+    free(message);
+    free(scratch);
     free(pixels);
-    return free_color_table(&color_table);
+    return color_table ? free_color_table(&color_table) : OK;
 }
 
 
-void print_fps(sf::Text *status, sf::Clock *clock, sf::Time *prev_time, int *fps_buffer) {
-    assert(prev_time && "Can't print fps without prev time pointer!\n");
-    assert(fps_buffer && "Can't print fps without fps buffer!\n");
+int receive_frames(int socket, uint8_t *message, uint8_t *pixels, DirtyRegion *dirty, int *nmax, FrameStats *stats) {
+    assert(stats && "Can't count traffic in null stats!\n");
 
-    static size_t fps_index = 0;
+    stats -> frame_net_bytes = 0;
 
-    sf::Time curr_time = clock -> getElapsedTime();
+    pollfd request = {socket, POLLIN, 0};
 
-    int fps = (int)((float) TEST_NUMBER * 1.0f / (curr_time.asSeconds() - prev_time -> asSeconds()));
+    while (poll(&request, 1, 0) > 0) {
+        if (!(request.revents & POLLIN)) {
+            printf("Back end closed connection\n");
+            return FILE_NOT_FOUND;
+        }
 
-    char fps_text[FPS_TEXT_SIZE] = "";
-    sprintf(fps_text, "FPS: %i", fps);
-    status -> setString(fps_text);
+        size_t bytes = 0;
+        int result = remote_receive_frame(socket, message, pixels, dirty, nmax, &bytes);
+        if (result) return result;
 
-    *prev_time = curr_time;
+        stats -> frame_net_bytes += bytes;
+        stats -> total_net_bytes += bytes;
+        stats -> full_net_bytes += 4 * (size_t) SCREEN_W * (size_t) SCREEN_H;
+    }
 
-    fps_buffer[fps_index] = fps;
-    fps_index = (fps_index + 1) % FPS_BUFFER_SIZE;
+    return OK;
 }
 
 
-void show_fps_buffer(int *fps_buffer) {
-    assert(fps_buffer && "Can't show null fps buffer!\n");
+void upload_dirty(sf::Texture *texture, const uint8_t *pixels, uint8_t *scratch, const DirtyRegion *dirty, FrameStats *stats) {
+    assert(texture && "Can't upload into null texture!\n");
+    assert(pixels && scratch && "Can't upload null buffer!\n");
+    assert(dirty && "Can't upload null dirty region!\n");
+    assert(stats && "Can't count upload in null stats!\n");
 
-    for (size_t i = 0; i < FPS_BUFFER_SIZE; i++) printf("%d, ", fps_buffer[i]);
-    putchar('\n');
-}
+    DirtyRect rects[DIRTY_BANDS] = {};
+    int count = dirty_rects(dirty, rects);
 
+    stats -> frame_bytes = 0;
 
-int event_parser(EventArgs *args) {
-    assert(args && "Event parser can't work with null args!\n");
-    assert(args -> window && "Event parser can't work with null window!\n");
-    assert(args -> transform && "Event parser can't work with null transform!\n");
+    for (int i = 0; i < count; i++) {
+        const DirtyRect *rect = rects + i;
+        const uint8_t *source = pixels + 4 * (rect -> y * SCREEN_W);
 
-    sf::Event event;
-    while (args -> window -> pollEvent(event)) {
-        if (event.type == sf::Event::Closed) {
-            args -> window -> close();
-            return 1;
+        // Rows of narrow rectangle are not contiguous in the screen buffer, so they are packed
+        if (rect -> width != SCREEN_W) {
+            for (int y = 0; y < rect -> height; y++)
+                memcpy(scratch + 4 * y * rect -> width, pixels + 4 * ((rect -> y + y) * SCREEN_W + rect -> x), 4 * (size_t) rect -> width);
+
+            source = scratch;
         }
-        
-        transform_input(event, args -> transform);
+
+        texture -> update(source, (unsigned) rect -> width, (unsigned) rect -> height, (unsigned) rect -> x, (unsigned) rect -> y);
+
+        stats -> frame_bytes += 4 * (size_t) rect -> width * (size_t) rect -> height;
     }
 
-    return 0;
+    stats -> total_bytes += stats -> frame_bytes;
+    stats -> full_bytes += 4 * (size_t) SCREEN_W * (size_t) SCREEN_H;
 }
 
 
-void transform_input(sf::Event event, Transform *transform) {
-    assert(transform && "Transformation pointer in null!\n");
+void print_fps(sf::Text *status, sf::String *string, sf::Clock *clock, sf::Time *prev_time, FrameTimes *times, bool graph,
+               int nmax, const FrameStats *stats, size_t scale) {
+    assert(prev_time && "Can't print fps without prev time pointer!\n");
+    assert(times && "Can't print fps without frame times!\n");
+    assert(stats && "Can't print null frame stats!\n");
 
-    switch (event.type) {
-        case sf::Event::KeyPressed: {
-            switch (event.key.code) {
-                case sf::Keyboard::Up:
-                    transform -> center_y -= MOVE_FACTOR * transform -> set_h; return;
+    sf::Time curr_time = clock -> getElapsedTime();
 
-                case sf::Keyboard::Down:
-                    transform -> center_y += MOVE_FACTOR * transform -> set_h; return;
+    int fps = (int)((float) scale / (curr_time.asSeconds() - prev_time -> asSeconds()));
 
-                case sf::Keyboard::Left:
-                    transform -> center_x -= MOVE_FACTOR * transform -> set_w; return;
+    char fps_text[FPS_TEXT_SIZE] = "";
+    int length = snprintf(fps_text, FPS_TEXT_SIZE, "FPS: %i NMAX: %i\nUpload: %zu KB, saved %.1f%%\nAllocs: %zu, peak RSS: %ld MB",
+                          fps, nmax, stats -> frame_bytes / 1024, 100.0 * (1.0 - (double) stats -> total_bytes / (double) stats -> full_bytes),
+                          stats -> frame_allocs, peak_rss_kb() / 1024);
 
-                case sf::Keyboard::Right:
-                    transform -> center_x += MOVE_FACTOR * transform -> set_w; return;
-                
-                default: return;
-            }
-        }
-        case sf::Event::MouseWheelScrolled: {
-            if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
-                if (event.mouseWheelScroll.delta > 0) {
-                    transform -> set_w *= ZOOM_FACTOR;
-                    transform -> set_h *= ZOOM_FACTOR;
-                }
-                else {
-                    transform -> set_w /= ZOOM_FACTOR;
-                    transform -> set_h /= ZOOM_FACTOR;
-                }
-            }
+    if (stats -> full_net_bytes && length > 0 && (size_t) length < FPS_TEXT_SIZE)
+        length += snprintf(fps_text + length, FPS_TEXT_SIZE - (size_t) length, "\nNetwork: %zu KB, saved %.1f%%", stats -> frame_net_bytes / 1024,
+                           100.0 * (1.0 - (double) stats -> total_net_bytes / (double) stats -> full_net_bytes));
 
-            break;
-        }
+    // Percentiles over the frames on the graph, phases are listed in the order of bar colors from the bottom
+    for (int phase = 0; graph && phase <= FRAME_PHASES && length > 0 && (size_t) length < FPS_TEXT_SIZE; phase++) {
+        float p50 = 0, p99 = 0;
+        frame_times_percentiles(times, phase, &p50, &p99);
 
-        default: return;
+        length += snprintf(fps_text + length, FPS_TEXT_SIZE - (size_t) length, "\n%s: p50 %.2f ms, p99 %.2f ms",
+                           (phase < FRAME_PHASES) ? FRAME_PHASE_NAMES[phase] : "Frame", (double) p50, (double) p99);
     }
-}
 
+    set_text(status, string, fps_text);
 
-void set_pixels(const IterColor *color_table, uint8_t *buffer, const Transform *transform) {
-    assert(color_table && "Color table is null!\n");
-    assert(buffer && "Can't set pixels with null buffer!\n");
+    *prev_time = curr_time;
+}
 
-    const float delta_x = transform -> set_w / (float)SCREEN_W;
-    const float delta_y = transform -> set_h / (float)SCREEN_H;
 
-    float y0 = transform -> center_y - 0.5f * transform -> set_h;
+void update_frame_graph(sf::VertexArray *vertices, const FrameTimes *times) {
+    assert(vertices && vertices -> getVertexCount() == GRAPH_VERTICES && "Invalid graph vertex array!\n");
+    assert(times && "Can't draw null frame times!\n");
 
-    for (uint32_t y = 0; y < SCREEN_H; y++) {
+    const float bottom = SCREEN_H - 10;
+    const float top_limit = bottom - FRAME_GRAPH_HEIGHT;
+    const float scale = FRAME_GRAPH_HEIGHT / FRAME_GRAPH_MAX_MS;
 
-        __m256 x0 = _mm256_add_ps(
-            _mm256_set1_ps(transform -> center_x - 0.5f * transform -> set_w),
-            _mm256_set_ps(0.0f, delta_x, 2.0f * delta_x, 3.0f * delta_x, 4.0f * delta_x, 5.0f * delta_x, 6.0f * delta_x, 7.0f * delta_x)
-        );
+    for (int i = 0; i < FRAME_HISTORY; i++) {
+        float left = GRAPH_X + (float) (FRAME_HISTORY - 1 - i) * GRAPH_BAR;
+        float top = bottom;
 
-        for (uint32_t x = 0; x < SCREEN_W; x += 8) {
-            __m256 x_i = x0;
-            __m256 y_i = _mm256_set1_ps(y0);
+        for (int phase = 0; phase < FRAME_PHASES; phase++) {
+            // Frames not measured yet and clipped parts of long frames get empty quads
+            float height = (i < times -> count) ? frame_times_get(times, i, phase) * scale : 0;
+            if (height > top - top_limit) height = top - top_limit;
 
-            __m256i N = _mm256_setzero_si256();
-            for (;;) {
-                __m256 x2 = _mm256_mul_ps(x_i, x_i);
-                __m256 y2 = _mm256_mul_ps(y_i, y_i);
-                __m256 xy = _mm256_mul_ps(x_i, y_i);
+            sf::Vertex *quad = &(*vertices)[(size_t) (4 * (i * FRAME_PHASES + phase))];
 
+            quad[0] = sf::Vertex(sf::Vector2f(left, top), GRAPH_COLORS[phase]);
+            quad[1] = sf::Vertex(sf::Vector2f(left + GRAPH_BAR, top), GRAPH_COLORS[phase]);
+            quad[2] = sf::Vertex(sf::Vector2f(left + GRAPH_BAR, top - height), GRAPH_COLORS[phase]);
+            quad[3] = sf::Vertex(sf::Vector2f(left, top - height), GRAPH_COLORS[phase]);
 
-                __m256 res1 = _mm256_cmp_ps(_mm256_add_ps(x2, y2), _mm256_set1_ps(RMAX * RMAX), _CMP_LT_OS);
-                if (_mm256_testz_si256(_mm256_castps_si256(res1), _mm256_set1_epi32(0xFFFFFFFF))) break;
+            top -= height;
+        }
+    }
 
-                N = _mm256_add_epi32(N, _mm256_and_si256(_mm256_castps_si256(res1), _mm256_set1_epi32(1)));
+    // Line of 60 FPS budget over the bars
+    float budget = bottom - FRAME_BUDGET_MS * scale;
+    float right = GRAPH_X + FRAME_HISTORY * GRAPH_BAR;
+    sf::Vertex *line = &(*vertices)[(size_t) (4 * FRAME_HISTORY * FRAME_PHASES)];
 
-                __m256i res2 = _mm256_cmpeq_epi32(N, _mm256_set1_epi32(NMAX));
-                if (!_mm256_testz_si256(res2, _mm256_set1_epi32(0xFFFFFFFF))) break;
+    line[0] = sf::Vertex(sf::Vector2f(GRAPH_X, budget), sf::Color::White);
+    line[1] = sf::Vertex(sf::Vector2f(right, budget), sf::Color::White);
+    line[2] = sf::Vertex(sf::Vector2f(right, budget + 1), sf::Color::White);
+    line[3] = sf::Vertex(sf::Vector2f(GRAPH_X, budget + 1), sf::Color::White);
+}
 
 
-                x_i = _mm256_add_ps(_mm256_sub_ps(x2, y2), x0);
-                y_i = _mm256_add_ps(_mm256_mul_ps(xy, _mm256_set1_ps(2.0f)), _mm256_set1_ps(y0));
-            }
+void set_text(sf::Text *text, sf::String *string, const char *str) {
+    assert(text && string && "Can't set null text!\n");
+    assert(str && "Can't set null string!\n");
 
-            VecToArr tmpN = {}, tmpX = {};
-            tmpN.int_vec = N, tmpX.float_vec = x0;
+    string -> clear();
+    for (; *str; str++) *string += sf::String((sf::Uint32) *str);
 
-            for (int i = 7; i >= 0; i--) {
-                set_pixel_color(color_table, buffer, (tmpN.int_arr)[i], (tmpX.float_arr)[8 - i - 1], y0);
-                buffer += 4;
-            }
+    text -> setString(*string);
+}
 
-            x0 = _mm256_add_ps(x0, _mm256_set1_ps(8.0f * delta_x));
-        }
 
-        y0 += delta_y;
-    }
-}
+void show_frame_times(FrameTimes *times) {
+    assert(times && "Can't show null frame times!\n");
 
+    printf("Last %d frames:\n", times -> count);
 
-void set_pixel_color(const IterColor *color_table, uint8_t *buffer, int N, float x, float y) {
-    assert(buffer && "Can't set pixel color with null buffer!\n");
+    for (int phase = 0; phase <= FRAME_PHASES; phase++) {
+        float p50 = 0, p99 = 0;
+        frame_times_percentiles(times, phase, &p50, &p99);
 
-    if (0 < N && N < NMAX) {
-        buffer[0] = color_table[N % POSSIBLE_COLORS].red;
-        buffer[1] = color_table[N % POSSIBLE_COLORS].green;
-        buffer[2] = color_table[N % POSSIBLE_COLORS].blue;
-        buffer[3] = 255;
-    }
-    else {
-        buffer[0] = 0;
-        buffer[1] = 0;
-        buffer[2] = 0;
-        buffer[3] = 255;
+        printf("%-10s p50 %7.3f ms, p99 %7.3f ms\n", (phase < FRAME_PHASES) ? FRAME_PHASE_NAMES[phase] : "Frame",
+               (double) p50, (double) p99);
     }
 }
 
 
-int load_color_table(const char *filename, IterColor **buffer) {
-    ASSERT(filename, INVALID_ARG, "Can't load without filename!\n");
-    ASSERT(buffer, INVALID_ARG, "Can't load in null buffer!\n");
-
-    FILE *file = fopen(filename, "r");
-    ASSERT(file, FILE_NOT_FOUND, "Color table source file not found!\n");
+int event_parser(EventArgs *args) {
+    assert(args && "Event parser can't work with null args!\n");
+    assert(args -> window && "Event parser can't work with null window!\n");
+    assert(args -> transform && "Event parser can't work with null transform!\n");
+    assert(args -> nmax && "Event parser can't work with null nmax!\n");
 
-    *buffer = (IterColor *) calloc(POSSIBLE_COLORS, sizeof(IterColor));
-    ASSERT(*buffer, ALLOC_FAIL, "Can't allocate color table buffer!\n");
+    sf::Event event;
+    while (args -> window -> pollEvent(event)) {
+        if (event.type == sf::Event::Closed) {
+            args -> window -> close();
+            return 1;
+        }
 
-    for (int i = 0; i < POSSIBLE_COLORS; i++) {
-        if (fscanf(file, "%hhu %hhu %hhu", &((*buffer + i) -> red), &((*buffer + i) -> green), &((*buffer + i) -> blue)) != 3) {
-            free(*buffer);
-            *buffer = nullptr;
+        // Graph belongs to this window only, so it is not a view input
+        if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F1) {
+            if (args -> graph) *args -> graph = !*args -> graph;
+            continue;
+        }
+        
+        ViewInput input = event_to_input(event);
+        if (input == INPUT_NONE) continue;
 
-            printf("Color table source file not found!\n");
-            return INVALID_FORMAT;
+        // Remote view changes when back end answers with new tiles
+        if (args -> socket >= 0) {
+            if (remote_send_input(args -> socket, input)) return 1;
         }
+        else view_input_apply(input, args -> transform, args -> nmax);
     }
 
-    fclose(file);
-
-    return OK;
+    return 0;
 }
 
 
-int free_color_table(IterColor **buffer) {
-    ASSERT(buffer, INVALID_ARG, "Pointer to buffer is null!\n");
-    ASSERT(*buffer, INVALID_ARG, "Can't free null buffer!\n");
+ViewInput event_to_input(sf::Event event) {
+    switch (event.type) {
+        case sf::Event::KeyPressed: {
+            switch (event.key.code) {
+                case sf::Keyboard::Up:          return INPUT_UP;
+                case sf::Keyboard::Down:        return INPUT_DOWN;
+                case sf::Keyboard::Left:        return INPUT_LEFT;
+                case sf::Keyboard::Right:       return INPUT_RIGHT;
+                case sf::Keyboard::N:           return INPUT_NUCLEUS;
 
-    free(*buffer);
-    *buffer = nullptr;
+                case sf::Keyboard::Add:
+                case sf::Keyboard::Equal:       return INPUT_NMAX_UP;
 
-    return OK;
+                case sf::Keyboard::Subtract:
+                case sf::Keyboard::Hyphen:      return INPUT_NMAX_DOWN;
+
+                default: return INPUT_NONE;
+            }
+        }
+        case sf::Event::MouseWheelScrolled: {
+            if (event.mouseWheelScroll.wheel != sf::Mouse::VerticalWheel) return INPUT_NONE;
+
+            return (event.mouseWheelScroll.delta > 0) ? INPUT_ZOOM_IN : INPUT_ZOOM_OUT;
+        }
+
+        default: return INPUT_NONE;
+    }
 }
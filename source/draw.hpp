@@ -6,6 +6,9 @@
 
 /**
  * \brief Constantly draws Mandelbrot set
+ * \param [in] socket  Remote back end socket that renders the view, negative value means local rendering
+ * \param [in] session Session file of calculated tiles for local rendering, null means no session
+ * \param [in] benchmark Every local frame is calculated from scratch many times and FPS is multiplied back
  * \return Non zero value means error
 */
-int draw_mandelbrot(void);
+int draw_mandelbrot(int socket, const char *session, bool benchmark);
@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \brief Source file for render time estimation from sparse pixel sample
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "estimate.hpp"
+
+
+/// Arguments of sample rendering tasks
+typedef struct {
+    const RefOrbit *orbit = nullptr;            ///< Main reference orbit
+    const DeepView *view = nullptr;             ///< Estimated view
+    PerturbTier tier = TIER_DOUBLE;             ///< Delta precision tier
+    const int *pixels = nullptr;                ///< Sampled pixel indices
+    int count = 0;                              ///< Number of sampled pixels
+    int *iters = nullptr;                       ///< Iteration numbers of the whole view
+    double *chunk_seconds = nullptr;            ///< Render time of every chunk
+} SampleTaskArgs;
+
+
+/**
+ * \brief Renders ESTIMATE_CHUNK sampled pixels
+*/
+static void sample_task(void *arg, int index);
+
+
+/**
+ * \brief Returns pseudo random offset in [0, range) for the cell, the same for every run
+*/
+static int cell_jitter(uint32_t cell, int range);
+
+
+/**
+ * \brief Returns relative standard error of seconds per iteration, estimated as ratio of chunk time and iteration sums
+ * \param [in] seconds Render time of every chunk
+ * \param [in] iters   Valid iterations of every chunk
+ * \param [in] count   Number of chunks
+*/
+static double rate_error(const double *seconds, const double *iters, int count);
+
+
+
+
+int estimate_render(const DeepView *view, WorkerPool *pool, int stride, RenderEstimate *estimate) {
+    ASSERT(view, INVALID_ARG, "Can't estimate null view!\n");
+    ASSERT(pool, INVALID_ARG, "Can't estimate without worker pool!\n");
+    ASSERT(stride > 0, INVALID_ARG, "Invalid sample stride!\n");
+    ASSERT(estimate, INVALID_ARG, "Can't store null estimate!\n");
+
+    *estimate = {};
+
+    const int cells_x = (view -> width + stride - 1) / stride;
+    const int cells_y = (view -> height + stride - 1) / stride;
+
+    const int chunks_max = (cells_x * cells_y * ESTIMATE_RUN + ESTIMATE_CHUNK - 1) / ESTIMATE_CHUNK;
+
+    // Only sampled pixels are written, so untouched pages of the buffer are never committed
+    int *iters = (int *) calloc((size_t) view -> width * (size_t) view -> height, sizeof(int));
+    int *pixels = (int *) calloc((size_t) cells_x * (size_t) cells_y * ESTIMATE_RUN, sizeof(int));
+    double *chunk_seconds = (double *) calloc((size_t) chunks_max, sizeof(double));
+    double *chunk_iters = (double *) calloc((size_t) chunks_max, sizeof(double));
+
+    if (!iters || !pixels || !chunk_seconds || !chunk_iters) {
+        free(iters);
+        free(pixels);
+        free(chunk_seconds);
+        free(chunk_iters);
+
+        printf("Can't allocate estimate buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    int count = 0;
+
+    for (int cy = 0; cy < cells_y; cy++) {
+        for (int cx = 0; cx < cells_x; cx++) {
+            int cell_w = (cx + 1) * stride > view -> width ? view -> width - cx * stride : stride;
+            int cell_h = (cy + 1) * stride > view -> height ? view -> height - cy * stride : stride;
+
+            int run = (cell_w < ESTIMATE_RUN) ? cell_w : ESTIMATE_RUN;
+
+            uint32_t cell = (uint32_t) (cy * cells_x + cx);
+            int x = cx * stride + cell_jitter(2 * cell, cell_w - run + 1);
+            int y = cy * stride + cell_jitter(2 * cell + 1, cell_h);
+
+            for (int i = 0; i < run; i++) pixels[count++] = y * view -> width + x + i;
+        }
+    }
+
+    RefOrbit orbit = {};
+
+    double start = get_seconds();
+    int result = ref_orbit_create(&orbit, view, &view -> center_x, &view -> center_y, ORBIT_AUTO);
+    estimate -> ref_seconds = get_seconds() - start;
+
+    if (!result) {
+        SampleTaskArgs args = {};
+        args.orbit = &orbit;
+        args.view = view;
+        args.tier = perturb_choose_tier(view);
+        args.pixels = pixels;
+        args.count = count;
+        args.iters = iters;
+        args.chunk_seconds = chunk_seconds;
+
+        start = get_seconds();
+        pool_run(pool, sample_task, &args, (count + ESTIMATE_CHUNK - 1) / ESTIMATE_CHUNK);
+        estimate -> sample_seconds = get_seconds() - start;
+
+        result = ref_orbit_free(&orbit);
+    }
+
+    if (!result) {
+        double sum = 0, sum2 = 0;
+        int valid = 0;
+
+        for (int i = 0; i < count; i++) {
+            int n = iters[pixels[i]];
+
+            if (n == PIXEL_GLITCHED) {
+                estimate -> glitched++;
+                continue;
+            }
+
+            sum += n;
+            sum2 += (double) n * n;
+            valid++;
+
+            chunk_iters[i / ESTIMATE_CHUNK] += n;
+        }
+
+        estimate -> samples = count;
+
+        if (valid) {
+            double pixels_count = (double) view -> width * (double) view -> height;
+            double mean = sum / valid;
+            double variance = (valid > 1) ? (sum2 - sum * mean) / (valid - 1) : 0;
+
+            estimate -> iters = mean * pixels_count;
+            estimate -> iters_error = ESTIMATE_Z * sqrt(fmax(variance, 0) / valid) * pixels_count;
+
+            estimate -> throughput = (estimate -> sample_seconds > 0) ? sum / estimate -> sample_seconds : 0;
+
+            // Chunks run in parallel, so their times give only the spread of the rate, its level is taken from wall time
+            double rate = rate_error(chunk_seconds, chunk_iters, (count + ESTIMATE_CHUNK - 1) / ESTIMATE_CHUNK);
+            estimate -> throughput_error = ESTIMATE_Z * rate * estimate -> throughput;
+
+            if (estimate -> throughput > 0) {
+                // Glitched pixels are rendered again at full cost, every cluster of them with its own reference
+                double share = (double) estimate -> glitched / count;
+                double glitched = pixels_count * share;
+                double references = fmin(glitched / ESTIMATE_CLUSTER_PIXELS, PERTURB_MAX_CLUSTERS * PERTURB_MAX_ROUNDS);
+
+                estimate -> glitch_seconds = references * estimate -> ref_seconds + glitched * mean / estimate -> throughput;
+
+                double iter_seconds = estimate -> iters / estimate -> throughput;
+                estimate -> seconds = estimate -> ref_seconds + iter_seconds + estimate -> glitch_seconds;
+
+                // Glitch time grows with glitched share, so its relative binomial error carries over
+                double share_error = (share > 0) ? ESTIMATE_Z * sqrt(share * (1 - share) / count) / share : 0;
+
+                double iters_part = estimate -> iters_error / estimate -> throughput;
+                double rate_part = ESTIMATE_Z * rate * (iter_seconds + estimate -> glitch_seconds);
+                double glitch_part = share_error * estimate -> glitch_seconds;
+
+                estimate -> seconds_error = sqrt(iters_part * iters_part + rate_part * rate_part + glitch_part * glitch_part);
+            }
+        }
+    }
+
+    free(iters);
+    free(pixels);
+    free(chunk_seconds);
+    free(chunk_iters);
+
+    return result;
+}
+
+
+static void sample_task(void *arg, int index) {
+    SampleTaskArgs *args = (SampleTaskArgs *) arg;
+
+    int begin = index * ESTIMATE_CHUNK;
+    int count = args -> count - begin;
+    if (count > ESTIMATE_CHUNK) count = ESTIMATE_CHUNK;
+
+    double start = get_seconds();
+    perturb_pixels(args -> orbit, args -> view, args -> tier, args -> pixels + begin, count, args -> iters);
+    args -> chunk_seconds[index] = get_seconds() - start;
+}
+
+
+static int cell_jitter(uint32_t cell, int range) {
+    // Integer hash, so neighbour cells get unrelated offsets
+    cell ^= cell >> 16;
+    cell *= 0x7feb352d;
+    cell ^= cell >> 15;
+    cell *= 0x846ca68b;
+    cell ^= cell >> 16;
+
+    return (int) (cell % (uint32_t) range);
+}
+
+
+static double rate_error(const double *seconds, const double *iters, int count) {
+    double seconds_sum = 0, iters_sum = 0;
+
+    for (int i = 0; i < count; i++) {
+        seconds_sum += seconds[i];
+        iters_sum += iters[i];
+    }
+
+    if (count < 2 || seconds_sum <= 0 || iters_sum <= 0) return 0;
+
+    double rate = seconds_sum / iters_sum;
+    double residual = 0;
+
+    for (int i = 0; i < count; i++) {
+        double diff = seconds[i] - rate * iters[i];
+        residual += diff * diff;
+    }
+
+    // Standard error of ratio estimator relative to the ratio itself
+    return sqrt(residual / (count - 1) / count) / (seconds_sum / count);
+}
@@ -0,0 +1,45 @@
+/**
+ * \file
+ * \brief Header file for render time estimation from sparse pixel sample
+*/
+
+#ifndef ESTIMATE_HPP
+#define ESTIMATE_HPP
+
+#include "perturb.hpp"
+#include "pool.hpp"
+
+
+/// Extrapolated cost of rendering the whole view
+typedef struct {
+    int samples = 0;                            ///< Number of sampled pixels
+    int glitched = 0;                           ///< Number of sampled pixels glitched with main reference
+    double ref_seconds = 0;                     ///< Time of main reference orbit, it is not sampled
+    double sample_seconds = 0;                  ///< Time of sampled pixels
+    double throughput = 0;                      ///< Iterations per second measured on the sample
+    double throughput_error = 0;                ///< 95% sampling error of throughput, from spread of per chunk rates
+    double iters = 0;                           ///< Extrapolated number of iterations of all pixels
+    double iters_error = 0;                     ///< 95% sampling error of iterations
+    double glitch_seconds = 0;                  ///< Approximate time of glitch correction, it is included in seconds
+    double seconds = 0;                         ///< Extrapolated render time
+    double seconds_error = 0;                   ///< 95% sampling error of render time, not a bound on real render time
+} RenderEstimate;
+
+
+/**
+ * \brief Renders ESTIMATE_RUN pixels row of every stride x stride cell with the real kernel and extrapolates render time
+ * \note Sample is stratified with jittered position inside every cell. Throughput is measured on the same pool
+ * the render would use, so it includes thread count and CPU limits of this machine. Glitch correction is
+ * approximated with one secondary reference per ESTIMATE_CLUSTER_PIXELS extrapolated glitched pixels and rendering
+ * them again. Error combines sampling errors of iterations, throughput and glitched share. Glitch correction model
+ * and throughput difference between sparse sample and full render are not covered, so real time can be outside it
+ * \param [in]     view        View to estimate
+ * \param [in,out] pool        Worker pool
+ * \param [in]     stride      Cell size in pixels
+ * \param [out]    estimate    Estimate to fill
+ * \return Non zero value means error
+*/
+int estimate_render(const DeepView *view, WorkerPool *pool, int stride, RenderEstimate *estimate);
+
+
+#endif
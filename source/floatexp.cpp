@@ -0,0 +1,53 @@
+/**
+ * \file
+ * \brief Source file for string conversions of extended exponent numbers
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "floatexp.hpp"
+
+
+
+
+int floatexp_from_string(const char *str, FloatExp *value) {
+    // Mantissa is parsed separately, because strtod turns "1e-500" into zero
+    char mantissa_str[64] = "";
+    size_t mantissa_len = strcspn(str, "eE");
+    if (mantissa_len == 0 || mantissa_len >= sizeof(mantissa_str)) return 1;
+
+    memcpy(mantissa_str, str, mantissa_len);
+
+    char *end = nullptr;
+    double mantissa = strtod(mantissa_str, &end);
+    if (*end != '\0') return 1;
+
+    long exp10 = 0;
+    if (str[mantissa_len] != '\0') {
+        const char *exp_str = str + mantissa_len + 1;
+        exp10 = strtol(exp_str, &end, 10);
+        if (end == exp_str || *end != '\0') return 1;
+    }
+
+    // mantissa * 10^exp10 = mantissa * 2^(exp10 * log2(10))
+    double power = (double) exp10 * 3.321928094887362347870319429489;
+    double int_part = floor(power);
+
+    *value = floatexp_make(mantissa * exp2(power - int_part), (int64_t) int_part);
+    return 0;
+}
+
+
+void floatexp_to_string(FloatExp value, char *str) {
+    if (floatexp_is_zero(value)) {
+        sprintf(str, "0");
+        return;
+    }
+
+    double exp10 = floatexp_log2(value) * 0.301029995663981195213738894724;
+    double int_part = floor(exp10);
+
+    sprintf(str, "%s%.6fe%+ld", (value.mantissa < 0) ? "-" : "", pow(10.0, exp10 - int_part), (long) int_part);
+}
@@ -0,0 +1,234 @@
+/**
+ * \file
+ * \brief Floating point numbers with extended exponent for zooms beyond double range
+*/
+
+#ifndef FLOATEXP_HPP
+#define FLOATEXP_HPP
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdint.h>
+
+
+const int FLOATEXP_RESCALE_BITS = 64;           ///< Vector mantissa is rescaled when it leaves [2^-64, 2^64]
+
+
+/// Number equal to mantissa * 2^exponent
+typedef struct {
+    double mantissa = 0;                        ///< Mantissa in [0.5, 1) by absolute value or zero
+    int64_t exponent = 0;                       ///< Binary exponent
+} FloatExp;
+
+
+/// Four complex numbers equal to (re + i * im) * 2^exponent, lanes have separate exponents
+typedef struct {
+    __m256d re = {};                            ///< Real mantissa
+    __m256d im = {};                            ///< Imaginary mantissa
+    __m256i exponent = {};                      ///< Binary exponents shared by real and imaginary parts
+} ComplexExpVec;
+
+
+/**
+ * \brief Creates normalized number equal to mantissa * 2^exponent
+*/
+inline FloatExp floatexp_make(double mantissa, int64_t exponent) {
+    int shift = 0;
+    double norm = frexp(mantissa, &shift);
+
+    if (fpclassify(norm) == FP_ZERO) return {0, 0};
+
+    return {norm, exponent + shift};
+}
+
+
+/**
+ * \brief Converts double into number
+*/
+inline FloatExp floatexp_from_double(double value) {
+    return floatexp_make(value, 0);
+}
+
+
+/**
+ * \brief Converts number into double, returns zero if it is too small for double
+*/
+inline double floatexp_to_double(FloatExp value) {
+    if (value.exponent < -1100) return 0;
+    if (value.exponent > 1100) return value.mantissa * HUGE_VAL;
+
+    return ldexp(value.mantissa, (int) value.exponent);
+}
+
+
+/**
+ * \brief Returns true if number is zero
+*/
+inline bool floatexp_is_zero(FloatExp value) {
+    return fpclassify(value.mantissa) == FP_ZERO;
+}
+
+
+/**
+ * \brief Returns log2 of number absolute value
+*/
+inline double floatexp_log2(FloatExp value) {
+    return log2(fabs(value.mantissa)) + (double) value.exponent;
+}
+
+
+/**
+ * \brief Calculates a * b
+*/
+inline FloatExp floatexp_mul(FloatExp a, FloatExp b) {
+    return floatexp_make(a.mantissa * b.mantissa, a.exponent + b.exponent);
+}
+
+
+/**
+ * \brief Calculates a * b
+*/
+inline FloatExp floatexp_mul_double(FloatExp a, double b) {
+    return floatexp_make(a.mantissa * b, a.exponent);
+}
+
+
+/**
+ * \brief Calculates a / b
+*/
+inline FloatExp floatexp_div(FloatExp a, FloatExp b) {
+    return floatexp_make(a.mantissa / b.mantissa, a.exponent - b.exponent);
+}
+
+
+/**
+ * \brief Calculates a + b
+*/
+inline FloatExp floatexp_add(FloatExp a, FloatExp b) {
+    if (floatexp_is_zero(a)) return b;
+    if (floatexp_is_zero(b)) return a;
+
+    if (a.exponent < b.exponent) {
+        FloatExp tmp = a;
+        a = b, b = tmp;
+    }
+
+    int64_t diff = a.exponent - b.exponent;
+    if (diff > 64) return a;
+
+    return floatexp_make(a.mantissa + ldexp(b.mantissa, (int) -diff), a.exponent);
+}
+
+
+/**
+ * \brief Calculates -a
+*/
+inline FloatExp floatexp_neg(FloatExp a) {
+    return {-a.mantissa, a.exponent};
+}
+
+
+/**
+ * \brief Calculates a - b
+*/
+inline FloatExp floatexp_sub(FloatExp a, FloatExp b) {
+    return floatexp_add(a, floatexp_neg(b));
+}
+
+
+/**
+ * \brief Parses string like "1.5e-500" that can be out of double range
+ * \param [in]  str     Source string
+ * \param [out] value   Parsed number
+ * \return Non zero value means error
+*/
+int floatexp_from_string(const char *str, FloatExp *value);
+
+
+/**
+ * \brief Prints number in decimal scientific notation
+ * \param [in]  value   Number to print
+ * \param [out] str     Buffer to store string, must fit at least 32 characters
+*/
+void floatexp_to_string(FloatExp value, char *str);
+
+
+/**
+ * \brief Calculates 2^exponent for each lane, lanes that are too small for double become zero
+*/
+inline __m256d floatexp_vec_exp2(__m256i exponent) {
+    const __m256i min_exp = _mm256_set1_epi64x(-1022);
+    const __m256i max_exp = _mm256_set1_epi64x(1023);
+
+    __m256i underflow = _mm256_cmpgt_epi64(min_exp, exponent);
+    __m256i clamped = _mm256_blendv_epi8(exponent, max_exp, _mm256_cmpgt_epi64(exponent, max_exp));
+
+    __m256i bits = _mm256_slli_epi64(_mm256_add_epi64(clamped, _mm256_set1_epi64x(1023)), 52);
+
+    return _mm256_castsi256_pd(_mm256_andnot_si256(underflow, bits));
+}
+
+
+/**
+ * \brief Creates vector number from four scalar complex numbers
+ * \param [in] re Real parts
+ * \param [in] im Imaginary parts
+*/
+inline ComplexExpVec complexexp_vec_load(const FloatExp re[4], const FloatExp im[4]) {
+    double re_mant[4] = {}, im_mant[4] = {};
+    int64_t exponent[4] = {};
+
+    for (int i = 0; i < 4; i++) {
+        exponent[i] = (re[i].exponent > im[i].exponent) ? re[i].exponent : im[i].exponent;
+        if (floatexp_is_zero(re[i])) exponent[i] = im[i].exponent;
+        if (floatexp_is_zero(im[i])) exponent[i] = re[i].exponent;
+
+        re_mant[i] = floatexp_to_double({re[i].mantissa, re[i].exponent - exponent[i]});
+        im_mant[i] = floatexp_to_double({im[i].mantissa, im[i].exponent - exponent[i]});
+    }
+
+    return {
+        _mm256_loadu_pd(re_mant),
+        _mm256_loadu_pd(im_mant),
+        _mm256_loadu_si256((const __m256i *) exponent)
+    };
+}
+
+
+/**
+ * \brief Moves exponent of lanes with mantissa out of [2^-64, 2^64] into separate exponent
+ * \param [in,out] num Number to rescale
+ * \return True if some lanes were rescaled
+*/
+inline bool complexexp_vec_rescale(ComplexExpVec *num) {
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+    const __m256d high = _mm256_set1_pd(ldexp(1.0, FLOATEXP_RESCALE_BITS));
+    const __m256d low = _mm256_set1_pd(ldexp(1.0, -FLOATEXP_RESCALE_BITS));
+
+    __m256d mag = _mm256_max_pd(_mm256_and_pd(num -> re, abs_mask), _mm256_and_pd(num -> im, abs_mask));
+
+    __m256d out = _mm256_or_pd(
+        _mm256_cmp_pd(mag, high, _CMP_GT_OQ),
+        _mm256_and_pd(_mm256_cmp_pd(mag, low, _CMP_LT_OQ), _mm256_cmp_pd(mag, _mm256_setzero_pd(), _CMP_NEQ_OQ))
+    );
+
+    if (_mm256_testz_pd(out, out)) return false;
+
+    // Biased exponent of magnitude is taken from its bits, other lanes keep zero shift
+    __m256i shift = _mm256_sub_epi64(
+        _mm256_srli_epi64(_mm256_castpd_si256(mag), 52),
+        _mm256_set1_epi64x(1023)
+    );
+    shift = _mm256_and_si256(shift, _mm256_castpd_si256(out));
+
+    __m256d scale = floatexp_vec_exp2(_mm256_sub_epi64(_mm256_setzero_si256(), shift));
+
+    num -> re = _mm256_mul_pd(num -> re, scale);
+    num -> im = _mm256_mul_pd(num -> im, scale);
+    num -> exponent = _mm256_add_epi64(num -> exponent, shift);
+
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * \file
+ * \brief Source file for per phase frame times of the viewer
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.hpp"
+#include "frametime.hpp"
+
+
+/**
+ * \brief Compares floats for qsort
+*/
+static int compare_floats(const void *a, const void *b);
+
+
+
+
+int frame_times_create(FrameTimes *times) {
+    ASSERT(times, INVALID_ARG, "Can't create null frame times!\n");
+
+    *times = {};
+    times -> times = (float *) calloc(FRAME_HISTORY * FRAME_PHASES, sizeof(float));
+    times -> sorted = (float *) calloc(FRAME_HISTORY, sizeof(float));
+
+    if (!times -> times || !times -> sorted) {
+        frame_times_free(times);
+
+        printf("Can't allocate frame times!\n");
+        return ALLOC_FAIL;
+    }
+
+    times -> current = times -> times;
+
+    return OK;
+}
+
+
+int frame_times_free(FrameTimes *times) {
+    ASSERT(times, INVALID_ARG, "Can't free null frame times!\n");
+
+    free(times -> times);
+    free(times -> sorted);
+
+    *times = {};
+
+    return OK;
+}
+
+
+void frame_times_begin(FrameTimes *times) {
+    assert(times && times -> times && "Can't measure into null frame times!\n");
+
+    times -> current = times -> times + times -> next * FRAME_PHASES;
+    memset(times -> current, 0, FRAME_PHASES * sizeof(float));
+
+    times -> mark = get_seconds();
+}
+
+
+void frame_times_mark(FrameTimes *times, FramePhase phase) {
+    assert(times && times -> current && "Can't measure into null frame times!\n");
+    assert(0 <= phase && phase < FRAME_PHASES && "Invalid frame phase!\n");
+
+    double now = get_seconds();
+
+    times -> current[phase] += (float) (1000 * (now - times -> mark));
+    times -> mark = now;
+}
+
+
+void frame_times_end(FrameTimes *times) {
+    assert(times && "Can't measure into null frame times!\n");
+
+    times -> next = (times -> next + 1) % FRAME_HISTORY;
+    if (times -> count < FRAME_HISTORY) times -> count++;
+}
+
+
+float frame_times_get(const FrameTimes *times, int age, int phase) {
+    assert(times && times -> times && "Can't read null frame times!\n");
+    assert(0 <= age && age < times -> count && "Frame is not kept!\n");
+    assert(0 <= phase && phase <= FRAME_PHASES && "Invalid frame phase!\n");
+
+    const float *row = times -> times + ((times -> next - 1 - age + FRAME_HISTORY) % FRAME_HISTORY) * FRAME_PHASES;
+
+    if (phase < FRAME_PHASES) return row[phase];
+
+    float total = 0;
+    for (int i = 0; i < FRAME_PHASES; i++) total += row[i];
+
+    return total;
+}
+
+
+void frame_times_percentiles(FrameTimes *times, int phase, float *p50, float *p99) {
+    assert(times && times -> sorted && "Can't read null frame times!\n");
+    assert(p50 && p99 && "Can't store null percentiles!\n");
+
+    *p50 = *p99 = 0;
+    if (!times -> count) return;
+
+    for (int i = 0; i < times -> count; i++) times -> sorted[i] = frame_times_get(times, i, phase);
+
+    // A few hundred values, sorting them costs microseconds
+    qsort(times -> sorted, (size_t) times -> count, sizeof(float), compare_floats);
+
+    *p50 = times -> sorted[(int) ceil(0.50 * times -> count) - 1];
+    *p99 = times -> sorted[(int) ceil(0.99 * times -> count) - 1];
+}
+
+
+static int compare_floats(const void *a, const void *b) {
+    float x = *(const float *) a, y = *(const float *) b;
+
+    return (x > y) - (x < y);
+}
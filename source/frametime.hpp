@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief Header file for per phase frame times of the viewer, kept in a ring buffer with percentile readouts
+*/
+
+#ifndef FRAMETIME_HPP
+#define FRAMETIME_HPP
+
+#include "configs.hpp"
+
+
+/// Phases of one viewer frame
+typedef enum {
+    PHASE_COMPUTE       = 0,        ///< Iteration update or receiving back end frames
+    PHASE_COLORIZE      = 1,        ///< Coloring changed pixels
+    PHASE_UPLOAD        = 2,        ///< Texture upload of changed rectangles
+    PHASE_PRESENT       = 3,        ///< Status text, drawing and buffer swap
+} FramePhase;
+
+const int FRAME_PHASES = 4;                     ///< Number of frame phases
+
+const char *const FRAME_PHASE_NAMES[] = {"Compute", "Colorize", "Upload", "Present"};
+
+
+/// Frame times of the last FRAME_HISTORY frames in milliseconds
+typedef struct {
+    float *times = nullptr;                     ///< FRAME_HISTORY rows of FRAME_PHASES phase times
+    float *sorted = nullptr;                    ///< Scratch of FRAME_HISTORY values for percentiles
+    float *current = nullptr;                   ///< Row of the frame being measured
+    int next = 0;                               ///< Row of the next frame
+    int count = 0;                              ///< Number of finished frames, up to FRAME_HISTORY
+    double mark = 0;                            ///< Time of the last phase mark in seconds
+} FrameTimes;
+
+
+/**
+ * \brief Allocates frame times buffers
+ * \param [out] times   Frame times to create
+ * \return Non zero value means error
+*/
+int frame_times_create(FrameTimes *times);
+
+
+/**
+ * \brief Frees frame times buffers
+ * \param [in,out] times   Frame times to free
+ * \return Non zero value means error
+*/
+int frame_times_free(FrameTimes *times);
+
+
+/**
+ * \brief Starts measuring new frame, its row is cleared
+*/
+void frame_times_begin(FrameTimes *times);
+
+
+/**
+ * \brief Adds time since the last mark to the phase of current frame
+ * \note Phase can be marked several times per frame, its times are summed
+*/
+void frame_times_mark(FrameTimes *times, FramePhase phase);
+
+
+/**
+ * \brief Finishes current frame, it becomes visible to readouts
+*/
+void frame_times_end(FrameTimes *times);
+
+
+/**
+ * \brief Returns time of finished frame
+ * \param [in] times   Frame times
+ * \param [in] age     Zero means the last finished frame, must be less than times -> count
+ * \param [in] phase   Phase or FRAME_PHASES for the whole frame
+ * \return Time in milliseconds
+*/
+float frame_times_get(const FrameTimes *times, int age, int phase);
+
+
+/**
+ * \brief Computes nearest rank percentiles of phase over kept frames
+ * \param [in,out] times   Frame times, scratch is overwritten
+ * \param [in]     phase   Phase or FRAME_PHASES for the whole frame
+ * \param [out]    p50     Median in milliseconds
+ * \param [out]    p99     99th percentile in milliseconds
+*/
+void frame_times_percentiles(FrameTimes *times, int phase, float *p50, float *p99);
+
+
+#endif
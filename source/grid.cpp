@@ -0,0 +1,136 @@
+/**
+ * \file
+ * \brief Source file for shared sample grid
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "utils.hpp"
+#include "grid.hpp"
+
+
+/**
+ * \brief Snaps one axis
+ * \param [in]  center      Requested center
+ * \param [in]  size        Requested size in pixels
+ * \param [in]  grid        Grid with pixel size and anchor exponent
+ * \param [out] anchor      Anchor of the axis
+ * \param [out] first       Sample of the first rendered pixel
+ * \param [out] rendered    Rendered size in pixels, multiple of TILE_CACHE_SIZE
+ * \param [out] crop        First requested pixel inside rendered ones
+ * \param [out] new_center  Center of rendered pixels
+*/
+static void snap_axis(const BigNum *center, int size, const SampleGrid *grid, BigNum *anchor, int64_t *first, int *rendered,
+                      int *crop, BigNum *new_center);
+
+
+/**
+ * \brief Sets center of rendered pixels, pixel x is at center + (x - rendered / 2) * pixel that is sample first + x
+*/
+static void grid_center(const BigNum *anchor, int64_t first, int rendered, FloatExp pixel, BigNum *center);
+
+
+/**
+ * \brief Returns floor(a / b) for positive b
+*/
+static int64_t floor_div(int64_t a, int64_t b);
+
+
+
+
+int grid_snap(const DeepView *view, GridView *snapped) {
+    ASSERT(view, INVALID_ARG, "Can't snap null view!\n");
+    ASSERT(snapped, INVALID_ARG, "Can't snap into null view!\n");
+    ASSERT(view -> width > 0 && view -> height > 0, INVALID_ARG, "Invalid view size!\n");
+
+    FloatExp pixel = deep_view_pixel(view);
+    ASSERT(pixel.mantissa > 0, INVALID_ARG, "Invalid pixel size!\n");
+
+    // Mantissa in [0.5, 1) keeps GRID_MANTISSA_BITS bits, views with almost the same zoom get one grid
+    double scale = ldexp(1, GRID_MANTISSA_BITS);
+
+    SampleGrid *grid = &snapped -> grid;
+    grid -> pixel = floatexp_make(round(pixel.mantissa * scale) / scale, pixel.exponent);
+    grid -> anchor_exponent = grid -> pixel.exponent + GRID_ANCHOR_BITS;
+
+    snapped -> view = *view;
+
+    int width = 0, height = 0;
+    snap_axis(&view -> center_x, view -> width, grid, &grid -> anchor_x, &grid -> first_x, &width, &snapped -> crop_x,
+              &snapped -> view.center_x);
+    snap_axis(&view -> center_y, view -> height, grid, &grid -> anchor_y, &grid -> first_y, &height, &snapped -> crop_y,
+              &snapped -> view.center_y);
+
+    snapped -> view.width = width;
+    snapped -> view.height = height;
+    snapped -> view.span = floatexp_mul_double(grid -> pixel, (double) width);
+
+    return OK;
+}
+
+
+void grid_crop(const GridView *snapped, const int *iters, int *output, int width, int height) {
+    assert(snapped && "Can't crop null view!\n");
+    assert(iters && output && "Can't crop null buffers!\n");
+
+    for (int y = 0; y < height; y++)
+        memcpy(output + (size_t) y * width,
+               iters + (size_t) (snapped -> crop_y + y) * snapped -> view.width + snapped -> crop_x, (size_t) width * sizeof(int));
+}
+
+
+void grid_tile(const SampleGrid *grid, int64_t tile_x, int64_t tile_y, int nmax, GridView *tile) {
+    assert(grid && "Can't make tile of null grid!\n");
+    assert(tile && "Can't make null tile!\n");
+
+    tile -> grid = *grid;
+    tile -> grid.first_x = tile_x * TILE_CACHE_SIZE;
+    tile -> grid.first_y = tile_y * TILE_CACHE_SIZE;
+
+    tile -> view.width = TILE_CACHE_SIZE;
+    tile -> view.height = TILE_CACHE_SIZE;
+    tile -> view.nmax = nmax;
+    tile -> view.span = floatexp_mul_double(grid -> pixel, (double) TILE_CACHE_SIZE);
+
+    grid_center(&grid -> anchor_x, tile -> grid.first_x, TILE_CACHE_SIZE, grid -> pixel, &tile -> view.center_x);
+    grid_center(&grid -> anchor_y, tile -> grid.first_y, TILE_CACHE_SIZE, grid -> pixel, &tile -> view.center_y);
+
+    tile -> crop_x = 0;
+    tile -> crop_y = 0;
+}
+
+
+static void snap_axis(const BigNum *center, int size, const SampleGrid *grid, BigNum *anchor, int64_t *first, int *rendered,
+                      int *crop, BigNum *new_center) {
+    *anchor = *center;
+    bignum_truncate(anchor, grid -> anchor_exponent);
+
+    BigNum offset = {};
+    bignum_sub(&offset, center, anchor);
+
+    // Offset is below 2^GRID_ANCHOR_BITS pixels, so it is exact enough in double
+    double samples = floatexp_to_double(floatexp_div(bignum_to_floatexp(&offset), grid -> pixel));
+
+    int64_t start = (int64_t) llround(samples - 0.5 * size);
+    int64_t end = start + size;
+
+    *first = floor_div(start, TILE_CACHE_SIZE) * TILE_CACHE_SIZE;
+    *rendered = (int) (floor_div(end + TILE_CACHE_SIZE - 1, TILE_CACHE_SIZE) * TILE_CACHE_SIZE - *first);
+    *crop = (int) (start - *first);
+
+    grid_center(anchor, *first, *rendered, grid -> pixel, new_center);
+}
+
+
+static void grid_center(const BigNum *anchor, int64_t first, int rendered, FloatExp pixel, BigNum *center) {
+    // Anchor keeps precision of the requested center, so the shift is added at the same precision
+    BigNum shift = {};
+    bignum_set_double_exp(&shift, (double) (first + rendered / 2) * pixel.mantissa, pixel.exponent, anchor -> size);
+    bignum_add(center, anchor, &shift);
+}
+
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
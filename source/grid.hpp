@@ -0,0 +1,69 @@
+/**
+ * \file
+ * \brief Header file for shared sample grid, overlapping views snapped to it render every sample once
+*/
+
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <stdint.h>
+#include "configs.hpp"
+#include "bignum.hpp"
+#include "floatexp.hpp"
+#include "perturb.hpp"
+
+
+/// Sample grid, sample (i, j) is at anchor + (i, j) * pixel
+typedef struct {
+    BigNum anchor_x = {};                       ///< Anchor x, multiple of 2^anchor_exponent
+    BigNum anchor_y = {};                       ///< Anchor y, multiple of 2^anchor_exponent
+    int64_t anchor_exponent = 0;                ///< Binary exponent of anchor step
+    FloatExp pixel = {};                        ///< Distance between samples with rounded mantissa
+    int64_t first_x = 0;                        ///< Sample column of the left view column, multiple of TILE_CACHE_SIZE
+    int64_t first_y = 0;                        ///< Sample row of the top view row, multiple of TILE_CACHE_SIZE
+} SampleGrid;
+
+
+/// Requested view snapped to sample grid and expanded to whole tiles
+typedef struct {
+    DeepView view = {};                         ///< Tile aligned view to render
+    SampleGrid grid = {};                       ///< Grid of the view
+    int crop_x = 0;                             ///< Left column of requested view inside rendered one
+    int crop_y = 0;                             ///< Top row of requested view inside rendered one
+} GridView;
+
+
+/**
+ * \brief Snaps view to the grid of its zoom level
+ * \note Pixel size changes by less than 2^-GRID_MANTISSA_BITS and center moves by less than a pixel,
+ * so snapped view looks the same. Views with the same rounded pixel size near the same anchor get the same samples
+ * \param [in]  view    Requested view
+ * \param [out] snapped Snapped and expanded view
+ * \return Non zero value means error
+*/
+int grid_snap(const DeepView *view, GridView *snapped);
+
+
+/**
+ * \brief Copies requested view pixels out of rendered view
+ * \param [in]  snapped Snapped view
+ * \param [in]  iters   Iteration numbers of rendered view
+ * \param [out] output  Iteration numbers of requested view
+ * \param [in]  width   Requested width
+ * \param [in]  height  Requested height
+*/
+void grid_crop(const GridView *snapped, const int *iters, int *output, int width, int height);
+
+
+/**
+ * \brief Makes view of one tile of the grid, its cache key is the key of that tile in any view on the grid
+ * \param [in]  grid    Sample grid, first sample is ignored
+ * \param [in]  tile_x  Tile column, first_x / TILE_CACHE_SIZE of the grid
+ * \param [in]  tile_y  Tile row, first_y / TILE_CACHE_SIZE of the grid
+ * \param [in]  nmax    Max iteration number
+ * \param [out] tile    View of TILE_CACHE_SIZE * TILE_CACHE_SIZE pixels with its grid, nothing is cropped
+*/
+void grid_tile(const SampleGrid *grid, int64_t tile_x, int64_t tile_y, int nmax, GridView *tile);
+
+
+#endif
@@ -0,0 +1,884 @@
+/**
+ * \file
+ * \brief HTTP tile server, one epoll thread parses requests and writes responses, worker pool renders tiles
+ * \note Requests:
+ * GET /tile/zoom/x/y.ppm[?nmax=N] -> PPM tile, tiles of zoom z split square [-2.5, 1.5] x [-2, 2] into 2^z x 2^z
+ * GET /stats -> connection and request counters
+ * Connections are keep-alive for HTTP/1.1 unless the client asks to close. Only HTTP_MAX_RENDERS tiles are
+ * rendered at the same time, other requests wait in FIFO order, so memory does not grow with connections
+*/
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "kernel.hpp"
+#include "pool.hpp"
+
+
+const int HTTP_BACKLOG = 4096;                  ///< Pending connections queue length, kernel caps it with somaxconn
+const int HTTP_EVENTS = 256;                    ///< Max events taken by one epoll_wait
+const int HTTP_REQUEST_SIZE = 2048;             ///< Max size of request head, longer requests are rejected
+const int HTTP_HEADER_SIZE = 256;               ///< Max size of response head
+const int HTTP_TILE = 256;                      ///< Side of served tile
+const int HTTP_PART = 64;                       ///< Side of square tile part rendered by one pool task, multiple of 8
+const int HTTP_PARTS_X = HTTP_TILE / HTTP_PART; ///< Parts in tile row
+const int HTTP_PARTS = HTTP_PARTS_X * HTTP_PARTS_X;    ///< Parts of one tile
+const int HTTP_MAX_RENDERS = 32;                ///< Tiles rendered at the same time, each keeps its own buffers
+const int HTTP_MAX_ZOOM = 12;                   ///< Deepest zoom, float kernel keeps pixels apart down to it
+const int HTTP_MAX_NMAX = 1 << 16;              ///< Max iteration limit of one tile
+const int HTTP_PARK_TIME = 1000;                ///< Milliseconds parked listener waits for a freed descriptor before retry
+const double HTTP_PARK_REPORT_INTERVAL = 10;    ///< Min seconds between out of descriptors messages
+const double HTTP_SET_LEFT = -2.5;              ///< Left side of tiled square
+const double HTTP_SET_TOP = -2;                 ///< Top side of tiled square
+const double HTTP_SET_SIZE = 4;                 ///< Side of tiled square
+
+const char HTTP_PPM_HEAD[] = "P6\n256 256\n255\n";     ///< PPM header of tile
+const size_t HTTP_PPM_SIZE = sizeof(HTTP_PPM_HEAD) - 1 + 3 * HTTP_TILE * HTTP_TILE;    ///< PPM tile size
+
+
+/// Server settings taken from command line
+typedef struct {
+    const char *address = "127.0.0.1";          ///< Listened IPv4 address
+    int port = HTTP_PORT;                       ///< Listened TCP port
+    int threads = 0;                            ///< Number of worker threads, zero means CPU limits
+} HttpArgs;
+
+
+/// Connection states
+typedef enum {
+    CONN_READING        = 0,        ///< Waiting for request head
+    CONN_WAITING        = 1,        ///< Tile request waits for a free render
+    CONN_RENDERING      = 2,        ///< Tile is rendered by the pool
+    CONN_WRITING        = 3,        ///< Response is sent
+} ConnState;
+
+
+/// Client connection, lives until its socket is closed and no render refers to it
+typedef struct HttpConnection {
+    int fd = -1;                                ///< Socket
+    ConnState state = CONN_READING;             ///< State
+    bool keep_alive = false;                    ///< Connection stays open after the response
+    bool closed = false;                        ///< Peer is gone, connection is freed when its render is finished
+    bool half_closed = false;                   ///< Peer shut down its sending side, EPOLLRDHUP is not watched any more
+    uint32_t events = 0;                        ///< Watched epoll events
+    char request[HTTP_REQUEST_SIZE] = "";       ///< Received bytes that are not parsed yet
+    int request_size = 0;                       ///< Number of received bytes
+    int zoom = 0;                               ///< Requested tile zoom
+    long tile_x = 0;                            ///< Requested tile column
+    long tile_y = 0;                            ///< Requested tile row
+    int nmax = NMAX;                            ///< Requested limit
+    char *response = nullptr;                   ///< Response head and body
+    size_t response_size = 0;                   ///< Response size
+    size_t response_sent = 0;                   ///< Sent bytes of response
+    struct HttpConnection *next = nullptr;      ///< Next connection waiting for render
+} HttpConnection;
+
+
+struct HttpServer;
+
+
+/// Render of one tile, tasks write colors straight into the response body
+typedef struct HttpRender {
+    PoolJob job = {};                           ///< One task per tile part
+    struct HttpServer *server = nullptr;        ///< Server
+    HttpConnection *connection = nullptr;       ///< Connection that asked for the tile
+    uint8_t *body = nullptr;                    ///< RGB pixels of response body
+    double left = 0;                            ///< X of the left pixel column
+    double top = 0;                             ///< Y of the top pixel row
+    double pixel = 0;                           ///< Pixel size
+    int nmax = 0;                               ///< Max iteration number
+    int *iters = nullptr;                       ///< Iteration numbers, parts one after another
+    uint8_t *colors = nullptr;                  ///< RGBA colors, parts one after another
+    std::atomic<int> parts_left = {};           ///< Parts not finished yet, the last one reports the render
+    struct HttpRender *next = nullptr;          ///< Next free or finished render
+} HttpRender;
+
+
+/// Server state, everything except the finished list is touched only by the epoll thread
+typedef struct HttpServer {
+    int epoll = -1;                             ///< Epoll instance
+    int listener = -1;                          ///< Listening socket
+    int wakeup = -1;                            ///< Eventfd that workers write when renders are finished
+    WorkerPool pool = {};                       ///< Worker pool that renders tiles
+    IterColor *color_table = nullptr;           ///< Palette
+    HttpConnection **connections = nullptr;     ///< Connections by socket descriptor
+    int connections_size = 0;                   ///< Size of connections table, descriptor limit of the process
+    HttpRender renders[HTTP_MAX_RENDERS] = {};  ///< Renders with their buffers
+    HttpRender *free_renders = nullptr;         ///< Renders that are not used now
+    HttpConnection *waiting = nullptr;          ///< First connection waiting for render
+    HttpConnection *waiting_last = nullptr;     ///< Last connection waiting for render
+    std::mutex lock = {};                       ///< Protects finished list
+    HttpRender *finished = nullptr;             ///< Renders finished by workers and not sent yet
+    int open = 0;                               ///< Number of open connections
+    int peak_open = 0;                          ///< Max number of open connections
+    long accepted = 0;                          ///< Number of accepted connections
+    bool parked = false;                        ///< Listener is not watched until a descriptor is freed
+    long parks = 0;                             ///< Number of times descriptors ran out
+    double park_reported = 0;                   ///< Time of the last out of descriptors message
+    long requests = 0;                          ///< Number of parsed requests
+    long tiles = 0;                             ///< Number of rendered tiles
+} HttpServer;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], HttpArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Raises descriptor limit to the hard limit, every connection takes one
+ * \return New descriptor limit
+*/
+int raise_fd_limit(void);
+
+
+/**
+ * \brief Creates non-blocking listening TCP socket
+ * \param [in] args    Address and port
+ * \return Socket descriptor or -1 on error
+*/
+int open_socket(const HttpArgs *args);
+
+
+/**
+ * \brief Allocates render buffers and creates epoll instance with listener and wakeup eventfd
+ * \param [out] server  Server with pool, palette and listener set
+ * \return Non zero value means error
+*/
+int server_create(HttpServer *server);
+
+
+/**
+ * \brief Accepts every pending connection
+*/
+void accept_connections(HttpServer *server);
+
+
+/**
+ * \brief Stops or resumes watching the listener, pending connections wait in the backlog while it is parked
+ * \note Listener is level triggered, so without parking accept failing with EMFILE is retried in a busy loop
+*/
+void park_listener(HttpServer *server, bool parked);
+
+
+/**
+ * \brief Handles epoll event of client socket
+*/
+void handle_event(HttpServer *server, HttpConnection *connection, uint32_t events);
+
+
+/**
+ * \brief Reads available bytes and handles complete requests
+ * \return False if connection was closed
+*/
+bool read_requests(HttpServer *server, HttpConnection *connection);
+
+
+/**
+ * \brief Parses request head at the start of the buffer and starts its response
+ * \return False if no complete head is received yet
+*/
+bool handle_request(HttpServer *server, HttpConnection *connection);
+
+
+/**
+ * \brief Parses tile path like /tile/3/5/2.ppm?nmax=500
+ * \return False if path is not a valid tile
+*/
+bool parse_tile(const char *target, HttpConnection *connection);
+
+
+/**
+ * \brief Builds response with the given status and small body, then starts sending it
+*/
+void respond(HttpServer *server, HttpConnection *connection, const char *status, const char *type, const char *body);
+
+
+/**
+ * \brief Allocates response with head for body of the given size
+ * \return Pointer to the body or null on allocation error
+*/
+uint8_t *make_response(HttpConnection *connection, const char *status, const char *type, size_t size);
+
+
+/**
+ * \brief Starts render of requested tile, or queues the connection if every render is busy
+*/
+void start_render(HttpServer *server, HttpConnection *connection);
+
+
+/**
+ * \brief Pool task, renders one tile part and reports render when it is the last one
+*/
+void render_part(void *arg, int index);
+
+
+/**
+ * \brief Sends responses of renders finished by workers and gives freed renders to waiting connections
+*/
+void finish_renders(HttpServer *server);
+
+
+/**
+ * \brief Sends as much of the response as the socket takes, waits for EPOLLOUT for the rest
+ * \return False if connection was closed
+*/
+bool write_response(HttpServer *server, HttpConnection *connection);
+
+
+/**
+ * \brief Changes events the connection waits for, EPOLLRDHUP is dropped once peer has shut down its side
+*/
+void watch(HttpServer *server, HttpConnection *connection, uint32_t events);
+
+
+/**
+ * \brief Detaches connection from epoll, then frees it unless render or queue still refers to it
+*/
+void close_connection(HttpServer *server, HttpConnection *connection);
+
+
+/**
+ * \brief Closes socket and frees connection that nothing refers to
+*/
+void free_connection(HttpServer *server, HttpConnection *connection);
+
+
+
+
+int main(int argc, char *argv[]) {
+    HttpArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    static HttpServer server;
+    if (load_color_table(COLOR_TABLE_FILE, &server.color_table)) return FILE_NOT_FOUND;
+
+    server.connections_size = raise_fd_limit();
+
+    if (pool_create(&server.pool, args.threads)) return ALLOC_FAIL;
+
+    server.listener = open_socket(&args);
+    if (server.listener < 0) return FILE_NOT_FOUND;
+
+    if (server_create(&server)) return ALLOC_FAIL;
+
+    // Client that disconnects before its response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on http://%s:%d, up to %d connections\n", args.address, args.port, server.connections_size);
+    fflush(stdout);
+
+    static epoll_event events[HTTP_EVENTS];
+
+    for (;;) {
+        // Parked listener is retried after a while even if no connection closes, descriptors may be freed elsewhere
+        int count = epoll_wait(server.epoll, events, HTTP_EVENTS, (server.parked) ? HTTP_PARK_TIME : -1);
+        if (count == 0 && server.parked) park_listener(&server, false);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) {
+            perror("epoll_wait");
+            return FILE_NOT_FOUND;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == server.listener) accept_connections(&server);
+            else if (fd == server.wakeup) finish_renders(&server);
+            else if (server.connections[fd]) handle_event(&server, server.connections[fd], events[i].events);
+        }
+    }
+}
+
+
+int parse_args(int argc, char *argv[], HttpArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-a")) args -> address = value;
+        else if (!strcmp(argv[i - 1], "-p")) args -> port = atoi(value);
+        else if (!strcmp(argv[i - 1], "-t")) args -> threads = atoi(value);
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(0 < args -> port && args -> port < 65536, INVALID_ARG, "Invalid port!\n");
+    ASSERT(args -> threads >= 0, INVALID_ARG, "Invalid threads number!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: httpd.exe [-a address] [-p port] [-t threads]\n");
+}
+
+
+int raise_fd_limit(void) {
+    rlimit limit = {};
+    if (getrlimit(RLIMIT_NOFILE, &limit)) return 1024;
+
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+
+    // Unlimited hard limit still can't be indexed, the kernel caps descriptors with fs.nr_open anyway
+    return (limit.rlim_cur > (1 << 20)) ? (1 << 20) : (int) limit.rlim_cur;
+}
+
+
+int open_socket(const HttpArgs *args) {
+    assert(args && "Can't open socket with null args!\n");
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) args -> port);
+
+    if (inet_pton(AF_INET, args -> address, &address.sin_addr) != 1) {
+        printf("Invalid address %s!\n", args -> address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(fd, (const sockaddr *) &address, sizeof(address)) || listen(fd, HTTP_BACKLOG)) {
+        perror(args -> address);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+int server_create(HttpServer *server) {
+    ASSERT(server, INVALID_ARG, "Can't create null server!\n");
+
+    server -> connections = (HttpConnection **) calloc((size_t) server -> connections_size, sizeof(HttpConnection *));
+    ASSERT(server -> connections, ALLOC_FAIL, "Can't allocate connections table!\n");
+
+    for (int i = 0; i < HTTP_MAX_RENDERS; i++) {
+        HttpRender *render = server -> renders + i;
+
+        render -> server = server;
+        render -> iters = (int *) calloc(HTTP_TILE * HTTP_TILE, sizeof(int));
+        render -> colors = (uint8_t *) calloc(HTTP_TILE * HTTP_TILE * 4, sizeof(uint8_t));
+        ASSERT(render -> iters && render -> colors, ALLOC_FAIL, "Can't allocate render buffers!\n");
+
+        render -> next = server -> free_renders;
+        server -> free_renders = render;
+    }
+
+    server -> epoll = epoll_create1(0);
+    server -> wakeup = eventfd(0, EFD_NONBLOCK);
+
+    if (server -> epoll < 0 || server -> wakeup < 0) {
+        perror("epoll");
+        return FILE_NOT_FOUND;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+
+    event.data.fd = server -> listener;
+    epoll_ctl(server -> epoll, EPOLL_CTL_ADD, server -> listener, &event);
+
+    event.data.fd = server -> wakeup;
+    epoll_ctl(server -> epoll, EPOLL_CTL_ADD, server -> wakeup, &event);
+
+    return OK;
+}
+
+
+void accept_connections(HttpServer *server) {
+    assert(server && "Can't accept without server!\n");
+
+    for (;;) {
+        int fd = accept4(server -> listener, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) park_listener(server, true);
+            return;
+        }
+
+        HttpConnection *connection = (fd < server -> connections_size) ?
+                                     (HttpConnection *) calloc(1, sizeof(HttpConnection)) : nullptr;
+        if (!connection) {
+            close(fd);
+            continue;
+        }
+
+        // Tile responses are written at once, their tail must not wait for delayed ack
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        *connection = {};
+        connection -> fd = fd;
+        server -> connections[fd] = connection;
+
+        connection -> events = EPOLLIN | EPOLLRDHUP;
+
+        epoll_event event = {};
+        event.events = connection -> events;
+        event.data.fd = fd;
+        epoll_ctl(server -> epoll, EPOLL_CTL_ADD, fd, &event);
+
+        server -> accepted++;
+        if (++server -> open > server -> peak_open) server -> peak_open = server -> open;
+    }
+}
+
+
+void park_listener(HttpServer *server, bool parked) {
+    assert(server && "Can't park listener of null server!\n");
+
+    if (parked == server -> parked) return;
+    server -> parked = parked;
+
+    epoll_event event = {};
+    event.events = (parked) ? 0 : (uint32_t) EPOLLIN;
+    event.data.fd = server -> listener;
+    epoll_ctl(server -> epoll, EPOLL_CTL_MOD, server -> listener, &event);
+
+    if (!parked) return;
+
+    server -> parks++;
+
+    double now = get_seconds();
+    if (now - server -> park_reported < HTTP_PARK_REPORT_INTERVAL) return;
+
+    printf("Out of descriptors %ld times, %d connections are open, new ones wait in backlog\n", server -> parks,
+           server -> open);
+    fflush(stdout);
+
+    server -> park_reported = now;
+}
+
+
+void handle_event(HttpServer *server, HttpConnection *connection, uint32_t events) {
+    assert(server && connection && "Can't handle event of null connection!\n");
+
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        close_connection(server, connection);
+        return;
+    }
+
+    // Client that shut down its side after the request still reads the response, and level triggered EPOLLRDHUP
+    // would fire on every wait, so it is reported once and the connection is closed when a write fails
+    if ((events & EPOLLRDHUP) && !connection -> half_closed) {
+        connection -> half_closed = true;
+        watch(server, connection, connection -> events);
+    }
+
+    // Rest of the stream is read before end of file closes the connection
+    if (connection -> state == CONN_READING) {
+        if (events & (EPOLLIN | EPOLLRDHUP)) read_requests(server, connection);
+        return;
+    }
+
+    if (connection -> state == CONN_WRITING && (events & EPOLLOUT)) write_response(server, connection);
+}
+
+
+bool read_requests(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && "Can't read from null connection!\n");
+
+    for (;;) {
+        int space = HTTP_REQUEST_SIZE - 1 - connection -> request_size;
+
+        if (space == 0) {
+            // Head that does not fit is not a tile request
+            connection -> keep_alive = false;
+            respond(server, connection, "431 Request Header Fields Too Large", "text/plain", "Request is too long\n");
+            return false;
+        }
+
+        ssize_t size = read(connection -> fd, connection -> request + connection -> request_size, (size_t) space);
+
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0 && errno == EAGAIN) break;
+
+        if (size <= 0) {
+            close_connection(server, connection);
+            return false;
+        }
+
+        connection -> request_size += (int) size;
+        connection -> request[connection -> request_size] = '\0';
+
+        if (strstr(connection -> request, "\r\n\r\n")) break;
+    }
+
+    // Pipelined requests are answered one by one, the next head is parsed when the response is sent
+    handle_request(server, connection);
+
+    return true;
+}
+
+
+bool handle_request(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && "Can't handle request of null connection!\n");
+
+    connection -> request[connection -> request_size] = '\0';
+
+    char *end = strstr(connection -> request, "\r\n\r\n");
+    if (!end) return false;
+
+    *end = '\0';
+    int head_size = (int) (end - connection -> request) + 4;
+
+    char method[16] = "", target[256] = "", version[16] = "";
+    bool valid = sscanf(connection -> request, "%15s %255s %15s", method, target, version) == 3 &&
+                 !strncmp(version, "HTTP/1.", 7);
+
+    // HTTP/1.1 keeps connection by default, HTTP/1.0 only when asked
+    connection -> keep_alive = !strcmp(version, "HTTP/1.1");
+
+    const char *header = strcasestr(connection -> request, "\r\nConnection:");
+    if (header) {
+        header += strlen("\r\nConnection:");
+        header += strspn(header, " \t");
+
+        if (!strncasecmp(header, "close", 5)) connection -> keep_alive = false;
+        if (!strncasecmp(header, "keep-alive", 10)) connection -> keep_alive = true;
+    }
+
+    bool has_body = strcasestr(connection -> request, "\r\nContent-Length:") || strcasestr(connection -> request, "\r\nTransfer-Encoding:");
+
+    memmove(connection -> request, connection -> request + head_size, (size_t) (connection -> request_size - head_size));
+    connection -> request_size -= head_size;
+    connection -> request[connection -> request_size] = '\0';
+
+    server -> requests++;
+
+    if (!valid) {
+        connection -> keep_alive = false;
+        respond(server, connection, "400 Bad Request", "text/plain", "Bad request\n");
+    }
+    else if (strcmp(method, "GET") || has_body) {
+        // Body is not read, so the stream can't be parsed after it
+        connection -> keep_alive = false;
+        respond(server, connection, "405 Method Not Allowed", "text/plain", "Only GET is served\n");
+    }
+    else if (!strcmp(target, "/stats")) {
+        char body[HTTP_HEADER_SIZE] = "";
+        snprintf(body, sizeof(body), "open %d peak %d accepted %ld parks %ld requests %ld tiles %ld\n", server -> open,
+                 server -> peak_open, server -> accepted, server -> parks, server -> requests, server -> tiles);
+
+        respond(server, connection, "200 OK", "text/plain", body);
+    }
+    else if (parse_tile(target, connection)) {
+        start_render(server, connection);
+    }
+    else {
+        respond(server, connection, "404 Not Found", "text/plain", "Unknown tile\n");
+    }
+
+    return true;
+}
+
+
+bool parse_tile(const char *target, HttpConnection *connection) {
+    assert(target && connection && "Can't parse null tile path!\n");
+
+    int consumed = 0;
+    if (sscanf(target, "/tile/%d/%ld/%ld.ppm%n", &connection -> zoom, &connection -> tile_x, &connection -> tile_y,
+               &consumed) != 3 || !consumed) return false;
+
+    const char *query = target + consumed;
+    connection -> nmax = NMAX;
+
+    if (*query) {
+        consumed = 0;
+        if (sscanf(query, "?nmax=%d%n", &connection -> nmax, &consumed) != 1 || query[consumed]) return false;
+    }
+
+    if (connection -> zoom < 0 || connection -> zoom > HTTP_MAX_ZOOM) return false;
+    if (connection -> nmax <= 0 || connection -> nmax > HTTP_MAX_NMAX) return false;
+
+    long tiles = 1L << connection -> zoom;
+
+    return 0 <= connection -> tile_x && connection -> tile_x < tiles && 0 <= connection -> tile_y && connection -> tile_y < tiles;
+}
+
+
+void respond(HttpServer *server, HttpConnection *connection, const char *status, const char *type, const char *body) {
+    assert(server && connection && "Can't respond to null connection!\n");
+    assert(status && type && body && "Can't send null response!\n");
+
+    size_t size = strlen(body);
+
+    uint8_t *data = make_response(connection, status, type, size);
+    if (!data) {
+        close_connection(server, connection);
+        return;
+    }
+
+    memcpy(data, body, size);
+    write_response(server, connection);
+}
+
+
+uint8_t *make_response(HttpConnection *connection, const char *status, const char *type, size_t size) {
+    assert(connection && status && type && "Can't make null response!\n");
+
+    char head[HTTP_HEADER_SIZE] = "";
+    int head_size = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                             "Connection: %s\r\n\r\n", status, type, size, (connection -> keep_alive) ? "keep-alive" : "close");
+
+    free(connection -> response);
+    connection -> response = (char *) calloc((size_t) head_size + size, sizeof(char));
+    if (!connection -> response) return nullptr;
+
+    memcpy(connection -> response, head, (size_t) head_size);
+    connection -> response_size = (size_t) head_size + size;
+    connection -> response_sent = 0;
+
+    return (uint8_t *) connection -> response + head_size;
+}
+
+
+void start_render(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && "Can't render tile of null connection!\n");
+
+    HttpRender *render = server -> free_renders;
+
+    if (!render) {
+        connection -> state = CONN_WAITING;
+        connection -> next = nullptr;
+
+        if (server -> waiting_last) server -> waiting_last -> next = connection;
+        else server -> waiting = connection;
+        server -> waiting_last = connection;
+
+        watch(server, connection, EPOLLRDHUP);
+        return;
+    }
+
+    uint8_t *data = make_response(connection, "200 OK", "image/x-portable-pixmap", HTTP_PPM_SIZE);
+    if (!data) {
+        close_connection(server, connection);
+        return;
+    }
+
+    server -> free_renders = render -> next;
+
+    memcpy(data, HTTP_PPM_HEAD, sizeof(HTTP_PPM_HEAD) - 1);
+
+    double size = HTTP_SET_SIZE / (double) (1L << connection -> zoom);
+
+    render -> connection = connection;
+    render -> body = data + sizeof(HTTP_PPM_HEAD) - 1;
+    render -> left = HTTP_SET_LEFT + (double) connection -> tile_x * size;
+    render -> top = HTTP_SET_TOP + (double) connection -> tile_y * size;
+    render -> pixel = size / HTTP_TILE;
+    render -> nmax = connection -> nmax;
+    render -> parts_left.store(HTTP_PARTS, std::memory_order_relaxed);
+
+    connection -> state = CONN_RENDERING;
+    watch(server, connection, EPOLLRDHUP);
+
+    pool_submit(&server -> pool, &render -> job, render_part, render, HTTP_PARTS);
+}
+
+
+void render_part(void *arg, int index) {
+    HttpRender *render = (HttpRender *) arg;
+
+    int part_x = index % HTTP_PARTS_X, part_y = index / HTTP_PARTS_X;
+    int *iters = render -> iters + (size_t) index * HTTP_PART * HTTP_PART;
+    uint8_t *colors = render -> colors + (size_t) index * HTTP_PART * HTTP_PART * 4;
+
+    iter_tile(iters, render -> left + part_x * HTTP_PART * render -> pixel, render -> top + part_y * HTTP_PART * render -> pixel,
+              render -> pixel, HTTP_PART, render -> nmax);
+    colorize(render -> server -> color_table, iters, colors, HTTP_PART * HTTP_PART, render -> nmax);
+
+    for (int y = 0; y < HTTP_PART; y++) {
+        uint8_t *row = render -> body + 3 * ((size_t) (part_y * HTTP_PART + y) * HTTP_TILE + (size_t) part_x * HTTP_PART);
+        const uint8_t *rgba = colors + 4 * (size_t) y * HTTP_PART;
+
+        for (int x = 0; x < HTTP_PART; x++) memcpy(row + 3 * x, rgba + 4 * x, 3);
+    }
+
+    if (render -> parts_left.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    HttpServer *server = render -> server;
+
+    {
+        std::lock_guard<std::mutex> guard(server -> lock);
+
+        render -> next = server -> finished;
+        server -> finished = render;
+    }
+
+    uint64_t one = 1;
+    if (write(server -> wakeup, &one, sizeof(one)) < 0) perror("eventfd");
+}
+
+
+void finish_renders(HttpServer *server) {
+    assert(server && "Can't finish renders without server!\n");
+
+    uint64_t count = 0;
+    if (read(server -> wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN) perror("eventfd");
+
+    HttpRender *finished = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(server -> lock);
+
+        finished = server -> finished;
+        server -> finished = nullptr;
+    }
+
+    while (finished) {
+        HttpRender *render = finished;
+        finished = render -> next;
+
+        // Last task reports the render before the worker counts it finished, so wait for that short moment
+        pool_wait(&server -> pool, &render -> job);
+
+        HttpConnection *connection = render -> connection;
+
+        render -> connection = nullptr;
+        render -> next = server -> free_renders;
+        server -> free_renders = render;
+
+        server -> tiles++;
+
+        if (connection -> closed) free_connection(server, connection);
+        else write_response(server, connection);
+    }
+
+    // Gone clients are dropped from the queue only here, so their descriptors stay reserved until then
+    while (server -> free_renders && server -> waiting) {
+        HttpConnection *connection = server -> waiting;
+
+        server -> waiting = connection -> next;
+        if (!server -> waiting) server -> waiting_last = nullptr;
+
+        if (connection -> closed) free_connection(server, connection);
+        else start_render(server, connection);
+    }
+}
+
+
+bool write_response(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && connection -> response && "Can't write null response!\n");
+
+    connection -> state = CONN_WRITING;
+
+    while (connection -> response_sent < connection -> response_size) {
+        ssize_t size = send(connection -> fd, connection -> response + connection -> response_sent,
+                            connection -> response_size - connection -> response_sent, MSG_NOSIGNAL);
+
+        if (size < 0 && errno == EINTR) continue;
+
+        if (size < 0 && errno == EAGAIN) {
+            watch(server, connection, EPOLLOUT | EPOLLRDHUP);
+            return true;
+        }
+
+        if (size < 0) {
+            close_connection(server, connection);
+            return false;
+        }
+
+        connection -> response_sent += (size_t) size;
+    }
+
+    free(connection -> response);
+    connection -> response = nullptr;
+
+    if (!connection -> keep_alive) {
+        close_connection(server, connection);
+        return false;
+    }
+
+    connection -> state = CONN_READING;
+    watch(server, connection, EPOLLIN | EPOLLRDHUP);
+
+    // Next pipelined request may be already received
+    handle_request(server, connection);
+
+    return true;
+}
+
+
+void watch(HttpServer *server, HttpConnection *connection, uint32_t events) {
+    assert(server && connection && "Can't watch null connection!\n");
+
+    if (connection -> half_closed) events &= ~(uint32_t) EPOLLRDHUP;
+    connection -> events = events;
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = connection -> fd;
+    epoll_ctl(server -> epoll, EPOLL_CTL_MOD, connection -> fd, &event);
+}
+
+
+void close_connection(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && "Can't close null connection!\n");
+
+    if (!connection -> closed) {
+        epoll_ctl(server -> epoll, EPOLL_CTL_DEL, connection -> fd, nullptr);
+        connection -> closed = true;
+        server -> open--;
+    }
+
+    // Descriptor is not closed while render or queue refers to the connection, accept could reuse it
+    if (connection -> state == CONN_RENDERING || connection -> state == CONN_WAITING) return;
+
+    free_connection(server, connection);
+}
+
+
+void free_connection(HttpServer *server, HttpConnection *connection) {
+    assert(server && connection && "Can't free null connection!\n");
+
+    server -> connections[connection -> fd] = nullptr;
+    close(connection -> fd);
+
+    park_listener(server, false);
+
+    free(connection -> response);
+    free(connection);
+}
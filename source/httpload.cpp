@@ -0,0 +1,523 @@
+/**
+ * \file
+ * \brief Load client of HTTP tile server, keeps thousands of keep-alive connections and measures tile latency
+ * \note Every connection asks for a random tile of the zoom, waits for the whole response, sleeps for the pause
+ * and asks again. Connections are opened all at once, so the accept path of the server is loaded too
+*/
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "configs.hpp"
+#include "utils.hpp"
+
+
+const int LOAD_EVENTS = 1024;                   ///< Max events taken by one epoll_wait
+const int LOAD_HEAD_SIZE = 1024;                ///< Max size of response head
+const int LOAD_READ_SIZE = 1 << 16;             ///< Bytes read by one call
+const double LOAD_GRACE = 10;                   ///< Seconds responses in flight are waited for after the test
+const int LOAD_TICK_MS = 10;                    ///< Max milliseconds between checks of sleeping connections
+
+
+/// Client settings taken from command line
+typedef struct {
+    const char *address = "127.0.0.1";          ///< Server IPv4 address
+    int port = HTTP_PORT;                       ///< Server TCP port
+    int connections = 10000;                    ///< Number of concurrent connections
+    double duration = 20;                       ///< Seconds new requests are sent
+    double pause = 10;                          ///< Mean seconds between response and the next request of a connection
+    int zoom = 4;                               ///< Zoom of requested tiles
+    int nmax = NMAX;                            ///< Limit of requested tiles
+} LoadArgs;
+
+
+/// Connection states
+typedef enum {
+    LOAD_CONNECTING     = 0,        ///< Non-blocking connect is in progress
+    LOAD_SLEEPING       = 1,        ///< Waits before the next request
+    LOAD_HEAD           = 2,        ///< Request is sent, response head is read
+    LOAD_BODY           = 3,        ///< Response body is read
+    LOAD_DONE           = 4,        ///< Connection is closed
+} LoadState;
+
+
+/// One client connection
+typedef struct {
+    int fd = -1;                                ///< Socket
+    LoadState state = LOAD_CONNECTING;          ///< State
+    double wake = 0;                            ///< Time of the next request when sleeping
+    double sent = 0;                            ///< Time the request was sent
+    char head[LOAD_HEAD_SIZE] = "";             ///< Received part of response head
+    int head_size = 0;                          ///< Received bytes of head
+    long body_left = 0;                         ///< Body bytes not received yet
+    bool ok = false;                            ///< Response status is 200
+} LoadConnection;
+
+
+/// Results of the test
+typedef struct {
+    int connected = 0;                          ///< Connections that were established
+    int failed = 0;                             ///< Connections that failed to connect
+    int dropped = 0;                            ///< Connections closed by the server or by error after connect
+    int peak_open = 0;                          ///< Max number of open connections
+    long requests = 0;                          ///< Sent requests
+    long responses = 0;                         ///< Whole responses
+    long errors = 0;                            ///< Responses with status other than 200
+    long bytes = 0;                             ///< Received body bytes
+    double *latencies = nullptr;                ///< Milliseconds from request to the end of response
+    long latencies_capacity = 0;                ///< Allocated latencies
+    double connect_time = 0;                    ///< Seconds until every connection was established or failed
+} LoadStats;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], LoadArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Raises descriptor limit to the hard limit, every connection takes one
+ * \return New descriptor limit
+*/
+int raise_fd_limit(void);
+
+
+/**
+ * \brief Starts non-blocking connect
+ * \return Socket descriptor or -1 on error
+*/
+int start_connect(const sockaddr_in *address);
+
+
+/**
+ * \brief Sends request for random tile
+ * \return False if connection failed
+*/
+bool send_request(const LoadArgs *args, LoadConnection *connection, LoadStats *stats);
+
+
+/**
+ * \brief Reads available response bytes, records latency of finished response
+ * \return False if connection was closed
+*/
+bool read_response(const LoadArgs *args, LoadConnection *connection, LoadStats *stats, double end);
+
+
+/**
+ * \brief Closes connection
+*/
+void drop_connection(LoadConnection *connection, LoadStats *stats);
+
+
+/**
+ * \brief Returns pause before the next request, exponential with the given mean so requests don't come in waves
+*/
+double random_pause(double mean);
+
+
+/**
+ * \brief Returns next pseudo random number
+*/
+uint64_t random_next(void);
+
+
+/**
+ * \brief Prints connection and latency results
+*/
+void print_stats(const LoadArgs *args, LoadStats *stats, double seconds);
+
+
+/**
+ * \brief Compares doubles for qsort
+*/
+int compare_doubles(const void *a, const void *b);
+
+
+
+
+int main(int argc, char *argv[]) {
+    LoadArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    int limit = raise_fd_limit();
+    if (args.connections + 16 > limit) {
+        printf("Descriptor limit %d is too low for %d connections\n", limit, args.connections);
+        return INVALID_ARG;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) args.port);
+
+    if (inet_pton(AF_INET, args.address, &address.sin_addr) != 1) {
+        printf("Invalid address %s!\n", args.address);
+        return INVALID_ARG;
+    }
+
+    LoadConnection *connections = (LoadConnection *) calloc((size_t) args.connections, sizeof(LoadConnection));
+    epoll_event *events = (epoll_event *) calloc(LOAD_EVENTS, sizeof(epoll_event));
+    int epoll = epoll_create1(0);
+
+    if (!connections || !events || epoll < 0) {
+        printf("Can't allocate %d connections!\n", args.connections);
+        return ALLOC_FAIL;
+    }
+
+    LoadStats stats = {};
+    double start = get_seconds();
+
+    for (int i = 0; i < args.connections; i++) {
+        LoadConnection *connection = connections + i;
+        *connection = {};
+
+        connection -> fd = start_connect(&address);
+        if (connection -> fd < 0) {
+            connection -> state = LOAD_DONE;
+            stats.failed++;
+            continue;
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLOUT;
+        event.data.u32 = (uint32_t) i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, connection -> fd, &event);
+    }
+
+    printf("Opening %d connections to %s:%d, tiles of zoom %d, pause %.1f s, %.0f s of requests\n", args.connections,
+           args.address, args.port, args.zoom, args.pause, args.duration);
+    fflush(stdout);
+
+    double end = start + args.duration;
+    int open = 0, pending = args.connections - stats.failed;
+
+    for (;;) {
+        double now = get_seconds();
+        if (now > end + LOAD_GRACE) break;
+
+        int count = epoll_wait(epoll, events, LOAD_EVENTS, LOAD_TICK_MS);
+
+        for (int i = 0; i < count; i++) {
+            LoadConnection *connection = connections + events[i].data.u32;
+
+            if (connection -> state == LOAD_CONNECTING) {
+                int error = 0;
+                socklen_t size = sizeof(error);
+                getsockopt(connection -> fd, SOL_SOCKET, SO_ERROR, &error, &size);
+
+                pending--;
+
+                if (error || (events[i].events & (EPOLLERR | EPOLLHUP))) {
+                    close(connection -> fd);
+                    connection -> state = LOAD_DONE;
+                    stats.failed++;
+                    continue;
+                }
+
+                stats.connected++;
+                if (++open > stats.peak_open) stats.peak_open = open;
+                if (!pending) stats.connect_time = get_seconds() - start;
+
+                // The first request is spread over the pause too, so the server sees steady load
+                connection -> state = LOAD_SLEEPING;
+                connection -> wake = get_seconds() + random_pause(args.pause);
+
+                // Sleeping connection gets events only if the server closes it
+                epoll_event event = {};
+                event.events = EPOLLIN | EPOLLRDHUP;
+                event.data.u32 = events[i].data.u32;
+                epoll_ctl(epoll, EPOLL_CTL_MOD, connection -> fd, &event);
+                continue;
+            }
+
+            if (connection -> state == LOAD_HEAD || connection -> state == LOAD_BODY) {
+                if (!read_response(&args, connection, &stats, end)) open--;
+                continue;
+            }
+
+            if (connection -> state == LOAD_SLEEPING) {
+                drop_connection(connection, &stats);
+                open--;
+            }
+        }
+
+        now = get_seconds();
+        bool busy = false;
+
+        // Linear scan is cheap next to the wait, and keeps the client as simple as the load it makes
+        for (int i = 0; i < args.connections; i++) {
+            LoadConnection *connection = connections + i;
+
+            if (connection -> state == LOAD_HEAD || connection -> state == LOAD_BODY) busy = true;
+            if (connection -> state != LOAD_SLEEPING || connection -> wake > now || now > end) continue;
+
+            busy = true;
+            if (!send_request(&args, connection, &stats)) open--;
+        }
+
+        if (now > end && !busy && !pending) break;
+    }
+
+    double seconds = get_seconds() - start;
+
+    for (int i = 0; i < args.connections; i++)
+        if (connections[i].state != LOAD_DONE) close(connections[i].fd);
+
+    print_stats(&args, &stats, seconds);
+
+    free(stats.latencies);
+    free(connections);
+    free(events);
+    close(epoll);
+
+    return (stats.responses && !stats.errors && !stats.failed && !stats.dropped) ? OK : INVALID_FORMAT;
+}
+
+
+int parse_args(int argc, char *argv[], LoadArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-a")) args -> address = value;
+        else if (!strcmp(argv[i - 1], "-p")) args -> port = atoi(value);
+        else if (!strcmp(argv[i - 1], "-c")) args -> connections = atoi(value);
+        else if (!strcmp(argv[i - 1], "-d")) args -> duration = atof(value);
+        else if (!strcmp(argv[i - 1], "-i")) args -> pause = atof(value);
+        else if (!strcmp(argv[i - 1], "-z")) args -> zoom = atoi(value);
+        else if (!strcmp(argv[i - 1], "-n")) args -> nmax = atoi(value);
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(0 < args -> port && args -> port < 65536, INVALID_ARG, "Invalid port!\n");
+    ASSERT(args -> connections > 0, INVALID_ARG, "Invalid connections number!\n");
+    ASSERT(args -> duration > 0 && args -> pause >= 0, INVALID_ARG, "Invalid duration or pause!\n");
+    ASSERT(0 <= args -> zoom && args -> zoom < 31, INVALID_ARG, "Invalid zoom!\n");
+    ASSERT(args -> nmax > 0, INVALID_ARG, "Invalid nmax!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: httpload.exe [-a address] [-p port] [-c connections] [-d seconds] [-i pause] [-z zoom] [-n nmax]\n");
+}
+
+
+int raise_fd_limit(void) {
+    rlimit limit = {};
+    if (getrlimit(RLIMIT_NOFILE, &limit)) return 1024;
+
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+
+    return (limit.rlim_cur > (1 << 20)) ? (1 << 20) : (int) limit.rlim_cur;
+}
+
+
+int start_connect(const sockaddr_in *address) {
+    assert(address && "Can't connect to null address!\n");
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (connect(fd, (const sockaddr *) address, sizeof(*address)) && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+bool send_request(const LoadArgs *args, LoadConnection *connection, LoadStats *stats) {
+    assert(args && connection && stats && "Can't send null request!\n");
+
+    uint64_t tiles = 1ull << args -> zoom;
+    uint64_t x = random_next() % tiles, y = random_next() % tiles;
+
+    char request[256] = "";
+    int size = snprintf(request, sizeof(request), "GET /tile/%d/%lu/%lu.ppm?nmax=%d HTTP/1.1\r\nHost: %s\r\n\r\n",
+                        args -> zoom, (unsigned long) x, (unsigned long) y, args -> nmax, args -> address);
+
+    // Request is far below socket buffer, so it is sent whole or the connection is broken
+    if (send(connection -> fd, request, (size_t) size, MSG_NOSIGNAL) != size) {
+        drop_connection(connection, stats);
+        return false;
+    }
+
+    connection -> state = LOAD_HEAD;
+    connection -> sent = get_seconds();
+    connection -> head_size = 0;
+
+    stats -> requests++;
+
+    return true;
+}
+
+
+bool read_response(const LoadArgs *args, LoadConnection *connection, LoadStats *stats, double end) {
+    assert(args && connection && stats && "Can't read null response!\n");
+
+    static char buffer[LOAD_READ_SIZE];
+
+    for (;;) {
+        ssize_t size = read(connection -> fd, buffer, sizeof(buffer));
+
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0 && errno == EAGAIN) return true;
+
+        if (size <= 0) {
+            drop_connection(connection, stats);
+            return false;
+        }
+
+        const char *data = buffer;
+
+        if (connection -> state == LOAD_HEAD) {
+            int copied = (int) size;
+            if (copied > LOAD_HEAD_SIZE - 1 - connection -> head_size) copied = LOAD_HEAD_SIZE - 1 - connection -> head_size;
+
+            memcpy(connection -> head + connection -> head_size, data, (size_t) copied);
+            connection -> head[connection -> head_size + copied] = '\0';
+
+            char *head_end = strstr(connection -> head, "\r\n\r\n");
+            if (!head_end) {
+                connection -> head_size += copied;
+
+                if (connection -> head_size == LOAD_HEAD_SIZE - 1) {
+                    drop_connection(connection, stats);
+                    return false;
+                }
+                continue;
+            }
+
+            // Bytes after the head are the start of the body
+            int head_size = (int) (head_end - connection -> head) + 4;
+            data += head_size - connection -> head_size;
+            size -= head_size - connection -> head_size;
+
+            const char *length = strcasestr(connection -> head, "\r\nContent-Length:");
+            connection -> ok = !strncmp(connection -> head, "HTTP/1.1 200", 12);
+            connection -> body_left = (length) ? atol(length + strlen("\r\nContent-Length:")) : 0;
+            connection -> state = LOAD_BODY;
+        }
+
+        connection -> body_left -= size;
+        stats -> bytes += size;
+
+        if (connection -> body_left < 0) {
+            // Server never pipelines, more bytes than the body means broken stream
+            drop_connection(connection, stats);
+            return false;
+        }
+
+        if (connection -> body_left > 0) continue;
+
+        double now = get_seconds();
+
+        if (stats -> responses == stats -> latencies_capacity) {
+            long capacity = (stats -> latencies_capacity) ? 2 * stats -> latencies_capacity : 4096;
+
+            double *latencies = (double *) realloc(stats -> latencies, (size_t) capacity * sizeof(double));
+            if (latencies) {
+                stats -> latencies = latencies;
+                stats -> latencies_capacity = capacity;
+            }
+        }
+
+        if (stats -> responses < stats -> latencies_capacity) stats -> latencies[stats -> responses] = 1000 * (now - connection -> sent);
+
+        stats -> responses++;
+        if (!connection -> ok) stats -> errors++;
+
+        connection -> state = LOAD_SLEEPING;
+        connection -> wake = (now < end) ? now + random_pause(args -> pause) : now;
+
+        return true;
+    }
+}
+
+
+void drop_connection(LoadConnection *connection, LoadStats *stats) {
+    assert(connection && stats && "Can't drop null connection!\n");
+
+    close(connection -> fd);
+    connection -> state = LOAD_DONE;
+    stats -> dropped++;
+}
+
+
+double random_pause(double mean) {
+    // Uniform in (0, 1], so log is finite
+    double uniform = ((double) (random_next() >> 11) + 1) / 9007199254740992.0;
+
+    return -mean * log(uniform);
+}
+
+
+uint64_t random_next(void) {
+    static uint64_t state = 0x9e3779b97f4a7c15;
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+
+    return state * 0x2545f4914f6cdd1d;
+}
+
+
+void print_stats(const LoadArgs *args, LoadStats *stats, double seconds) {
+    assert(args && stats && "Can't print null stats!\n");
+
+    printf("Connections: %d established in %.3f s, %d failed, %d dropped, peak %d open\n", stats -> connected,
+           stats -> connect_time, stats -> failed, stats -> dropped, stats -> peak_open);
+    printf("Requests: %ld sent, %ld answered, %ld errors, %.1f responses/s, %.1f MB/s\n", stats -> requests,
+           stats -> responses, stats -> errors, (double) stats -> responses / seconds, (double) stats -> bytes / seconds / 1e6);
+
+    long count = (stats -> responses < stats -> latencies_capacity) ? stats -> responses : stats -> latencies_capacity;
+    if (!count) return;
+
+    qsort(stats -> latencies, (size_t) count, sizeof(double), compare_doubles);
+
+    printf("Latency ms: p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n", stats -> latencies[count / 2],
+           stats -> latencies[count * 9 / 10], stats -> latencies[count * 99 / 100], stats -> latencies[count * 999 / 1000],
+           stats -> latencies[count - 1]);
+}
+
+
+int compare_doubles(const void *a, const void *b) {
+    double first = *(const double *) a, second = *(const double *) b;
+
+    return (first > second) - (first < second);
+}
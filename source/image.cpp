@@ -0,0 +1,28 @@
+/**
+ * \file
+ * \brief Source file for saving rendered images
+*/
+
+#include <stdio.h>
+#include "utils.hpp"
+#include "image.hpp"
+
+
+
+
+int write_ppm(const char *filename, const uint8_t *buffer, int width, int height) {
+    ASSERT(filename, INVALID_ARG, "Can't save without filename!\n");
+    ASSERT(buffer, INVALID_ARG, "Can't save null buffer!\n");
+
+    FILE *file = fopen(filename, "wb");
+    ASSERT(file, FILE_NOT_FOUND, "Can't open %s!\n", filename);
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    for (long i = 0; i < (long) width * height; i++)
+        fwrite(buffer + 4 * i, sizeof(uint8_t), 3, file);
+
+    fclose(file);
+
+    return OK;
+}
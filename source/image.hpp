@@ -0,0 +1,23 @@
+/**
+ * \file
+ * \brief Header file for saving rendered images
+*/
+
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <stdint.h>
+
+
+/**
+ * \brief Saves RGBA buffer as binary PPM image, alpha channel is dropped
+ * \param [in] filename Path to image file
+ * \param [in] buffer   Pixels colors in RGBA format
+ * \param [in] width    Image width
+ * \param [in] height   Image height
+ * \return Non zero value means error
+*/
+int write_ppm(const char *filename, const uint8_t *buffer, int width, int height);
+
+
+#endif
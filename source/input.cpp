@@ -0,0 +1,95 @@
+/**
+ * \file
+ * \brief Source file for viewer input commands
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "configs.hpp"
+#include "nucleus.hpp"
+#include "input.hpp"
+
+
+/**
+ * \brief Moves view to the nucleus of the lowest period component visible on the screen
+ * \param [in,out] transform   Transform to change
+*/
+static void jump_to_nucleus(Transform *transform);
+
+
+
+
+void view_input_apply(ViewInput input, Transform *transform, int *nmax) {
+    assert(transform && "Transformation pointer in null!\n");
+    assert(nmax && "Max iteration number pointer is null!\n");
+
+    switch (input) {
+        case INPUT_UP:
+            transform -> center_y -= MOVE_FACTOR * transform -> set_h; return;
+
+        case INPUT_DOWN:
+            transform -> center_y += MOVE_FACTOR * transform -> set_h; return;
+
+        case INPUT_LEFT:
+            transform -> center_x -= MOVE_FACTOR * transform -> set_w; return;
+
+        case INPUT_RIGHT:
+            transform -> center_x += MOVE_FACTOR * transform -> set_w; return;
+
+        case INPUT_ZOOM_IN:
+            transform -> set_w *= ZOOM_FACTOR;
+            transform -> set_h *= ZOOM_FACTOR;
+            return;
+
+        case INPUT_ZOOM_OUT:
+            transform -> set_w /= ZOOM_FACTOR;
+            transform -> set_h /= ZOOM_FACTOR;
+            return;
+
+        case INPUT_NMAX_UP:
+            if (*nmax <= INT32_MAX / 2) *nmax *= 2;
+            return;
+
+        case INPUT_NMAX_DOWN:
+            if (*nmax > 1) *nmax /= 2;
+            return;
+
+        case INPUT_NUCLEUS:
+            jump_to_nucleus(transform); return;
+
+        case INPUT_NONE:
+        default: return;
+    }
+}
+
+
+static void jump_to_nucleus(Transform *transform) {
+    assert(transform && "Transformation pointer in null!\n");
+
+    static DeepView view = {};
+    int size = bignum_size_for_bits(PERTURB_GUARD_BITS);
+
+    bignum_set_double(&view.center_x, transform -> center_x, size);
+    bignum_set_double(&view.center_y, transform -> center_y, size);
+    view.span = floatexp_from_double(transform -> set_w);
+
+    int period = 0;
+    if (nucleus_find_period(&view, &period) || !period) {
+        printf("No nucleus found on the screen\n");
+        return;
+    }
+
+    static Nucleus nucleus = {};
+    if (nucleus_locate(&nucleus, &view.center_x, &view.center_y, period)) return;
+
+    float scale = (float) floatexp_to_double(floatexp_mul_double(nucleus.size, NUCLEUS_VIEW_SCALE));
+
+    transform -> center_x = (float) bignum_to_double(&nucleus.x);
+    transform -> center_y = (float) bignum_to_double(&nucleus.y);
+    transform -> set_h *= scale / transform -> set_w;
+    transform -> set_w = scale;
+
+    printf("Nucleus of period %d at (%.9f, %.9f), size %g\n", nucleus.period,
+           bignum_to_double(&nucleus.x), bignum_to_double(&nucleus.y), floatexp_to_double(nucleus.size));
+}
@@ -0,0 +1,38 @@
+/**
+ * \file
+ * \brief Header file for viewer input commands, they do not depend on window library and can be sent over network
+*/
+
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+#include "kernel.hpp"
+
+
+/// Viewer input commands
+typedef enum {
+    INPUT_NONE          = 0,        ///< Event that does not change the view
+    INPUT_UP            = 1,        ///< Move view up
+    INPUT_DOWN          = 2,        ///< Move view down
+    INPUT_LEFT          = 3,        ///< Move view left
+    INPUT_RIGHT         = 4,        ///< Move view right
+    INPUT_ZOOM_IN       = 5,        ///< Zoom in
+    INPUT_ZOOM_OUT      = 6,        ///< Zoom out
+    INPUT_NMAX_UP       = 7,        ///< Double max iteration number
+    INPUT_NMAX_DOWN     = 8,        ///< Halve max iteration number
+    INPUT_NUCLEUS       = 9,        ///< Jump to the nucleus of the lowest period component on the screen
+} ViewInput;
+
+const int INPUT_COUNT = 10;                     ///< Number of input commands
+
+
+/**
+ * \brief Changes transform or max iteration number according to the input command
+ * \param [in]     input       Input command
+ * \param [in,out] transform   Transform to change
+ * \param [in,out] nmax        Max iteration number to change
+*/
+void view_input_apply(ViewInput input, Transform *transform, int *nmax);
+
+
+#endif
@@ -0,0 +1,530 @@
+/**
+ * \file
+ * \brief Renders Julia set boundary with modified inverse iteration or with escape time distance estimate
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "image.hpp"
+#include "pool.hpp"
+
+
+const int JULIA_SPLIT_DEPTH = 8;                ///< Preimage tree is split into 2^depth subtrees, one per task
+const int JULIA_OUTER = 512;                    ///< Side of hit count grid for points outside the window
+const double JULIA_BAILOUT = 1e6;               ///< Escape radius of distance estimate, big so estimate is precise
+const double JULIA_DEM_WIDTH = 0.5;             ///< Pixel is on the boundary when estimated distance is below that many pixels
+const double JULIA_COVERAGE = 0.95;             ///< Part of escape time boundary that inverse iteration must cover
+const int JULIA_MAX_CAP = 64;                   ///< Biggest hit count cap tried by compare mode
+
+
+/// Boundary renderers
+typedef enum {
+    JULIA_MIIM          = 0,        ///< Modified inverse iteration with hit count cap
+    JULIA_ESCAPE        = 1,        ///< Escape time with distance estimate on every pixel
+    JULIA_COMPARE       = 2,        ///< Escape time, then inverse iteration with growing cap until it covers the boundary
+} JuliaMode;
+
+
+/// Julia settings taken from command line
+typedef struct {
+    double c_re = -0.7269;                      ///< Parameter c real part
+    double c_im = 0.1889;                       ///< Parameter c imaginary part
+    double center_x = 0;                        ///< Window center x
+    double center_y = 0;                        ///< Window center y
+    double span = 3.2;                          ///< Window width
+    int width = 1080;                           ///< Image width
+    int height = 1080;                          ///< Image height
+    int nmax = 1024;                            ///< Max escape iteration number and max preimage depth
+    int cap = 4;                                ///< Hits of one pixel after which its preimages are not traced
+    int threads = 0;                            ///< Number of threads, zero means all cores
+    JuliaMode mode = JULIA_COMPARE;             ///< Boundary renderer
+    const char *output = "julia.ppm";           ///< Output image
+} JuliaArgs;
+
+
+/// Point of preimage tree
+typedef struct {
+    double x = 0;                               ///< Real part
+    double y = 0;                               ///< Imaginary part
+    int depth = 0;                              ///< Number of inverse steps from the fixed point
+} JuliaNode;
+
+
+/// Shared state of one boundary render
+typedef struct {
+    double c_re = 0;                            ///< Parameter c real part
+    double c_im = 0;                            ///< Parameter c imaginary part
+    double left = 0;                            ///< X of the left image edge
+    double top = 0;                             ///< Y of the top image edge
+    double scale = 0;                           ///< Pixels per plane unit
+    int width = 0;                              ///< Image width
+    int height = 0;                             ///< Image height
+    int nmax = 0;                               ///< Max escape iteration number and max preimage depth
+    int cap = 0;                                ///< Hit count cap
+    int outer_cap = 0;                          ///< Hit count cap of outer cells
+    double radius = 0;                          ///< Julia set lies in the disk of that radius
+    double root_x = 0;                          ///< Repelling fixed point x, root of preimage tree
+    double root_y = 0;                          ///< Repelling fixed point y
+    std::atomic<uint16_t> *hits = nullptr;      ///< Hit counts of window pixels
+    std::atomic<uint16_t> *outer = nullptr;     ///< Hit counts of JULIA_OUTER^2 cells that cover the disk
+    uint8_t *boundary = nullptr;                ///< Escape time boundary mask
+    std::atomic<long> nodes = {};               ///< Number of traced preimages
+    std::atomic<bool> failed = {};              ///< Some task couldn't allocate its stack
+} JuliaRender;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], JuliaArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Traces boundary with inverse iteration and current cap, hit counts are cleared first
+ * \param [in,out] render  Render state
+ * \param [in]     pool    Worker pool
+ * \return Non zero value means error
+*/
+int miim_render(JuliaRender *render, WorkerPool *pool);
+
+
+/**
+ * \brief Marks pixels whose escape time distance estimate is below JULIA_DEM_WIDTH pixels
+ * \param [in,out] render  Render state
+ * \param [in]     pool    Worker pool
+*/
+void escape_render(JuliaRender *render, WorkerPool *pool);
+
+
+/**
+ * \brief Compares traced pixels with escape time boundary, one pixel offset is allowed both ways
+ * \param [in]  render      Render state with both results
+ * \param [out] coverage    Part of boundary pixels with traced pixel nearby
+ * \param [out] precision   Part of traced pixels with boundary pixel nearby
+*/
+void compare_boundary(const JuliaRender *render, double *coverage, double *precision);
+
+
+/**
+ * \brief Saves white on black image of nonzero mask values
+ * \param [in] args     Settings
+ * \param [in] mask     Mask of width * height bytes
+ * \return Non zero value means error
+*/
+int save_mask(const JuliaArgs *args, const uint8_t *mask);
+
+
+/**
+ * \brief Traces one subtree of preimages of the fixed point
+*/
+static void miim_task(void *arg, int index);
+
+
+/**
+ * \brief Counts hit of the point, returns false if its pixel or cell already reached the cap
+*/
+static bool miim_visit(JuliaRender *render, double x, double y);
+
+
+/**
+ * \brief Computes distance estimate of one image row
+*/
+static void escape_task(void *arg, int index);
+
+
+/**
+ * \brief Principal square root of x + iy
+*/
+static void complex_sqrt(double x, double y, double *re, double *im);
+
+
+
+
+int main(int argc, char *argv[]) {
+    JuliaArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    static JuliaRender render = {};
+    render.c_re = args.c_re;
+    render.c_im = args.c_im;
+    render.scale = args.width / args.span;
+    render.left = args.center_x - 0.5 * args.span;
+    render.top = args.center_y - 0.5 * args.height / render.scale;
+    render.width = args.width;
+    render.height = args.height;
+    render.nmax = args.nmax;
+    render.cap = args.cap;
+    render.radius = fmax(2, hypot(args.c_re, args.c_im));
+
+    // Fixed point 1/2 + sqrt(1/4 - c) is repelling for every c but 1/4, so it lies on the Julia set
+    complex_sqrt(0.25 - args.c_re, -args.c_im, &render.root_x, &render.root_y);
+    render.root_x += 0.5;
+
+    size_t pixels_count = (size_t) args.width * (size_t) args.height;
+
+    // Zeroed memory is valid state of lock free atomics, so buffers are not constructed
+    render.hits = (std::atomic<uint16_t> *) calloc(pixels_count, sizeof(std::atomic<uint16_t>));
+    render.outer = (std::atomic<uint16_t> *) calloc((size_t) JULIA_OUTER * JULIA_OUTER, sizeof(std::atomic<uint16_t>));
+    render.boundary = (uint8_t *) calloc(pixels_count, sizeof(uint8_t));
+    uint8_t *mask = (uint8_t *) calloc(pixels_count, sizeof(uint8_t));
+
+    WorkerPool pool = {};
+    int result = OK;
+
+    if (!render.hits || !render.outer || !render.boundary || !mask) {
+        printf("Can't allocate Julia buffers!\n");
+        result = ALLOC_FAIL;
+    }
+    else if (pool_create(&pool, args.threads)) {
+        printf("Can't start worker pool!\n");
+        result = ALLOC_FAIL;
+    }
+
+    if (!result && args.mode != JULIA_MIIM) {
+        double start = get_seconds();
+        escape_render(&render, &pool);
+        double elapsed = get_seconds() - start;
+
+        long boundary = 0;
+        for (size_t i = 0; i < pixels_count; i++) boundary += render.boundary[i];
+
+        printf("Escape time: %.1f ms, %ld boundary pixels\n", 1e3 * elapsed, boundary);
+
+        if (args.mode == JULIA_ESCAPE) result = save_mask(&args, render.boundary);
+
+        if (args.mode == JULIA_COMPARE) {
+            printf("%6s %10s %12s %10s %10s %10s\n", "cap", "ms", "preimages", "coverage", "precision", "speedup");
+
+            double best = 0;
+            bool reached = false;
+
+            for (render.cap = 1; !result && render.cap <= JULIA_MAX_CAP; render.cap *= 2) {
+                double miim_start = get_seconds();
+                result = miim_render(&render, &pool);
+                double miim_elapsed = get_seconds() - miim_start;
+
+                double coverage = 0, precision = 0;
+                compare_boundary(&render, &coverage, &precision);
+
+                best = fmax(best, coverage);
+                reached = coverage >= JULIA_COVERAGE;
+
+                // Speedup means something only at equal quality, so rows below the target coverage have none
+                printf("%6d %10.1f %12ld %9.1f%% %9.1f%% ", render.cap, 1e3 * miim_elapsed, render.nodes.load(),
+                       100 * coverage, 100 * precision);
+
+                if (reached) printf("%9.1fx\n", elapsed / miim_elapsed);
+                else         printf("%10s\n", "-");
+
+                if (reached) break;
+            }
+
+            if (!result && !reached)
+                printf("Inverse iteration did not reach %.0f%% coverage up to cap %d, best %.1f%%, no speedup at equal "
+                       "quality\n", 100 * JULIA_COVERAGE, JULIA_MAX_CAP, 100 * best);
+        }
+    }
+
+    if (!result && args.mode == JULIA_MIIM) {
+        double start = get_seconds();
+        result = miim_render(&render, &pool);
+        double elapsed = get_seconds() - start;
+
+        if (!result) printf("Inverse iteration: %.1f ms, %ld preimages\n", 1e3 * elapsed, render.nodes.load());
+    }
+
+    if (!result && args.mode != JULIA_ESCAPE) {
+        for (size_t i = 0; i < pixels_count; i++) mask[i] = render.hits[i].load(std::memory_order_relaxed) > 0;
+
+        result = save_mask(&args, mask);
+    }
+
+    if (pool.threads) pool_destroy(&pool);
+
+    free(render.hits);
+    free(render.outer);
+    free(render.boundary);
+    free(mask);
+
+    return result;
+}
+
+
+int parse_args(int argc, char *argv[], JuliaArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-r")) args -> c_re = atof(value);
+        else if (!strcmp(argv[i - 1], "-i")) args -> c_im = atof(value);
+        else if (!strcmp(argv[i - 1], "-x")) args -> center_x = atof(value);
+        else if (!strcmp(argv[i - 1], "-y")) args -> center_y = atof(value);
+        else if (!strcmp(argv[i - 1], "-s")) args -> span = atof(value);
+        else if (!strcmp(argv[i - 1], "-w")) args -> width = atoi(value);
+        else if (!strcmp(argv[i - 1], "-h")) args -> height = atoi(value);
+        else if (!strcmp(argv[i - 1], "-n")) args -> nmax = atoi(value);
+        else if (!strcmp(argv[i - 1], "-k")) args -> cap = atoi(value);
+        else if (!strcmp(argv[i - 1], "-t")) args -> threads = atoi(value);
+        else if (!strcmp(argv[i - 1], "-m")) {
+            if      (!strcmp(value, "miim"))    args -> mode = JULIA_MIIM;
+            else if (!strcmp(value, "escape"))  args -> mode = JULIA_ESCAPE;
+            else if (!strcmp(value, "compare")) args -> mode = JULIA_COMPARE;
+            else ASSERT(0, INVALID_ARG, "Unknown mode %s!\n", value);
+        }
+        else if (!strcmp(argv[i - 1], "-o")) args -> output = value;
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(args -> span > 0, INVALID_ARG, "Invalid span!\n");
+    ASSERT(args -> width > 0 && args -> height > 0, INVALID_ARG, "Invalid image size!\n");
+    ASSERT(args -> nmax > JULIA_SPLIT_DEPTH, INVALID_ARG, "Max iteration number must be above %d!\n", JULIA_SPLIT_DEPTH);
+    ASSERT(args -> cap > 0 && args -> cap < UINT16_MAX, INVALID_ARG, "Invalid hit count cap!\n");
+    ASSERT(args -> threads >= 0, INVALID_ARG, "Invalid number of threads!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: julia.exe [-r c_re] [-i c_im] [-x center_x] [-y center_y] [-s span] [-w width] [-h height] [-n nmax] [-k cap] [-t threads] [-m miim|escape|compare] [-o output.ppm]\n");
+}
+
+
+int miim_render(JuliaRender *render, WorkerPool *pool) {
+    ASSERT(render, INVALID_ARG, "Can't trace null render!\n");
+    ASSERT(pool, INVALID_ARG, "Can't trace without worker pool!\n");
+
+    memset((void *) render -> hits, 0, (size_t) render -> width * (size_t) render -> height * sizeof(std::atomic<uint16_t>));
+    memset((void *) render -> outer, 0, (size_t) JULIA_OUTER * JULIA_OUTER * sizeof(std::atomic<uint16_t>));
+
+    render -> nodes.store(0);
+    render -> failed.store(false);
+
+    // Boundary crosses outer cell on about cell / pixel window pixels, so outer cells allow that many more hits
+    double cell_pixels = 2 * render -> radius * render -> scale / JULIA_OUTER;
+    render -> outer_cap = (int) fmin(render -> cap * fmax(cell_pixels, 1), UINT16_MAX - 1);
+
+    pool_run(pool, miim_task, render, 1 << JULIA_SPLIT_DEPTH);
+
+    ASSERT(!render -> failed.load(), ALLOC_FAIL, "Can't allocate preimage stack!\n");
+
+    return OK;
+}
+
+
+void escape_render(JuliaRender *render, WorkerPool *pool) {
+    assert(render && "Can't render null render!\n");
+    assert(pool && "Can't render without worker pool!\n");
+
+    pool_run(pool, escape_task, render, render -> height);
+}
+
+
+void compare_boundary(const JuliaRender *render, double *coverage, double *precision) {
+    assert(render && "Can't compare null render!\n");
+    assert(coverage && precision && "Can't store null results!\n");
+
+    const int width = render -> width, height = render -> height;
+
+    long boundary = 0, covered = 0, traced = 0, matched = 0;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            bool is_boundary = render -> boundary[y * width + x];
+            bool is_traced = render -> hits[y * width + x].load(std::memory_order_relaxed) > 0;
+
+            if (!is_boundary && !is_traced) continue;
+
+            bool boundary_near = false, traced_near = false;
+
+            for (int ny = y - 1; ny <= y + 1; ny++) {
+                for (int nx = x - 1; nx <= x + 1; nx++) {
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+
+                    boundary_near |= render -> boundary[ny * width + nx] != 0;
+                    traced_near |= render -> hits[ny * width + nx].load(std::memory_order_relaxed) > 0;
+                }
+            }
+
+            if (is_boundary) {
+                boundary++;
+                covered += traced_near;
+            }
+
+            if (is_traced) {
+                traced++;
+                matched += boundary_near;
+            }
+        }
+    }
+
+    *coverage = boundary ? (double) covered / (double) boundary : 1;
+    *precision = traced ? (double) matched / (double) traced : 1;
+}
+
+
+int save_mask(const JuliaArgs *args, const uint8_t *mask) {
+    size_t pixels_count = (size_t) args -> width * (size_t) args -> height;
+
+    uint8_t *pixels = (uint8_t *) calloc(pixels_count, 4);
+    ASSERT(pixels, ALLOC_FAIL, "Can't allocate image!\n");
+
+    for (size_t i = 0; i < pixels_count; i++) {
+        uint8_t value = mask[i] ? 255 : 0;
+
+        pixels[4 * i + 0] = value;
+        pixels[4 * i + 1] = value;
+        pixels[4 * i + 2] = value;
+        pixels[4 * i + 3] = 255;
+    }
+
+    int result = write_ppm(args -> output, pixels, args -> width, args -> height);
+
+    free(pixels);
+    return result;
+}
+
+
+static void miim_task(void *arg, int index) {
+    JuliaRender *render = (JuliaRender *) arg;
+
+    // Fixed point is its own principal preimage, so only its other preimage -root starts new points. Points below it
+    // never map back to it or to each other, and bits of the task index choose the branch of the next inverse steps,
+    // so subtrees don't overlap
+    JuliaNode root = {-render -> root_x, -render -> root_y, JULIA_SPLIT_DEPTH + 1};
+    if (index == 0) miim_visit(render, render -> root_x, render -> root_y);
+
+    for (int level = 0; level < JULIA_SPLIT_DEPTH; level++) {
+        complex_sqrt(root.x - render -> c_re, root.y - render -> c_im, &root.x, &root.y);
+
+        if ((index >> level) & 1) {
+            root.x = -root.x;
+            root.y = -root.y;
+        }
+    }
+
+    // Depth first order leaves at most one pending sibling per level
+    JuliaNode *stack = (JuliaNode *) calloc((size_t) (render -> nmax - JULIA_SPLIT_DEPTH + 2), sizeof(JuliaNode));
+    if (!stack) {
+        render -> failed.store(true);
+        return;
+    }
+
+    int top = 0;
+    long nodes = 0;
+    stack[top++] = root;
+
+    while (top) {
+        JuliaNode node = stack[--top];
+        nodes++;
+
+        if (!miim_visit(render, node.x, node.y) || node.depth == render -> nmax) continue;
+
+        double re = 0, im = 0;
+        complex_sqrt(node.x - render -> c_re, node.y - render -> c_im, &re, &im);
+
+        stack[top++] = {-re, -im, node.depth + 1};
+        stack[top++] = {re, im, node.depth + 1};
+    }
+
+    render -> nodes.fetch_add(nodes, std::memory_order_relaxed);
+
+    free(stack);
+}
+
+
+static bool miim_visit(JuliaRender *render, double x, double y) {
+    double px = (x - render -> left) * render -> scale;
+    double py = (y - render -> top) * render -> scale;
+
+    std::atomic<uint16_t> *count = nullptr;
+    int cap = render -> cap;
+
+    if (px >= 0 && py >= 0 && px < render -> width && py < render -> height) {
+        count = &render -> hits[(int) py * render -> width + (int) px];
+    }
+    else {
+        // Points outside the window are capped on coarse grid, their preimages may come back into the window
+        double cell = JULIA_OUTER / (2 * render -> radius);
+        int cx = (int) ((x + render -> radius) * cell), cy = (int) ((y + render -> radius) * cell);
+
+        if (cx < 0 || cy < 0 || cx >= JULIA_OUTER || cy >= JULIA_OUTER) return false;
+
+        count = &render -> outer[cy * JULIA_OUTER + cx];
+        cap = render -> outer_cap;
+    }
+
+    // Threads may overshoot the cap by a few hits, that only costs a few extra preimages
+    if (count -> load(std::memory_order_relaxed) >= cap) return false;
+
+    count -> fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+static void escape_task(void *arg, int index) {
+    JuliaRender *render = (JuliaRender *) arg;
+
+    const double pixel = 1 / render -> scale;
+    const double y0 = render -> top + (index + 0.5) * pixel;
+
+    uint8_t *row = render -> boundary + (size_t) index * (size_t) render -> width;
+
+    for (int i = 0; i < render -> width; i++) {
+        double x = render -> left + (i + 0.5) * pixel, y = y0;
+        double dx = 1, dy = 0;
+        double r2 = x * x + y * y;
+
+        int n = 0;
+        for (; n < render -> nmax && r2 < JULIA_BAILOUT * JULIA_BAILOUT; n++) {
+            // Derivative by starting point, dz' = 2 z dz
+            double ndx = 2 * (x * dx - y * dy);
+            dy = 2 * (x * dy + y * dx);
+            dx = ndx;
+
+            double nx = x * x - y * y + render -> c_re;
+            y = 2 * x * y + render -> c_im;
+            x = nx;
+
+            r2 = x * x + y * y;
+        }
+
+        // Points that never escape are inside, only escaped ones near the set are boundary
+        bool boundary = false;
+        if (n < render -> nmax) {
+            double r = sqrt(r2);
+            boundary = r * log(r) < JULIA_DEM_WIDTH * pixel * hypot(dx, dy);
+        }
+
+        row[i] = boundary;
+    }
+}
+
+
+static void complex_sqrt(double x, double y, double *re, double *im) {
+    double r = hypot(x, y);
+
+    *re = sqrt(0.5 * (r + x));
+    *im = copysign(sqrt(0.5 * (r - x)), y);
+}
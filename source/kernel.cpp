@@ -0,0 +1,365 @@
+/**
+ * \file
+ * \brief Source file for Mandelbrot set computational kernels and coloring
+*/
+
+#include <assert.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "kernel.hpp"
+
+
+typedef union {
+    __m256 float_vec;
+    __m256i int_vec;
+    float float_arr[8];
+    int int_arr[8];
+} VecToArr;
+
+
+/**
+ * \brief Iterates 8 pixels of the row from given z and iteration number until they escape or reach nmax
+ * \param [in,out] state   Iteration state, z is stored for pixels that reached nmax
+ * \param [in]     offset  Index of the first pixel
+ * \param [in]     x0      Pixels x
+ * \param [in]     y0      Pixels y
+ * \param [in]     start   Pixels to iterate, others keep their state
+ * \param [in]     nmax    Max iteration number
+*/
+static void iterate_lanes(IterState *state, int offset, __m256 x0, __m256 y0, __m256i start, int nmax);
+
+
+
+
+void set_pixels(const IterColor *color_table, uint8_t *buffer, const Transform *transform) {
+    DirtyRect screen = {0, 0, SCREEN_W, SCREEN_H};
+    set_pixels_rect(color_table, buffer, transform, &screen);
+}
+
+
+void set_pixels_rect(const IterColor *color_table, uint8_t *buffer, const Transform *transform, const DirtyRect *rect) {
+    assert(color_table && "Color table is null!\n");
+    assert(buffer && "Can't set pixels with null buffer!\n");
+    assert(rect && rect -> x % 8 == 0 && rect -> width % 8 == 0 && "Rectangle columns must be aligned to 8 pixels!\n");
+    assert(rect -> x + rect -> width <= SCREEN_W && rect -> y + rect -> height <= SCREEN_H && "Rectangle is out of screen!\n");
+
+    const float delta_x = transform -> set_w / (float)SCREEN_W;
+    const float delta_y = transform -> set_h / (float)SCREEN_H;
+
+    float y0 = transform -> center_y - 0.5f * transform -> set_h;
+
+    __m256 left = _mm256_add_ps(
+        _mm256_set1_ps(transform -> center_x - 0.5f * transform -> set_w),
+        _mm256_set_ps(0.0f, delta_x, 2.0f * delta_x, 3.0f * delta_x, 4.0f * delta_x, 5.0f * delta_x, 6.0f * delta_x, 7.0f * delta_x)
+    );
+
+    // Coordinates are accumulated from the screen corner, so rectangles give the same bits as the whole screen
+    for (int y = 0; y < rect -> y; y++) y0 += delta_y;
+    for (int x = 0; x < rect -> x; x += 8) left = _mm256_add_ps(left, _mm256_set1_ps(8.0f * delta_x));
+
+    for (int y = rect -> y; y < rect -> y + rect -> height; y++) {
+        __m256 x0 = left;
+        uint8_t *pixel = buffer + 4 * ((size_t) y * SCREEN_W + (size_t) rect -> x);
+
+        for (int x = rect -> x; x < rect -> x + rect -> width; x += 8) {
+            __m256 x_i = x0;
+            __m256 y_i = _mm256_set1_ps(y0);
+
+            __m256i N = _mm256_setzero_si256();
+            for (;;) {
+                __m256 x2 = _mm256_mul_ps(x_i, x_i);
+                __m256 y2 = _mm256_mul_ps(y_i, y_i);
+                __m256 xy = _mm256_mul_ps(x_i, y_i);
+
+
+                __m256 res1 = _mm256_cmp_ps(_mm256_add_ps(x2, y2), _mm256_set1_ps(RMAX * RMAX), _CMP_LT_OS);
+                if (_mm256_testz_si256(_mm256_castps_si256(res1), _mm256_set1_epi32(0xFFFFFFFF))) break;
+
+                N = _mm256_add_epi32(N, _mm256_and_si256(_mm256_castps_si256(res1), _mm256_set1_epi32(1)));
+
+                __m256i res2 = _mm256_cmpeq_epi32(N, _mm256_set1_epi32(NMAX));
+                if (!_mm256_testz_si256(res2, _mm256_set1_epi32(0xFFFFFFFF))) break;
+
+
+                x_i = _mm256_add_ps(_mm256_sub_ps(x2, y2), x0);
+                y_i = _mm256_add_ps(_mm256_mul_ps(xy, _mm256_set1_ps(2.0f)), _mm256_set1_ps(y0));
+            }
+
+            VecToArr tmpN = {}, tmpX = {};
+            tmpN.int_vec = N, tmpX.float_vec = x0;
+
+            for (int i = 7; i >= 0; i--) {
+                set_pixel_color(color_table, pixel, (tmpN.int_arr)[i], (tmpX.float_arr)[8 - i - 1], y0);
+                pixel += 4;
+            }
+
+            x0 = _mm256_add_ps(x0, _mm256_set1_ps(8.0f * delta_x));
+        }
+
+        y0 += delta_y;
+    }
+}
+
+
+void set_pixel_color(const IterColor *color_table, uint8_t *buffer, int N, float x, float y) {
+    assert(buffer && "Can't set pixel color with null buffer!\n");
+
+    if (0 < N && N < NMAX) {
+        buffer[0] = color_table[N % POSSIBLE_COLORS].red;
+        buffer[1] = color_table[N % POSSIBLE_COLORS].green;
+        buffer[2] = color_table[N % POSSIBLE_COLORS].blue;
+        buffer[3] = 255;
+    }
+    else {
+        buffer[0] = 0;
+        buffer[1] = 0;
+        buffer[2] = 0;
+        buffer[3] = 255;
+    }
+}
+
+
+int iter_state_create(IterState *state) {
+    ASSERT(state, INVALID_ARG, "Can't create null iteration state!\n");
+
+    state -> iters = (int *) calloc(SCREEN_W * SCREEN_H, sizeof(int));
+    state -> re = (float *) calloc(SCREEN_W * SCREEN_H, sizeof(float));
+    state -> im = (float *) calloc(SCREEN_W * SCREEN_H, sizeof(float));
+    state -> nmax = 0;
+
+    if (!state -> iters || !state -> re || !state -> im) {
+        iter_state_free(state);
+
+        printf("Can't allocate iteration state!\n");
+        return ALLOC_FAIL;
+    }
+
+    return OK;
+}
+
+
+int iter_state_free(IterState *state) {
+    ASSERT(state, INVALID_ARG, "Can't free null iteration state!\n");
+
+    free(state -> iters);
+    free(state -> re);
+    free(state -> im);
+
+    state -> iters = nullptr;
+    state -> re = nullptr;
+    state -> im = nullptr;
+    state -> nmax = 0;
+
+    return OK;
+}
+
+
+int iter_state_update(IterState *state, const Transform *transform, int nmax, DirtyRegion *dirty) {
+    assert(state && "Can't update null iteration state!\n");
+    assert(transform && "Can't update iteration state without transform!\n");
+    assert(dirty && "Can't update iteration state without dirty region!\n");
+
+    bool same_view = state -> nmax && !memcmp(&state -> transform, transform, sizeof(Transform));
+
+    if (same_view && nmax == state -> nmax) return 0;
+
+    bool resume = same_view && nmax > state -> nmax;
+    if (!resume) dirty_all(dirty);
+
+    const float delta_x = transform -> set_w / (float)SCREEN_W;
+    const float delta_y = transform -> set_h / (float)SCREEN_H;
+
+    const __m256i prev_nmax = _mm256_set1_epi32(state -> nmax);
+
+    float left = transform -> center_x - 0.5f * transform -> set_w;
+    float y0 = transform -> center_y - 0.5f * transform -> set_h;
+
+    int iterated = 0;
+
+    for (int y = 0; y < SCREEN_H; y++, y0 += delta_y) {
+        // Coordinates are accumulated exactly like in set_pixels, so both kernels give the same image
+        __m256 x0 = _mm256_add_ps(
+            _mm256_set1_ps(left),
+            _mm256_set_ps(7.0f * delta_x, 6.0f * delta_x, 5.0f * delta_x, 4.0f * delta_x, 3.0f * delta_x, 2.0f * delta_x, delta_x, 0.0f)
+        );
+
+        for (int x = 0; x < SCREEN_W; x += 8, x0 = _mm256_add_ps(x0, _mm256_set1_ps(8.0f * delta_x))) {
+            int offset = y * SCREEN_W + x;
+
+            __m256i start = _mm256_set1_epi32(-1);
+
+            if (resume) {
+                // Only pixels that reached the previous limit are continued
+                start = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(state -> iters + offset)), prev_nmax);
+                if (_mm256_testz_si256(start, start)) continue;
+
+                dirty_add(dirty, x, y, 8);
+            }
+            else {
+                _mm256_storeu_si256((__m256i *)(state -> iters + offset), _mm256_setzero_si256());
+                _mm256_storeu_ps(state -> re + offset, x0);
+                _mm256_storeu_ps(state -> im + offset, _mm256_set1_ps(y0));
+            }
+
+            iterate_lanes(state, offset, x0, _mm256_set1_ps(y0), start, nmax);
+            iterated += __builtin_popcount((unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(start)));
+        }
+    }
+
+    state -> transform = *transform;
+    state -> nmax = nmax;
+
+    return iterated;
+}
+
+
+void iter_tile(int *iters, double left, double top, double pixel, int size, int nmax) {
+    assert(iters && "Can't calculate tile into null buffer!\n");
+    assert(size % 8 == 0 && "Tile side must be multiple of 8!\n");
+
+    // Lanes live on stack, the same loop as the screen state iterates them
+    int lane_iters[8] = {};
+    float lane_re[8] = {}, lane_im[8] = {};
+
+    IterState lanes = {};
+    lanes.iters = lane_iters;
+    lanes.re = lane_re;
+    lanes.im = lane_im;
+
+    for (int y = 0; y < size; y++) {
+        __m256 y0 = _mm256_set1_ps((float) (top + y * pixel));
+
+        for (int x = 0; x < size; x += 8) {
+            // Every coordinate is taken from the tile corner, so tiles don't depend on the screen they were seen on
+            __m256 x0 = _mm256_set_ps((float) (left + (x + 7) * pixel), (float) (left + (x + 6) * pixel),
+                                      (float) (left + (x + 5) * pixel), (float) (left + (x + 4) * pixel),
+                                      (float) (left + (x + 3) * pixel), (float) (left + (x + 2) * pixel),
+                                      (float) (left + (x + 1) * pixel), (float) (left + x * pixel));
+
+            _mm256_storeu_si256((__m256i *) lane_iters, _mm256_setzero_si256());
+            _mm256_storeu_ps(lane_re, x0);
+            _mm256_storeu_ps(lane_im, y0);
+
+            iterate_lanes(&lanes, 0, x0, y0, _mm256_set1_epi32(-1), nmax);
+
+            memcpy(iters + y * size + x, lane_iters, sizeof(lane_iters));
+        }
+    }
+}
+
+
+int load_color_table(const char *filename, IterColor **buffer) {
+    ASSERT(filename, INVALID_ARG, "Can't load without filename!\n");
+    ASSERT(buffer, INVALID_ARG, "Can't load in null buffer!\n");
+
+    FILE *file = fopen(filename, "r");
+    ASSERT(file, FILE_NOT_FOUND, "Color table source file not found!\n");
+
+    *buffer = (IterColor *) calloc(POSSIBLE_COLORS, sizeof(IterColor));
+    ASSERT(*buffer, ALLOC_FAIL, "Can't allocate color table buffer!\n");
+
+    for (int i = 0; i < POSSIBLE_COLORS; i++) {
+        if (fscanf(file, "%hhu %hhu %hhu", &((*buffer + i) -> red), &((*buffer + i) -> green), &((*buffer + i) -> blue)) != 3) {
+            free(*buffer);
+            *buffer = nullptr;
+
+            printf("Color table source file not found!\n");
+            return INVALID_FORMAT;
+        }
+    }
+
+    fclose(file);
+
+    return OK;
+}
+
+
+int free_color_table(IterColor **buffer) {
+    ASSERT(buffer, INVALID_ARG, "Pointer to buffer is null!\n");
+    ASSERT(*buffer, INVALID_ARG, "Can't free null buffer!\n");
+
+    free(*buffer);
+    *buffer = nullptr;
+
+    return OK;
+}
+
+
+void colorize(const IterColor *color_table, const int *iters, uint8_t *buffer, int count, int nmax) {
+    assert(color_table && "Color table is null!\n");
+    assert(iters && "Can't colorize null iterations!\n");
+    assert(buffer && "Can't colorize into null buffer!\n");
+
+    for (int i = 0; i < count; i++, buffer += 4) {
+        int N = iters[i];
+
+        if (0 < N && N < nmax) {
+            buffer[0] = color_table[N % POSSIBLE_COLORS].red;
+            buffer[1] = color_table[N % POSSIBLE_COLORS].green;
+            buffer[2] = color_table[N % POSSIBLE_COLORS].blue;
+        }
+        else {
+            buffer[0] = 0;
+            buffer[1] = 0;
+            buffer[2] = 0;
+        }
+
+        buffer[3] = 255;
+    }
+}
+
+
+void colorize_dirty(const IterColor *color_table, const int *iters, uint8_t *buffer, const DirtyRegion *dirty, int nmax) {
+    assert(dirty && "Can't colorize null dirty region!\n");
+
+    for (int band = 0; band < DIRTY_BANDS; band++) {
+        int left = dirty -> left[band], width = dirty -> right[band] - left;
+        if (width <= 0) continue;
+
+        int row_end = (band + 1) * DIRTY_BAND_ROWS;
+        if (row_end > SCREEN_H) row_end = SCREEN_H;
+
+        for (int y = band * DIRTY_BAND_ROWS; y < row_end; y++) {
+            int offset = y * SCREEN_W + left;
+            colorize(color_table, iters + offset, buffer + 4 * offset, width, nmax);
+        }
+    }
+}
+
+
+static void iterate_lanes(IterState *state, int offset, __m256 x0, __m256 y0, __m256i start, int nmax) {
+    __m256 x_i = _mm256_loadu_ps(state -> re + offset);
+    __m256 y_i = _mm256_loadu_ps(state -> im + offset);
+
+    __m256i N = _mm256_loadu_si256((const __m256i *)(state -> iters + offset));
+    __m256i active = start;
+
+    const __m256i limit = _mm256_set1_epi32(nmax);
+
+    for (;;) {
+        __m256 x2 = _mm256_mul_ps(x_i, x_i);
+        __m256 y2 = _mm256_mul_ps(y_i, y_i);
+        __m256 xy = _mm256_mul_ps(x_i, y_i);
+
+        __m256i inside = _mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(x2, y2), _mm256_set1_ps(RMAX * RMAX), _CMP_LT_OS));
+        active = _mm256_and_si256(active, inside);
+
+        if (_mm256_testz_si256(active, active)) break;
+
+        N = _mm256_sub_epi32(N, active);
+
+        // z is updated before the limit check, so continued pixels start right from the next iteration
+        x_i = _mm256_blendv_ps(x_i, _mm256_add_ps(_mm256_sub_ps(x2, y2), x0), _mm256_castsi256_ps(active));
+        y_i = _mm256_blendv_ps(y_i, _mm256_add_ps(_mm256_mul_ps(xy, _mm256_set1_ps(2.0f)), y0), _mm256_castsi256_ps(active));
+
+        active = _mm256_andnot_si256(_mm256_cmpeq_epi32(N, limit), active);
+    }
+
+    _mm256_storeu_si256((__m256i *)(state -> iters + offset), N);
+    _mm256_storeu_ps(state -> re + offset, x_i);
+    _mm256_storeu_ps(state -> im + offset, y_i);
+}
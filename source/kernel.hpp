@@ -0,0 +1,150 @@
+/**
+ * \file
+ * \brief Header file for Mandelbrot set computational kernels and coloring
+*/
+
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include <stdint.h>
+#include "configs.hpp"
+#include "dirty.hpp"
+
+
+/// Contains information about Mandelbrot set offset and scale
+typedef struct {
+    float center_x = CENTER_X;      ///< Offset x
+    float center_y = CENTER_Y;      ///< Offset y
+    float set_w = SET_W;            ///< Scale x
+    float set_h = SET_H;            ///< Scale y
+} Transform;
+
+
+/// Iteration numbers and last z of the screen, lets pixels continue when iteration limit grows
+typedef struct {
+    int *iters = nullptr;           ///< Iteration numbers
+    float *re = nullptr;            ///< Real part of z for the iteration after the limit
+    float *im = nullptr;            ///< Imaginary part of z for the iteration after the limit
+    int nmax = 0;                   ///< Limit of stored state, zero means no state
+    Transform transform = {};       ///< Transform of stored state
+} IterState;
+
+
+/// Contains information about color in RGB format
+typedef struct {
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
+} IterColor;
+
+
+/**
+ * \brief Set pixels colors in buffer accroding to Mandelbrot formula
+ * \param [in]  color_table Containts rgb color for each iteration number
+ * \param [out] buffer      Buffer to store pixels colors
+ * \param [in]  transform   Mandelbrot set offset and scale
+*/
+void set_pixels(const IterColor *color_table, uint8_t *buffer, const Transform *transform);
+
+
+/**
+ * \brief Set colors of screen rectangle pixels, the rest of the buffer is not touched
+ * \param [in]  color_table Containts rgb color for each iteration number
+ * \param [out] buffer      Screen buffer to store pixels colors
+ * \param [in]  transform   Mandelbrot set offset and scale
+ * \param [in]  rect        Rectangle, its left column and width are multiples of 8
+*/
+void set_pixels_rect(const IterColor *color_table, uint8_t *buffer, const Transform *transform, const DirtyRect *rect);
+
+
+/**
+ * \brief Set pixel color in buffer based on iterations number and position
+ * \param [out] buffer  Buffer to store pixel color
+ * \param [in]  N       Number of iterations
+ * \param [in]  x       Pixel x coordinate
+ * \param [in]  y       Pixel y coordinate
+*/
+void set_pixel_color(const IterColor *color_table, uint8_t *buffer, int N, float x, float y);
+
+
+/**
+ * \brief Loads color table from file into allocated buffer
+ * \param [in]  filename    Path to color table source file
+ * \param [out] buffer      Buffer to allocate and fill with colors
+ * \return Non zero value means error 
+*/
+int load_color_table(const char *filename, IterColor **buffer);
+
+
+/**
+ * \brief Free color table buffer
+ * \param [out] buffer  Buffer to free
+ * \return Non zero value means error
+*/
+int free_color_table(IterColor **buffer);
+
+
+/**
+ * \brief Allocates iteration state for the screen
+ * \param [out] state State to allocate, it is empty after creation
+ * \return Non zero value means error
+*/
+int iter_state_create(IterState *state);
+
+
+/**
+ * \brief Free iteration state buffers
+ * \param [out] state State to free
+ * \return Non zero value means error
+*/
+int iter_state_free(IterState *state);
+
+
+/**
+ * \brief Brings iteration numbers to the transform and limit
+ * \note If only the limit was raised, pixels that reached the previous limit continue from stored z,
+ * other pixels are kept. Changed transform or lowered limit recalculates the whole screen
+ * \param [in,out] state       Iteration state
+ * \param [in]     transform   Mandelbrot set offset and scale
+ * \param [in]     nmax        Max iteration number
+ * \param [out]    dirty       Changed pixels are added to it
+ * \return Number of iterated pixels
+*/
+int iter_state_update(IterState *state, const Transform *transform, int nmax, DirtyRegion *dirty);
+
+
+/**
+ * \brief Calculates iteration numbers of square tile from scratch
+ * \param [out] iters   Iteration numbers of size * size pixels in row order
+ * \param [in]  left    X of the left pixel column
+ * \param [in]  top     Y of the top pixel row
+ * \param [in]  pixel   Pixel size
+ * \param [in]  size    Tile side, multiple of 8
+ * \param [in]  nmax    Max iteration number
+*/
+void iter_tile(int *iters, double left, double top, double pixel, int size, int nmax);
+
+
+/**
+ * \brief Colors iteration numbers with runtime iteration limit
+ * \param [in]  color_table Containts rgb color for each iteration number
+ * \param [in]  iters       Iteration numbers
+ * \param [out] buffer      Buffer to store pixels colors in RGBA format
+ * \param [in]  count       Number of pixels
+ * \param [in]  nmax        Max iteration number, such pixels are black
+*/
+void colorize(const IterColor *color_table, const int *iters, uint8_t *buffer, int count, int nmax);
+
+
+/**
+ * \brief Colors changed screen pixels
+ * \param [in]  color_table Containts rgb color for each iteration number
+ * \param [in]  iters       Iteration numbers of the screen
+ * \param [out] buffer      Screen buffer to store pixels colors in RGBA format
+ * \param [in]  dirty       Changed pixels
+ * \param [in]  nmax        Max iteration number, such pixels are black
+*/
+void colorize_dirty(const IterColor *color_table, const int *iters, uint8_t *buffer, const DirtyRegion *dirty, int nmax);
+
+
+#endif
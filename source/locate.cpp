@@ -0,0 +1,119 @@
+/**
+ * \file
+ * \brief Finds minibrot nucleus near the point, so deep zoom can start right at it
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "nucleus.hpp"
+
+
+const int LOCATE_STRING_SIZE = BIGNUM_MAX_BITS / 3 + 32;    ///< Fits decimal string of any number
+
+
+/// Locator settings taken from command line
+typedef struct {
+    const char *center_x = "-0.75";             ///< Start point x as decimal string
+    const char *center_y = "0";                 ///< Start point y as decimal string
+    const char *span = "3.5";                   ///< Search area width like "1e-500"
+    int period = 0;                             ///< Period, zero means detect it in search area
+    int nmax = NMAX;                            ///< Max period to detect
+} LocateArgs;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], LocateArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+
+
+int main(int argc, char *argv[]) {
+    LocateArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    static DeepView view = {};
+    if (deep_view_parse(&view, args.center_x, args.center_y, args.span)) return INVALID_FORMAT;
+
+    view.nmax = args.nmax;
+
+    int period = args.period;
+    if (!period) {
+        if (nucleus_find_period(&view, &period)) return INVALID_FORMAT;
+        ASSERT(period, INVALID_FORMAT, "No period up to %d found, try bigger span or nmax!\n", args.nmax);
+    }
+
+    double start = get_seconds();
+
+    static Nucleus nucleus = {};
+    int result = nucleus_locate(&nucleus, &view.center_x, &view.center_y, period);
+    if (result) return result;
+
+    double elapsed = get_seconds() - start;
+
+    // Digits that are significant for the minibrot and a few more
+    int digits = (int)(-floatexp_log2(nucleus.size) * 0.30103) + 10;
+    if (digits < 10) digits = 10;
+    if (digits > LOCATE_STRING_SIZE - 16) digits = LOCATE_STRING_SIZE - 16;
+
+    static char x_str[LOCATE_STRING_SIZE] = "", y_str[LOCATE_STRING_SIZE] = "";
+    bignum_to_string(&nucleus.x, x_str, digits);
+    bignum_to_string(&nucleus.y, y_str, digits);
+
+    char size_str[32] = "", span_str[32] = "";
+    floatexp_to_string(nucleus.size, size_str);
+    floatexp_to_string(floatexp_mul_double(nucleus.size, NUCLEUS_VIEW_SCALE), span_str);
+
+    printf("Period: %d\n", nucleus.period);
+    printf("Nucleus x: %s\n", x_str);
+    printf("Nucleus y: %s\n", y_str);
+    printf("Size: %s\n", size_str);
+    printf("Newton steps: %d, precision: %d bits, time: %.3f s\n", nucleus.steps, 32 * (nucleus.x.size - 1), elapsed);
+    printf("Render: ./render.exe -x %s -y %s -s %s -n %d\n", x_str, y_str, span_str,
+           (args.nmax > 2 * nucleus.period) ? args.nmax : 2 * nucleus.period);
+
+    return OK;
+}
+
+
+int parse_args(int argc, char *argv[], LocateArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-x")) args -> center_x = value;
+        else if (!strcmp(argv[i - 1], "-y")) args -> center_y = value;
+        else if (!strcmp(argv[i - 1], "-s")) args -> span = value;
+        else if (!strcmp(argv[i - 1], "-p")) args -> period = atoi(value);
+        else if (!strcmp(argv[i - 1], "-n")) args -> nmax = atoi(value);
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(args -> period >= 0, INVALID_ARG, "Invalid period!\n");
+    ASSERT(args -> nmax > 0, INVALID_ARG, "Invalid max iteration number!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: locate.exe [-x center_x] [-y center_y] [-s span] [-p period] [-n nmax]\n");
+}
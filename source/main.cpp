@@ -1,9 +1,37 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "remote.hpp"
 #include "draw.hpp"
 
 
-int main() {
-    int result = draw_mandelbrot();
+int main(int argc, char *argv[]) {
+    int socket = -1;
+    const char *session = nullptr;
+    bool benchmark = false;
+
+    // paint.exe -c host[:port] shows view rendered by server.exe, -s file keeps calculated tiles between runs,
+    // -b measures kernel speed by calculating every frame many times
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-b")) benchmark = true;
+        else if (i + 1 < argc && !strcmp(argv[i], "-c") && socket < 0) {
+            char *host = argv[++i];
+
+            char *port = strrchr(host, ':');
+            if (port) *port++ = '\0';
+
+            socket = remote_connect(host, port ? atoi(port) : REMOTE_PORT);
+            if (socket < 0) return 1;
+        }
+        else if (i + 1 < argc && !strcmp(argv[i], "-s")) session = argv[++i];
+        else {
+            printf("Usage: paint.exe [-c host:port] [-s session] [-b]\n");
+            return 1;
+        }
+    }
+
+    int result = draw_mandelbrot(socket, session, benchmark);
 
     printf("Mandelbrot set!\n");
 
@@ -0,0 +1,284 @@
+/**
+ * \file
+ * \brief Source file for locating nuclei of hyperbolic components and minibrots
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "nucleus.hpp"
+
+
+/// Complex number with extended exponent parts
+typedef struct {
+    FloatExp re = {};                           ///< Real part
+    FloatExp im = {};                           ///< Imaginary part
+} ComplexExp;
+
+
+/**
+ * \brief Calculates a * b
+*/
+static ComplexExp complexexp_mul(ComplexExp a, ComplexExp b);
+
+
+/**
+ * \brief Calculates a / b
+*/
+static ComplexExp complexexp_div(ComplexExp a, ComplexExp b);
+
+
+/**
+ * \brief Calculates 2 * z * d + 1, the derivative step of z^2 + c
+*/
+static ComplexExp complexexp_derivative_step(ComplexExp z, ComplexExp d);
+
+
+/**
+ * \brief Calculates |a|^2
+*/
+static FloatExp complexexp_norm(ComplexExp a);
+
+
+/**
+ * \brief Returns true if a < b
+*/
+static bool floatexp_less(FloatExp a, FloatExp b);
+
+
+/**
+ * \brief Calculates z_p / z_p' at c, that is Newton step for z_p(c) = 0
+ * \param [in]  cx      Point x
+ * \param [in]  cy      Point y
+ * \param [in]  period  Component period
+ * \param [out] step    Newton step to subtract from c
+ * \return Non zero value means error
+*/
+static int newton_step(const BigNum *cx, const BigNum *cy, int period, ComplexExp *step);
+
+
+/**
+ * \brief Returns the lowest period of nucleus, Newton iteration for period p can converge to nucleus of any divisor of p
+ * \param [in] cx      Nucleus x
+ * \param [in] cy      Nucleus y
+ * \param [in] period  Period used in Newton iteration
+ * \param [in] bits    Precision, z_n is zero if it is below it
+*/
+static int lowest_period(const BigNum *cx, const BigNum *cy, int period, int bits);
+
+
+/**
+ * \brief Estimates minibrot size as |1 / (b * l^2)|, where l is the orbit multiplier and b is the sum of
+ * inverse partial multipliers
+*/
+static FloatExp estimate_size(const BigNum *cx, const BigNum *cy, int period);
+
+
+
+
+int nucleus_find_period(const DeepView *view, int *period) {
+    ASSERT(view, INVALID_ARG, "Can't search period in null view!\n");
+    ASSERT(period, INVALID_ARG, "Can't store period in null pointer!\n");
+
+    FloatExp radius = floatexp_mul_double(view -> span, 0.5);
+    FloatExp radius2 = floatexp_mul(radius, radius);
+
+    static thread_local BigNum x = {}, y = {};
+    bignum_zero(&x, view -> center_x.size);
+    bignum_zero(&y, view -> center_x.size);
+
+    ComplexExp dz = {};
+    *period = 0;
+
+    for (int n = 1; n <= view -> nmax; n++) {
+        ComplexExp z = {bignum_to_floatexp(&x), bignum_to_floatexp(&y)};
+        dz = complexexp_derivative_step(z, dz);
+
+        bignum_mandel_step(&x, &y, &view -> center_x, &view -> center_y);
+
+        z = {bignum_to_floatexp(&x), bignum_to_floatexp(&y)};
+        FloatExp norm = complexexp_norm(z);
+
+        if (floatexp_log2(norm) > 2) return OK;
+
+        // Disk image is approximately disk of radius |dz| * r around z, it contains zero at period
+        if (floatexp_less(norm, floatexp_mul(complexexp_norm(dz), radius2))) {
+            *period = n;
+            return OK;
+        }
+    }
+
+    return OK;
+}
+
+
+int nucleus_locate(Nucleus *nucleus, const BigNum *x, const BigNum *y, int period) {
+    ASSERT(nucleus, INVALID_ARG, "Can't store nucleus in null pointer!\n");
+    ASSERT(x && y, INVALID_ARG, "Can't start Newton iteration from null point!\n");
+    ASSERT(period > 0, INVALID_ARG, "Period must be positive!\n");
+
+    nucleus -> x = *x;
+    nucleus -> y = *y;
+    nucleus -> period = period;
+    nucleus -> steps = 0;
+
+    static thread_local BigNum delta = {};
+
+    for (int refine = 0; refine < NUCLEUS_MAX_REFINES; refine++) {
+        int size = nucleus -> x.size;
+        int bits = 32 * (size - 1);
+
+        bool converged = false;
+
+        for (int i = 0; i < NUCLEUS_MAX_STEPS && !converged; i++) {
+            ComplexExp step = {};
+
+            int result = newton_step(&nucleus -> x, &nucleus -> y, period, &step);
+            if (result) return result;
+
+            FloatExp step_norm = complexexp_norm(step);
+            ASSERT(floatexp_log2(step_norm) < 4, INVALID_FORMAT, "Newton iteration diverged!\n");
+
+            bignum_set_double_exp(&delta, step.re.mantissa, step.re.exponent, size);
+            bignum_sub(&nucleus -> x, &nucleus -> x, &delta);
+            bignum_set_double_exp(&delta, step.im.mantissa, step.im.exponent, size);
+            bignum_sub(&nucleus -> y, &nucleus -> y, &delta);
+
+            nucleus -> steps++;
+
+            converged = floatexp_is_zero(step_norm) || 0.5 * floatexp_log2(step_norm) < NUCLEUS_STEP_GUARD_BITS - bits;
+        }
+
+        ASSERT(converged, INVALID_FORMAT, "Newton iteration did not converge in %d steps!\n", NUCLEUS_MAX_STEPS);
+
+        period = lowest_period(&nucleus -> x, &nucleus -> y, period, bits);
+        nucleus -> period = period;
+
+        nucleus -> size = estimate_size(&nucleus -> x, &nucleus -> y, period);
+
+        // Minibrot must be rendered with pixels much smaller than its size
+        int needed = PERTURB_GUARD_BITS - (int) floatexp_log2(nucleus -> size);
+        if (needed <= bits) return OK;
+
+        ASSERT(needed <= BIGNUM_MAX_BITS, INVALID_ARG, "Nucleus needs %d bits, max is %d!\n", needed, BIGNUM_MAX_BITS);
+
+        bignum_resize(&nucleus -> x, bignum_size_for_bits(needed));
+        bignum_resize(&nucleus -> y, bignum_size_for_bits(needed));
+    }
+
+    printf("Nucleus precision did not settle!\n");
+    return INVALID_FORMAT;
+}
+
+
+static ComplexExp complexexp_mul(ComplexExp a, ComplexExp b) {
+    return {
+        floatexp_sub(floatexp_mul(a.re, b.re), floatexp_mul(a.im, b.im)),
+        floatexp_add(floatexp_mul(a.re, b.im), floatexp_mul(a.im, b.re))
+    };
+}
+
+
+static ComplexExp complexexp_div(ComplexExp a, ComplexExp b) {
+    FloatExp norm = complexexp_norm(b);
+
+    return {
+        floatexp_div(floatexp_add(floatexp_mul(a.re, b.re), floatexp_mul(a.im, b.im)), norm),
+        floatexp_div(floatexp_sub(floatexp_mul(a.im, b.re), floatexp_mul(a.re, b.im)), norm)
+    };
+}
+
+
+static ComplexExp complexexp_derivative_step(ComplexExp z, ComplexExp d) {
+    ComplexExp res = complexexp_mul(z, d);
+
+    res.re = floatexp_add(floatexp_mul_double(res.re, 2), floatexp_from_double(1));
+    res.im = floatexp_mul_double(res.im, 2);
+
+    return res;
+}
+
+
+static FloatExp complexexp_norm(ComplexExp a) {
+    return floatexp_add(floatexp_mul(a.re, a.re), floatexp_mul(a.im, a.im));
+}
+
+
+static bool floatexp_less(FloatExp a, FloatExp b) {
+    return floatexp_sub(a, b).mantissa < 0;
+}
+
+
+static int newton_step(const BigNum *cx, const BigNum *cy, int period, ComplexExp *step) {
+    static thread_local BigNum x = {}, y = {};
+    bignum_zero(&x, cx -> size);
+    bignum_zero(&y, cx -> size);
+
+    ComplexExp dz = {};
+
+    for (int n = 0; n < period; n++) {
+        ComplexExp z = {bignum_to_floatexp(&x), bignum_to_floatexp(&y)};
+        dz = complexexp_derivative_step(z, dz);
+
+        double norm = bignum_mandel_step(&x, &y, cx, cy);
+        ASSERT(norm < 16, INVALID_FORMAT, "Newton iteration escaped at %d of period %d!\n", n, period);
+    }
+
+    ASSERT(!floatexp_is_zero(complexexp_norm(dz)), INVALID_FORMAT, "Zero derivative in Newton iteration!\n");
+
+    ComplexExp z = {bignum_to_floatexp(&x), bignum_to_floatexp(&y)};
+    *step = complexexp_div(z, dz);
+
+    return OK;
+}
+
+
+static int lowest_period(const BigNum *cx, const BigNum *cy, int period, int bits) {
+    static thread_local BigNum x = {}, y = {};
+    bignum_zero(&x, cx -> size);
+    bignum_zero(&y, cx -> size);
+
+    for (int n = 1; n < period; n++) {
+        bignum_mandel_step(&x, &y, cx, cy);
+
+        if (period % n) continue;
+
+        FloatExp norm = complexexp_norm({bignum_to_floatexp(&x), bignum_to_floatexp(&y)});
+        if (floatexp_is_zero(norm) || 0.5 * floatexp_log2(norm) < NUCLEUS_STEP_GUARD_BITS - bits) return n;
+    }
+
+    return period;
+}
+
+
+static FloatExp estimate_size(const BigNum *cx, const BigNum *cy, int period) {
+    static thread_local BigNum x = {}, y = {};
+    bignum_zero(&x, cx -> size);
+    bignum_zero(&y, cx -> size);
+
+    const ComplexExp one = {floatexp_from_double(1), {}};
+    ComplexExp l = one, b = one;
+
+    for (int n = 1; n < period; n++) {
+        bignum_mandel_step(&x, &y, cx, cy);
+
+        ComplexExp z = {bignum_to_floatexp(&x), bignum_to_floatexp(&y)};
+        l = complexexp_mul(z, l);
+        l.re = floatexp_mul_double(l.re, 2);
+        l.im = floatexp_mul_double(l.im, 2);
+
+        ComplexExp inv = complexexp_div(one, l);
+        b.re = floatexp_add(b.re, inv.re);
+        b.im = floatexp_add(b.im, inv.im);
+    }
+
+    FloatExp norm = complexexp_norm(complexexp_mul(b, complexexp_mul(l, l)));
+
+    // |s| = 1 / sqrt(norm), exponent is halved separately so it never leaves double range
+    int64_t half = norm.exponent / 2;
+    double mantissa = sqrt(ldexp(norm.mantissa, (int)(norm.exponent - 2 * half)));
+
+    return floatexp_make(1.0 / mantissa, -half);
+}
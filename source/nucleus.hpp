@@ -0,0 +1,48 @@
+/**
+ * \file
+ * \brief Header file for locating nuclei of hyperbolic components and minibrots
+*/
+
+#ifndef NUCLEUS_HPP
+#define NUCLEUS_HPP
+
+#include "configs.hpp"
+#include "bignum.hpp"
+#include "floatexp.hpp"
+#include "perturb.hpp"
+
+
+/// Nucleus of hyperbolic component, center of minibrot for its cardioid
+typedef struct {
+    BigNum x = {};                              ///< Nucleus x
+    BigNum y = {};                              ///< Nucleus y
+    int period = 0;                             ///< Component period
+    FloatExp size = {};                         ///< Estimated size of minibrot or atom domain
+    int steps = 0;                              ///< Total number of Newton steps
+} Nucleus;
+
+
+/**
+ * \brief Finds lowest period of component inside the view with ball method
+ * \note Disk of radius span / 2 around view center is iterated with first order bound,
+ * period is the first n where the disk contains zero
+ * \param [in]  view    View to search in, nmax limits period
+ * \param [out] period  Found period or zero if the view escapes or nothing is found
+ * \return Non zero value means error
+*/
+int nucleus_find_period(const DeepView *view, int *period);
+
+
+/**
+ * \brief Converges to nucleus of given period with Newton iteration
+ * \note Precision is raised until it is enough for the nucleus size, so result can have more limbs than x and y
+ * \param [out] nucleus Result
+ * \param [in]  x       Start point x
+ * \param [in]  y       Start point y
+ * \param [in]  period  Component period
+ * \return Non zero value means error
+*/
+int nucleus_locate(Nucleus *nucleus, const BigNum *x, const BigNum *y, int period);
+
+
+#endif
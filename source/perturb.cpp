@@ -0,0 +1,1181 @@
+/**
+ * \file
+ * \brief Source file for perturbation rendering of deep zooms
+*/
+
+#include <assert.h>
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "perturb.hpp"
+
+
+/// Walks over reference orbit points, restores them between waypoints for compressed orbit
+typedef struct {
+    const RefOrbit *orbit = nullptr;            ///< Orbit to walk
+    int n = 0;                                  ///< Current iteration number
+    int waypoint = 0;                           ///< Next waypoint index
+    double re = 0;                              ///< Real part of Z_n
+    double im = 0;                              ///< Imaginary part of Z_n
+} OrbitCursor;
+
+
+/**
+ * \brief Calculates one double precision step of reference orbit
+ * \note Compressor and cursor must use exactly the same operations to restore the same values
+*/
+static inline void orbit_restore_step(double *re, double *im, double ref_x, double ref_y);
+
+
+/**
+ * \brief Moves cursor to Z_0
+*/
+static inline void cursor_start(OrbitCursor *cursor, const RefOrbit *orbit);
+
+
+/**
+ * \brief Moves cursor to the next point
+*/
+static inline void cursor_next(OrbitCursor *cursor);
+
+
+/**
+ * \brief Appends waypoint to compressed orbit
+ * \return Non zero value means error
+*/
+static int add_waypoint(RefOrbit *orbit, int n, double re, double im);
+
+
+/**
+ * \brief Moves cursor to Z_n
+ * \note Compressed orbit is restored from the last waypoint before n
+*/
+static void cursor_seek(OrbitCursor *cursor, const RefOrbit *orbit, int n);
+
+
+/// Pixels rendered with one secondary reference, glitch cluster or resumed pixels
+typedef struct {
+    const int *pixels = nullptr;                ///< Pixel indices of the group
+    int count = 0;                              ///< Number of pixels
+    int reference = 0;                          ///< Pixel index used as secondary reference
+} PixelGroup;
+
+
+/// Pixels rendered with one reference orbit by lane kernels
+typedef struct {
+    const RefOrbit *orbit = nullptr;            ///< Reference orbit
+    int reference = PERTURB_REF_CENTER;         ///< Reference id stored into resume state
+    const int *pixels = nullptr;                ///< Pixel indices or null for consecutive pixels
+    int begin = 0;                              ///< First pixel (or first element of pixels)
+    int count = 0;                              ///< Number of pixels
+    int start = 1;                              ///< First iteration, greater values continue pixels from resume state
+} LaneBatch;
+
+
+/// Arguments of parallel rendering tasks
+typedef struct {
+    const DeepView *view = nullptr;             ///< Rendered view
+    const RefOrbit *orbit = nullptr;            ///< Main reference orbit
+    PerturbTier tier = TIER_DOUBLE;             ///< Delta precision tier
+    int *iters = nullptr;                       ///< Iteration numbers of the view
+    PerturbResume *resume = nullptr;            ///< State of pixels that reached the limit, can be null
+    const int *pixels = nullptr;                ///< Pixels rendered with main reference in chunks
+    int pixels_count = 0;                       ///< Number of pixels rendered in chunks
+    const PixelGroup *groups = nullptr;         ///< Pixel groups with secondary references
+    int start = 1;                              ///< First iteration of pixels
+    std::atomic<bool> failed = {};              ///< Some secondary orbit was not created, set by concurrent tasks
+    PerturbControl *control = nullptr;          ///< Progress and cancel flag, can be null
+} RenderTaskArgs;
+
+
+/// Resumed pixel and its reference for sorting
+typedef struct {
+    int reference = 0;                          ///< Reference id
+    int pixel = 0;                              ///< Pixel index
+} ResumePixel;
+
+
+/**
+ * \brief Renders lanes batch with the tier kernel
+*/
+static void perturb_batch(const LaneBatch *batch, const DeepView *view, PerturbTier tier, int *iters, PerturbResume *resume);
+
+
+/**
+ * \brief Calculates pixels with plain double deltas
+*/
+static void perturb_lanes_double(const LaneBatch *batch, const DeepView *view, int *iters, PerturbResume *resume);
+
+
+/**
+ * \brief Calculates pixels with rescaled deltas, so they do not underflow
+ * \note Delta is stored as d * 2^e, so delta^2 term is d^2 * 2^e and dc term is dc * 2^(ec - e) in units of 2^e.
+ * Both factors are recalculated only when d is rescaled
+*/
+static void perturb_lanes_floatexp(const LaneBatch *batch, const DeepView *view, int *iters, PerturbResume *resume);
+
+
+/**
+ * \brief Returns true if render was cancelled
+*/
+static bool is_cancelled(const RenderTaskArgs *args);
+
+
+/**
+ * \brief Adds rendered pixels to progress
+*/
+static void add_progress(const RenderTaskArgs *args, int count);
+
+
+/**
+ * \brief Renders PERTURB_BAND_ROWS rows with main reference
+*/
+static void render_band_task(void *arg, int index);
+
+
+/**
+ * \brief Renders PERTURB_RESUME_CHUNK listed pixels with main reference
+*/
+static void render_chunk_task(void *arg, int index);
+
+
+/**
+ * \brief Calculates secondary reference of one group and renders group pixels with it
+*/
+static void render_group_task(void *arg, int index);
+
+
+/**
+ * \brief Calculates reference orbit at the pixel center
+ * \return Non zero value means error
+*/
+static int create_pixel_orbit(RefOrbit *orbit, const DeepView *view, int pixel);
+
+
+/**
+ * \brief Renders the whole view or listed pixels and fixes glitches, see perturb_render() and perturb_render_pixels()
+ * \param [in] pixels          Pixel indices rendered with main reference, null means all pixels
+ * \param [in] pixels_listed   Number of listed pixels
+*/
+static int render_view(const DeepView *view, int *iters, WorkerPool *pool, PerturbResume *resume, const int *pixels, int pixels_listed,
+                       PerturbStats *stats, PerturbControl *control);
+
+
+/**
+ * \brief Continues pixels that reached the previous limit with references they were rendered with
+ * \param [in,out] args    Task arguments with view, tier, iters and resume state
+ * \param [in,out] pool    Worker pool
+ * \param [out]    order   Buffer of width * height pixel indices
+ * \param [out]    stats   References counter is updated
+ * \return Non zero value means error
+*/
+static int resume_pixels(RenderTaskArgs *args, WorkerPool *pool, int *order, PerturbStats *stats);
+
+
+/**
+ * \brief Compares resumed pixels by reference and then by index
+*/
+static int cmp_resume_pixels(const void *a, const void *b);
+
+
+/**
+ * \brief Splits glitched pixels into 4-connected clusters sorted by size
+ * \param [in]  view        Rendered view
+ * \param [in]  iters       Iteration numbers
+ * \param [out] seen        Buffer of width * height marks
+ * \param [out] order       Buffer of width * height pixel indices, clusters pixels are stored there
+ * \param [out] clusters    Pointer to allocated clusters array
+ * \param [out] count       Number of clusters
+ * \return Non zero value means error
+*/
+static int find_clusters(const DeepView *view, const int *iters, uint8_t *seen, int *order, PixelGroup **clusters, int *count);
+
+
+/**
+ * \brief Compares clusters by size for sorting in descending order
+*/
+static int cmp_clusters(const void *a, const void *b);
+
+
+/**
+ * \brief Stores lanes results into pixels
+*/
+static void store_lanes(int *iters, const int index[4], int count, __m256i N, __m256d glitched);
+
+
+/**
+ * \brief Stores deltas of lanes that reached the limit into resume state
+*/
+static void store_resume(PerturbResume *resume, const int index[4], int count, int reference,
+                         const FloatExp re[4], const FloatExp im[4], __m256d active);
+
+
+
+
+int deep_view_parse(DeepView *view, const char *re, const char *im, const char *span) {
+    ASSERT(view, INVALID_ARG, "Can't parse into null view!\n");
+    ASSERT(re && im && span, INVALID_ARG, "Can't parse null strings!\n");
+
+    ASSERT(!floatexp_from_string(span, &view -> span), INVALID_FORMAT, "Invalid span %s!\n", span);
+    ASSERT(view -> span.mantissa > 0, INVALID_FORMAT, "Span must be positive!\n");
+
+    int bits = PERTURB_GUARD_BITS - (int) floatexp_log2(view -> span);
+    if (bits < PERTURB_GUARD_BITS) bits = PERTURB_GUARD_BITS;
+
+    int size = bignum_size_for_bits(bits);
+
+    if (bignum_from_string(&view -> center_x, re, size)) return INVALID_FORMAT;
+    if (bignum_from_string(&view -> center_y, im, size)) return INVALID_FORMAT;
+
+    return OK;
+}
+
+
+FloatExp deep_view_pixel(const DeepView *view) {
+    assert(view && "Can't get pixel size of null view!\n");
+
+    return floatexp_mul_double(view -> span, 1.0 / (double) view -> width);
+}
+
+
+PerturbTier perturb_choose_tier(const DeepView *view) {
+    assert(view && "Can't choose tier for null view!\n");
+
+    return (floatexp_log2(deep_view_pixel(view)) > PERTURB_DOUBLE_MIN_LOG2) ? TIER_DOUBLE : TIER_FLOATEXP;
+}
+
+
+FloatExp bignum_to_floatexp(const BigNum *num) {
+    assert(num && "Can't convert null number!\n");
+
+    int top = num -> size - 1;
+    for (; top >= 0 && num -> limbs[top] == 0; top--) {}
+
+    if (top < 0) return {0, 0};
+
+    double mantissa = 0;
+    for (int i = top; i >= 0 && i > top - 3; i--)
+        mantissa += ldexp((double) num -> limbs[i], 32 * (i - top));
+
+    if (num -> sign) mantissa = -mantissa;
+
+    return floatexp_make(mantissa, 32 * (int64_t)(top - num -> size + 1));
+}
+
+
+int ref_orbit_create(RefOrbit *orbit, const DeepView *view, const BigNum *ref_x, const BigNum *ref_y, OrbitStorage storage) {
+    ASSERT(orbit, INVALID_ARG, "Can't create null orbit!\n");
+    ASSERT(view && ref_x && ref_y, INVALID_ARG, "Can't create orbit without reference!\n");
+
+    if (storage == ORBIT_AUTO)
+        storage = (view -> nmax >= ORBIT_COMPRESS_MIN_LENGTH) ? ORBIT_COMPRESSED : ORBIT_FULL;
+
+    orbit -> storage = storage;
+    orbit -> ref_x = bignum_to_double(ref_x);
+    orbit -> ref_y = bignum_to_double(ref_y);
+
+    if (storage == ORBIT_FULL) {
+        size_t capacity = (size_t) view -> nmax + 1;
+
+        orbit -> re = (double *) calloc(capacity, sizeof(double));
+        orbit -> im = (double *) calloc(capacity, sizeof(double));
+
+        if (!orbit -> re || !orbit -> im) {
+            ref_orbit_free(orbit);
+
+            printf("Can't allocate reference orbit!\n");
+            return ALLOC_FAIL;
+        }
+    }
+
+    BigNum diff = {};
+    bignum_sub(&diff, ref_x, &view -> center_x);
+    orbit -> offset_x = bignum_to_floatexp(&diff);
+    bignum_sub(&diff, ref_y, &view -> center_y);
+    orbit -> offset_y = bignum_to_floatexp(&diff);
+
+    static thread_local BigNum x = {}, y = {};
+    bignum_zero(&x, ref_x -> size);
+    bignum_zero(&y, ref_x -> size);
+
+    orbit -> length = 0;
+
+    // Value that cursor restores from the previous point
+    double restored_re = 0, restored_im = 0;
+
+    for (int n = 0; n <= view -> nmax; n++) {
+        double re = bignum_to_double(&x), im = bignum_to_double(&y);
+        double norm = re * re + im * im;
+
+        if (storage == ORBIT_FULL) {
+            orbit -> re[n] = re;
+            orbit -> im[n] = im;
+        }
+        else {
+            if (n > 0) orbit_restore_step(&restored_re, &restored_im, orbit -> ref_x, orbit -> ref_y);
+
+            double err_re = restored_re - re, err_im = restored_im - im;
+            if (err_re * err_re + err_im * err_im > ORBIT_COMPRESS_TOL * ORBIT_COMPRESS_TOL * norm) {
+                if (add_waypoint(orbit, n, re, im)) {
+                    ref_orbit_free(orbit);
+                    return ALLOC_FAIL;
+                }
+
+                restored_re = re;
+                restored_im = im;
+            }
+        }
+
+        orbit -> length = n + 1;
+
+        if (norm > (double) RMAX * (double) RMAX) break;
+
+        bignum_mandel_step(&x, &y, ref_x, ref_y);
+    }
+
+    return OK;
+}
+
+
+int ref_orbit_free(RefOrbit *orbit) {
+    ASSERT(orbit, INVALID_ARG, "Pointer to orbit is null!\n");
+
+    free(orbit -> re);
+    free(orbit -> im);
+    free(orbit -> waypoints);
+
+    orbit -> re = nullptr;
+    orbit -> im = nullptr;
+    orbit -> waypoints = nullptr;
+    orbit -> waypoints_count = 0;
+    orbit -> waypoints_capacity = 0;
+    orbit -> length = 0;
+
+    return OK;
+}
+
+
+size_t ref_orbit_memory(const RefOrbit *orbit) {
+    assert(orbit && "Can't measure null orbit!\n");
+
+    if (orbit -> storage == ORBIT_FULL) return 2 * sizeof(double) * (size_t) orbit -> length;
+
+    return sizeof(OrbitWaypoint) * (size_t) orbit -> waypoints_count;
+}
+
+
+void perturb_rows(const RefOrbit *orbit, const DeepView *view, PerturbTier tier, int row_begin, int row_end, int *iters) {
+    assert(orbit && "Can't render without reference orbit!\n");
+    assert(view && "Can't render null view!\n");
+    assert(iters && "Can't render into null buffer!\n");
+
+    LaneBatch batch = {};
+    batch.orbit = orbit;
+    batch.begin = row_begin * view -> width;
+    batch.count = (row_end - row_begin) * view -> width;
+
+    perturb_batch(&batch, view, tier, iters, nullptr);
+}
+
+
+void perturb_pixels(const RefOrbit *orbit, const DeepView *view, PerturbTier tier, const int *pixels, int count, int *iters) {
+    assert(orbit && "Can't render without reference orbit!\n");
+    assert(view && "Can't render null view!\n");
+    assert(pixels && "Can't render null pixels list!\n");
+    assert(iters && "Can't render into null buffer!\n");
+
+    LaneBatch batch = {};
+    batch.orbit = orbit;
+    batch.pixels = pixels;
+    batch.count = count;
+
+    perturb_batch(&batch, view, tier, iters, nullptr);
+}
+
+
+int perturb_resume_create(PerturbResume *resume, int pixels_count) {
+    ASSERT(resume, INVALID_ARG, "Can't create null resume state!\n");
+    ASSERT(pixels_count > 0, INVALID_ARG, "Invalid pixels count!\n");
+
+    resume -> nmax = 0;
+    resume -> delta_re = (FloatExp *) calloc((size_t) pixels_count, sizeof(FloatExp));
+    resume -> delta_im = (FloatExp *) calloc((size_t) pixels_count, sizeof(FloatExp));
+    resume -> reference = (int *) calloc((size_t) pixels_count, sizeof(int));
+
+    if (!resume -> delta_re || !resume -> delta_im || !resume -> reference) {
+        perturb_resume_free(resume);
+
+        printf("Can't allocate resume state!\n");
+        return ALLOC_FAIL;
+    }
+
+    return OK;
+}
+
+
+int perturb_resume_free(PerturbResume *resume) {
+    ASSERT(resume, INVALID_ARG, "Can't free null resume state!\n");
+
+    free(resume -> delta_re);
+    free(resume -> delta_im);
+    free(resume -> reference);
+
+    resume -> delta_re = nullptr;
+    resume -> delta_im = nullptr;
+    resume -> reference = nullptr;
+    resume -> nmax = 0;
+
+    return OK;
+}
+
+
+int perturb_render(const DeepView *view, int *iters, WorkerPool *pool, PerturbResume *resume, PerturbStats *stats,
+                   PerturbControl *control) {
+    return render_view(view, iters, pool, resume, nullptr, 0, stats, control);
+}
+
+
+int perturb_render_pixels(const DeepView *view, int *iters, WorkerPool *pool, const int *pixels, int count,
+                          PerturbStats *stats, PerturbControl *control) {
+    ASSERT(pixels || count == 0, INVALID_ARG, "Can't render null pixels list!\n");
+
+    return render_view(view, iters, pool, nullptr, pixels, count, stats, control);
+}
+
+
+static int render_view(const DeepView *view, int *iters, WorkerPool *pool, PerturbResume *resume, const int *pixels, int pixels_listed,
+                       PerturbStats *stats, PerturbControl *control) {
+    ASSERT(view, INVALID_ARG, "Can't render null view!\n");
+    ASSERT(iters, INVALID_ARG, "Can't render into null buffer!\n");
+    ASSERT(pool, INVALID_ARG, "Can't render without worker pool!\n");
+
+    PerturbStats local_stats = {};
+    if (!stats) stats = &local_stats;
+    *stats = {};
+
+    size_t pixels_count = (size_t) view -> width * (size_t) view -> height;
+
+    uint8_t *seen = (uint8_t *) calloc(pixels_count, sizeof(uint8_t));
+    int *order = (int *) calloc(pixels_count, sizeof(int));
+
+    if (!seen || !order) {
+        free(seen);
+        free(order);
+
+        printf("Can't allocate glitch correction buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    RenderTaskArgs args = {};
+    args.view = view;
+    args.tier = perturb_choose_tier(view);
+    args.iters = iters;
+    args.resume = resume;
+    args.control = control;
+
+    int result = OK;
+
+    if (resume && 0 < resume -> nmax && resume -> nmax < view -> nmax) {
+        result = resume_pixels(&args, pool, order, stats);
+    }
+    else if (!pixels || pixels_listed) {
+        RefOrbit orbit = {};
+        result = ref_orbit_create(&orbit, view, &view -> center_x, &view -> center_y, ORBIT_AUTO);
+
+        if (!result) {
+            stats -> references = 1;
+
+            if (control) control -> total += pixels ? pixels_listed : (long) pixels_count;
+
+            args.orbit = &orbit;
+
+            if (pixels) {
+                args.pixels = pixels;
+                args.pixels_count = pixels_listed;
+                pool_run(pool, render_chunk_task, &args, (pixels_listed + PERTURB_RESUME_CHUNK - 1) / PERTURB_RESUME_CHUNK);
+            }
+            else pool_run(pool, render_band_task, &args, (view -> height + PERTURB_BAND_ROWS - 1) / PERTURB_BAND_ROWS);
+
+            args.orbit = nullptr;
+
+            result = ref_orbit_free(&orbit);
+        }
+    }
+
+    args.start = 1;
+
+    if (!result && is_cancelled(&args)) result = CANCELLED;
+
+    for (int round = 0; round < PERTURB_MAX_ROUNDS && !result; round++) {
+        PixelGroup *clusters = nullptr;
+        int count = 0;
+
+        result = find_clusters(view, iters, seen, order, &clusters, &count);
+        if (result) break;
+
+        if (round == 0)
+            for (int i = 0; i < count; i++) stats -> glitched += clusters[i].count;
+
+        if (count == 0) {
+            free(clusters);
+            break;
+        }
+
+        if (count > PERTURB_MAX_CLUSTERS) count = PERTURB_MAX_CLUSTERS;
+
+        if (control)
+            for (int i = 0; i < count; i++) control -> total += clusters[i].count;
+
+        // Secondary orbits are the expensive part, so every cluster is a separate task
+        args.groups = clusters;
+        pool_run(pool, render_group_task, &args, count);
+
+        free(clusters);
+
+        stats -> references += count;
+        stats -> rounds = round + 1;
+
+        if (args.failed.load()) result = ALLOC_FAIL;
+        else if (is_cancelled(&args)) result = CANCELLED;
+    }
+
+    for (size_t i = 0; i < pixels_count; i++)
+        if (iters[i] == PIXEL_GLITCHED) stats -> remaining++;
+
+    if (resume) resume -> nmax = (result) ? 0 : view -> nmax;
+
+    free(seen);
+    free(order);
+
+    return result;
+}
+
+
+static void perturb_batch(const LaneBatch *batch, const DeepView *view, PerturbTier tier, int *iters, PerturbResume *resume) {
+    if (tier == TIER_DOUBLE) perturb_lanes_double(batch, view, iters, resume);
+    else perturb_lanes_floatexp(batch, view, iters, resume);
+}
+
+
+static bool is_cancelled(const RenderTaskArgs *args) {
+    return args -> control && args -> control -> cancel.load(std::memory_order_relaxed);
+}
+
+
+static void add_progress(const RenderTaskArgs *args, int count) {
+    if (args -> control) args -> control -> done.fetch_add(count, std::memory_order_relaxed);
+}
+
+
+static void render_band_task(void *arg, int index) {
+    RenderTaskArgs *args = (RenderTaskArgs *) arg;
+    if (is_cancelled(args)) return;
+
+    int row_begin = index * PERTURB_BAND_ROWS;
+    int row_end = row_begin + PERTURB_BAND_ROWS;
+    if (row_end > args -> view -> height) row_end = args -> view -> height;
+
+    LaneBatch batch = {};
+    batch.orbit = args -> orbit;
+    batch.begin = row_begin * args -> view -> width;
+    batch.count = (row_end - row_begin) * args -> view -> width;
+
+    perturb_batch(&batch, args -> view, args -> tier, args -> iters, args -> resume);
+    add_progress(args, batch.count);
+}
+
+
+static void render_chunk_task(void *arg, int index) {
+    RenderTaskArgs *args = (RenderTaskArgs *) arg;
+    if (is_cancelled(args)) return;
+
+    LaneBatch batch = {};
+    batch.orbit = args -> orbit;
+    batch.pixels = args -> pixels;
+    batch.begin = index * PERTURB_RESUME_CHUNK;
+    batch.count = args -> pixels_count - batch.begin;
+    batch.start = args -> start;
+
+    if (batch.count > PERTURB_RESUME_CHUNK) batch.count = PERTURB_RESUME_CHUNK;
+
+    perturb_batch(&batch, args -> view, args -> tier, args -> iters, args -> resume);
+    add_progress(args, batch.count);
+}
+
+
+static void render_group_task(void *arg, int index) {
+    RenderTaskArgs *args = (RenderTaskArgs *) arg;
+    const PixelGroup *group = args -> groups + index;
+
+    if (is_cancelled(args)) return;
+
+    RefOrbit orbit = {};
+    if (create_pixel_orbit(&orbit, args -> view, group -> reference)) {
+        args -> failed.store(true);
+        return;
+    }
+
+    LaneBatch batch = {};
+    batch.orbit = &orbit;
+    batch.reference = group -> reference;
+    batch.pixels = group -> pixels;
+    batch.count = group -> count;
+    batch.start = args -> start;
+
+    perturb_batch(&batch, args -> view, args -> tier, args -> iters, args -> resume);
+    add_progress(args, batch.count);
+
+    ref_orbit_free(&orbit);
+}
+
+
+static int create_pixel_orbit(RefOrbit *orbit, const DeepView *view, int pixel) {
+    const FloatExp pixel_size = deep_view_pixel(view);
+    const int size = view -> center_x.size;
+
+    int x = pixel % view -> width, y = pixel / view -> width;
+
+    FloatExp off_x = floatexp_mul_double(pixel_size, (double) x - 0.5 * (double) view -> width);
+    FloatExp off_y = floatexp_mul_double(pixel_size, (double) y - 0.5 * (double) view -> height);
+
+    static thread_local BigNum ref_x = {}, ref_y = {};
+
+    bignum_set_double_exp(&ref_x, off_x.mantissa, off_x.exponent, size);
+    bignum_add(&ref_x, &ref_x, &view -> center_x);
+    bignum_set_double_exp(&ref_y, off_y.mantissa, off_y.exponent, size);
+    bignum_add(&ref_y, &ref_y, &view -> center_y);
+
+    return ref_orbit_create(orbit, view, &ref_x, &ref_y, ORBIT_AUTO);
+}
+
+
+static int resume_pixels(RenderTaskArgs *args, WorkerPool *pool, int *order, PerturbStats *stats) {
+    const DeepView *view = args -> view;
+    const PerturbResume *resume = args -> resume;
+    const int pixels_count = view -> width * view -> height;
+
+    int count = 0;
+    for (int i = 0; i < pixels_count; i++)
+        if (args -> iters[i] == resume -> nmax) count++;
+
+    stats -> resumed = count;
+    if (count == 0) return OK;
+
+    if (args -> control) args -> control -> total += count;
+
+    ResumePixel *sorted = (ResumePixel *) calloc((size_t) count, sizeof(ResumePixel));
+    ASSERT(sorted, ALLOC_FAIL, "Can't allocate resumed pixels!\n");
+
+    for (int i = 0, j = 0; i < pixels_count; i++)
+        if (args -> iters[i] == resume -> nmax) sorted[j++] = {resume -> reference[i], i};
+
+    // Center reference has the lowest id, so its pixels come first
+    qsort(sorted, (size_t) count, sizeof(ResumePixel), cmp_resume_pixels);
+
+    for (int i = 0; i < count; i++) order[i] = sorted[i].pixel;
+
+    int center_count = 0;
+    for (; center_count < count && sorted[center_count].reference == PERTURB_REF_CENTER; center_count++) {}
+
+    int groups_count = 0;
+    for (int i = center_count; i < count; i++)
+        if (i == center_count || sorted[i].reference != sorted[i - 1].reference) groups_count++;
+
+    PixelGroup *groups = (PixelGroup *) calloc((size_t) groups_count + 1, sizeof(PixelGroup));
+    if (!groups) {
+        free(sorted);
+
+        printf("Can't allocate resumed pixel groups!\n");
+        return ALLOC_FAIL;
+    }
+
+    for (int i = center_count, group = -1; i < count; i++) {
+        if (i == center_count || sorted[i].reference != sorted[i - 1].reference) {
+            groups[++group] = {order + i, 0, sorted[i].reference};
+        }
+
+        groups[group].count++;
+    }
+
+    free(sorted);
+
+    args -> start = resume -> nmax + 1;
+
+    int result = OK;
+
+    if (center_count) {
+        RefOrbit orbit = {};
+        result = ref_orbit_create(&orbit, view, &view -> center_x, &view -> center_y, ORBIT_AUTO);
+
+        if (!result) {
+            args -> orbit = &orbit;
+            args -> pixels = order;
+            args -> pixels_count = center_count;
+
+            pool_run(pool, render_chunk_task, args, (center_count + PERTURB_RESUME_CHUNK - 1) / PERTURB_RESUME_CHUNK);
+
+            args -> orbit = nullptr;
+            stats -> references++;
+
+            result = ref_orbit_free(&orbit);
+        }
+    }
+
+    if (!result && is_cancelled(args)) result = CANCELLED;
+
+    if (!result && groups_count) {
+        args -> groups = groups;
+        pool_run(pool, render_group_task, args, groups_count);
+
+        stats -> references += groups_count;
+
+        if (args -> failed.load()) result = ALLOC_FAIL;
+    }
+
+    free(groups);
+
+    return result;
+}
+
+
+static int cmp_resume_pixels(const void *a, const void *b) {
+    const ResumePixel *first = (const ResumePixel *) a, *second = (const ResumePixel *) b;
+
+    if (first -> reference != second -> reference) return (first -> reference < second -> reference) ? -1 : 1;
+
+    return first -> pixel - second -> pixel;
+}
+
+
+static int find_clusters(const DeepView *view, const int *iters, uint8_t *seen, int *order, PixelGroup **clusters, int *count) {
+    const int width = view -> width, height = view -> height;
+
+    memset(seen, 0, (size_t) width * (size_t) height);
+
+    int capacity = 0, used = 0;
+    *clusters = nullptr;
+    *count = 0;
+
+    for (int start = 0; start < width * height; start++) {
+        if (iters[start] != PIXEL_GLITCHED || seen[start]) continue;
+
+        // Breadth first search, order is used as queue and keeps cluster pixels after it
+        int head = used, tail = used;
+        order[tail++] = start;
+        seen[start] = 1;
+
+        double sum_x = 0, sum_y = 0;
+
+        while (head < tail) {
+            int pixel = order[head++];
+            int x = pixel % width, y = pixel / width;
+
+            sum_x += x;
+            sum_y += y;
+
+            const int neighbours[4] = {
+                (x > 0)          ? pixel - 1     : -1,
+                (x < width - 1)  ? pixel + 1     : -1,
+                (y > 0)          ? pixel - width : -1,
+                (y < height - 1) ? pixel + width : -1,
+            };
+
+            for (int i = 0; i < 4; i++) {
+                int next = neighbours[i];
+                if (next < 0 || seen[next] || iters[next] != PIXEL_GLITCHED) continue;
+
+                seen[next] = 1;
+                order[tail++] = next;
+            }
+        }
+
+        if (*count == capacity) {
+            capacity = (capacity) ? 2 * capacity : PERTURB_MAX_CLUSTERS;
+
+            PixelGroup *resized = (PixelGroup *) realloc(*clusters, (size_t) capacity * sizeof(PixelGroup));
+            if (!resized) {
+                free(*clusters);
+                *clusters = nullptr;
+
+                printf("Can't allocate glitch clusters!\n");
+                return ALLOC_FAIL;
+            }
+
+            *clusters = resized;
+        }
+
+        // Cluster pixel closest to centroid becomes reference
+        double center_x = sum_x / (tail - used), center_y = sum_y / (tail - used);
+        int reference = order[used];
+        double best = -1;
+
+        for (int i = used; i < tail; i++) {
+            double dx = order[i] % width - center_x, dy = order[i] / width - center_y;
+            double dist = dx * dx + dy * dy;
+
+            if (best < 0 || dist < best) {
+                best = dist;
+                reference = order[i];
+            }
+        }
+
+        (*clusters)[(*count)++] = {order + used, tail - used, reference};
+        used = tail;
+    }
+
+    qsort(*clusters, (size_t) *count, sizeof(PixelGroup), cmp_clusters);
+
+    return OK;
+}
+
+
+static int cmp_clusters(const void *a, const void *b) {
+    return ((const PixelGroup *) b) -> count - ((const PixelGroup *) a) -> count;
+}
+
+
+static void perturb_lanes_double(const LaneBatch *batch, const DeepView *view, int *iters, PerturbResume *resume) {
+    const RefOrbit *orbit = batch -> orbit;
+
+    const double pixel = floatexp_to_double(deep_view_pixel(view));
+    const double off_x = floatexp_to_double(orbit -> offset_x);
+    const double off_y = floatexp_to_double(orbit -> offset_y);
+
+    const double half_w = 0.5 * (double) view -> width;
+    const double half_h = 0.5 * (double) view -> height;
+
+    const __m256d bailout = _mm256_set1_pd((double) RMAX * (double) RMAX);
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    for (int i = 0; i < batch -> count; i += 4) {
+        int index[4] = {};
+        double lanes_x[4] = {}, lanes_y[4] = {}, start_x[4] = {}, start_y[4] = {};
+
+        // Missing lanes of the last group repeat its last pixel
+        for (int lane = 0; lane < 4; lane++) {
+            int pos = batch -> begin + i + ((i + lane < batch -> count) ? lane : batch -> count - i - 1);
+            index[lane] = (batch -> pixels) ? batch -> pixels[pos] : pos;
+
+            lanes_x[lane] = ((double)(index[lane] % view -> width) - half_w) * pixel - off_x;
+            lanes_y[lane] = ((double)(index[lane] / view -> width) - half_h) * pixel - off_y;
+
+            start_x[lane] = (batch -> start > 1) ? floatexp_to_double(resume -> delta_re[index[lane]]) : lanes_x[lane];
+            start_y[lane] = (batch -> start > 1) ? floatexp_to_double(resume -> delta_im[index[lane]]) : lanes_y[lane];
+        }
+
+        const __m256d dcx = _mm256_loadu_pd(lanes_x);
+        const __m256d dcy = _mm256_loadu_pd(lanes_y);
+
+        __m256d dx = _mm256_loadu_pd(start_x), dy = _mm256_loadu_pd(start_y);
+        __m256d active = all, glitched = _mm256_setzero_pd();
+        __m256i N = _mm256_set1_epi64x(batch -> start - 1);
+
+        OrbitCursor cursor = {};
+        cursor_seek(&cursor, orbit, batch -> start);
+
+        for (int n = batch -> start;; n++) {
+            if (n >= orbit -> length) {
+                glitched = _mm256_or_pd(glitched, active);
+                break;
+            }
+
+            __m256d Zr = _mm256_set1_pd(cursor.re);
+            __m256d Zi = _mm256_set1_pd(cursor.im);
+            __m256d tolerance = _mm256_set1_pd(PERTURB_GLITCH_TOL * (cursor.re * cursor.re + cursor.im * cursor.im));
+
+            __m256d zr = _mm256_add_pd(Zr, dx);
+            __m256d zi = _mm256_add_pd(Zi, dy);
+            __m256d norm = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+
+            active = _mm256_and_pd(active, _mm256_cmp_pd(norm, bailout, _CMP_LT_OQ));
+
+            __m256d glitch = _mm256_and_pd(active, _mm256_cmp_pd(norm, tolerance, _CMP_LT_OQ));
+            glitched = _mm256_or_pd(glitched, glitch);
+            active = _mm256_andnot_pd(glitch, active);
+
+            N = _mm256_sub_epi64(N, _mm256_castpd_si256(active));
+
+            if (_mm256_testz_pd(active, active)) break;
+
+            // delta = 2 * Z * delta + delta^2 + dc
+            __m256d new_dx = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_sub_pd(_mm256_mul_pd(Zr, dx), _mm256_mul_pd(Zi, dy))),
+                _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), dcx)
+            );
+            __m256d new_dy = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(Zr, dy), _mm256_mul_pd(Zi, dx)), _mm256_mul_pd(dx, dy))),
+                dcy
+            );
+
+            // Delta of the next iteration is kept, so higher limit continues right from it
+            if (n == view -> nmax) {
+                if (resume) {
+                    double lanes_re[4] = {}, lanes_im[4] = {};
+                    _mm256_storeu_pd(lanes_re, new_dx);
+                    _mm256_storeu_pd(lanes_im, new_dy);
+
+                    FloatExp re[4] = {}, im[4] = {};
+                    for (int lane = 0; lane < 4; lane++) {
+                        re[lane] = floatexp_from_double(lanes_re[lane]);
+                        im[lane] = floatexp_from_double(lanes_im[lane]);
+                    }
+
+                    store_resume(resume, index, batch -> count - i, batch -> reference, re, im, active);
+                }
+
+                break;
+            }
+
+            dx = new_dx;
+            dy = new_dy;
+
+            cursor_next(&cursor);
+        }
+
+        store_lanes(iters, index, batch -> count - i, N, glitched);
+    }
+}
+
+
+static void perturb_lanes_floatexp(const LaneBatch *batch, const DeepView *view, int *iters, PerturbResume *resume) {
+    const RefOrbit *orbit = batch -> orbit;
+
+    const FloatExp pixel = deep_view_pixel(view);
+    const double half_w = 0.5 * (double) view -> width;
+    const double half_h = 0.5 * (double) view -> height;
+
+    const __m256d bailout = _mm256_set1_pd((double) RMAX * (double) RMAX);
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    for (int i = 0; i < batch -> count; i += 4) {
+        int index[4] = {};
+        FloatExp lanes_x[4] = {}, lanes_y[4] = {}, start_x[4] = {}, start_y[4] = {};
+
+        for (int lane = 0; lane < 4; lane++) {
+            int pos = batch -> begin + i + ((i + lane < batch -> count) ? lane : batch -> count - i - 1);
+            index[lane] = (batch -> pixels) ? batch -> pixels[pos] : pos;
+
+            double x = (double)(index[lane] % view -> width) - half_w;
+            double y = (double)(index[lane] / view -> width) - half_h;
+
+            lanes_x[lane] = floatexp_sub(floatexp_mul_double(pixel, x), orbit -> offset_x);
+            lanes_y[lane] = floatexp_sub(floatexp_mul_double(pixel, y), orbit -> offset_y);
+
+            start_x[lane] = (batch -> start > 1) ? resume -> delta_re[index[lane]] : lanes_x[lane];
+            start_y[lane] = (batch -> start > 1) ? resume -> delta_im[index[lane]] : lanes_y[lane];
+        }
+
+        const ComplexExpVec dc = complexexp_vec_load(lanes_x, lanes_y);
+        ComplexExpVec delta = complexexp_vec_load(start_x, start_y);
+
+        __m256d scale = floatexp_vec_exp2(delta.exponent);
+        __m256d dc_scale = floatexp_vec_exp2(_mm256_sub_epi64(dc.exponent, delta.exponent));
+
+        __m256d active = all, glitched = _mm256_setzero_pd();
+        __m256i N = _mm256_set1_epi64x(batch -> start - 1);
+
+        OrbitCursor cursor = {};
+        cursor_seek(&cursor, orbit, batch -> start);
+
+        for (int n = batch -> start;; n++) {
+            if (n >= orbit -> length) {
+                glitched = _mm256_or_pd(glitched, active);
+                break;
+            }
+
+            __m256d Zr = _mm256_set1_pd(cursor.re);
+            __m256d Zi = _mm256_set1_pd(cursor.im);
+            __m256d tolerance = _mm256_set1_pd(PERTURB_GLITCH_TOL * (cursor.re * cursor.re + cursor.im * cursor.im));
+
+            __m256d zr = _mm256_add_pd(Zr, _mm256_mul_pd(delta.re, scale));
+            __m256d zi = _mm256_add_pd(Zi, _mm256_mul_pd(delta.im, scale));
+            __m256d norm = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+
+            active = _mm256_and_pd(active, _mm256_cmp_pd(norm, bailout, _CMP_LT_OQ));
+
+            __m256d glitch = _mm256_and_pd(active, _mm256_cmp_pd(norm, tolerance, _CMP_LT_OQ));
+            glitched = _mm256_or_pd(glitched, glitch);
+            active = _mm256_andnot_pd(glitch, active);
+
+            N = _mm256_sub_epi64(N, _mm256_castpd_si256(active));
+
+            if (_mm256_testz_pd(active, active)) break;
+
+            __m256d dx = delta.re, dy = delta.im;
+
+            // d = 2 * Z * d + d^2 * 2^e + dc * 2^(ec - e)
+            __m256d new_dx = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_sub_pd(_mm256_mul_pd(Zr, dx), _mm256_mul_pd(Zi, dy))),
+                _mm256_add_pd(
+                    _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), scale),
+                    _mm256_mul_pd(dc.re, dc_scale)
+                )
+            );
+            __m256d new_dy = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_add_pd(
+                    _mm256_add_pd(_mm256_mul_pd(Zr, dy), _mm256_mul_pd(Zi, dx)),
+                    _mm256_mul_pd(_mm256_mul_pd(dx, dy), scale)
+                )),
+                _mm256_mul_pd(dc.im, dc_scale)
+            );
+
+            if (n == view -> nmax) {
+                if (resume) {
+                    double lanes_re[4] = {}, lanes_im[4] = {};
+                    int64_t lanes_exp[4] = {};
+
+                    _mm256_storeu_pd(lanes_re, new_dx);
+                    _mm256_storeu_pd(lanes_im, new_dy);
+                    _mm256_storeu_si256((__m256i *) lanes_exp, delta.exponent);
+
+                    FloatExp re[4] = {}, im[4] = {};
+                    for (int lane = 0; lane < 4; lane++) {
+                        re[lane] = floatexp_make(lanes_re[lane], lanes_exp[lane]);
+                        im[lane] = floatexp_make(lanes_im[lane], lanes_exp[lane]);
+                    }
+
+                    store_resume(resume, index, batch -> count - i, batch -> reference, re, im, active);
+                }
+
+                break;
+            }
+
+            // Finished lanes are zeroed, so they never trigger rescaling
+            delta.re = _mm256_and_pd(new_dx, active);
+            delta.im = _mm256_and_pd(new_dy, active);
+
+            if (complexexp_vec_rescale(&delta)) {
+                scale = floatexp_vec_exp2(delta.exponent);
+                dc_scale = floatexp_vec_exp2(_mm256_sub_epi64(dc.exponent, delta.exponent));
+            }
+
+            cursor_next(&cursor);
+        }
+
+        store_lanes(iters, index, batch -> count - i, N, glitched);
+    }
+}
+
+
+static inline void orbit_restore_step(double *re, double *im, double ref_x, double ref_y) {
+    double new_re = (*re) * (*re) - (*im) * (*im) + ref_x;
+    double new_im = 2 * (*re) * (*im) + ref_y;
+
+    *re = new_re;
+    *im = new_im;
+}
+
+
+static inline void cursor_start(OrbitCursor *cursor, const RefOrbit *orbit) {
+    cursor -> orbit = orbit;
+    cursor -> n = 0;
+    cursor -> waypoint = 0;
+    cursor -> re = 0;
+    cursor -> im = 0;
+
+    if (orbit -> storage == ORBIT_FULL) {
+        cursor -> re = orbit -> re[0];
+        cursor -> im = orbit -> im[0];
+    }
+    else if (orbit -> waypoints_count && orbit -> waypoints[0].n == 0) {
+        cursor -> re = orbit -> waypoints[0].re;
+        cursor -> im = orbit -> waypoints[0].im;
+        cursor -> waypoint = 1;
+    }
+}
+
+
+static inline void cursor_next(OrbitCursor *cursor) {
+    const RefOrbit *orbit = cursor -> orbit;
+    int n = ++cursor -> n;
+
+    if (n >= orbit -> length) return;
+
+    if (orbit -> storage == ORBIT_FULL) {
+        cursor -> re = orbit -> re[n];
+        cursor -> im = orbit -> im[n];
+    }
+    else if (cursor -> waypoint < orbit -> waypoints_count && orbit -> waypoints[cursor -> waypoint].n == n) {
+        cursor -> re = orbit -> waypoints[cursor -> waypoint].re;
+        cursor -> im = orbit -> waypoints[cursor -> waypoint].im;
+        cursor -> waypoint++;
+    }
+    else orbit_restore_step(&cursor -> re, &cursor -> im, orbit -> ref_x, orbit -> ref_y);
+}
+
+
+static void cursor_seek(OrbitCursor *cursor, const RefOrbit *orbit, int n) {
+    cursor_start(cursor, orbit);
+
+    if (orbit -> storage == ORBIT_COMPRESSED) {
+        // Last waypoint not after n, restoring from it gives the same values as walking from Z_0
+        int left = 0, right = orbit -> waypoints_count;
+        while (right - left > 1) {
+            int middle = (left + right) / 2;
+
+            if (orbit -> waypoints[middle].n <= n) left = middle;
+            else right = middle;
+        }
+
+        if (left < orbit -> waypoints_count && orbit -> waypoints[left].n <= n) {
+            cursor -> n = orbit -> waypoints[left].n;
+            cursor -> re = orbit -> waypoints[left].re;
+            cursor -> im = orbit -> waypoints[left].im;
+            cursor -> waypoint = left + 1;
+        }
+    }
+    else if (n < orbit -> length) {
+        cursor -> n = n - 1;
+    }
+
+    while (cursor -> n < n) cursor_next(cursor);
+}
+
+
+static int add_waypoint(RefOrbit *orbit, int n, double re, double im) {
+    if (orbit -> waypoints_count == orbit -> waypoints_capacity) {
+        int capacity = (orbit -> waypoints_capacity) ? 2 * orbit -> waypoints_capacity : ORBIT_WAYPOINTS_MIN_CAPACITY;
+
+        OrbitWaypoint *waypoints = (OrbitWaypoint *) realloc(orbit -> waypoints, (size_t) capacity * sizeof(OrbitWaypoint));
+        ASSERT(waypoints, ALLOC_FAIL, "Can't allocate orbit waypoints!\n");
+
+        orbit -> waypoints = waypoints;
+        orbit -> waypoints_capacity = capacity;
+    }
+
+    orbit -> waypoints[orbit -> waypoints_count++] = {n, re, im};
+
+    return OK;
+}
+
+
+static void store_lanes(int *iters, const int index[4], int count, __m256i N, __m256d glitched) {
+    int64_t lanes_n[4] = {}, lanes_glitched[4] = {};
+
+    _mm256_storeu_si256((__m256i *) lanes_n, N);
+    _mm256_storeu_si256((__m256i *) lanes_glitched, _mm256_castpd_si256(glitched));
+
+    if (count > 4) count = 4;
+
+    for (int i = 0; i < count; i++)
+        iters[index[i]] = (lanes_glitched[i]) ? PIXEL_GLITCHED : (int) lanes_n[i];
+}
+
+
+static void store_resume(PerturbResume *resume, const int index[4], int count, int reference,
+                         const FloatExp re[4], const FloatExp im[4], __m256d active) {
+    int64_t lanes_active[4] = {};
+    _mm256_storeu_si256((__m256i *) lanes_active, _mm256_castpd_si256(active));
+
+    if (count > 4) count = 4;
+
+    for (int i = 0; i < count; i++) {
+        if (!lanes_active[i]) continue;
+
+        resume -> delta_re[index[i]] = re[i];
+        resume -> delta_im[index[i]] = im[i];
+        resume -> reference[index[i]] = reference;
+    }
+}
@@ -0,0 +1,227 @@
+/**
+ * \file
+ * \brief Header file for perturbation rendering of deep zooms
+*/
+
+#ifndef PERTURB_HPP
+#define PERTURB_HPP
+
+#include <atomic>
+#include "configs.hpp"
+#include "bignum.hpp"
+#include "floatexp.hpp"
+#include "pool.hpp"
+
+
+const int PIXEL_GLITCHED = -1;                  ///< Iteration number of pixel that needs another reference
+const int PERTURB_REF_CENTER = -1;              ///< Reference id of view center in resume state
+
+
+/// Deep zoom view described with arbitrary precision center
+typedef struct {
+    BigNum center_x = {};                       ///< Center x
+    BigNum center_y = {};                       ///< Center y
+    FloatExp span = {};                         ///< View width in set coordinates
+    int width = 0;                              ///< Width in pixels
+    int height = 0;                             ///< Height in pixels
+    int nmax = NMAX;                            ///< Max iteration number
+} DeepView;
+
+
+/// Reference orbit storage modes
+typedef enum {
+    ORBIT_AUTO          = 0,        ///< Compressed for long orbits, full otherwise
+    ORBIT_FULL          = 1,        ///< Every Z_n is stored as two doubles
+    ORBIT_COMPRESSED    = 2,        ///< Z_n is restored with double iteration between stored waypoints
+} OrbitStorage;
+
+
+/// Point where compressed orbit is reset to the arbitrary precision value
+typedef struct {
+    int n = 0;                                  ///< Iteration number
+    double re = 0;                              ///< Real part of Z_n
+    double im = 0;                              ///< Imaginary part of Z_n
+} OrbitWaypoint;
+
+
+/// Reference orbit calculated with arbitrary precision and rounded to doubles
+typedef struct {
+    OrbitStorage storage = ORBIT_FULL;          ///< Storage mode, never ORBIT_AUTO after creation
+    double *re = nullptr;                       ///< Real parts of Z_n in full storage
+    double *im = nullptr;                       ///< Imaginary parts of Z_n in full storage
+    OrbitWaypoint *waypoints = nullptr;         ///< Waypoints in compressed storage
+    int waypoints_count = 0;                    ///< Number of waypoints
+    int waypoints_capacity = 0;                 ///< Allocated waypoints
+    double ref_x = 0;                           ///< Reference x rounded to double to restore compressed orbit
+    double ref_y = 0;                           ///< Reference y rounded to double to restore compressed orbit
+    int length = 0;                             ///< Number of points Z_0 ... Z_{length - 1}
+    FloatExp offset_x = {};                     ///< Reference x minus view center x
+    FloatExp offset_y = {};                     ///< Reference y minus view center y
+} RefOrbit;
+
+
+/// Delta iteration precision tiers
+typedef enum {
+    TIER_DOUBLE         = 0,        ///< Deltas are plain doubles
+    TIER_FLOATEXP       = 1,        ///< Deltas are rescaled doubles with extended exponent
+} PerturbTier;
+
+
+/// Glitch correction results of one render
+typedef struct {
+    int references = 0;                         ///< Number of calculated reference orbits
+    int rounds = 0;                             ///< Number of glitch correction rounds
+    int glitched = 0;                           ///< Number of pixels glitched with main reference
+    int remaining = 0;                          ///< Number of pixels left glitched
+    int resumed = 0;                            ///< Number of pixels continued from resume state
+} PerturbStats;
+
+
+/// Delta iteration state of pixels that reached the limit, lets the same view continue with higher limit
+typedef struct {
+    int nmax = 0;                               ///< Limit the state was calculated with, zero means no state
+    FloatExp *delta_re = nullptr;               ///< Delta real part for the iteration after the limit
+    FloatExp *delta_im = nullptr;               ///< Delta imaginary part for the iteration after the limit
+    int *reference = nullptr;                   ///< PERTURB_REF_CENTER or index of pixel used as reference
+} PerturbResume;
+
+
+/// Progress and cancellation of one render shared with other threads
+typedef struct {
+    std::atomic<long> done = {};                ///< Number of rendered pixels, glitched pixels are counted again
+    std::atomic<long> total = {};               ///< Number of pixels known to be rendered
+    std::atomic<bool> cancel = {};              ///< Render stops at the next band or group when set
+} PerturbControl;
+
+
+/**
+ * \brief Parses view center and span and chooses enough precision for them
+ * \param [out] view    View to fill
+ * \param [in]  re      Center x as decimal string
+ * \param [in]  im      Center y as decimal string
+ * \param [in]  span    View width like "1e-500"
+ * \return Non zero value means error
+*/
+int deep_view_parse(DeepView *view, const char *re, const char *im, const char *span);
+
+
+/**
+ * \brief Returns pixel size of the view
+*/
+FloatExp deep_view_pixel(const DeepView *view);
+
+
+/**
+ * \brief Chooses the cheapest tier that can represent view deltas
+*/
+PerturbTier perturb_choose_tier(const DeepView *view);
+
+
+/**
+ * \brief Converts number into extended exponent double, lower bits are truncated
+*/
+FloatExp bignum_to_floatexp(const BigNum *num);
+
+
+/**
+ * \brief Calculates reference orbit with arbitrary precision
+ * \param [out] orbit       Orbit to allocate and fill
+ * \param [in]  view        View the orbit belongs to
+ * \param [in]  ref_x       Reference point x
+ * \param [in]  ref_y       Reference point y
+ * \param [in]  storage     Storage mode
+ * \return Non zero value means error
+*/
+int ref_orbit_create(RefOrbit *orbit, const DeepView *view, const BigNum *ref_x, const BigNum *ref_y, OrbitStorage storage);
+
+
+/**
+ * \brief Returns number of bytes used by orbit points
+*/
+size_t ref_orbit_memory(const RefOrbit *orbit);
+
+
+/**
+ * \brief Free reference orbit buffers
+ * \param [out] orbit Orbit to free
+ * \return Non zero value means error
+*/
+int ref_orbit_free(RefOrbit *orbit);
+
+
+/**
+ * \brief Calculates iteration numbers for view rows with delta iteration against reference orbit
+ * \param [in]  orbit       Reference orbit
+ * \param [in]  view        Rendered view
+ * \param [in]  tier        Delta precision tier
+ * \param [in]  row_begin   First row to render
+ * \param [in]  row_end     Row after the last row to render
+ * \param [out] iters       Iteration numbers of the whole view, glitched pixels get PIXEL_GLITCHED
+*/
+void perturb_rows(const RefOrbit *orbit, const DeepView *view, PerturbTier tier, int row_begin, int row_end, int *iters);
+
+
+/**
+ * \brief Calculates iteration numbers for listed pixels with delta iteration against reference orbit
+ * \param [in]  orbit   Reference orbit
+ * \param [in]  view    Rendered view
+ * \param [in]  tier    Delta precision tier
+ * \param [in]  pixels  Pixel indices
+ * \param [in]  count   Number of pixels
+ * \param [out] iters   Iteration numbers of the whole view, glitched pixels get PIXEL_GLITCHED
+*/
+void perturb_pixels(const RefOrbit *orbit, const DeepView *view, PerturbTier tier, const int *pixels, int count, int *iters);
+
+
+/**
+ * \brief Allocates resume state for pixels_count pixels
+ * \param [out] resume          State to allocate, it is empty after creation
+ * \param [in]  pixels_count    Number of view pixels
+ * \return Non zero value means error
+*/
+int perturb_resume_create(PerturbResume *resume, int pixels_count);
+
+
+/**
+ * \brief Free resume state buffers
+ * \param [out] resume State to free
+ * \return Non zero value means error
+*/
+int perturb_resume_free(PerturbResume *resume);
+
+
+/**
+ * \brief Renders whole view with reference orbit at view center and fixes glitches
+ * \note Glitched pixels are split into connected clusters. Every round secondary reference orbits of the
+ * largest clusters are calculated in parallel and only pixels of these clusters are rendered again.
+ * If resume state was calculated for the same view with lower limit, iters must hold its result and
+ * only pixels that reached that limit are continued with the references they were rendered with
+ * \param [in]     view    View to render
+ * \param [in,out] iters   Iteration numbers buffer of width * height
+ * \param [in,out] pool    Worker pool for rows and secondary references
+ * \param [in,out] resume  State to continue from and to update, can be null
+ * \param [out]    stats   Glitch correction results, can be null
+ * \param [in,out] control Progress to update and cancel flag to check, can be null
+ * \return Non zero value means error, CANCELLED if cancel flag was set
+*/
+int perturb_render(const DeepView *view, int *iters, WorkerPool *pool, PerturbResume *resume, PerturbStats *stats,
+                   PerturbControl *control);
+
+
+/**
+ * \brief Renders only listed pixels with reference orbit at view center and fixes glitches like perturb_render()
+ * \note Other pixels keep their iteration numbers, glitched ones among them are corrected too
+ * \param [in]     view    View to render
+ * \param [in,out] iters   Iteration numbers buffer of width * height
+ * \param [in,out] pool    Worker pool for pixels and secondary references
+ * \param [in]     pixels  Pixel indices in ascending order, so neighbour lanes stay coherent
+ * \param [in]     count   Number of listed pixels
+ * \param [out]    stats   Glitch correction results, can be null
+ * \param [in,out] control Progress to update and cancel flag to check, can be null
+ * \return Non zero value means error, CANCELLED if cancel flag was set
+*/
+int perturb_render_pixels(const DeepView *view, int *iters, WorkerPool *pool, const int *pixels, int count,
+                          PerturbStats *stats, PerturbControl *control);
+
+
+#endif
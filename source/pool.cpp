@@ -0,0 +1,558 @@
+/**
+ * \file
+ * \brief Source file for worker pool that runs batches of independent tasks
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "utils.hpp"
+#include "pool.hpp"
+
+
+const int CGROUP_LINE_SIZE = 256;               ///< Max length of cgroup file line and path
+
+
+/// Cgroup paths of the process from /proc/self/cgroup
+typedef struct {
+    char unified[CGROUP_LINE_SIZE] = "";        ///< Cgroup v2 path
+    char cpu[CGROUP_LINE_SIZE] = "";            ///< Cgroup v1 cpu controller path
+    char cpuset[CGROUP_LINE_SIZE] = "";         ///< Cgroup v1 cpuset controller path
+} CgroupPaths;
+
+
+/// Mount points of cgroup v2 hierarchy, the second one is used in hybrid mode
+const char *const CGROUP_UNIFIED_DIRS[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified", nullptr};
+
+/// Mount points of cgroup v1 cpu controller
+const char *const CGROUP_CPU_DIRS[] = {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpuacct,cpu", nullptr};
+
+/// Mount points of cgroup v1 cpuset controller
+const char *const CGROUP_CPUSET_DIRS[] = {"/sys/fs/cgroup/cpuset", nullptr};
+
+
+static thread_local PoolPriority thread_priority = POOL_INTERACTIVE;   ///< Class of jobs submitted by the thread
+static thread_local bool thread_idle = false;                           ///< Thread runs with SCHED_IDLE
+
+
+/**
+ * \brief Reads cgroup paths of the process, missing controllers get empty paths
+*/
+static void read_cgroup_paths(CgroupPaths *paths);
+
+
+/**
+ * \brief Reads the first line of cgroup file from the first mount point that has it
+ * \param [in]  dirs    Null terminated list of mount points
+ * \param [in]  group   Cgroup path, empty path means no such controller
+ * \param [in]  file    File name
+ * \param [out] line    Buffer of CGROUP_LINE_SIZE characters
+ * \return Non zero value means error
+*/
+static int read_cgroup_file(const char *const *dirs, const char *group, const char *file, char *line);
+
+
+/**
+ * \brief Returns CPUs allowed by the smallest cgroup quota of the process group and its ancestors, zero means no quota
+*/
+static double read_cgroup_quota(const CgroupPaths *paths);
+
+
+/**
+ * \brief Returns CPUs allowed by quota of one cgroup, zero means no quota
+ * \param [in] unified Group is cgroup v2 group, otherwise cgroup v1 cpu controller group
+ * \param [in] group   Cgroup path
+*/
+static double read_group_quota(bool unified, const char *group);
+
+
+/**
+ * \brief Returns number of CPUs in cgroup cpuset, zero means no cpuset
+*/
+static int read_cgroup_cpuset(const CgroupPaths *paths);
+
+
+/**
+ * \brief Returns number of CPUs in list like "0-3,8,10-11"
+*/
+static int count_cpu_list(const char *list);
+
+
+/**
+ * \brief Lowers limit to value if value is set
+*/
+static int apply_limit(int limit, int value);
+
+
+/**
+ * \brief Worker thread body, takes tasks until pool is stopped
+ * \param [in,out] pool    Pool of the worker
+ * \param [in]     idle    Worker runs with SCHED_IDLE and takes only tasks below interactive class
+*/
+static void worker_loop(WorkerPool *pool, bool idle);
+
+
+/**
+ * \brief Returns the first job of the highest class in [first, last], null if there is none
+ * \note Pool lock must be held
+*/
+static PoolJob *next_job(WorkerPool *pool, PoolPriority first, PoolPriority last);
+
+
+/**
+ * \brief Checks that the calling thread may run tasks of the class, with idle background only threads of its policy may
+*/
+static bool can_run(const WorkerPool *pool, PoolPriority priority);
+
+
+/**
+ * \brief Takes next task index of the job and removes job from queue if it was the last one
+ * \note Pool lock must be held
+*/
+static int take_task(WorkerPool *pool, PoolJob *job);
+
+
+/**
+ * \brief Runs task with class of its job and marks it finished
+ * \param [in,out] pool    Pool that runs job
+ * \param [in,out] job     Job of the task
+ * \param [in]     index   Task index
+ * \param [in,out] guard   Held pool lock, it is released while task runs
+*/
+static void run_task(WorkerPool *pool, PoolJob *job, int index, std::unique_lock<std::mutex> *guard);
+
+
+/**
+ * \brief Switches calling thread to SCHED_IDLE or back to SCHED_OTHER, does nothing if it already has the policy
+ * \note Leaving SCHED_IDLE needs CAP_SYS_NICE, failure is printed and the thread keeps its policy
+ * \param [in] idle    Policy to set is SCHED_IDLE
+ * \return Non zero value means error
+*/
+static int set_thread_policy(bool idle);
+
+
+/**
+ * \brief Removes job from queue
+ * \note Pool lock must be held
+*/
+static void remove_job(WorkerPool *pool, PoolJob *job);
+
+
+
+
+void pool_limits(PoolLimits *limits) {
+    assert(limits && "Can't fill null limits!\n");
+
+    *limits = {};
+    limits -> hardware = (int) std::thread::hardware_concurrency();
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (!sched_getaffinity(0, sizeof(mask), &mask)) limits -> affinity = CPU_COUNT(&mask);
+
+    CgroupPaths paths = {};
+    read_cgroup_paths(&paths);
+
+    limits -> cpuset = read_cgroup_cpuset(&paths);
+    limits -> quota = read_cgroup_quota(&paths);
+
+    int threads = apply_limit(0, limits -> hardware);
+    threads = apply_limit(threads, limits -> affinity);
+    threads = apply_limit(threads, limits -> cpuset);
+    // Quota below one CPU still gets one thread, not the unlimited pool
+    if (limits -> quota > 0) threads = apply_limit(threads, (limits -> quota < 1) ? 1 : (int) floor(limits -> quota));
+
+    limits -> threads = (threads > 0) ? threads : 1;
+}
+
+
+int pool_create(WorkerPool *pool, int threads_count) {
+    ASSERT(pool, INVALID_ARG, "Can't create null pool!\n");
+
+    if (threads_count <= 0) {
+        PoolLimits limits = {};
+        pool_limits(&limits);
+
+        printf("Worker pool: %d threads (hardware %d, affinity %d, cpuset %d, quota %.2f)\n", limits.threads,
+               limits.hardware, limits.affinity, limits.cpuset, limits.quota);
+
+        threads_count = limits.threads;
+    }
+
+    // Idle workers never leave SCHED_IDLE, so interactive tasks get their own set of workers
+    int total_count = (pool -> idle_background) ? 2 * threads_count : threads_count;
+
+    pool -> threads = new (std::nothrow) std::thread[total_count];
+    ASSERT(pool -> threads, ALLOC_FAIL, "Can't allocate worker threads!\n");
+
+    pool -> threads_count = total_count;
+    pool -> stop = false;
+
+    for (int i = 0; i < total_count; i++)
+        pool -> threads[i] = std::thread(worker_loop, pool, i >= threads_count);
+
+    return OK;
+}
+
+
+int pool_destroy(WorkerPool *pool) {
+    ASSERT(pool, INVALID_ARG, "Can't destroy null pool!\n");
+    ASSERT(pool -> threads, INVALID_ARG, "Pool is not created!\n");
+
+    {
+        std::lock_guard<std::mutex> guard(pool -> lock);
+        pool -> stop = true;
+    }
+
+    pool -> wake.notify_all();
+
+    for (int i = 0; i < pool -> threads_count; i++)
+        pool -> threads[i].join();
+
+    delete[] pool -> threads;
+
+    pool -> threads = nullptr;
+    pool -> threads_count = 0;
+
+    for (int i = 0; i < POOL_PRIORITIES; i++) {
+        pool -> head[i] = nullptr;
+        pool -> tail[i] = nullptr;
+    }
+
+    return OK;
+}
+
+
+PoolPriority pool_set_priority(PoolPriority priority) {
+    PoolPriority prev = thread_priority;
+    thread_priority = priority;
+
+    return prev;
+}
+
+
+void pool_metrics(WorkerPool *pool, PoolClassStats *stats) {
+    assert(pool && "Can't read metrics of null pool!\n");
+    assert(stats && "Can't store metrics in null buffer!\n");
+
+    std::lock_guard<std::mutex> guard(pool -> lock);
+
+    for (int i = 0; i < POOL_PRIORITIES; i++) stats[i] = pool -> stats[i];
+}
+
+
+void pool_submit(WorkerPool *pool, PoolJob *job, PoolFunc func, void *arg, int count) {
+    assert(pool && "Can't submit to null pool!\n");
+    assert(job && "Can't submit null job!\n");
+    assert(func && "Can't submit job without function!\n");
+
+    job -> func = func;
+    job -> arg = arg;
+    job -> count = count;
+    job -> taken = 0;
+    job -> finished = 0;
+    job -> priority = thread_priority;
+    job -> submitted = get_seconds();
+    job -> next = nullptr;
+
+    if (count <= 0) return;
+
+    {
+        std::lock_guard<std::mutex> guard(pool -> lock);
+
+        int priority = job -> priority;
+
+        if (pool -> tail[priority]) pool -> tail[priority] -> next = job;
+        else pool -> head[priority] = job;
+
+        pool -> tail[priority] = job;
+
+        PoolClassStats *stats = pool -> stats + priority;
+        stats -> jobs++;
+        stats -> queued += count;
+        if (stats -> queued > stats -> peak_queued) stats -> peak_queued = stats -> queued;
+    }
+
+    // Woken worker of the other policy would not take the task, so idle background wakes everyone
+    if (count == 1 && !pool -> idle_background) pool -> wake.notify_one();
+    else pool -> wake.notify_all();
+}
+
+
+void pool_wait(WorkerPool *pool, PoolJob *job) {
+    assert(pool && "Can't wait on null pool!\n");
+    assert(job && "Can't wait for null job!\n");
+
+    std::unique_lock<std::mutex> guard(pool -> lock);
+
+    while (job -> taken < job -> count) {
+        // Caller helps its own job only when no more important tasks are queued
+        PoolJob *next = next_job(pool, POOL_INTERACTIVE, job -> priority);
+        if (!next || next -> priority == job -> priority || !can_run(pool, next -> priority)) next = job;
+
+        // Caller keeps its policy, so tasks of the other one are left to workers. Idle workers always run their own
+        // jobs, so they never wait for each other
+        if (!can_run(pool, next -> priority)) break;
+
+        int index = take_task(pool, next);
+        run_task(pool, next, index, &guard);
+    }
+
+    while (job -> finished < job -> count) pool -> done.wait(guard);
+}
+
+
+void pool_run(WorkerPool *pool, PoolFunc func, void *arg, int count) {
+    PoolJob job = {};
+
+    pool_submit(pool, &job, func, arg, count);
+    pool_wait(pool, &job);
+}
+
+
+static void read_cgroup_paths(CgroupPaths *paths) {
+    assert(paths && "Can't fill null paths!\n");
+
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (!file) return;
+
+    char line[CGROUP_LINE_SIZE] = "";
+
+    // Lines look like "0::/path" for v2 and "3:cpu,cpuacct:/path" for v1
+    while (fgets(line, CGROUP_LINE_SIZE, file)) {
+        line[strcspn(line, "\n")] = '\0';
+
+        char *controllers = strchr(line, ':');
+        if (!controllers) continue;
+
+        char *group = strchr(++controllers, ':');
+        if (!group) continue;
+
+        *(group++) = '\0';
+
+        if (!*controllers) {
+            strcpy(paths -> unified, group);
+            continue;
+        }
+
+        for (char *name = strtok(controllers, ","); name; name = strtok(nullptr, ",")) {
+            if (!strcmp(name, "cpu")) strcpy(paths -> cpu, group);
+            if (!strcmp(name, "cpuset")) strcpy(paths -> cpuset, group);
+        }
+    }
+
+    fclose(file);
+}
+
+
+static int read_cgroup_file(const char *const *dirs, const char *group, const char *file, char *line) {
+    if (!*group) return FILE_NOT_FOUND;
+
+    for (; *dirs; dirs++) {
+        char path[2 * CGROUP_LINE_SIZE] = "";
+        snprintf(path, sizeof(path), "%s%s/%s", *dirs, (strcmp(group, "/")) ? group : "", file);
+
+        FILE *stream = fopen(path, "r");
+        if (!stream) continue;
+
+        char *result = fgets(line, CGROUP_LINE_SIZE, stream);
+        fclose(stream);
+
+        if (result) return OK;
+    }
+
+    return FILE_NOT_FOUND;
+}
+
+
+static double read_cgroup_quota(const CgroupPaths *paths) {
+    double quota = 0;
+
+    // Parent quota limits all its children, so the smallest one on the way to the root counts
+    for (int unified = 1; unified >= 0; unified--) {
+        char group[CGROUP_LINE_SIZE] = "";
+        strcpy(group, (unified) ? paths -> unified : paths -> cpu);
+
+        while (*group) {
+            double value = read_group_quota(unified, group);
+            if (value > 0 && (quota <= 0 || value < quota)) quota = value;
+
+            if (!strcmp(group, "/")) break;
+
+            char *slash = strrchr(group, '/');
+            if (!slash) break;
+
+            if (slash == group) slash[1] = '\0';
+            else *slash = '\0';
+        }
+    }
+
+    return quota;
+}
+
+
+static double read_group_quota(bool unified, const char *group) {
+    char line[CGROUP_LINE_SIZE] = "";
+
+    // Cgroup v2 has "max 100000" or "200000 100000"
+    if (unified && !read_cgroup_file(CGROUP_UNIFIED_DIRS, group, "cpu.max", line)) {
+        long quota = 0, period = 0;
+        if (sscanf(line, "%ld %ld", &quota, &period) == 2 && quota > 0 && period > 0) return (double) quota / (double) period;
+    }
+
+    // Cgroup v1 has -1 quota when it is not set
+    if (!unified && !read_cgroup_file(CGROUP_CPU_DIRS, group, "cpu.cfs_quota_us", line)) {
+        long quota = atol(line);
+
+        if (quota > 0 && !read_cgroup_file(CGROUP_CPU_DIRS, group, "cpu.cfs_period_us", line)) {
+            long period = atol(line);
+            if (period > 0) return (double) quota / (double) period;
+        }
+    }
+
+    return 0;
+}
+
+
+static int read_cgroup_cpuset(const CgroupPaths *paths) {
+    char line[CGROUP_LINE_SIZE] = "";
+
+    if (!read_cgroup_file(CGROUP_UNIFIED_DIRS, paths -> unified, "cpuset.cpus.effective", line)) return count_cpu_list(line);
+    if (!read_cgroup_file(CGROUP_CPUSET_DIRS, paths -> cpuset, "cpuset.effective_cpus", line)) return count_cpu_list(line);
+    if (!read_cgroup_file(CGROUP_CPUSET_DIRS, paths -> cpuset, "cpuset.cpus", line)) return count_cpu_list(line);
+
+    return 0;
+}
+
+
+static int count_cpu_list(const char *list) {
+    int count = 0;
+
+    while (*list) {
+        char *end = nullptr;
+        long first = strtol(list, &end, 10);
+        if (end == list) break;
+
+        long last = first;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list) break;
+        }
+
+        if (last >= first) count += (int) (last - first + 1);
+
+        list = end;
+        if (*list == ',') list++;
+    }
+
+    return count;
+}
+
+
+static int apply_limit(int limit, int value) {
+    if (value <= 0) return limit;
+
+    return (limit <= 0 || value < limit) ? value : limit;
+}
+
+
+static void worker_loop(WorkerPool *pool, bool idle) {
+    if (idle) set_thread_policy(true);
+
+    PoolPriority first = (idle) ? POOL_BACKGROUND : POOL_INTERACTIVE;
+    PoolPriority last = (pool -> idle_background && !idle) ? POOL_INTERACTIVE : POOL_SPECULATIVE;
+
+    std::unique_lock<std::mutex> guard(pool -> lock);
+
+    for (;;) {
+        PoolJob *job = nullptr;
+        while (!pool -> stop && !(job = next_job(pool, first, last))) pool -> wake.wait(guard);
+
+        if (pool -> stop) return;
+
+        // Every task is one tile or band, so new interactive job preempts lower classes at the next task
+        int index = take_task(pool, job);
+        run_task(pool, job, index, &guard);
+    }
+}
+
+
+static PoolJob *next_job(WorkerPool *pool, PoolPriority first, PoolPriority last) {
+    for (int i = first; i <= last; i++) {
+        if (pool -> head[i]) return pool -> head[i];
+    }
+
+    return nullptr;
+}
+
+
+static bool can_run(const WorkerPool *pool, PoolPriority priority) {
+    return !pool -> idle_background || (priority != POOL_INTERACTIVE) == thread_idle;
+}
+
+
+static int take_task(WorkerPool *pool, PoolJob *job) {
+    int index = job -> taken++;
+
+    PoolClassStats *stats = pool -> stats + job -> priority;
+    stats -> queued--;
+    stats -> tasks++;
+    stats -> wait += get_seconds() - job -> submitted;
+
+    if (job -> taken == job -> count) remove_job(pool, job);
+
+    return index;
+}
+
+
+static void run_task(WorkerPool *pool, PoolJob *job, int index, std::unique_lock<std::mutex> *guard) {
+    PoolPriority prev = pool_set_priority(job -> priority);
+
+    guard -> unlock();
+    job -> func(job -> arg, index);
+    guard -> lock();
+
+    pool_set_priority(prev);
+
+    if (++job -> finished == job -> count) pool -> done.notify_all();
+}
+
+
+static int set_thread_policy(bool idle) {
+    if (idle == thread_idle) return OK;
+
+    sched_param param = {};
+    param.sched_priority = 0;
+
+    int error = pthread_setschedparam(pthread_self(), idle ? SCHED_IDLE : SCHED_OTHER, &param);
+    ASSERT(!error, INVALID_ARG, "Can't switch thread to %s: %s\n", idle ? "SCHED_IDLE" : "SCHED_OTHER", strerror(error));
+
+    thread_idle = idle;
+
+    return OK;
+}
+
+
+static void remove_job(WorkerPool *pool, PoolJob *job) {
+    int priority = job -> priority;
+
+    PoolJob *prev = nullptr;
+    PoolJob *curr = pool -> head[priority];
+
+    for (; curr && curr != job; curr = curr -> next) prev = curr;
+
+    if (!curr) return;
+
+    if (prev) prev -> next = job -> next;
+    else pool -> head[priority] = job -> next;
+
+    if (pool -> tail[priority] == job) pool -> tail[priority] = prev;
+
+    job -> next = nullptr;
+}
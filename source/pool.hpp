@@ -0,0 +1,154 @@
+/**
+ * \file
+ * \brief Header file for worker pool that runs batches of independent tasks
+*/
+
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+/**
+ * \brief Function that runs one task of a job
+ * \param [in] arg      Job argument
+ * \param [in] index    Task index in [0, count)
+*/
+typedef void (*PoolFunc)(void *arg, int index);
+
+
+/// Priority classes of jobs, task of lower class never starts while higher class has tasks left
+typedef enum {
+    POOL_INTERACTIVE    = 0,        ///< Frames the user waits for
+    POOL_BACKGROUND     = 1,        ///< Exports and batch renders
+    POOL_SPECULATIVE    = 2,        ///< Prefetch and refinement that may be never used
+} PoolPriority;
+
+const int POOL_PRIORITIES = 3;                  ///< Number of priority classes
+
+
+/// Batch of tasks that share function and argument, owned by the caller until it is finished
+typedef struct PoolJob {
+    PoolFunc func = nullptr;                    ///< Task function
+    void *arg = nullptr;                        ///< Task function argument
+    int count = 0;                              ///< Number of tasks
+    int taken = 0;                              ///< Number of tasks already taken by workers
+    int finished = 0;                           ///< Number of finished tasks
+    PoolPriority priority = POOL_INTERACTIVE;   ///< Priority class
+    double submitted = 0;                       ///< Submit time in seconds
+    PoolJob *next = nullptr;                    ///< Next job in queue
+} PoolJob;
+
+
+/// Queue metrics of one priority class
+typedef struct {
+    int queued = 0;                             ///< Number of tasks waiting in queue now
+    int peak_queued = 0;                        ///< Max number of tasks waiting in queue
+    long jobs = 0;                              ///< Number of submitted jobs
+    long tasks = 0;                             ///< Number of started tasks
+    double wait = 0;                            ///< Total seconds tasks waited from submit to start
+} PoolClassStats;
+
+
+/// Fixed set of threads that take tasks from queued jobs
+typedef struct {
+    std::thread *threads = nullptr;             ///< Worker threads
+    int threads_count = 0;                      ///< Number of worker threads
+    std::mutex lock = {};                       ///< Protects queue, metrics and stop flag
+    std::condition_variable wake = {};          ///< Signals new tasks or stop
+    std::condition_variable done = {};          ///< Signals finished jobs
+    PoolJob *head[POOL_PRIORITIES] = {};        ///< First job with tasks left of every class
+    PoolJob *tail[POOL_PRIORITIES] = {};        ///< Last job with tasks left of every class
+    PoolClassStats stats[POOL_PRIORITIES] = {}; ///< Queue metrics of every class
+    bool idle_background = false;               ///< Tasks below interactive class run on extra workers with SCHED_IDLE, set before pool_create
+    bool stop = false;                          ///< Workers exit when set
+} WorkerPool;
+
+
+/// CPU limits of the process, zero means limit is not set or can't be read
+typedef struct {
+    int hardware = 0;                           ///< Number of hardware threads
+    int affinity = 0;                           ///< Number of CPUs in scheduler affinity mask
+    int cpuset = 0;                             ///< Number of CPUs in cgroup cpuset
+    double quota = 0;                           ///< CPUs allowed by cgroup v1 or v2 CPU quota
+    int threads = 1;                            ///< Number of worker threads that fit all limits
+} PoolLimits;
+
+
+/**
+ * \brief Reads CPU limits of the process and chooses number of worker threads
+ * \note Quota is rounded down, because threads above it are throttled by the kernel
+ * \param [out] limits Limits to fill
+*/
+void pool_limits(PoolLimits *limits);
+
+
+/**
+ * \brief Starts worker threads
+ * \note Pool with idle background gets threads_count interactive workers and as many SCHED_IDLE workers for other classes
+ * \param [out] pool            Pool to start
+ * \param [in]  threads_count   Number of threads, zero means number allowed by CPU limits, chosen limits are printed
+ * \return Non zero value means error
+*/
+int pool_create(WorkerPool *pool, int threads_count);
+
+
+/**
+ * \brief Stops worker threads, queued tasks that are not taken are dropped
+ * \param [out] pool Pool to stop
+ * \return Non zero value means error
+*/
+int pool_destroy(WorkerPool *pool);
+
+
+/**
+ * \brief Sets priority class of jobs submitted by the calling thread
+ * \note Tasks run with class of their job, so jobs submitted from tasks inherit it
+ * \param [in] priority Priority class
+ * \return Previous class of the thread
+*/
+PoolPriority pool_set_priority(PoolPriority priority);
+
+
+/**
+ * \brief Copies queue metrics of all priority classes
+ * \param [in,out] pool    Pool to read
+ * \param [out]    stats   Buffer of POOL_PRIORITIES metrics
+*/
+void pool_metrics(WorkerPool *pool, PoolClassStats *stats);
+
+
+/**
+ * \brief Queues job with priority class of the calling thread, returns immediately
+ * \param [in,out]  pool    Pool to run job
+ * \param [out]     job     Job to fill, must live until pool_wait returns
+ * \param [in]      func    Task function
+ * \param [in]      arg     Task function argument
+ * \param [in]      count   Number of tasks
+*/
+void pool_submit(WorkerPool *pool, PoolJob *job, PoolFunc func, void *arg, int count);
+
+
+/**
+ * \brief Runs tasks of the job in the calling thread and waits until all of them are finished
+ * \note Tasks of higher priority classes queued meanwhile are run first. With idle background the caller runs only tasks
+ *       of its own scheduling policy and leaves the rest to workers
+ * \param [in,out]  pool    Pool that runs job
+ * \param [in,out]  job     Submitted job
+*/
+void pool_wait(WorkerPool *pool, PoolJob *job);
+
+
+/**
+ * \brief Runs func(arg, i) for all i in [0, count) and waits for them
+ * \param [in,out]  pool    Pool to run tasks
+ * \param [in]      func    Task function
+ * \param [in]      arg     Task function argument
+ * \param [in]      count   Number of tasks
+*/
+void pool_run(WorkerPool *pool, PoolFunc func, void *arg, int count);
+
+
+#endif
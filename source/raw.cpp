@@ -0,0 +1,275 @@
+/**
+ * \file
+ * \brief Source file for raw per pixel data planes
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "raw.hpp"
+
+
+/**
+ * \brief Iterates one pixel and computes all its planes
+ * \param [in]  c_x     Real part of c
+ * \param [in]  c_y     Imaginary part of c
+ * \param [in]  pixel   Pixel size, distance estimate is measured in pixels
+ * \param [in]  nmax    Max iteration number
+ * \param [out] result  Planes of the pixel
+*/
+static void render_pixel(double c_x, double c_y, double pixel, int nmax, RawPixel *result);
+
+
+/**
+ * \brief Writes color interpolated between two palette entries
+*/
+static void blend_colors(const IterColor *a, const IterColor *b, float t, uint8_t *rgba);
+
+
+
+
+int raw_layout_parse(const char *name, RawLayout *layout) {
+    ASSERT(name, INVALID_ARG, "Can't parse null layout name!\n");
+    ASSERT(layout, INVALID_ARG, "Can't parse into null layout!\n");
+
+    if      (!strcmp(name, "soa")) *layout = RAW_PLANAR;
+    else if (!strcmp(name, "aos")) *layout = RAW_INTERLEAVED;
+    else ASSERT(0, INVALID_ARG, "Unknown layout %s, use soa or aos!\n", name);
+
+    return OK;
+}
+
+
+int raw_buffer_create(RawBuffer *raw, int width, int height, RawLayout layout) {
+    ASSERT(raw, INVALID_ARG, "Can't create null raw buffer!\n");
+    ASSERT(width > 0 && height > 0, INVALID_ARG, "Invalid raw buffer size!\n");
+
+    *raw = {};
+    raw -> layout = layout;
+    raw -> width = width;
+    raw -> height = height;
+
+    size_t count = (size_t) width * (size_t) height;
+    bool allocated = false;
+
+    if (layout == RAW_PLANAR) {
+        raw -> iters = (int *) calloc(count, sizeof(int));
+        raw -> smooth = (float *) calloc(count, sizeof(float));
+        raw -> distance = (float *) calloc(count, sizeof(float));
+        raw -> re = (float *) calloc(count, sizeof(float));
+        raw -> im = (float *) calloc(count, sizeof(float));
+
+        allocated = raw -> iters && raw -> smooth && raw -> distance && raw -> re && raw -> im;
+    }
+    else {
+        raw -> pixels = (RawPixel *) calloc(count, sizeof(RawPixel));
+        allocated = raw -> pixels;
+    }
+
+    if (!allocated) {
+        raw_buffer_free(raw);
+
+        printf("Can't allocate raw buffer!\n");
+        return ALLOC_FAIL;
+    }
+
+    return OK;
+}
+
+
+int raw_buffer_free(RawBuffer *raw) {
+    ASSERT(raw, INVALID_ARG, "Can't free null raw buffer!\n");
+
+    free(raw -> iters);
+    free(raw -> smooth);
+    free(raw -> distance);
+    free(raw -> re);
+    free(raw -> im);
+    free(raw -> pixels);
+
+    *raw = {};
+
+    return OK;
+}
+
+
+void raw_buffer_render(RawBuffer *raw, double center_x, double center_y, double span, int nmax) {
+    assert(raw && (raw -> iters || raw -> pixels) && "Can't render into null raw buffer!\n");
+
+    double pixel = span / raw -> width;
+
+    for (int y = 0; y < raw -> height; y++) {
+        for (int x = 0; x < raw -> width; x++) {
+            RawPixel result = {};
+            render_pixel(center_x + (x - raw -> width / 2) * pixel, center_y + (y - raw -> height / 2) * pixel, pixel,
+                         nmax, &result);
+
+            size_t i = (size_t) y * raw -> width + x;
+
+            if (raw -> layout == RAW_INTERLEAVED) raw -> pixels[i] = result;
+            else {
+                raw -> iters[i] = result.iters;
+                raw -> smooth[i] = result.smooth;
+                raw -> distance[i] = result.distance;
+                raw -> re[i] = result.re;
+                raw -> im[i] = result.im;
+            }
+        }
+    }
+}
+
+
+void raw_colorize_iters(const RawBuffer *raw, const IterColor *color_table, uint8_t *rgba, int nmax) {
+    assert(raw && color_table && rgba && "Can't colorize null buffers!\n");
+
+    int count = raw -> width * raw -> height;
+
+    // Planar layout is the iterations array colorize already takes
+    if (raw -> layout == RAW_PLANAR) {
+        colorize(color_table, raw -> iters, rgba, count, nmax);
+        return;
+    }
+
+    for (int i = 0; i < count; i++, rgba += 4) {
+        int N = raw -> pixels[i].iters;
+        const IterColor *color = color_table + N % POSSIBLE_COLORS;
+        bool outside = (0 < N && N < nmax);
+
+        rgba[0] = outside ? color -> red : 0;
+        rgba[1] = outside ? color -> green : 0;
+        rgba[2] = outside ? color -> blue : 0;
+        rgba[3] = 255;
+    }
+}
+
+
+void raw_colorize_smooth(const RawBuffer *raw, const IterColor *color_table, uint8_t *rgba, int nmax) {
+    assert(raw && color_table && rgba && "Can't colorize null buffers!\n");
+
+    int count = raw -> width * raw -> height;
+
+    for (int i = 0; i < count; i++, rgba += 4) {
+        int N = 0;
+        float smooth = 0;
+
+        if (raw -> layout == RAW_INTERLEAVED) {
+            N = raw -> pixels[i].iters;
+            smooth = raw -> pixels[i].smooth;
+        }
+        else {
+            N = raw -> iters[i];
+            smooth = raw -> smooth[i];
+        }
+
+        if (N >= nmax) {
+            rgba[0] = rgba[1] = rgba[2] = 0;
+            rgba[3] = 255;
+            continue;
+        }
+
+        int index = (int) smooth;
+        blend_colors(color_table + index % POSSIBLE_COLORS, color_table + (index + 1) % POSSIBLE_COLORS,
+                     smooth - (float) index, rgba);
+    }
+}
+
+
+void raw_shade_distance(const RawBuffer *raw, uint8_t *rgba) {
+    assert(raw && rgba && "Can't shade null buffers!\n");
+
+    int count = raw -> width * raw -> height;
+
+    for (int i = 0; i < count; i++, rgba += 4) {
+        float distance = (raw -> layout == RAW_INTERLEAVED) ? raw -> pixels[i].distance : raw -> distance[i];
+        uint8_t value = (uint8_t) (255 * distance / (distance + RAW_DISTANCE_SCALE));
+
+        rgba[0] = rgba[1] = rgba[2] = value;
+        rgba[3] = 255;
+    }
+}
+
+
+void raw_histogram(const RawBuffer *raw, int nmax, long *histogram) {
+    assert(raw && histogram && "Can't count into null histogram!\n");
+
+    memset(histogram, 0, (size_t) (nmax + 1) * sizeof(long));
+
+    int count = raw -> width * raw -> height;
+
+    if (raw -> layout == RAW_PLANAR) {
+        for (int i = 0; i < count; i++) histogram[raw -> iters[i]]++;
+    }
+    else {
+        for (int i = 0; i < count; i++) histogram[raw -> pixels[i].iters]++;
+    }
+}
+
+
+int raw_collect_resume(const RawBuffer *raw, int nmax, int *pixels, float *re, float *im) {
+    assert(raw && pixels && re && im && "Can't collect into null buffers!\n");
+
+    int count = raw -> width * raw -> height, listed = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (raw -> layout == RAW_INTERLEAVED) {
+            const RawPixel *pixel = raw -> pixels + i;
+            if (pixel -> iters != nmax) continue;
+
+            re[listed] = pixel -> re;
+            im[listed] = pixel -> im;
+        }
+        else {
+            if (raw -> iters[i] != nmax) continue;
+
+            re[listed] = raw -> re[i];
+            im[listed] = raw -> im[i];
+        }
+
+        pixels[listed++] = i;
+    }
+
+    return listed;
+}
+
+
+static void render_pixel(double c_x, double c_y, double pixel, int nmax, RawPixel *result) {
+    double x = 0, y = 0, dx = 0, dy = 0;
+    int n = 0;
+
+    for (; n < nmax && x * x + y * y <= RAW_BAILOUT * RAW_BAILOUT; n++) {
+        // dz = 2 z dz + 1 is taken before z changes
+        double new_dx = 2 * (x * dx - y * dy) + 1;
+        dy = 2 * (x * dy + y * dx);
+        dx = new_dx;
+
+        double new_x = x * x - y * y + c_x;
+        y = 2 * x * y + c_y;
+        x = new_x;
+    }
+
+    *result = {};
+    result -> iters = n;
+
+    if (n < nmax) {
+        double modulus = sqrt(x * x + y * y);
+
+        // Modulus is in (RAW_BAILOUT, RAW_BAILOUT^2], so smooth value is in [n, n + 1)
+        result -> smooth = (float) (n + 1 - log2(log(modulus) / log(RAW_BAILOUT)));
+        result -> distance = (float) (modulus * log(modulus) / (sqrt(dx * dx + dy * dy) * pixel));
+    }
+    else {
+        result -> re = (float) x;
+        result -> im = (float) y;
+    }
+}
+
+
+static void blend_colors(const IterColor *a, const IterColor *b, float t, uint8_t *rgba) {
+    rgba[0] = (uint8_t) ((float) a -> red + t * (float) (b -> red - a -> red));
+    rgba[1] = (uint8_t) ((float) a -> green + t * (float) (b -> green - a -> green));
+    rgba[2] = (uint8_t) ((float) a -> blue + t * (float) (b -> blue - a -> blue));
+    rgba[3] = 255;
+}
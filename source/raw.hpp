@@ -0,0 +1,134 @@
+/**
+ * \file
+ * \brief Header file for raw per pixel data planes stored either as separate planes or interleaved per pixel
+ * \note Pass that reads one plane streams only that plane in planar layout, pass that reads several planes
+ * of the same pixel gets them from one cache line in interleaved layout
+*/
+
+#ifndef RAW_HPP
+#define RAW_HPP
+
+#include <stdint.h>
+#include "kernel.hpp"
+
+
+/// Memory layout of raw planes
+typedef enum {
+    RAW_PLANAR          = 0,        ///< Every plane is a separate array (SoA)
+    RAW_INTERLEAVED     = 1,        ///< All planes of a pixel are stored together (AoS)
+} RawLayout;
+
+
+/// All planes of one pixel in interleaved layout
+typedef struct {
+    int iters = 0;                              ///< Iteration number
+    float smooth = 0;                           ///< Continuous iteration number in [iters, iters + 1), zero inside the set
+    float distance = 0;                         ///< Exterior distance estimate in pixels, zero inside the set
+    float re = 0;                               ///< Real part of z after the limit, zero for escaped pixels
+    float im = 0;                               ///< Imaginary part of z after the limit, zero for escaped pixels
+} RawPixel;
+
+
+/// Raw render result of width * height pixels
+typedef struct {
+    RawLayout layout = RAW_PLANAR;              ///< Layout of the planes
+    int width = 0;                              ///< Width in pixels
+    int height = 0;                             ///< Height in pixels
+    int *iters = nullptr;                       ///< Iteration plane of planar layout
+    float *smooth = nullptr;                    ///< Smooth iteration plane of planar layout
+    float *distance = nullptr;                  ///< Distance estimate plane of planar layout
+    float *re = nullptr;                        ///< Resume real part plane of planar layout
+    float *im = nullptr;                        ///< Resume imaginary part plane of planar layout
+    RawPixel *pixels = nullptr;                 ///< Pixels of interleaved layout
+} RawBuffer;
+
+
+/**
+ * \brief Parses layout name "soa" or "aos"
+ * \param [in]  name    Layout name
+ * \param [out] layout  Parsed layout
+ * \return Non zero value means error
+*/
+int raw_layout_parse(const char *name, RawLayout *layout);
+
+
+/**
+ * \brief Allocates raw buffer with given layout
+ * \param [out] raw     Buffer to create
+ * \param [in]  width   Width in pixels
+ * \param [in]  height  Height in pixels
+ * \param [in]  layout  Layout of the planes
+ * \return Non zero value means error
+*/
+int raw_buffer_create(RawBuffer *raw, int width, int height, RawLayout layout);
+
+
+/**
+ * \brief Frees raw buffer
+ * \param [in,out] raw  Buffer to free
+ * \return Non zero value means error
+*/
+int raw_buffer_free(RawBuffer *raw);
+
+
+/**
+ * \brief Renders all planes of the view in double precision
+ * \param [out] raw         Buffer to fill
+ * \param [in]  center_x    View center x
+ * \param [in]  center_y    View center y
+ * \param [in]  span        View width in set coordinates
+ * \param [in]  nmax        Max iteration number
+*/
+void raw_buffer_render(RawBuffer *raw, double center_x, double center_y, double span, int nmax);
+
+
+/**
+ * \brief Colors pixels by iteration number like colorize, reads iteration plane
+ * \param [in]  raw         Raw buffer
+ * \param [in]  color_table Palette of POSSIBLE_COLORS colors
+ * \param [out] rgba        Image of raw buffer size
+ * \param [in]  nmax        Max iteration number
+*/
+void raw_colorize_iters(const RawBuffer *raw, const IterColor *color_table, uint8_t *rgba, int nmax);
+
+
+/**
+ * \brief Colors pixels by palette interpolated with smooth iteration number, reads iteration and smooth planes
+ * \param [in]  raw         Raw buffer
+ * \param [in]  color_table Palette of POSSIBLE_COLORS colors
+ * \param [out] rgba        Image of raw buffer size
+ * \param [in]  nmax        Max iteration number
+*/
+void raw_colorize_smooth(const RawBuffer *raw, const IterColor *color_table, uint8_t *rgba, int nmax);
+
+
+/**
+ * \brief Shades pixels by distance estimate, boundary is dark, reads distance plane
+ * \param [in]  raw         Raw buffer
+ * \param [out] rgba        Image of raw buffer size
+*/
+void raw_shade_distance(const RawBuffer *raw, uint8_t *rgba);
+
+
+/**
+ * \brief Counts pixels of every iteration number, reads iteration plane
+ * \param [in]  raw         Raw buffer
+ * \param [in]  nmax        Max iteration number
+ * \param [out] histogram   Counters of nmax + 1 iteration numbers
+*/
+void raw_histogram(const RawBuffer *raw, int nmax, long *histogram);
+
+
+/**
+ * \brief Lists pixels that reached the limit with their z, reads iteration and resume planes
+ * \param [in]  raw         Raw buffer
+ * \param [in]  nmax        Max iteration number
+ * \param [out] pixels      Indices of pixels that reached the limit
+ * \param [out] re          Real parts of their z
+ * \param [out] im          Imaginary parts of their z
+ * \return Number of listed pixels
+*/
+int raw_collect_resume(const RawBuffer *raw, int nmax, int *pixels, float *re, float *im);
+
+
+#endif
@@ -0,0 +1,404 @@
+/**
+ * \file
+ * \brief Source file for remote viewer protocol
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "utils.hpp"
+#include "remote.hpp"
+
+
+const int REMOTE_MAX_RUN = 129;                 ///< Longest run of equal pixels in one code
+const int REMOTE_MAX_LITERAL = 128;             ///< Longest sequence of distinct pixels in one code
+const int REMOTE_TILE_PIXELS = REMOTE_TILE * REMOTE_TILE;   ///< Pixels of the full tile
+
+
+/**
+ * \brief Writes the whole buffer
+ * \return Non zero value means error
+*/
+static int write_all(int fd, const void *buffer, size_t size);
+
+
+/**
+ * \brief Reads exactly size bytes
+ * \return Non zero value means error or closed connection
+*/
+static int read_all(int fd, void *buffer, size_t size);
+
+
+/**
+ * \brief Returns true if the dirty region intersects the rectangle
+*/
+static bool rect_is_dirty(const DirtyRegion *dirty, int x, int y, int width, int height);
+
+
+/**
+ * \brief Packs pixels with run length encoding
+ * \note Code byte c < 128 is followed by c + 1 distinct pixels, code c >= 128 is followed by one pixel repeated c - 126 times
+ * \param [in]  pixels  Pixels to pack
+ * \param [in]  count   Number of pixels
+ * \param [out] output  Encoded bytes
+ * \return Encoded size in bytes
+*/
+static size_t encode_runs(const uint32_t *pixels, int count, uint8_t *output);
+
+
+/**
+ * \brief Unpacks tile pixels and XORs them into the screen
+ * \param [in]     input   Encoded bytes
+ * \param [in]     size    Encoded size in bytes
+ * \param [in]     tile    Tile rectangle
+ * \param [in,out] pixels  Screen buffer in RGBA format
+ * \return Non zero value means error
+*/
+static int decode_runs(const uint8_t *input, size_t size, const RemoteTileHeader *tile, uint8_t *pixels);
+
+
+
+
+size_t remote_message_capacity(void) {
+    size_t codes = (size_t) (REMOTE_TILE_PIXELS + REMOTE_MAX_LITERAL - 1) / REMOTE_MAX_LITERAL;
+
+    return sizeof(RemoteHeader) + sizeof(RemoteFrameHeader) + 4 * (size_t) SCREEN_W * SCREEN_H +
+           (size_t) REMOTE_TILES_X * REMOTE_TILES_Y * (sizeof(RemoteTileHeader) + codes);
+}
+
+
+int remote_encoder_create(RemoteEncoder *encoder) {
+    ASSERT(encoder, INVALID_ARG, "Can't create null encoder!\n");
+
+    encoder -> sent = (uint8_t *) calloc((size_t) SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
+    encoder -> delta = (uint32_t *) calloc(REMOTE_TILE_PIXELS, sizeof(uint32_t));
+    encoder -> message = (uint8_t *) calloc(remote_message_capacity(), sizeof(uint8_t));
+
+    if (!encoder -> sent || !encoder -> delta || !encoder -> message) {
+        remote_encoder_free(encoder);
+
+        printf("Can't allocate encoder buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    return OK;
+}
+
+
+int remote_encoder_free(RemoteEncoder *encoder) {
+    ASSERT(encoder, INVALID_ARG, "Can't free null encoder!\n");
+
+    free(encoder -> sent);
+    free(encoder -> delta);
+    free(encoder -> message);
+
+    *encoder = {};
+
+    return OK;
+}
+
+
+int remote_send_frame(int fd, RemoteEncoder *encoder, const uint8_t *pixels, const DirtyRegion *dirty, int nmax,
+                      size_t *bytes) {
+    ASSERT(encoder && encoder -> message, INVALID_ARG, "Can't send frame with null encoder!\n");
+    ASSERT(pixels, INVALID_ARG, "Can't send null screen!\n");
+    ASSERT(dirty, INVALID_ARG, "Can't send frame without dirty region!\n");
+
+    RemoteFrameHeader frame = {};
+    frame.nmax = nmax;
+
+    size_t size = sizeof(RemoteHeader) + sizeof(RemoteFrameHeader);
+
+    for (int y = 0; y < SCREEN_H; y += REMOTE_TILE) {
+        for (int x = 0; x < SCREEN_W; x += REMOTE_TILE) {
+            int width = (x + REMOTE_TILE > SCREEN_W) ? SCREEN_W - x : REMOTE_TILE;
+            int height = (y + REMOTE_TILE > SCREEN_H) ? SCREEN_H - y : REMOTE_TILE;
+
+            if (!rect_is_dirty(dirty, x, y, width, height)) continue;
+
+            // Recalculated pixels often get the same colors, such tiles are not sent
+            bool changed = false;
+            for (int row = y; row < y + height && !changed; row++) {
+                size_t offset = 4 * ((size_t) row * SCREEN_W + (size_t) x);
+                changed = memcmp(pixels + offset, encoder -> sent + offset, 4 * (size_t) width) != 0;
+            }
+
+            if (!changed) continue;
+
+            for (int row = 0; row < height; row++) {
+                size_t offset = 4 * ((size_t) (y + row) * SCREEN_W + (size_t) x);
+
+                for (int col = 0; col < width; col++) {
+                    uint32_t pixel = 0, old = 0;
+                    memcpy(&pixel, pixels + offset + 4 * col, sizeof(pixel));
+                    memcpy(&old, encoder -> sent + offset + 4 * col, sizeof(old));
+
+                    // Pixels that kept their colors become zero runs
+                    encoder -> delta[row * width + col] = pixel ^ old;
+                }
+
+                memcpy(encoder -> sent + offset, pixels + offset, 4 * (size_t) width);
+            }
+
+            RemoteTileHeader tile = {};
+            tile.x = (uint16_t) x;
+            tile.y = (uint16_t) y;
+            tile.width = (uint16_t) width;
+            tile.height = (uint16_t) height;
+            tile.size = (uint32_t) encode_runs(encoder -> delta, width * height,
+                                               encoder -> message + size + sizeof(RemoteTileHeader));
+
+            memcpy(encoder -> message + size, &tile, sizeof(tile));
+            size += sizeof(tile) + tile.size;
+
+            frame.tiles++;
+        }
+    }
+
+    RemoteHeader header = {};
+    header.type = REMOTE_FRAME;
+    header.size = (uint32_t) (size - sizeof(RemoteHeader));
+
+    memcpy(encoder -> message, &header, sizeof(header));
+    memcpy(encoder -> message + sizeof(header), &frame, sizeof(frame));
+
+    if (bytes) *bytes = size;
+
+    return write_all(fd, encoder -> message, size);
+}
+
+
+int remote_receive_frame(int fd, uint8_t *message, uint8_t *pixels, DirtyRegion *dirty, int *nmax, size_t *bytes) {
+    ASSERT(message, INVALID_ARG, "Can't receive into null message buffer!\n");
+    ASSERT(pixels, INVALID_ARG, "Can't receive into null screen!\n");
+    ASSERT(dirty, INVALID_ARG, "Can't receive without dirty region!\n");
+    ASSERT(nmax, INVALID_ARG, "Can't receive into null max iteration number!\n");
+
+    RemoteHeader header = {};
+    if (read_all(fd, &header, sizeof(header))) return FILE_NOT_FOUND;
+
+    ASSERT(header.type == REMOTE_FRAME, INVALID_FORMAT, "Unexpected message type %u!\n", header.type);
+    ASSERT(header.size >= sizeof(RemoteFrameHeader) && header.size <= remote_message_capacity() - sizeof(header),
+           INVALID_FORMAT, "Invalid frame size %u!\n", header.size);
+
+    if (read_all(fd, message, header.size)) return FILE_NOT_FOUND;
+
+    RemoteFrameHeader frame = {};
+    memcpy(&frame, message, sizeof(frame));
+
+    size_t offset = sizeof(frame);
+
+    for (uint32_t i = 0; i < frame.tiles; i++) {
+        RemoteTileHeader tile = {};
+
+        ASSERT(offset + sizeof(tile) <= header.size, INVALID_FORMAT, "Frame is truncated!\n");
+        memcpy(&tile, message + offset, sizeof(tile));
+        offset += sizeof(tile);
+
+        ASSERT(tile.width && tile.height && tile.x + tile.width <= SCREEN_W && tile.y + tile.height <= SCREEN_H,
+               INVALID_FORMAT, "Tile is out of screen!\n");
+        ASSERT(tile.size <= header.size - offset, INVALID_FORMAT, "Frame is truncated!\n");
+
+        if (decode_runs(message + offset, tile.size, &tile, pixels)) return INVALID_FORMAT;
+        offset += tile.size;
+
+        for (int row = tile.y; row < tile.y + tile.height; row++) dirty_add(dirty, tile.x, row, tile.width);
+    }
+
+    *nmax = frame.nmax;
+    if (bytes) *bytes = sizeof(header) + header.size;
+
+    return OK;
+}
+
+
+int remote_send_input(int fd, ViewInput input) {
+    struct {
+        RemoteHeader header;
+        uint32_t input;
+    } message = {{REMOTE_INPUT, sizeof(uint32_t)}, (uint32_t) input};
+
+    return write_all(fd, &message, sizeof(message));
+}
+
+
+int remote_receive_input(int fd, ViewInput *input) {
+    ASSERT(input, INVALID_ARG, "Can't receive into null input!\n");
+
+    RemoteHeader header = {};
+    uint32_t value = 0;
+
+    if (read_all(fd, &header, sizeof(header))) return FILE_NOT_FOUND;
+
+    ASSERT(header.type == REMOTE_INPUT && header.size == sizeof(value), INVALID_FORMAT, "Unexpected message type %u!\n",
+           header.type);
+
+    if (read_all(fd, &value, sizeof(value))) return FILE_NOT_FOUND;
+
+    // Unknown commands of newer front ends are ignored
+    *input = (value < INPUT_COUNT) ? (ViewInput) value : INPUT_NONE;
+
+    return OK;
+}
+
+
+int remote_connect(const char *host, int port) {
+    assert(host && "Can't connect to null host!\n");
+
+    char service[16] = "";
+    snprintf(service, sizeof(service), "%d", port);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *addresses = nullptr;
+    int error = getaddrinfo(host, service, &hints, &addresses);
+    if (error) {
+        printf("Can't resolve %s: %s\n", host, gai_strerror(error));
+        return -1;
+    }
+
+    int fd = -1;
+
+    for (addrinfo *address = addresses; address && fd < 0; address = address -> ai_next) {
+        fd = socket(address -> ai_family, address -> ai_socktype, address -> ai_protocol);
+        if (fd < 0) continue;
+
+        if (connect(fd, address -> ai_addr, address -> ai_addrlen)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(addresses);
+
+    if (fd < 0) {
+        printf("Can't connect to %s:%d!\n", host, port);
+        return -1;
+    }
+
+    // Input commands are tiny, they must not wait for more data
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    return fd;
+}
+
+
+static int write_all(int fd, const void *buffer, size_t size) {
+    const uint8_t *bytes = (const uint8_t *) buffer;
+
+    while (size) {
+        // Closed connection is reported as error instead of SIGPIPE
+        ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return FILE_NOT_FOUND;
+
+        bytes += written;
+        size -= (size_t) written;
+    }
+
+    return OK;
+}
+
+
+static int read_all(int fd, void *buffer, size_t size) {
+    uint8_t *bytes = (uint8_t *) buffer;
+
+    while (size) {
+        ssize_t count = recv(fd, bytes, size, 0);
+
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return FILE_NOT_FOUND;
+
+        bytes += count;
+        size -= (size_t) count;
+    }
+
+    return OK;
+}
+
+
+static bool rect_is_dirty(const DirtyRegion *dirty, int x, int y, int width, int height) {
+    int last = (y + height - 1) / DIRTY_BAND_ROWS;
+
+    for (int band = y / DIRTY_BAND_ROWS; band <= last; band++) {
+        if (dirty -> left[band] < x + width && dirty -> right[band] > x) return true;
+    }
+
+    return false;
+}
+
+
+static size_t encode_runs(const uint32_t *pixels, int count, uint8_t *output) {
+    size_t size = 0;
+    int i = 0;
+
+    while (i < count) {
+        int run = 1;
+        while (i + run < count && run < REMOTE_MAX_RUN && pixels[i + run] == pixels[i]) run++;
+
+        if (run > 1) {
+            output[size++] = (uint8_t) (REMOTE_MAX_LITERAL + run - 2);
+            memcpy(output + size, pixels + i, sizeof(uint32_t));
+            size += sizeof(uint32_t);
+
+            i += run;
+            continue;
+        }
+
+        // Literal sequence ends before the next pair of equal pixels
+        int length = 1;
+        while (i + length < count && length < REMOTE_MAX_LITERAL &&
+               !(i + length + 1 < count && pixels[i + length] == pixels[i + length + 1])) length++;
+
+        output[size++] = (uint8_t) (length - 1);
+        memcpy(output + size, pixels + i, sizeof(uint32_t) * (size_t) length);
+        size += sizeof(uint32_t) * (size_t) length;
+
+        i += length;
+    }
+
+    return size;
+}
+
+
+static int decode_runs(const uint8_t *input, size_t size, const RemoteTileHeader *tile, uint8_t *pixels) {
+    int count = tile -> width * tile -> height, index = 0;
+    size_t offset = 0;
+
+    while (offset < size) {
+        int code = input[offset++];
+        bool repeated = code >= REMOTE_MAX_LITERAL;
+        int length = repeated ? code - REMOTE_MAX_LITERAL + 2 : code + 1;
+
+        size_t data = repeated ? sizeof(uint32_t) : sizeof(uint32_t) * (size_t) length;
+        ASSERT(offset + data <= size && index + length <= count, INVALID_FORMAT, "Invalid tile encoding!\n");
+
+        for (int i = 0; i < length; i++, index++) {
+            uint32_t delta = 0, pixel = 0;
+            memcpy(&delta, input + offset + (repeated ? 0 : sizeof(uint32_t) * (size_t) i), sizeof(delta));
+
+            uint8_t *target = pixels + 4 * ((size_t) (tile -> y + index / tile -> width) * SCREEN_W +
+                                            (size_t) (tile -> x + index % tile -> width));
+            memcpy(&pixel, target, sizeof(pixel));
+            pixel ^= delta;
+            memcpy(target, &pixel, sizeof(pixel));
+        }
+
+        offset += data;
+    }
+
+    ASSERT(index == count, INVALID_FORMAT, "Invalid tile encoding!\n");
+
+    return OK;
+}
@@ -0,0 +1,133 @@
+/**
+ * \file
+ * \brief Header file for remote viewer protocol, window front end sends input commands and render back end
+ * answers with compressed deltas of changed screen tiles
+ * \note Every message is RemoteHeader and payload of its size. Input payload is one uint32_t command.
+ * Frame payload is RemoteFrameHeader and tiles, every tile is RemoteTileHeader and its pixels XOR previous
+ * pixels of the tile, packed with run length encoding. Fields are in host byte order
+*/
+
+#ifndef REMOTE_HPP
+#define REMOTE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "configs.hpp"
+#include "dirty.hpp"
+#include "input.hpp"
+
+
+const int REMOTE_TILES_X = (SCREEN_W + REMOTE_TILE - 1) / REMOTE_TILE;  ///< Tiles in a screen row
+const int REMOTE_TILES_Y = (SCREEN_H + REMOTE_TILE - 1) / REMOTE_TILE;  ///< Tiles in a screen column
+
+
+/// Message types
+typedef enum {
+    REMOTE_INPUT        = 1,        ///< Input command from front end
+    REMOTE_FRAME        = 2,        ///< Changed tiles from back end
+} RemoteMessage;
+
+
+/// Header of every message
+typedef struct {
+    uint32_t type = 0;                          ///< Message type
+    uint32_t size = 0;                          ///< Payload size in bytes
+} RemoteHeader;
+
+
+/// Header of frame payload
+typedef struct {
+    int32_t nmax = 0;                           ///< Max iteration number of the frame
+    uint32_t tiles = 0;                         ///< Number of tiles that follow
+} RemoteFrameHeader;
+
+
+/// Header of one tile
+typedef struct {
+    uint16_t x = 0;                             ///< Left column
+    uint16_t y = 0;                             ///< Top row
+    uint16_t width = 0;                         ///< Width in pixels
+    uint16_t height = 0;                        ///< Height in pixels
+    uint32_t size = 0;                          ///< Encoded size in bytes
+} RemoteTileHeader;
+
+
+/// Back end state, it knows what the front end shows
+typedef struct {
+    uint8_t *sent = nullptr;                    ///< Screen of the front end in RGBA format
+    uint32_t *delta = nullptr;                  ///< Tile pixels XOR sent pixels
+    uint8_t *message = nullptr;                 ///< Encoded frame message
+} RemoteEncoder;
+
+
+/**
+ * \brief Returns the largest frame message size, it is reached when every pixel changed and does not compress
+*/
+size_t remote_message_capacity(void);
+
+
+/**
+ * \brief Allocates encoder buffers, sent screen starts black like a new front end
+ * \return Non zero value means error
+*/
+int remote_encoder_create(RemoteEncoder *encoder);
+
+
+/**
+ * \brief Frees encoder buffers
+ * \return Non zero value means error
+*/
+int remote_encoder_free(RemoteEncoder *encoder);
+
+
+/**
+ * \brief Sends tiles of the dirty region that differ from what the front end has
+ * \param [in]     fd      Socket
+ * \param [in,out] encoder Encoder, sent screen is updated
+ * \param [in]     pixels  Screen buffer in RGBA format
+ * \param [in]     dirty   Changed pixels, tiles outside of it are not compared
+ * \param [in]     nmax    Max iteration number of the frame
+ * \param [out]    bytes   Sent bytes
+ * \return Non zero value means error
+*/
+int remote_send_frame(int fd, RemoteEncoder *encoder, const uint8_t *pixels, const DirtyRegion *dirty, int nmax,
+                      size_t *bytes);
+
+
+/**
+ * \brief Receives frame message and applies its tiles
+ * \param [in]     fd      Socket
+ * \param [out]    message Buffer of remote_message_capacity() bytes
+ * \param [in,out] pixels  Screen buffer in RGBA format
+ * \param [out]    dirty   Received tiles are added to it
+ * \param [out]    nmax    Max iteration number of the frame
+ * \param [out]    bytes   Received bytes
+ * \return Non zero value means error
+*/
+int remote_receive_frame(int fd, uint8_t *message, uint8_t *pixels, DirtyRegion *dirty, int *nmax, size_t *bytes);
+
+
+/**
+ * \brief Sends input command
+ * \return Non zero value means error
+*/
+int remote_send_input(int fd, ViewInput input);
+
+
+/**
+ * \brief Receives input command, blocks until it arrives
+ * \return Non zero value means error or closed connection
+*/
+int remote_receive_input(int fd, ViewInput *input);
+
+
+/**
+ * \brief Connects to back end
+ * \param [in] host    Host name or address
+ * \param [in] port    TCP port
+ * \return Socket descriptor or -1 on error
+*/
+int remote_connect(const char *host, int port);
+
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * \file
+ * \brief Batch renderer that saves one view into image file
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "kernel.hpp"
+#include "perturb.hpp"
+#include "pool.hpp"
+#include "estimate.hpp"
+#include "resample.hpp"
+#include "tilecache.hpp"
+#include "image.hpp"
+
+
+const int STATE_LINE_SIZE = BIGNUM_MAX_BITS;    ///< Fits state header line with any center string
+const char *const STATE_SIGNATURE = "MANDELBROT STATE 1";   ///< First line of state file
+const int SUPERSAMPLE_MAX = 8;                  ///< Max supersampling factor along each axis
+
+
+/// Batch render settings taken from command line
+typedef struct {
+    const char *center_x = "-0.75";             ///< Center x as decimal string
+    const char *center_y = "0";                 ///< Center y as decimal string
+    const char *span = "3.5";                   ///< View width like "1e-500"
+    int width = SCREEN_W;                       ///< Image width
+    int height = SCREEN_H;                      ///< Image height
+    int nmax = NMAX;                            ///< Max iteration number
+    int threads = 0;                            ///< Number of worker threads, zero means CPU limits
+    const char *output = "mandelbrot.ppm";      ///< Output image path
+    const char *state = nullptr;                ///< Resume state file, continued if it has the same view
+    int estimate = 0;                           ///< Sample stride of time estimate, zero means render
+    int supersample = 1;                        ///< Rendered pixels per output pixel along each axis
+    ResampleFilter filter = FILTER_LANCZOS;     ///< Downscale filter of supersampled image
+    const char *cache = TILE_CACHE_NAME;        ///< Shared tile cache name, "off" disables it
+} RenderArgs;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], RenderArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Prints render time estimate of the view
+ * \param [in]     view    View to estimate
+ * \param [in,out] pool    Worker pool the render would use
+ * \param [in]     stride  Sample stride
+ * \return Non zero value means error
+*/
+int print_estimate(const DeepView *view, WorkerPool *pool, int stride);
+
+
+/**
+ * \brief Renders view through shared tile cache, falls back to plain render if the cache can't be opened
+ * \param [in]     args    Render settings
+ * \param [in]     view    View to render
+ * \param [out]    iters   Iteration numbers
+ * \param [in,out] pool    Worker pool
+ * \param [out]    stats   Glitch correction results
+ * \return Non zero value means error
+*/
+int render_cached(const RenderArgs *args, const DeepView *view, int *iters, WorkerPool *pool, PerturbStats *stats);
+
+
+/**
+ * \brief Downscales supersampled image to the output size and saves it
+ * \param [in] args    Render settings with supersampled size
+ * \param [in] pixels  Supersampled image
+ * \return Non zero value means error
+*/
+int write_supersampled(const RenderArgs *args, const uint8_t *pixels);
+
+
+/**
+ * \brief Loads iteration numbers and resume state saved for the same view with lower limit
+ * \note Missing file or state of another view leaves resume empty and is not an error
+ * \param [in]  args    Render settings
+ * \param [out] iters   Iteration numbers
+ * \param [out] resume  Allocated resume state
+ * \return Non zero value means error
+*/
+int load_state(const RenderArgs *args, int *iters, PerturbResume *resume);
+
+
+/**
+ * \brief Saves iteration numbers and deltas of pixels that reached the limit
+ * \param [in] args    Render settings
+ * \param [in] iters   Iteration numbers
+ * \param [in] resume  Resume state
+ * \return Non zero value means error
+*/
+int save_state(const RenderArgs *args, const int *iters, const PerturbResume *resume);
+
+
+/**
+ * \brief Reads header line without line break
+ * \return Non zero value means error
+*/
+int read_line(FILE *file, char *line);
+
+
+
+
+int main(int argc, char *argv[]) {
+    RenderArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    // Everything below works on supersampled size, the image is shrunk only before saving
+    args.width *= args.supersample;
+    args.height *= args.supersample;
+
+    static DeepView view = {};
+    if (deep_view_parse(&view, args.center_x, args.center_y, args.span)) return INVALID_FORMAT;
+
+    view.width = args.width;
+    view.height = args.height;
+    view.nmax = args.nmax;
+
+    size_t pixels_count = (size_t) args.width * (size_t) args.height;
+
+    int *iters = (int *) calloc(pixels_count, sizeof(int));
+    ASSERT(iters, ALLOC_FAIL, "Can't allocate iterations buffer!\n");
+
+    uint8_t *pixels = (uint8_t *) calloc(pixels_count * 4, sizeof(uint8_t));
+    ASSERT(pixels, ALLOC_FAIL, "Can't allocate buffer for pixels colors!\n");
+
+    IterColor *color_table = nullptr;
+    if (load_color_table(COLOR_TABLE_FILE, &color_table)) return FILE_NOT_FOUND;
+
+    char span_str[32] = "";
+    floatexp_to_string(view.span, span_str);
+
+    printf("Rendering %dx%d, span %s, %d bits, %s deltas\n", view.width, view.height, span_str,
+           32 * (view.center_x.size - 1), (perturb_choose_tier(&view) == TIER_DOUBLE) ? "double" : "floatexp");
+
+    static WorkerPool pool = {};
+    if (pool_create(&pool, args.threads)) return ALLOC_FAIL;
+
+    if (args.estimate) {
+        int result = print_estimate(&view, &pool, args.estimate);
+
+        pool_destroy(&pool);
+        free(iters);
+        free(pixels);
+        free_color_table(&color_table);
+
+        return result;
+    }
+
+    static PerturbResume resume = {};
+    PerturbResume *resume_ptr = nullptr;
+
+    if (args.state) {
+        if (perturb_resume_create(&resume, (int) pixels_count)) return ALLOC_FAIL;
+        if (load_state(&args, iters, &resume)) return INVALID_FORMAT;
+
+        if (resume.nmax) printf("Continuing pixels that reached %d iterations\n", resume.nmax);
+
+        resume_ptr = &resume;
+    }
+
+    double start = get_seconds();
+
+    PerturbStats stats = {};
+    int result = OK;
+
+    // Cached tiles have no resume state, so continued renders do not use the cache
+    if (resume_ptr || !strcmp(args.cache, "off")) result = perturb_render(&view, iters, &pool, resume_ptr, &stats, nullptr);
+    else result = render_cached(&args, &view, iters, &pool, &stats);
+
+    printf("Rendered in %.3f s with %d threads\n", get_seconds() - start, pool.threads_count);
+    printf("References: %d in %d rounds, glitched pixels: %d, left: %d\n",
+           stats.references, stats.rounds, stats.glitched, stats.remaining);
+
+    if (resume_ptr) {
+        printf("Resumed pixels: %d\n", stats.resumed);
+
+        if (!result) result = save_state(&args, iters, &resume);
+        perturb_resume_free(&resume);
+    }
+
+    pool_destroy(&pool);
+
+    if (!result) {
+        colorize(color_table, iters, pixels, (int) pixels_count, view.nmax);
+
+        if (args.supersample > 1) result = write_supersampled(&args, pixels);
+        else                      result = write_ppm(args.output, pixels, view.width, view.height);
+    }
+
+    free(iters);
+    free(pixels);
+    free_color_table(&color_table);
+
+    return result;
+}
+
+
+int parse_args(int argc, char *argv[], RenderArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-x")) args -> center_x = value;
+        else if (!strcmp(argv[i - 1], "-y")) args -> center_y = value;
+        else if (!strcmp(argv[i - 1], "-s")) args -> span = value;
+        else if (!strcmp(argv[i - 1], "-w")) args -> width = atoi(value);
+        else if (!strcmp(argv[i - 1], "-h")) args -> height = atoi(value);
+        else if (!strcmp(argv[i - 1], "-n")) args -> nmax = atoi(value);
+        else if (!strcmp(argv[i - 1], "-t")) args -> threads = atoi(value);
+        else if (!strcmp(argv[i - 1], "-e")) args -> estimate = atoi(value);
+        else if (!strcmp(argv[i - 1], "-a")) args -> supersample = atoi(value);
+        else if (!strcmp(argv[i - 1], "-f")) {
+            if (resample_filter_parse(value, &args -> filter)) return INVALID_ARG;
+        }
+        else if (!strcmp(argv[i - 1], "-c")) args -> cache = value;
+        else if (!strcmp(argv[i - 1], "-o")) args -> output = value;
+        else if (!strcmp(argv[i - 1], "-r")) args -> state = value;
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(args -> width > 0 && args -> height > 0, INVALID_ARG, "Invalid image size!\n");
+    ASSERT(args -> nmax > 0, INVALID_ARG, "Invalid max iteration number!\n");
+    ASSERT(args -> estimate >= 0, INVALID_ARG, "Invalid sample stride!\n");
+    ASSERT(args -> supersample > 0 && args -> supersample <= SUPERSAMPLE_MAX, INVALID_ARG, "Invalid supersampling factor!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: render.exe [-x center_x] [-y center_y] [-s span] [-w width] [-h height] [-n nmax] [-t threads] [-o output.ppm] [-r state] [-e sample_stride] [-a supersample] [-f box|mitchell|lanczos] [-c cache|off]\n");
+}
+
+
+int print_estimate(const DeepView *view, WorkerPool *pool, int stride) {
+    ASSERT(view, INVALID_ARG, "Can't estimate null view!\n");
+
+    RenderEstimate estimate = {};
+    int result = estimate_render(view, pool, stride, &estimate);
+    if (result) return result;
+
+    printf("Sampled %d pixels in %.3f s, reference orbit %.3f s, %.1f +- %.1f Miter/s\n", estimate.samples,
+           estimate.sample_seconds, estimate.ref_seconds, 1e-6 * estimate.throughput, 1e-6 * estimate.throughput_error);
+    printf("Iterations: %.4g +- %.2g\n", estimate.iters, estimate.iters_error);
+    printf("Estimated time: %.3f s +- %.3f s (95%% sampling error) with %d threads\n", estimate.seconds,
+           estimate.seconds_error, pool -> threads_count);
+
+    if (estimate.glitched)
+        printf("Glitched sample pixels: %d, glitch correction about %.3f s is included\n", estimate.glitched,
+               estimate.glitch_seconds);
+
+    // Sampling error says how well the sample is measured, not how well the model predicts the render
+    printf("Error covers only sampling, not the glitch correction model or full render running at other throughput\n");
+
+    return OK;
+}
+
+
+int render_cached(const RenderArgs *args, const DeepView *view, int *iters, WorkerPool *pool, PerturbStats *stats) {
+    ASSERT(args, INVALID_ARG, "Can't render with null args!\n");
+
+    TileCache cache = {};
+    if (tile_cache_open(&cache, args -> cache)) {
+        printf("Rendering without tile cache\n");
+        return perturb_render(view, iters, pool, nullptr, stats, nullptr);
+    }
+
+    TileCacheStats cache_stats = {};
+    int result = tile_cache_render(&cache, view, nullptr, iters, pool, stats, nullptr, &cache_stats);
+
+    printf("Tile cache: %d of %d tiles reused, %d stored, %lu tiles in %s\n", cache_stats.hits, cache_stats.tiles,
+           cache_stats.stored, (unsigned long) cache.header -> stored.load(), args -> cache);
+
+    tile_cache_close(&cache);
+
+    return result;
+}
+
+
+int write_supersampled(const RenderArgs *args, const uint8_t *pixels) {
+    ASSERT(args, INVALID_ARG, "Can't save with null args!\n");
+    ASSERT(pixels, INVALID_ARG, "Can't save null image!\n");
+
+    int width = args -> width / args -> supersample, height = args -> height / args -> supersample;
+
+    uint8_t *image = (uint8_t *) calloc((size_t) width * (size_t) height * 4, sizeof(uint8_t));
+    ASSERT(image, ALLOC_FAIL, "Can't allocate output image!\n");
+
+    double start = get_seconds();
+    int result = resample_rgba(pixels, args -> width, args -> height, image, width, height, args -> filter);
+
+    if (!result) {
+        printf("Downscaled %dx%d to %dx%d in %.3f s\n", args -> width, args -> height, width, height,
+               get_seconds() - start);
+        result = write_ppm(args -> output, image, width, height);
+    }
+
+    free(image);
+
+    return result;
+}
+
+
+int load_state(const RenderArgs *args, int *iters, PerturbResume *resume) {
+    ASSERT(args && args -> state, INVALID_ARG, "Can't load state without filename!\n");
+    ASSERT(iters, INVALID_ARG, "Can't load state into null buffer!\n");
+    ASSERT(resume, INVALID_ARG, "Can't load into null resume state!\n");
+
+    resume -> nmax = 0;
+
+    FILE *file = fopen(args -> state, "rb");
+    if (!file) return OK;
+
+    static char line[STATE_LINE_SIZE] = "";
+    const char *strings[] = {STATE_SIGNATURE, args -> center_x, args -> center_y, args -> span};
+
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        if (read_line(file, line) || strcmp(line, strings[i])) {
+            printf("State %s belongs to another view, rendering from scratch\n", args -> state);
+            fclose(file);
+            return OK;
+        }
+    }
+
+    int width = 0, height = 0, nmax = 0;
+    if (read_line(file, line) || sscanf(line, "%d %d %d", &width, &height, &nmax) != 3 ||
+        width != args -> width || height != args -> height) {
+        printf("State %s belongs to another view, rendering from scratch\n", args -> state);
+        fclose(file);
+        return OK;
+    }
+
+    if (nmax >= args -> nmax) {
+        printf("State %s has %d iterations already, rendering from scratch\n", args -> state, nmax);
+        fclose(file);
+        return OK;
+    }
+
+    size_t pixels_count = (size_t) width * (size_t) height;
+
+    if (fread(iters, sizeof(int), pixels_count, file) != pixels_count) {
+        fclose(file);
+
+        printf("State %s is truncated!\n", args -> state);
+        return INVALID_FORMAT;
+    }
+
+    for (size_t i = 0; i < pixels_count; i++) {
+        if (iters[i] != nmax) continue;
+
+        if (fread(resume -> delta_re + i, sizeof(FloatExp), 1, file) != 1 ||
+            fread(resume -> delta_im + i, sizeof(FloatExp), 1, file) != 1 ||
+            fread(resume -> reference + i, sizeof(int), 1, file) != 1) {
+            fclose(file);
+
+            printf("State %s is truncated!\n", args -> state);
+            return INVALID_FORMAT;
+        }
+    }
+
+    fclose(file);
+
+    resume -> nmax = nmax;
+
+    return OK;
+}
+
+
+int save_state(const RenderArgs *args, const int *iters, const PerturbResume *resume) {
+    ASSERT(args && args -> state, INVALID_ARG, "Can't save state without filename!\n");
+    ASSERT(iters, INVALID_ARG, "Can't save null iterations!\n");
+    ASSERT(resume, INVALID_ARG, "Can't save null resume state!\n");
+
+    FILE *file = fopen(args -> state, "wb");
+    ASSERT(file, FILE_NOT_FOUND, "Can't open %s!\n", args -> state);
+
+    fprintf(file, "%s\n%s\n%s\n%s\n%d %d %d\n", STATE_SIGNATURE, args -> center_x, args -> center_y, args -> span,
+            args -> width, args -> height, resume -> nmax);
+
+    size_t pixels_count = (size_t) args -> width * (size_t) args -> height;
+
+    fwrite(iters, sizeof(int), pixels_count, file);
+
+    // Deltas are stored only for pixels that can be continued
+    for (size_t i = 0; i < pixels_count; i++) {
+        if (iters[i] != resume -> nmax) continue;
+
+        fwrite(resume -> delta_re + i, sizeof(FloatExp), 1, file);
+        fwrite(resume -> delta_im + i, sizeof(FloatExp), 1, file);
+        fwrite(resume -> reference + i, sizeof(int), 1, file);
+    }
+
+    fclose(file);
+
+    return OK;
+}
+
+
+int read_line(FILE *file, char *line) {
+    if (!fgets(line, STATE_LINE_SIZE, file)) return INVALID_FORMAT;
+
+    line[strcspn(line, "\n")] = '\0';
+
+    return OK;
+}
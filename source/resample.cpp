@@ -0,0 +1,427 @@
+/**
+ * \file
+ * \brief Source file for separable resampling filters used by supersampled exports and preview upscale
+*/
+
+#include <assert.h>
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.hpp"
+#include "resample.hpp"
+
+
+const int SRGB_TABLE_SIZE = 4096;               ///< Linear to sRGB table resolution
+const double MITCHELL_B = 1.0 / 3;              ///< Mitchell-Netravali B parameter
+const double MITCHELL_C = 1.0 / 3;              ///< Mitchell-Netravali C parameter
+const double LANCZOS_LOBES = 3;                 ///< Lanczos window size
+
+
+/// Lookup tables of sRGB transfer function
+typedef struct {
+    float to_linear[256] = {};                  ///< 8 bit sRGB to linear light
+    uint8_t to_srgb[SRGB_TABLE_SIZE] = {};      ///< Linear light in [0, 1] to 8 bit sRGB
+} SrgbTables;
+
+
+/**
+ * \brief Returns filter radius in source pixels when image is not downscaled
+*/
+static double filter_support(ResampleFilter filter);
+
+
+/**
+ * \brief Returns filter value at distance x
+*/
+static double filter_value(ResampleFilter filter, double x);
+
+
+/**
+ * \brief Calculates weights of resizing one axis
+ * \param [out] table       Table to allocate and fill
+ * \param [in]  src_size    Source size
+ * \param [in]  dst_size    Destination size
+ * \param [in]  filter      Filter
+ * \return Non zero value means error
+*/
+static int table_create(FilterTable *table, int src_size, int dst_size, ResampleFilter filter);
+
+
+/**
+ * \brief Free table buffers
+*/
+static void table_free(FilterTable *table);
+
+
+/**
+ * \brief Resizes rows, two rows are filtered at once in one AVX2 register
+*/
+static void resample_rows(const float *src, int src_w, int height, float *dst, int dst_w, const FilterTable *table);
+
+
+/**
+ * \brief Resizes columns into one destination row, every tap adds weighted source row to it
+*/
+static void resample_column(const float *src, int width, float *out, int y, const FilterTable *table);
+
+
+/**
+ * \brief Returns sRGB tables, they are filled on the first call
+*/
+static const SrgbTables *srgb_tables(void);
+
+
+/**
+ * \brief Fills sRGB tables
+*/
+static SrgbTables create_srgb_tables(void);
+
+
+
+
+int resample_filter_parse(const char *name, ResampleFilter *filter) {
+    ASSERT(name && filter, INVALID_ARG, "Can't parse null filter!\n");
+
+    if      (!strcmp(name, "box")) *filter = FILTER_BOX;
+    else if (!strcmp(name, "mitchell")) *filter = FILTER_MITCHELL;
+    else if (!strcmp(name, "lanczos")) *filter = FILTER_LANCZOS;
+    else ASSERT(0, INVALID_ARG, "Unknown filter %s!\n", name);
+
+    return OK;
+}
+
+
+int resampler_create(Resampler *resampler, int src_w, int src_h, int dst_w, int dst_h, ResampleFilter filter) {
+    ASSERT(resampler, INVALID_ARG, "Can't create null resampler!\n");
+    ASSERT(src_w > 0 && src_h > 0 && dst_w > 0 && dst_h > 0, INVALID_ARG, "Invalid image size!\n");
+
+    *resampler = {};
+    resampler -> src_w = src_w;
+    resampler -> src_h = src_h;
+    resampler -> dst_w = dst_w;
+    resampler -> dst_h = dst_h;
+
+    int lines = (2 * src_w > dst_w) ? 2 * src_w : dst_w;
+
+    resampler -> tmp = (float *) calloc((size_t) dst_w * (size_t) src_h * 4, sizeof(float));
+    resampler -> lines = (float *) calloc((size_t) lines * 4, sizeof(float));
+
+    int result = (resampler -> tmp && resampler -> lines) ? OK : ALLOC_FAIL;
+    if (!result) result = table_create(&resampler -> rows, src_w, dst_w, filter);
+    if (!result) result = table_create(&resampler -> columns, src_h, dst_h, filter);
+
+    if (result) {
+        printf("Can't allocate resampling buffers!\n");
+        resampler_free(resampler);
+    }
+
+    return result;
+}
+
+
+int resampler_free(Resampler *resampler) {
+    ASSERT(resampler, INVALID_ARG, "Can't free null resampler!\n");
+
+    table_free(&resampler -> rows);
+    table_free(&resampler -> columns);
+    free(resampler -> tmp);
+    free(resampler -> lines);
+
+    *resampler = {};
+
+    return OK;
+}
+
+
+void resampler_linear(Resampler *resampler, const float *src, float *dst) {
+    assert(resampler && resampler -> tmp && "Can't resample with null resampler!\n");
+    assert(src && dst && "Can't resample null image!\n");
+
+    const int dst_w = resampler -> dst_w;
+
+    resample_rows(src, resampler -> src_w, resampler -> src_h, resampler -> tmp, dst_w, &resampler -> rows);
+
+    for (int y = 0; y < resampler -> dst_h; y++)
+        resample_column(resampler -> tmp, dst_w, dst + 4 * (size_t) y * (size_t) dst_w, y, &resampler -> columns);
+}
+
+
+void resampler_rgba(Resampler *resampler, const uint8_t *src, uint8_t *dst) {
+    assert(resampler && resampler -> tmp && "Can't resample with null resampler!\n");
+    assert(src && dst && "Can't resample null image!\n");
+
+    const int src_w = resampler -> src_w, src_h = resampler -> src_h, dst_w = resampler -> dst_w;
+    float *lines = resampler -> lines;
+
+    // Row pairs are converted while they are in cache, rows pass filters both of them in one register
+    for (int y = 0; y < src_h; y += 2) {
+        int height = (y + 1 < src_h) ? 2 : 1;
+
+        rgba_to_linear(src + 4 * (size_t) y * (size_t) src_w, lines, height * src_w);
+        resample_rows(lines, src_w, height, resampler -> tmp + 4 * (size_t) y * (size_t) dst_w, dst_w, &resampler -> rows);
+    }
+
+    for (int y = 0; y < resampler -> dst_h; y++) {
+        resample_column(resampler -> tmp, dst_w, lines, y, &resampler -> columns);
+        linear_to_rgba(lines, dst + 4 * (size_t) y * (size_t) dst_w, dst_w);
+    }
+}
+
+
+int resample_linear(const float *src, int src_w, int src_h, float *dst, int dst_w, int dst_h, ResampleFilter filter) {
+    ASSERT(src && dst, INVALID_ARG, "Can't resample null image!\n");
+
+    Resampler resampler = {};
+    int result = resampler_create(&resampler, src_w, src_h, dst_w, dst_h, filter);
+    if (result) return result;
+
+    resampler_linear(&resampler, src, dst);
+
+    return resampler_free(&resampler);
+}
+
+
+int resample_rgba(const uint8_t *src, int src_w, int src_h, uint8_t *dst, int dst_w, int dst_h, ResampleFilter filter) {
+    ASSERT(src && dst, INVALID_ARG, "Can't resample null image!\n");
+
+    Resampler resampler = {};
+    int result = resampler_create(&resampler, src_w, src_h, dst_w, dst_h, filter);
+    if (result) return result;
+
+    resampler_rgba(&resampler, src, dst);
+
+    return resampler_free(&resampler);
+}
+
+
+void rgba_to_linear(const uint8_t *src, float *dst, int count) {
+    assert(src && dst && "Can't convert null pixels!\n");
+
+    const SrgbTables *tables = srgb_tables();
+
+    for (int i = 0; i < count; i++, src += 4, dst += 4) {
+        dst[0] = tables -> to_linear[src[0]];
+        dst[1] = tables -> to_linear[src[1]];
+        dst[2] = tables -> to_linear[src[2]];
+        dst[3] = (float) src[3] / 255.0f;
+    }
+}
+
+
+void linear_to_rgba(const float *src, uint8_t *dst, int count) {
+    assert(src && dst && "Can't convert null pixels!\n");
+
+    const SrgbTables *tables = srgb_tables();
+
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set_ps(255.0f, SRGB_TABLE_SIZE - 1, SRGB_TABLE_SIZE - 1, SRGB_TABLE_SIZE - 1);
+
+    for (int i = 0; i < count; i++, src += 4, dst += 4) {
+        // Negative lobes of Mitchell and Lanczos can leave range, so values are clamped before lookup
+        __m128 value = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), zero), one), scale);
+
+        alignas(16) int index[4] = {};
+        _mm_store_si128((__m128i *) index, _mm_cvtps_epi32(value));
+
+        dst[0] = tables -> to_srgb[index[0]];
+        dst[1] = tables -> to_srgb[index[1]];
+        dst[2] = tables -> to_srgb[index[2]];
+        dst[3] = (uint8_t) index[3];
+    }
+}
+
+
+static double filter_support(ResampleFilter filter) {
+    switch (filter) {
+        case FILTER_BOX:        return 0.5;
+        case FILTER_MITCHELL:   return 2;
+        case FILTER_LANCZOS:    return LANCZOS_LOBES;
+        default:                return 0.5;
+    }
+}
+
+
+static double filter_value(ResampleFilter filter, double x) {
+    x = fabs(x);
+
+    switch (filter) {
+        case FILTER_BOX:
+            return (x < 0.5) ? 1 : 0;
+
+        case FILTER_MITCHELL: {
+            const double B = MITCHELL_B, C = MITCHELL_C;
+
+            if (x < 1) return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6;
+            if (x < 2) return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6;
+
+            return 0;
+        }
+
+        case FILTER_LANCZOS: {
+            if (x < 1e-8) return 1;
+            if (x >= LANCZOS_LOBES) return 0;
+
+            double px = M_PI * x;
+            return LANCZOS_LOBES * sin(px) * sin(px / LANCZOS_LOBES) / (px * px);
+        }
+
+        default: return 0;
+    }
+}
+
+
+static int table_create(FilterTable *table, int src_size, int dst_size, ResampleFilter filter) {
+    double scale = (double) dst_size / src_size;
+
+    // Downscale stretches filter over source pixels, so every source pixel contributes
+    double stretch = (scale < 1) ? 1 / scale : 1;
+    double support = filter_support(filter) * stretch;
+
+    table -> taps = 2 * (int) ceil(support) + 1;
+    table -> start = (int *) calloc((size_t) dst_size, sizeof(int));
+    table -> count = (int *) calloc((size_t) dst_size, sizeof(int));
+    table -> weights = (float *) calloc((size_t) dst_size * (size_t) table -> taps, sizeof(float));
+
+    if (!table -> start || !table -> count || !table -> weights) return ALLOC_FAIL;
+
+    for (int i = 0; i < dst_size; i++) {
+        double center = (i + 0.5) / scale;
+
+        int first = (int) floor(center - support + 0.5);
+        int last = (int) floor(center + support + 0.5);
+
+        if (first < 0) first = 0;
+        if (last > src_size) last = src_size;
+        if (last - first > table -> taps) last = first + table -> taps;
+
+        float *weights = table -> weights + (size_t) i * (size_t) table -> taps;
+        double sum = 0;
+
+        for (int j = first; j < last; j++) {
+            double weight = filter_value(filter, (j + 0.5 - center) / stretch);
+
+            weights[j - first] = (float) weight;
+            sum += weight;
+        }
+
+        // Box filter between two pixels can miss both of them, nearest pixel is taken then
+        if (fabs(sum) < 1e-12) {
+            first = (int) center;
+            if (first >= src_size) first = src_size - 1;
+
+            last = first + 1;
+            weights[0] = 1;
+            sum = 1;
+        }
+
+        for (int j = 0; j < last - first; j++) weights[j] = (float) (weights[j] / sum);
+
+        table -> start[i] = first;
+        table -> count[i] = last - first;
+    }
+
+    return OK;
+}
+
+
+static void table_free(FilterTable *table) {
+    free(table -> start);
+    free(table -> count);
+    free(table -> weights);
+
+    *table = {};
+}
+
+
+static void resample_rows(const float *src, int src_w, int height, float *dst, int dst_w, const FilterTable *table) {
+    const size_t src_stride = 4 * (size_t) src_w, dst_stride = 4 * (size_t) dst_w;
+
+    int y = 0;
+
+    for (; y + 1 < height; y += 2) {
+        const float *row = src + (size_t) y * src_stride;
+        float *out = dst + (size_t) y * dst_stride;
+
+        for (int x = 0; x < dst_w; x++) {
+            const float *pixel = row + 4 * table -> start[x];
+            const float *weights = table -> weights + (size_t) x * (size_t) table -> taps;
+
+            __m256 acc = _mm256_setzero_ps();
+
+            // Low half is pixel of the first row, high half is the same pixel of the second row
+            for (int j = 0; j < table -> count[x]; j++, pixel += 4) {
+                __m256 pair = _mm256_set_m128(_mm_loadu_ps(pixel + src_stride), _mm_loadu_ps(pixel));
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(pair, _mm256_set1_ps(weights[j])));
+            }
+
+            _mm_storeu_ps(out + 4 * x, _mm256_castps256_ps128(acc));
+            _mm_storeu_ps(out + dst_stride + 4 * x, _mm256_extractf128_ps(acc, 1));
+        }
+    }
+
+    if (y < height) {
+        const float *row = src + (size_t) y * src_stride;
+        float *out = dst + (size_t) y * dst_stride;
+
+        for (int x = 0; x < dst_w; x++) {
+            const float *pixel = row + 4 * table -> start[x];
+            const float *weights = table -> weights + (size_t) x * (size_t) table -> taps;
+
+            __m128 acc = _mm_setzero_ps();
+
+            for (int j = 0; j < table -> count[x]; j++, pixel += 4)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(pixel), _mm_set1_ps(weights[j])));
+
+            _mm_storeu_ps(out + 4 * x, acc);
+        }
+    }
+}
+
+
+static void resample_column(const float *src, int width, float *out, int y, const FilterTable *table) {
+    const int floats = 4 * width;
+    const float *weights = table -> weights + (size_t) y * (size_t) table -> taps;
+
+    memset(out, 0, (size_t) floats * sizeof(float));
+
+    // Rows are read one after another, so source is streamed instead of walked by columns
+    for (int j = 0; j < table -> count[y]; j++) {
+        const float *row = src + (size_t) (table -> start[y] + j) * (size_t) floats;
+        const __m256 weight = _mm256_set1_ps(weights[j]);
+
+        int i = 0;
+        for (; i + 8 <= floats; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(row + i), weight)));
+
+        // Odd width leaves one pixel
+        if (i < floats)
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), _mm256_castps256_ps128(weight))));
+    }
+}
+
+
+static const SrgbTables *srgb_tables(void) {
+    static const SrgbTables tables = create_srgb_tables();
+
+    return &tables;
+}
+
+
+static SrgbTables create_srgb_tables(void) {
+    SrgbTables tables = {};
+
+    for (int i = 0; i < 256; i++) {
+        double c = i / 255.0;
+        tables.to_linear[i] = (float) ((c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+    }
+
+    for (int i = 0; i < SRGB_TABLE_SIZE; i++) {
+        double l = (double) i / (SRGB_TABLE_SIZE - 1);
+        double c = (l <= 0.0031308) ? 12.92 * l : 1.055 * pow(l, 1 / 2.4) - 0.055;
+
+        tables.to_srgb[i] = (uint8_t) lround(255 * c);
+    }
+
+    return tables;
+}
@@ -0,0 +1,140 @@
+/**
+ * \file
+ * \brief Header file for separable resampling filters used by supersampled exports and preview upscale
+*/
+
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include <stdint.h>
+
+
+/// Resampling filters
+typedef enum {
+    FILTER_BOX          = 0,        ///< Area average, the cheapest one
+    FILTER_MITCHELL     = 1,        ///< Mitchell-Netravali cubic with B = C = 1/3, small ringing
+    FILTER_LANCZOS      = 2,        ///< Lanczos with 3 lobes, the sharpest one
+} ResampleFilter;
+
+
+/// Source pixels and weights of every destination pixel along one axis
+typedef struct {
+    int *start = nullptr;                       ///< First source pixel
+    int *count = nullptr;                       ///< Number of source pixels
+    float *weights = nullptr;                   ///< Weights, taps for every destination pixel
+    int taps = 0;                               ///< Max number of source pixels
+} FilterTable;
+
+
+/// Resizer of one source and destination size, keeps filter tables and buffers between images
+typedef struct {
+    int src_w = 0;                              ///< Source width
+    int src_h = 0;                              ///< Source height
+    int dst_w = 0;                              ///< Destination width
+    int dst_h = 0;                              ///< Destination height
+    FilterTable rows = {};                      ///< Weights of rows pass
+    FilterTable columns = {};                   ///< Weights of columns pass
+    float *tmp = nullptr;                       ///< Rows pass result of dst_w * src_h pixels
+    float *lines = nullptr;                     ///< Linear light copy of two source rows or one destination row of 8 bit image
+} Resampler;
+
+
+/**
+ * \brief Parses filter name "box", "mitchell" or "lanczos"
+ * \param [in]  name    Filter name
+ * \param [out] filter  Parsed filter
+ * \return Non zero value means error
+*/
+int resample_filter_parse(const char *name, ResampleFilter *filter);
+
+
+/**
+ * \brief Calculates filter tables and allocates buffers of resizing images of the given sizes
+ * \param [out] resampler   Resampler to create
+ * \param [in]  src_w       Source width
+ * \param [in]  src_h       Source height
+ * \param [in]  dst_w       Destination width
+ * \param [in]  dst_h       Destination height
+ * \param [in]  filter      Filter
+ * \return Non zero value means error
+*/
+int resampler_create(Resampler *resampler, int src_w, int src_h, int dst_w, int dst_h, ResampleFilter filter);
+
+
+/**
+ * \brief Frees tables and buffers
+ * \return Non zero value means error
+*/
+int resampler_free(Resampler *resampler);
+
+
+/**
+ * \brief Resizes linear light RGBA image of resampler sizes without allocations
+ * \note Rows are filtered first, then columns. Both passes use AVX2 and work on two pixels per register
+ * \param [in,out] resampler   Resampler, its buffers are overwritten
+ * \param [in]     src         Source image
+ * \param [out]    dst         Destination image
+*/
+void resampler_linear(Resampler *resampler, const float *src, float *dst);
+
+
+/**
+ * \brief Resizes 8 bit sRGB RGBA image of resampler sizes in linear light without allocations
+ * \note Source rows are converted to linear light as the rows pass reads them and destination rows back as the
+ * columns pass writes them, so no whole image is kept in floats except the rows pass result
+ * \param [in,out] resampler   Resampler, its buffers are overwritten
+ * \param [in]     src         Source image
+ * \param [out]    dst         Destination image
+*/
+void resampler_rgba(Resampler *resampler, const uint8_t *src, uint8_t *dst);
+
+
+/**
+ * \brief Resizes linear light RGBA image, every channel is a float
+ * \note Tables and buffers are made for this call only, repeated resizes of the same sizes should keep a Resampler
+ * \param [in]  src     Source image
+ * \param [in]  src_w   Source width
+ * \param [in]  src_h   Source height
+ * \param [out] dst     Destination image
+ * \param [in]  dst_w   Destination width
+ * \param [in]  dst_h   Destination height
+ * \param [in]  filter  Filter
+ * \return Non zero value means error
+*/
+int resample_linear(const float *src, int src_w, int src_h, float *dst, int dst_w, int dst_h, ResampleFilter filter);
+
+
+/**
+ * \brief Resizes 8 bit sRGB RGBA image in linear light, alpha channel is filtered as is
+ * \note Tables and buffers are made for this call only, repeated resizes of the same sizes should keep a Resampler
+ * \param [in]  src     Source image
+ * \param [in]  src_w   Source width
+ * \param [in]  src_h   Source height
+ * \param [out] dst     Destination image
+ * \param [in]  dst_w   Destination width
+ * \param [in]  dst_h   Destination height
+ * \param [in]  filter  Filter
+ * \return Non zero value means error
+*/
+int resample_rgba(const uint8_t *src, int src_w, int src_h, uint8_t *dst, int dst_w, int dst_h, ResampleFilter filter);
+
+
+/**
+ * \brief Converts 8 bit sRGB RGBA pixels into linear light floats
+ * \param [in]  src     Source pixels
+ * \param [out] dst     Destination pixels
+ * \param [in]  count   Number of pixels
+*/
+void rgba_to_linear(const uint8_t *src, float *dst, int count);
+
+
+/**
+ * \brief Converts linear light float pixels into 8 bit sRGB RGBA, values are clamped
+ * \param [in]  src     Source pixels
+ * \param [out] dst     Destination pixels
+ * \param [in]  count   Number of pixels
+*/
+void linear_to_rgba(const float *src, uint8_t *dst, int count);
+
+
+#endif
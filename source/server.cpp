@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \brief Remote viewer back end, renders the view of one front end at a time and streams changed tiles to it
+*/
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "kernel.hpp"
+#include "input.hpp"
+#include "remote.hpp"
+
+
+const int SERVER_BACKLOG = 4;                   ///< Pending connections queue length
+
+
+/// Back end settings taken from command line
+typedef struct {
+    const char *address = "127.0.0.1";          ///< Listened IPv4 address, 0.0.0.0 accepts remote front ends
+    int port = REMOTE_PORT;                     ///< Listened TCP port
+} ServerArgs;
+
+
+/// Traffic of one front end connection
+typedef struct {
+    size_t frames = 0;                          ///< Sent frames
+    size_t bytes = 0;                           ///< Sent bytes
+    size_t full_bytes = 0;                      ///< Bytes that whole RGBA frames would take
+} ServerStats;
+
+
+/**
+ * \brief Parses command line arguments
+ * \param [out] args    Settings to fill
+ * \return Non zero value means error
+*/
+int parse_args(int argc, char *argv[], ServerArgs *args);
+
+
+/**
+ * \brief Prints command line usage
+*/
+void print_usage(void);
+
+
+/**
+ * \brief Creates listening TCP socket
+ * \param [in] args    Address and port
+ * \return Socket descriptor or -1 on error
+*/
+int open_socket(const ServerArgs *args);
+
+
+/**
+ * \brief Renders view of the front end until it disconnects
+ * \param [in] fd          Front end socket
+ * \param [in] color_table Palette
+ * \return Non zero value means error
+*/
+int serve_viewer(int fd, const IterColor *color_table);
+
+
+
+
+int main(int argc, char *argv[]) {
+    ServerArgs args = {};
+    if (parse_args(argc, argv, &args)) {
+        print_usage();
+        return INVALID_ARG;
+    }
+
+    IterColor *color_table = nullptr;
+    if (load_color_table(COLOR_TABLE_FILE, &color_table)) return FILE_NOT_FOUND;
+
+    int listener = open_socket(&args);
+    if (listener < 0) return FILE_NOT_FOUND;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on %s:%d\n", args.address, args.port);
+    fflush(stdout);
+
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // Frames are sent right after input is handled, small ones must not wait for more data
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        serve_viewer(fd, color_table);
+        close(fd);
+    }
+}
+
+
+int parse_args(int argc, char *argv[], ServerArgs *args) {
+    ASSERT(args, INVALID_ARG, "Can't parse into null args!\n");
+
+    for (int i = 1; i < argc; i++) {
+        ASSERT(i + 1 < argc, INVALID_ARG, "Option %s requires value!\n", argv[i]);
+
+        const char *value = argv[++i];
+
+        if      (!strcmp(argv[i - 1], "-a")) args -> address = value;
+        else if (!strcmp(argv[i - 1], "-p")) args -> port = atoi(value);
+        else ASSERT(0, INVALID_ARG, "Unknown option %s!\n", argv[i - 1]);
+    }
+
+    ASSERT(0 < args -> port && args -> port < 65536, INVALID_ARG, "Invalid port!\n");
+
+    return OK;
+}
+
+
+void print_usage(void) {
+    printf("Usage: server.exe [-a address] [-p port]\n");
+}
+
+
+int open_socket(const ServerArgs *args) {
+    assert(args && "Can't open socket with null args!\n");
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) args -> port);
+
+    if (inet_pton(AF_INET, args -> address, &address.sin_addr) != 1) {
+        printf("Invalid address %s!\n", args -> address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(fd, (const sockaddr *) &address, sizeof(address)) || listen(fd, SERVER_BACKLOG)) {
+        perror(args -> address);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+int serve_viewer(int fd, const IterColor *color_table) {
+    assert(color_table && "Can't serve without palette!\n");
+
+    uint8_t *pixels = (uint8_t *) calloc(SCREEN_W * SCREEN_H * 4, sizeof(uint8_t));
+    ASSERT(pixels, ALLOC_FAIL, "Can't allocate buffer for pixels colors!\n");
+
+    IterState state = {};
+    RemoteEncoder encoder = {};
+
+    if (iter_state_create(&state) || remote_encoder_create(&encoder)) {
+        iter_state_free(&state);
+        free(pixels);
+        return ALLOC_FAIL;
+    }
+
+    DirtyRegion dirty = {};
+    dirty_clear(&dirty);
+
+    Transform transform = {};
+    int nmax = NMAX;
+
+    ServerStats stats = {};
+    bool changed = true;
+
+    printf("Viewer connected\n");
+    fflush(stdout);
+
+    for (;;) {
+        // All queued input is applied before rendering, so fast key repeat does not pile up frames
+        pollfd request = {fd, POLLIN, 0};
+        int ready = poll(&request, 1, changed ? 0 : -1);
+
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) break;
+
+        if (ready > 0) {
+            ViewInput input = INPUT_NONE;
+            if (remote_receive_input(fd, &input)) break;
+
+            view_input_apply(input, &transform, &nmax);
+            changed = true;
+            continue;
+        }
+
+        if (iter_state_update(&state, &transform, nmax, &dirty))
+            colorize_dirty(color_table, state.iters, pixels, &dirty, nmax);
+
+        size_t bytes = 0;
+        if (remote_send_frame(fd, &encoder, pixels, &dirty, nmax, &bytes)) break;
+
+        dirty_clear(&dirty);
+        changed = false;
+
+        stats.frames++;
+        stats.bytes += bytes;
+        stats.full_bytes += 4 * (size_t) SCREEN_W * SCREEN_H;
+    }
+
+    printf("Viewer disconnected: %zu frames, sent %zu KB instead of %zu KB (%.1f%%)\n", stats.frames,
+           stats.bytes / 1024, stats.full_bytes / 1024,
+           stats.full_bytes ? 100.0 * (double) stats.bytes / (double) stats.full_bytes : 0.0);
+    fflush(stdout);
+
+    remote_encoder_free(&encoder);
+    iter_state_free(&state);
+    free(pixels);
+
+    return OK;
+}
@@ -0,0 +1,395 @@
+/**
+ * \file
+ * \brief Source file for exploration session that keeps every tile the viewer has calculated on disk
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "session.hpp"
+
+
+const uint64_t SESSION_MAGIC = 0x4d414e4453455353;     ///< "MANDSESS"
+const int SESSION_TILE_PIXELS = SESSION_TILE * SESSION_TILE;    ///< Pixels of one tile
+const int SESSION_FIRST_TILES = 64;                     ///< Tiles allocated when the first one is indexed
+
+
+/// Beginning of session file
+typedef struct {
+    uint64_t magic = SESSION_MAGIC;             ///< File signature
+    int32_t tile = SESSION_TILE;                ///< Tile side
+    int32_t levels = SESSION_OUT_LEVELS;        ///< Levels above the initial view
+    double root_pixel = 0;                      ///< Pixel size of the top level
+} SessionHeader;
+
+
+/// Header of one tile in session file, iteration numbers follow it
+typedef struct {
+    int32_t level = 0;                          ///< Quadtree level
+    int32_t nmax = 0;                           ///< Limit the tile was calculated with
+    int64_t x = 0;                              ///< Tile column
+    int64_t y = 0;                              ///< Tile row
+} SessionRecord;
+
+
+/**
+ * \brief Returns pixel size of the top level, initial view is SESSION_OUT_LEVELS levels below it
+*/
+static double session_root_pixel(void);
+
+
+/**
+ * \brief Finds quadtree level of the view
+ * \return False if pixels are not square or their size is not top level size divided by power of two
+*/
+static bool session_level(const Transform *transform, int *level);
+
+
+/**
+ * \brief Tells whether the tile lies inside the square of the quadtree root
+*/
+static bool session_in_root(int level, int64_t x, int64_t y);
+
+
+/**
+ * \brief Returns child index of the tile ancestor on the given level
+*/
+static int session_child(int level, int64_t x, int64_t y, int ancestor);
+
+
+/**
+ * \brief Adds tile to the index, tile with lower limit at the same place is replaced
+ * \return Non zero value means error
+*/
+static int session_index(Session *session, const SessionTile *tile);
+
+
+/**
+ * \brief Rounds down division by positive divisor
+*/
+static int64_t floor_div(int64_t value, int64_t divisor);
+
+
+
+
+int session_open(Session *session, const char *path) {
+    ASSERT(session, INVALID_ARG, "Can't open null session!\n");
+    ASSERT(path, INVALID_ARG, "Can't open session without path!\n");
+
+    *session = {};
+
+    // Append mode keeps the log valid, every record is written at the end whatever was read before
+    session -> file = fopen(path, "a+b");
+    ASSERT(session -> file, FILE_NOT_FOUND, "Can't open session %s!\n", path);
+
+    session -> nodes = (SessionNode *) calloc(1, sizeof(SessionNode));
+    session -> scratch = (int *) calloc(SESSION_TILE_PIXELS, sizeof(int));
+
+    if (!session -> nodes || !session -> scratch) {
+        session_close(session);
+
+        printf("Can't allocate session index!\n");
+        return ALLOC_FAIL;
+    }
+
+    session -> nodes[0] = {};
+    session -> nodes_count = 1;
+    session -> nodes_capacity = 1;
+
+    fseek(session -> file, 0, SEEK_END);
+    long size = ftell(session -> file);
+
+    SessionHeader header = {};
+    header.root_pixel = session_root_pixel();
+
+    if (!size) {
+        fwrite(&header, sizeof(header), 1, session -> file);
+
+        if (fflush(session -> file)) {
+            session_close(session);
+
+            printf("Can't write session %s!\n", path);
+            return FILE_NOT_FOUND;
+        }
+
+        return OK;
+    }
+
+    SessionHeader stored = {};
+    fseek(session -> file, 0, SEEK_SET);
+
+    if (fread(&stored, sizeof(stored), 1, session -> file) != 1 || stored.magic != header.magic ||
+        stored.tile != header.tile || stored.levels != header.levels ||
+        fabs(stored.root_pixel - header.root_pixel) > 1e-12 * header.root_pixel) {
+        session_close(session);
+
+        printf("Session %s is not a session of this viewer!\n", path);
+        return INVALID_FORMAT;
+    }
+
+    const long data_size = (long) (SESSION_TILE_PIXELS * sizeof(int));
+
+    long offset = (long) sizeof(stored);
+    SessionRecord record = {};
+
+    while (offset + (long) sizeof(record) + data_size <= size) {
+        fseek(session -> file, offset, SEEK_SET);
+        if (fread(&record, sizeof(record), 1, session -> file) != 1) break;
+
+        SessionTile tile = {record.level, record.nmax, record.x, record.y, offset + (long) sizeof(record)};
+        offset = tile.offset + data_size;
+
+        if (!session_in_root(tile.level, tile.x, tile.y)) continue;
+
+        int result = session_index(session, &tile);
+        if (result) {
+            session_close(session);
+            return result;
+        }
+    }
+
+    // Tile that was being written when the viewer died is just dropped
+    if (offset != size) printf("Session %s has truncated tile, it is ignored\n", path);
+
+    printf("Session %s: %d tiles, %d quadtree nodes\n", path, session -> tiles_count, session -> nodes_count);
+
+    return OK;
+}
+
+
+int session_close(Session *session) {
+    ASSERT(session, INVALID_ARG, "Can't close null session!\n");
+
+    int result = OK;
+    if (session -> file && fclose(session -> file)) result = FILE_NOT_FOUND;
+
+    free(session -> nodes);
+    free(session -> tiles);
+    free(session -> scratch);
+
+    *session = {};
+
+    return result;
+}
+
+
+int session_find(const Session *session, int level, int64_t x, int64_t y, int nmax) {
+    assert(session && "Can't search null session!\n");
+
+    if (!session_in_root(level, x, y)) return -1;
+
+    int node = 0;
+
+    for (int ancestor = 0; ancestor <= level; ancestor++) {
+        node = session -> nodes[node].children[session_child(level, x, y, ancestor)];
+        if (!node) return -1;
+    }
+
+    int tile = session -> nodes[node].tile;
+
+    return (tile >= 0 && session -> tiles[tile].nmax >= nmax) ? tile : -1;
+}
+
+
+int session_read(Session *session, int tile, int *iters) {
+    ASSERT(session && session -> file, INVALID_ARG, "Can't read from closed session!\n");
+    ASSERT(tile >= 0 && tile < session -> tiles_count, INVALID_ARG, "Invalid session tile %d!\n", tile);
+    ASSERT(iters, INVALID_ARG, "Can't read tile into null buffer!\n");
+
+    fseek(session -> file, session -> tiles[tile].offset, SEEK_SET);
+
+    size_t count = fread(iters, sizeof(int), SESSION_TILE_PIXELS, session -> file);
+    ASSERT(count == SESSION_TILE_PIXELS, INVALID_FORMAT, "Session tile %d is truncated!\n", tile);
+
+    return OK;
+}
+
+
+int session_store(Session *session, int level, int64_t x, int64_t y, int nmax, const int *iters) {
+    ASSERT(session && session -> file, INVALID_ARG, "Can't store into closed session!\n");
+    ASSERT(iters, INVALID_ARG, "Can't store null tile!\n");
+    ASSERT(session_in_root(level, x, y), INVALID_ARG, "Tile is out of session quadtree!\n");
+
+    SessionRecord record = {level, nmax, x, y};
+
+    fseek(session -> file, 0, SEEK_END);
+    long offset = ftell(session -> file) + (long) sizeof(record);
+
+    fwrite(&record, sizeof(record), 1, session -> file);
+    fwrite(iters, sizeof(int), SESSION_TILE_PIXELS, session -> file);
+
+    // Tile is on disk before it is in the index, so the index never points past the end of the file
+    ASSERT(!fflush(session -> file), FILE_NOT_FOUND, "Can't write session tile!\n");
+
+    SessionTile tile = {level, nmax, x, y, offset};
+    return session_index(session, &tile);
+}
+
+
+int session_update(Session *session, IterState *state, Transform *transform, int nmax, DirtyRegion *dirty) {
+    assert(session && session -> file && "Can't update from closed session!\n");
+    assert(state && transform && dirty && "Can't update null screen!\n");
+
+    int level = 0;
+    if (!session_level(transform, &level)) {
+        session -> level = -1;
+        return iter_state_update(state, transform, nmax, dirty);
+    }
+
+    const double pixel = (double) transform -> set_w / SCREEN_W;
+
+    int64_t screen_x = llround(((double) transform -> center_x - 0.5 * transform -> set_w) / pixel);
+    int64_t screen_y = llround(((double) transform -> center_y - 0.5 * transform -> set_h) / pixel);
+
+    transform -> center_x = (float) (((double) screen_x + 0.5 * SCREEN_W) * pixel);
+    transform -> center_y = (float) (((double) screen_y + 0.5 * SCREEN_H) * pixel);
+
+    if (session -> level == level && session -> screen_x == screen_x && session -> screen_y == screen_y &&
+        session -> nmax == nmax) return 0;
+
+    int64_t first_x = floor_div(screen_x, SESSION_TILE), last_x = floor_div(screen_x + SCREEN_W - 1, SESSION_TILE);
+    int64_t first_y = floor_div(screen_y, SESSION_TILE), last_y = floor_div(screen_y + SCREEN_H - 1, SESSION_TILE);
+
+    for (int64_t tile_y = first_y; tile_y <= last_y; tile_y++) {
+        for (int64_t tile_x = first_x; tile_x <= last_x; tile_x++) {
+            int tile = session_find(session, level, tile_x, tile_y, nmax);
+
+            if (tile >= 0 && !session_read(session, tile, session -> scratch)) session -> loaded++;
+            else {
+                iter_tile(session -> scratch, (double) (tile_x * SESSION_TILE) * pixel,
+                          (double) (tile_y * SESSION_TILE) * pixel, pixel, SESSION_TILE, nmax);
+                session -> computed++;
+
+                // Failed write only costs the tile being calculated again next time
+                if (session_in_root(level, tile_x, tile_y))
+                    session_store(session, level, tile_x, tile_y, nmax, session -> scratch);
+            }
+
+            // Visible part of the tile, clipped to the screen
+            int64_t left = tile_x * SESSION_TILE - screen_x, top = tile_y * SESSION_TILE - screen_y;
+
+            int begin_x = (int) (left < 0 ? -left : 0), end_x = (int) (left + SESSION_TILE > SCREEN_W ? SCREEN_W - left : SESSION_TILE);
+            int begin_y = (int) (top < 0 ? -top : 0), end_y = (int) (top + SESSION_TILE > SCREEN_H ? SCREEN_H - top : SESSION_TILE);
+
+            for (int y = begin_y; y < end_y; y++) {
+                const int *source = session -> scratch + y * SESSION_TILE;
+                int *target = state -> iters + (top + y) * SCREEN_W + left;
+
+                // Tile with higher limit gives the same numbers up to the limit
+                for (int x = begin_x; x < end_x; x++) target[x] = (source[x] < nmax) ? source[x] : nmax;
+            }
+        }
+    }
+
+    // Screen has no z for pixels at the limit, so iter_state_update must not continue them
+    state -> nmax = 0;
+
+    session -> level = level;
+    session -> screen_x = screen_x;
+    session -> screen_y = screen_y;
+    session -> nmax = nmax;
+
+    dirty_all(dirty);
+
+    return SCREEN_W * SCREEN_H;
+}
+
+
+static double session_root_pixel(void) {
+    return ldexp((double) SET_W / SCREEN_W, SESSION_OUT_LEVELS);
+}
+
+
+static bool session_level(const Transform *transform, int *level) {
+    double pixel_w = (double) transform -> set_w / SCREEN_W;
+    double pixel_h = (double) transform -> set_h / SCREEN_H;
+
+    if (!(pixel_w > 0) || fabs(pixel_w - pixel_h) > 1e-9 * pixel_w) return false;
+
+    int exponent = 0;
+    double mantissa = frexp(session_root_pixel() / pixel_w, &exponent);
+
+    // Ratio is exactly 2^(exponent - 1) for views zoomed by powers of two
+    if (fabs(mantissa - 0.5) > 1e-9) return false;
+
+    *level = exponent - 1;
+
+    return *level >= 0 && *level <= SESSION_MAX_LEVEL;
+}
+
+
+static bool session_in_root(int level, int64_t x, int64_t y) {
+    if (level < 0 || level > SESSION_MAX_LEVEL) return false;
+
+    // Root square is split into 2 x 2 tiles of level 0 around the origin
+    int64_t half = (int64_t) 1 << level;
+
+    return x >= -half && x < half && y >= -half && y < half;
+}
+
+
+static int session_child(int level, int64_t x, int64_t y, int ancestor) {
+    // Arithmetic shift keeps negative coordinates on their side of the origin
+    int64_t ancestor_x = x >> (level - ancestor), ancestor_y = y >> (level - ancestor);
+
+    return (int) ((ancestor_x & 1) | ((ancestor_y & 1) << 1));
+}
+
+
+static int session_index(Session *session, const SessionTile *tile) {
+    int node = 0;
+
+    for (int ancestor = 0; ancestor <= tile -> level; ancestor++) {
+        int child = session_child(tile -> level, tile -> x, tile -> y, ancestor);
+
+        if (!session -> nodes[node].children[child]) {
+            if (session -> nodes_count == session -> nodes_capacity) {
+                int capacity = 2 * session -> nodes_capacity;
+
+                SessionNode *nodes = (SessionNode *) realloc(session -> nodes, (size_t) capacity * sizeof(SessionNode));
+                ASSERT(nodes, ALLOC_FAIL, "Can't grow session quadtree!\n");
+
+                session -> nodes = nodes;
+                session -> nodes_capacity = capacity;
+            }
+
+            session -> nodes[session -> nodes_count] = {};
+            session -> nodes[node].children[child] = session -> nodes_count++;
+        }
+
+        node = session -> nodes[node].children[child];
+    }
+
+    int index = session -> nodes[node].tile;
+
+    if (index >= 0) {
+        // Later record of the same tile replaces the earlier one unless its limit is lower
+        if (session -> tiles[index].nmax <= tile -> nmax) session -> tiles[index] = *tile;
+        return OK;
+    }
+
+    if (session -> tiles_count == session -> tiles_capacity) {
+        int capacity = session -> tiles_capacity ? 2 * session -> tiles_capacity : SESSION_FIRST_TILES;
+
+        SessionTile *tiles = (SessionTile *) realloc(session -> tiles, (size_t) capacity * sizeof(SessionTile));
+        ASSERT(tiles, ALLOC_FAIL, "Can't grow session tiles!\n");
+
+        session -> tiles = tiles;
+        session -> tiles_capacity = capacity;
+    }
+
+    session -> nodes[node].tile = session -> tiles_count;
+    session -> tiles[session -> tiles_count++] = *tile;
+
+    return OK;
+}
+
+
+static int64_t floor_div(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+
+    return (value % divisor < 0) ? quotient - 1 : quotient;
+}
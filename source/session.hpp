@@ -0,0 +1,122 @@
+/**
+ * \file
+ * \brief Header file for exploration session that keeps every tile the viewer has calculated on disk
+ * \note Tiles are addressed by (level, x, y): level L has pixels 2^L times smaller than the top level and
+ * tile (L, x, y) covers pixels [x * SESSION_TILE, (x + 1) * SESSION_TILE) of the level grid. File is
+ * append only log of tiles, sparse quadtree index of them is built when the session is opened
+*/
+
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include "configs.hpp"
+#include "dirty.hpp"
+#include "kernel.hpp"
+
+
+/// Node of the quadtree, children cover quarters of its square
+typedef struct {
+    int children[4] = {};                       ///< Child node indices, zero means no child because root is never a child
+    int tile = -1;                              ///< Index of stored tile, negative means node has no tile
+} SessionNode;
+
+
+/// Stored tile
+typedef struct {
+    int level = 0;                              ///< Quadtree level
+    int nmax = 0;                               ///< Limit the tile was calculated with
+    int64_t x = 0;                              ///< Tile column on the level grid
+    int64_t y = 0;                              ///< Tile row on the level grid
+    long offset = 0;                            ///< File offset of iteration numbers
+} SessionTile;
+
+
+/// Opened session
+typedef struct {
+    FILE *file = nullptr;                       ///< Session file opened for appending
+    SessionNode *nodes = nullptr;               ///< Quadtree nodes, the first one is root
+    int nodes_count = 0;                        ///< Number of nodes
+    int nodes_capacity = 0;                     ///< Allocated nodes
+    SessionTile *tiles = nullptr;               ///< Stored tiles
+    int tiles_count = 0;                        ///< Number of tiles
+    int tiles_capacity = 0;                     ///< Allocated tiles
+    int *scratch = nullptr;                     ///< Iterations of one tile
+    int level = -1;                             ///< Level of the last shown screen, negative means it was not from session
+    int64_t screen_x = 0;                       ///< Left pixel of the last shown screen on the level grid
+    int64_t screen_y = 0;                       ///< Top pixel of the last shown screen on the level grid
+    int nmax = 0;                               ///< Limit of the last shown screen
+    long loaded = 0;                            ///< Number of tiles read from the session
+    long computed = 0;                          ///< Number of tiles calculated and stored
+} Session;
+
+
+/**
+ * \brief Opens session file, creates it if it does not exist, and builds quadtree of its tiles
+ * \param [out] session Session to open
+ * \param [in]  path    Session file
+ * \return Non zero value means error
+*/
+int session_open(Session *session, const char *path);
+
+
+/**
+ * \brief Closes session file and frees index
+ * \param [in,out] session Session to close
+ * \return Non zero value means error
+*/
+int session_close(Session *session);
+
+
+/**
+ * \brief Finds tile with limit not lower than the given one
+ * \param [in] session Session
+ * \param [in] level   Quadtree level
+ * \param [in] x       Tile column
+ * \param [in] y       Tile row
+ * \param [in] nmax    Required limit
+ * \return Tile index, negative if there is no such tile
+*/
+int session_find(const Session *session, int level, int64_t x, int64_t y, int nmax);
+
+
+/**
+ * \brief Reads iteration numbers of the tile
+ * \param [in,out] session Session
+ * \param [in]     tile    Tile index
+ * \param [out]    iters   Buffer of SESSION_TILE * SESSION_TILE iteration numbers
+ * \return Non zero value means error
+*/
+int session_read(Session *session, int tile, int *iters);
+
+
+/**
+ * \brief Appends tile to the session file and index, tile with lower limit at the same place is replaced
+ * \param [in,out] session Session
+ * \param [in]     level   Quadtree level
+ * \param [in]     x       Tile column
+ * \param [in]     y       Tile row
+ * \param [in]     nmax    Limit the tile was calculated with
+ * \param [in]     iters   SESSION_TILE * SESSION_TILE iteration numbers
+ * \return Non zero value means error
+*/
+int session_store(Session *session, int level, int64_t x, int64_t y, int nmax, const int *iters);
+
+
+/**
+ * \brief Brings screen iterations to the view, tiles are taken from the session and missing ones are calculated and stored
+ * \note View zoomed by powers of two from the initial one is snapped to the level grid, the center moves less than
+ * a pixel. Other views are calculated by iter_state_update. Screens from session have no z, so raised limit
+ * calculates tiles again instead of continuing pixels
+ * \param [in,out] session     Session
+ * \param [in,out] state       Screen iteration state
+ * \param [in,out] transform   Mandelbrot set offset and scale, center is snapped to the grid
+ * \param [in]     nmax        Max iteration number
+ * \param [out]    dirty       Changed pixels are added to it
+ * \return Number of changed pixels
+*/
+int session_update(Session *session, IterState *state, Transform *transform, int nmax, DirtyRegion *dirty);
+
+
+#endif
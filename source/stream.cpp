@@ -0,0 +1,165 @@
+/**
+ * \file
+ * \brief Source file for asynchronous screen render that delivers every finished tile as soon as it is ready
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "stream.hpp"
+
+
+/**
+ * \brief Renders one tile and delivers it, or skips it if render is cancelled
+*/
+static void stream_task(void *arg, int index);
+
+
+/**
+ * \brief Returns screen rectangle of the tile
+*/
+static DirtyRect stream_tile_rect(int tile);
+
+
+/**
+ * \brief Fills render order, tiles closer to the screen center go first
+*/
+static void stream_order(int *order);
+
+
+
+
+int stream_render_start(StreamRender *render, WorkerPool *pool, const IterColor *color_table, uint8_t *buffer,
+                        const Transform *transform, StreamCallback callback, void *arg) {
+    ASSERT(render, INVALID_ARG, "Can't start null render!\n");
+    ASSERT(!render -> active, INVALID_ARG, "Can't start render that is not finished!\n");
+    ASSERT(pool, INVALID_ARG, "Can't start render without worker pool!\n");
+    ASSERT(color_table, INVALID_ARG, "Can't start render without color table!\n");
+    ASSERT(buffer, INVALID_ARG, "Can't start render with null buffer!\n");
+    ASSERT(transform, INVALID_ARG, "Can't start render without transform!\n");
+
+    render -> pool = pool;
+    render -> color_table = color_table;
+    render -> buffer = buffer;
+    render -> transform = *transform;
+    render -> callback = callback;
+    render -> arg = arg;
+    render -> queued = 0;
+    render -> taken = 0;
+    render -> settled = 0;
+    render -> cancel.store(false, std::memory_order_relaxed);
+    render -> active = true;
+
+    stream_order(render -> order);
+
+    pool_submit(pool, &render -> job, stream_task, render, STREAM_TILES);
+
+    return OK;
+}
+
+
+bool stream_render_next(StreamRender *render, StreamTile *tile, bool wait) {
+    assert(render && render -> active && "Can't read tiles of render that is not started!\n");
+    assert(!render -> callback && "Tiles of render with callback are not queued!\n");
+    assert(tile && "Can't store null tile!\n");
+
+    std::unique_lock<std::mutex> guard(render -> lock);
+
+    if (wait) {
+        render -> ready.wait(guard, [render] {
+            return render -> taken < render -> queued || render -> settled == STREAM_TILES;
+        });
+    }
+
+    if (render -> taken == render -> queued) return false;
+
+    int index = render -> queue[render -> taken++];
+
+    tile -> rect = stream_tile_rect(index);
+    tile -> pixels = render -> buffer + 4 * ((size_t) tile -> rect.y * SCREEN_W + (size_t) tile -> rect.x);
+
+    return true;
+}
+
+
+void stream_render_cancel(StreamRender *render) {
+    assert(render && "Can't cancel null render!\n");
+
+    render -> cancel.store(true, std::memory_order_relaxed);
+}
+
+
+int stream_render_finish(StreamRender *render) {
+    ASSERT(render, INVALID_ARG, "Can't finish null render!\n");
+    ASSERT(render -> active, INVALID_ARG, "Can't finish render that is not started!\n");
+
+    pool_wait(render -> pool, &render -> job);
+    render -> active = false;
+
+    std::lock_guard<std::mutex> guard(render -> lock);
+
+    // Tiles given to the callback are counted in queued too, so it tells how many were rendered
+    return (render -> queued < STREAM_TILES) ? CANCELLED : OK;
+}
+
+
+static void stream_task(void *arg, int index) {
+    StreamRender *render = (StreamRender *) arg;
+
+    int tile = render -> order[index];
+    bool skip = render -> cancel.load(std::memory_order_relaxed);
+
+    if (!skip) {
+        StreamTile finished = {};
+        finished.rect = stream_tile_rect(tile);
+        finished.pixels = render -> buffer + 4 * ((size_t) finished.rect.y * SCREEN_W + (size_t) finished.rect.x);
+
+        set_pixels_rect(render -> color_table, render -> buffer, &render -> transform, &finished.rect);
+
+        if (render -> callback) render -> callback(render -> arg, &finished);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(render -> lock);
+
+        if (!skip) render -> queue[render -> queued++] = tile;
+        render -> settled++;
+    }
+
+    // Consumer may wait for the end of cancelled render, so skipped tiles wake it too
+    render -> ready.notify_all();
+}
+
+
+static DirtyRect stream_tile_rect(int tile) {
+    DirtyRect rect = {};
+    rect.x = (tile % STREAM_TILES_X) * STREAM_TILE;
+    rect.y = (tile / STREAM_TILES_X) * STREAM_TILE;
+    rect.width = (rect.x + STREAM_TILE > SCREEN_W) ? SCREEN_W - rect.x : STREAM_TILE;
+    rect.height = (rect.y + STREAM_TILE > SCREEN_H) ? SCREEN_H - rect.y : STREAM_TILE;
+
+    return rect;
+}
+
+
+static void stream_order(int *order) {
+    int distance[STREAM_TILES] = {};
+
+    for (int i = 0; i < STREAM_TILES; i++) {
+        // Doubled coordinates of tile center relative to the screen center, so they stay integer
+        int dx = 2 * (i % STREAM_TILES_X) + 1 - STREAM_TILES_X;
+        int dy = 2 * (i / STREAM_TILES_X) + 1 - STREAM_TILES_Y;
+
+        distance[i] = dx * dx + dy * dy;
+        order[i] = i;
+    }
+
+    // Insertion sort keeps row order of tiles at the same distance
+    for (int i = 1; i < STREAM_TILES; i++) {
+        int tile = order[i], j = i;
+
+        for (; j > 0 && distance[order[j - 1]] > distance[tile]; j--) order[j] = order[j - 1];
+        order[j] = tile;
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ * \file
+ * \brief Header file for asynchronous screen render that delivers every finished tile as soon as it is ready
+ * \note Render is queued to the worker pool and start returns at once. Finished tiles are passed to the callback
+ * from worker threads, or put to the completion queue that the caller reads. Tiles near the screen center go first
+*/
+
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "configs.hpp"
+#include "dirty.hpp"
+#include "kernel.hpp"
+#include "pool.hpp"
+
+
+const int STREAM_TILES_X = (SCREEN_W + STREAM_TILE - 1) / STREAM_TILE;     ///< Number of tile columns
+const int STREAM_TILES_Y = (SCREEN_H + STREAM_TILE - 1) / STREAM_TILE;     ///< Number of tile rows
+const int STREAM_TILES = STREAM_TILES_X * STREAM_TILES_Y;                  ///< Number of tiles of the screen
+
+
+/// Finished tile of the streamed frame
+typedef struct {
+    DirtyRect rect = {};                        ///< Tile position on the screen
+    const uint8_t *pixels = nullptr;            ///< First tile pixel in frame buffer, rows are SCREEN_W * 4 bytes apart
+} StreamTile;
+
+
+/**
+ * \brief Receives finished tile, called from worker threads, so it must be thread safe
+ * \param [in] arg      Callback argument
+ * \param [in] tile     Finished tile, its pixels are not changed until the render is finished
+*/
+typedef void (*StreamCallback)(void *arg, const StreamTile *tile);
+
+
+/// Render in flight, owned by the caller until stream_render_finish returns
+typedef struct {
+    WorkerPool *pool = nullptr;                 ///< Pool that renders tiles
+    PoolJob job = {};                           ///< One task per tile
+    const IterColor *color_table = nullptr;     ///< Palette
+    uint8_t *buffer = nullptr;                  ///< Screen buffer in RGBA format
+    Transform transform = {};                   ///< Rendered view
+    StreamCallback callback = nullptr;          ///< Tile receiver, null means completion queue
+    void *arg = nullptr;                        ///< Callback argument
+    int order[STREAM_TILES] = {};               ///< Tile indices in render order
+    int queue[STREAM_TILES] = {};               ///< Completion queue, finished tiles in finish order
+    int queued = 0;                             ///< Number of finished tiles in the queue
+    int taken = 0;                              ///< Number of tiles taken from the queue
+    int settled = 0;                            ///< Number of finished or cancelled tiles
+    std::mutex lock = {};                       ///< Protects queue and counters
+    std::condition_variable ready = {};         ///< Signals finished tiles
+    std::atomic<bool> cancel = {};              ///< Tiles that are not started yet are skipped when set
+    bool active = false;                        ///< Render is started and not finished
+} StreamRender;
+
+
+/**
+ * \brief Queues render of the screen with priority class of the calling thread and returns at once
+ * \param [out] render      Render to start, must not be active
+ * \param [in]  pool        Worker pool
+ * \param [in]  color_table Palette, must live until the render is finished
+ * \param [out] buffer      Screen buffer in RGBA format, tiles are written to it
+ * \param [in]  transform   Mandelbrot set offset and scale
+ * \param [in]  callback    Receives every finished tile, null means tiles are read with stream_render_next
+ * \param [in]  arg         Callback argument
+ * \return Non zero value means error
+*/
+int stream_render_start(StreamRender *render, WorkerPool *pool, const IterColor *color_table, uint8_t *buffer,
+                        const Transform *transform, StreamCallback callback, void *arg);
+
+
+/**
+ * \brief Takes next finished tile from the completion queue
+ * \param [in,out] render  Started render without callback
+ * \param [out]    tile    Finished tile
+ * \param [in]     wait    Wait for the next tile if none is ready yet
+ * \return False if no tile is ready or every tile is taken or cancelled
+*/
+bool stream_render_next(StreamRender *render, StreamTile *tile, bool wait);
+
+
+/**
+ * \brief Asks render to skip tiles that are not started yet, returns at once
+*/
+void stream_render_cancel(StreamRender *render);
+
+
+/**
+ * \brief Waits until every tile is finished or skipped, tasks still queued are run in the calling thread
+ * \param [in,out] render  Started render
+ * \return Non zero value means error, CANCELLED if some tiles were skipped
+*/
+int stream_render_finish(StreamRender *render);
+
+
+#endif
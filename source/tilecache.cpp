@@ -0,0 +1,649 @@
+/**
+ * \file
+ * \brief Source file for tile cache shared by all processes of the host
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "utils.hpp"
+#include "tilecache.hpp"
+
+
+const uint64_t TILE_CACHE_MAGIC = 0x4d414e44454c5443;  ///< "MANDELTC", mixed into layout id
+const uint64_t TILE_HASH_SEED = 0x9e3779b97f4a7c15;    ///< Seed of slot key hash
+const uint64_t TILE_CHECK_SEED = 0xc2b2ae3d27d4eb4f;   ///< Seed of check hash
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared cache needs address free 64 bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared cache needs address free 32 bit atomics");
+
+
+/// Tile state in one render
+typedef enum {
+    TILE_MISSING        = 0,        ///< Not checked yet
+    TILE_CACHED         = 1,        ///< Copied from cache
+    TILE_OWNED          = 2,        ///< Claimed by this render, it is stored after render
+    TILE_PENDING        = 3,        ///< Claimed by another render, this one waits for it
+    TILE_LOCAL          = 4,        ///< Rendered here and not stored, probe sequence is full or key collides
+    TILE_LATE           = 5,        ///< Claimer failed or is too slow, rendered here after waiting
+    TILE_TAKEN          = 6,        ///< Claimer is gone, its claim was taken over and the tile is stored after render
+} TileStatus;
+
+
+/// Tile rectangle in view pixels
+typedef struct {
+    int x = 0;                                  ///< Left column
+    int y = 0;                                  ///< Top row
+    int width = 0;                              ///< Width in pixels
+    int height = 0;                             ///< Height in pixels
+} TileRect;
+
+
+/// Slot claimed by this render with the claim word it wrote, the word tells whether the claim was taken over since
+typedef struct {
+    TileSlot *slot = nullptr;                   ///< Claimed slot, null if the tile is not claimed
+    uint64_t claim = 0;                         ///< Claim word written by this render
+} TileClaim;
+
+
+/// Two hashes of the same words
+typedef struct {
+    uint64_t hash = 0;                          ///< Key hash state
+    uint64_t check = 0;                         ///< Check hash state
+} TileHasher;
+
+
+/**
+ * \brief Mixes 64 bit word into both hashes
+*/
+static void hash_word(TileHasher *hasher, uint64_t word);
+
+
+/**
+ * \brief Mixes arbitrary precision number into both hashes
+*/
+static void hash_bignum(TileHasher *hasher, const BigNum *num);
+
+
+/**
+ * \brief Mixes extended exponent double into both hashes
+*/
+static void hash_floatexp(TileHasher *hasher, FloatExp value);
+
+
+/**
+ * \brief Mixes grid anchor into both hashes, limbs below anchor step are skipped
+*/
+static void hash_anchor(TileHasher *hasher, const BigNum *anchor, int64_t exponent);
+
+
+/**
+ * \brief Returns layout id that all processes sharing the cache must agree on
+*/
+static uint64_t cache_layout(void);
+
+
+/**
+ * \brief Returns slot with the key or null if there is none
+*/
+static TileSlot *find_slot(TileCache *cache, TileKey key);
+
+
+/**
+ * \brief Claims slot for the key, so other renders wait for it instead of rendering the same tile
+ * \param [in]  cache   Cache
+ * \param [in]  key     Tile key
+ * \param [out] pending True if another render has claimed the key
+ * \param [out] claim   Claimed slot and written claim word, null slot if the key is claimed by a live render or probe
+ *                      sequence is full
+*/
+static void claim_slot(TileCache *cache, TileKey key, bool *pending, TileClaim *claim);
+
+
+/**
+ * \brief Returns claim word of the calling process
+*/
+static uint64_t make_claim(void);
+
+
+/**
+ * \brief Takes over slot that is written by a process that died or claimed it longer than TILE_CACHE_CLAIM_AGE ago
+ * \note Failures the claimer catches itself make the slot SLOT_ABANDONED, this handles the ones it can't
+ * \param [in]  slot    Slot to take over
+ * \param [out] claim   Written claim word if the slot is taken over
+ * \return True if the slot is claimed by this process now
+*/
+static bool take_over(TileSlot *slot, uint64_t *claim);
+
+
+/**
+ * \brief Renews the claim if the slot still has it, so the claimer is not taken for stuck while it writes the slot
+ * \return False if the claim was taken over, the slot must not be written then
+*/
+static bool renew_claim(TileClaim *claim);
+
+
+/**
+ * \brief Writes tile into claimed slot and makes it visible to lookups, does nothing if the claim was taken over
+ * \return True if the tile is stored
+*/
+static bool publish_slot(TileCache *cache, TileClaim *claim, TileKey key, const int *iters, int count);
+
+
+/**
+ * \brief Stores rendered tiles with the status into their claimed slots, tiles with pixels left glitched are abandoned
+ * \param [in] wanted  Status of the tiles to store
+ * \param [in] failed  Render failed, all tiles with the status are abandoned
+*/
+static void store_claimed(TileCache *cache, const DeepView *view, const SampleGrid *grid, const uint8_t *status,
+                          int wanted, TileClaim *claimed, int *tile, const int *iters, bool failed,
+                          TileCacheStats *cache_stats);
+
+
+/**
+ * \brief Waits until tiles claimed by other renders are ready and copies them, tiles of failed or slow renders become
+ * TILE_LATE and tiles of dead renders are taken over as TILE_TAKEN
+*/
+static void wait_pending(TileCache *cache, const DeepView *view, const SampleGrid *grid, uint8_t *status,
+                         TileClaim *claimed, int *tile, int *iters, PerturbControl *control, TileCacheStats *cache_stats);
+
+
+/**
+ * \brief Lists pixels of tiles whose status bit is set in mask in row order, so lanes get neighbour pixels
+ * \return Number of pixels
+*/
+static int list_pixels(const DeepView *view, const uint8_t *status, int mask, int *pixels);
+
+
+/**
+ * \brief Returns tile rectangle clipped by the view
+*/
+static TileRect tile_rect(const DeepView *view, int x, int y);
+
+
+/**
+ * \brief Copies tile pixels into view buffer
+*/
+static void copy_tile(const DeepView *view, const TileRect *rect, const int *tile, int *iters);
+
+
+
+
+int tile_cache_open(TileCache *cache, const char *name) {
+    ASSERT(cache, INVALID_ARG, "Can't open null cache!\n");
+    ASSERT(name, INVALID_ARG, "Can't open cache without name!\n");
+
+    size_t size = sizeof(TileCacheHeader) + (size_t) TILE_CACHE_SLOTS * sizeof(TileSlot);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    ASSERT(fd >= 0, FILE_NOT_FOUND, "Can't open shared cache %s!\n", name);
+
+    struct stat info = {};
+    if (fstat(fd, &info) || (info.st_size != 0 && (size_t) info.st_size != size)) {
+        close(fd);
+
+        printf("Shared cache %s has another size!\n", name);
+        return INVALID_FORMAT;
+    }
+
+    // New object is zero filled, that is empty table. Racing creators set the same size
+    if (info.st_size == 0 && ftruncate(fd, (off_t) size)) {
+        close(fd);
+
+        printf("Can't resize shared cache %s!\n", name);
+        return ALLOC_FAIL;
+    }
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    ASSERT(memory != MAP_FAILED, ALLOC_FAIL, "Can't map shared cache %s!\n", name);
+
+    cache -> header = (TileCacheHeader *) memory;
+    cache -> slots = (TileSlot *) ((uint8_t *) memory + sizeof(TileCacheHeader));
+    cache -> size = size;
+
+    uint64_t expected = 0;
+    if (!cache -> header -> layout.compare_exchange_strong(expected, cache_layout()) && expected != cache_layout()) {
+        tile_cache_close(cache);
+
+        printf("Shared cache %s has another layout!\n", name);
+        return INVALID_FORMAT;
+    }
+
+    return OK;
+}
+
+
+int tile_cache_close(TileCache *cache) {
+    ASSERT(cache, INVALID_ARG, "Can't close null cache!\n");
+
+    if (cache -> header) munmap(cache -> header, cache -> size);
+
+    *cache = {};
+
+    return OK;
+}
+
+
+TileKey tile_cache_key(const DeepView *view, const SampleGrid *grid, int x, int y) {
+    assert(view && "Can't make key of null view!\n");
+
+    TileHasher hasher = {TILE_HASH_SEED, TILE_CHECK_SEED};
+
+    if (grid) {
+        // Bits below anchor step are zero, so anchors of any precision give the same hash
+        hash_anchor(&hasher, &grid -> anchor_x, grid -> anchor_exponent);
+        hash_anchor(&hasher, &grid -> anchor_y, grid -> anchor_exponent);
+        hash_floatexp(&hasher, grid -> pixel);
+        hash_word(&hasher, (uint64_t) view -> nmax);
+        hash_word(&hasher, (uint64_t) (grid -> first_x / TILE_CACHE_SIZE + x));
+        hash_word(&hasher, (uint64_t) (grid -> first_y / TILE_CACHE_SIZE + y));
+    }
+    else {
+        hash_bignum(&hasher, &view -> center_x);
+        hash_bignum(&hasher, &view -> center_y);
+        hash_floatexp(&hasher, view -> span);
+        hash_word(&hasher, (uint64_t) view -> width << 32 | (uint32_t) view -> height);
+        hash_word(&hasher, (uint64_t) view -> nmax);
+        hash_word(&hasher, (uint64_t) x << 32 | (uint32_t) y);
+    }
+
+    // Zero key marks free slot
+    return {hasher.hash | 1, hasher.check};
+}
+
+
+bool tile_cache_lookup(TileCache *cache, TileKey key, int *iters, int count) {
+    assert(cache && cache -> slots && "Can't look up in closed cache!\n");
+    assert(iters && "Can't copy tile into null buffer!\n");
+
+    TileSlot *slot = find_slot(cache, key);
+
+    // Slots are never reused, so data published by the state is immutable
+    if (slot && slot -> state.load(std::memory_order_acquire) == SLOT_READY && slot -> check == key.check &&
+        slot -> count == (uint32_t) count) {
+        memcpy(iters, slot -> iters, (size_t) count * sizeof(int));
+        cache -> header -> hits.fetch_add(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    cache -> header -> misses.fetch_add(1, std::memory_order_relaxed);
+
+    return false;
+}
+
+
+bool tile_cache_insert(TileCache *cache, TileKey key, const int *iters, int count) {
+    assert(cache && cache -> slots && "Can't insert into closed cache!\n");
+    assert(iters && "Can't insert null tile!\n");
+    assert(0 < count && count <= TILE_CACHE_SIZE * TILE_CACHE_SIZE && "Invalid tile size!\n");
+
+    bool pending = false;
+    TileClaim claim = {};
+    claim_slot(cache, key, &pending, &claim);
+
+    // Another process stores or has stored the same tile
+    if (!claim.slot) return false;
+
+    return publish_slot(cache, &claim, key, iters, count);
+}
+
+
+int tile_cache_render(TileCache *cache, const DeepView *view, const SampleGrid *grid, int *iters, WorkerPool *pool,
+                      PerturbStats *stats, PerturbControl *control, TileCacheStats *cache_stats) {
+    ASSERT(cache && cache -> slots, INVALID_ARG, "Can't render with closed cache!\n");
+    ASSERT(view, INVALID_ARG, "Can't render null view!\n");
+    ASSERT(iters, INVALID_ARG, "Can't render into null buffer!\n");
+    ASSERT(!grid || (view -> width % TILE_CACHE_SIZE == 0 && view -> height % TILE_CACHE_SIZE == 0), INVALID_ARG,
+           "Grid view must consist of whole tiles!\n");
+
+    TileCacheStats local_stats = {};
+    if (!cache_stats) cache_stats = &local_stats;
+    *cache_stats = {};
+
+    const int tiles_x = (view -> width + TILE_CACHE_SIZE - 1) / TILE_CACHE_SIZE;
+    const int tiles_y = (view -> height + TILE_CACHE_SIZE - 1) / TILE_CACHE_SIZE;
+    const int tiles = tiles_x * tiles_y;
+
+    uint8_t *status = (uint8_t *) calloc((size_t) tiles, sizeof(uint8_t));
+    TileClaim *claimed = (TileClaim *) calloc((size_t) tiles, sizeof(TileClaim));
+    int *pixels = (int *) calloc((size_t) view -> width * (size_t) view -> height, sizeof(int));
+    int *tile = (int *) calloc(TILE_CACHE_SIZE * TILE_CACHE_SIZE, sizeof(int));
+
+    if (!status || !claimed || !pixels || !tile) {
+        free(status);
+        free(claimed);
+        free(pixels);
+        free(tile);
+
+        printf("Can't allocate tile cache buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    cache_stats -> tiles = tiles;
+    cache_stats -> samples = (long) view -> width * view -> height;
+
+    for (int i = 0; i < tiles; i++) {
+        TileKey key = tile_cache_key(view, grid, i % tiles_x, i / tiles_x);
+        TileRect rect = tile_rect(view, i % tiles_x, i / tiles_x);
+
+        if (tile_cache_lookup(cache, key, tile, rect.width * rect.height)) {
+            copy_tile(view, &rect, tile, iters);
+            status[i] = TILE_CACHED;
+            cache_stats -> hits++;
+            continue;
+        }
+
+        bool pending = false;
+        claim_slot(cache, key, &pending, &claimed[i]);
+        status[i] = (claimed[i].slot) ? TILE_OWNED : (pending) ? TILE_PENDING : TILE_LOCAL;
+    }
+
+    int count = list_pixels(view, status, (1 << TILE_OWNED) | (1 << TILE_LOCAL), pixels);
+    int result = perturb_render_pixels(view, iters, pool, pixels, count, stats, control);
+
+    store_claimed(cache, view, grid, status, TILE_OWNED, claimed, tile, iters, result, cache_stats);
+
+    if (!result) {
+        wait_pending(cache, view, grid, status, claimed, tile, iters, control, cache_stats);
+
+        // Tiles whose claimers gave up are rendered here and not stored, tiles of dead claimers are stored
+        count = list_pixels(view, status, (1 << TILE_LATE) | (1 << TILE_TAKEN), pixels);
+        if (count) result = perturb_render_pixels(view, iters, pool, pixels, count, nullptr, control);
+
+        store_claimed(cache, view, grid, status, TILE_TAKEN, claimed, tile, iters, result, cache_stats);
+    }
+
+    for (int i = 0; i < tiles; i++) {
+        if (status[i] != TILE_CACHED) continue;
+
+        TileRect rect = tile_rect(view, i % tiles_x, i / tiles_x);
+        cache_stats -> reused += (long) rect.width * rect.height;
+    }
+
+    free(status);
+    free(claimed);
+    free(pixels);
+    free(tile);
+
+    return result;
+}
+
+
+static TileSlot *find_slot(TileCache *cache, TileKey key) {
+    for (int probe = 0; probe < TILE_CACHE_PROBES; probe++) {
+        TileSlot *slot = cache -> slots + (key.hash + (uint64_t) probe) % TILE_CACHE_SLOTS;
+
+        uint64_t slot_key = slot -> key.load(std::memory_order_acquire);
+        if (slot_key == 0) return nullptr;
+        if (slot_key == key.hash) return slot;
+    }
+
+    return nullptr;
+}
+
+
+static void claim_slot(TileCache *cache, TileKey key, bool *pending, TileClaim *claim) {
+    *pending = false;
+    *claim = {};
+
+    for (int probe = 0; probe < TILE_CACHE_PROBES; probe++) {
+        TileSlot *slot = cache -> slots + (key.hash + (uint64_t) probe) % TILE_CACHE_SLOTS;
+
+        // Claim is visible before the state, so nobody sees SLOT_WRITING without its claimer
+        uint64_t expected = 0;
+        if (slot -> key.compare_exchange_strong(expected, key.hash, std::memory_order_acq_rel)) {
+            *claim = {slot, make_claim()};
+            slot -> claim.store(claim -> claim, std::memory_order_relaxed);
+            slot -> state.store(SLOT_WRITING, std::memory_order_release);
+            return;
+        }
+
+        if (expected != key.hash) continue;
+
+        // Slot of the same key is being written, was just finished, was left by failed render or by dead process
+        uint32_t state = SLOT_ABANDONED;
+        if (slot -> state.compare_exchange_strong(state, SLOT_WRITING, std::memory_order_acq_rel)) {
+            *claim = {slot, make_claim()};
+            slot -> claim.store(claim -> claim, std::memory_order_release);
+            return;
+        }
+
+        uint64_t taken = 0;
+        if (take_over(slot, &taken)) {
+            *claim = {slot, taken};
+            return;
+        }
+
+        *pending = true;
+        return;
+    }
+
+    cache -> header -> dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+static uint64_t make_claim(void) {
+    return (uint64_t) (uint32_t) get_seconds() << 32 | (uint32_t) getpid();
+}
+
+
+static bool take_over(TileSlot *slot, uint64_t *taken) {
+    if (slot -> state.load(std::memory_order_acquire) != SLOT_WRITING) return false;
+
+    uint64_t claim = slot -> claim.load(std::memory_order_acquire);
+    if (!claim) return false;
+
+    pid_t pid = (pid_t) (uint32_t) claim;
+    uint32_t age = (uint32_t) get_seconds() - (uint32_t) (claim >> 32);
+
+    // Pid of a dead claimer can be reused, so old claims are taken over whatever the pid check says
+    bool dead = age > (uint32_t) TILE_CACHE_CLAIM_AGE || (kill(pid, 0) && errno == ESRCH);
+
+    // Only one of the renders that found the claim dead wins it
+    *taken = make_claim();
+    return dead && slot -> claim.compare_exchange_strong(claim, *taken, std::memory_order_acq_rel);
+}
+
+
+static bool renew_claim(TileClaim *claim) {
+    uint64_t expected = claim -> claim;
+    uint64_t renewed = make_claim();
+
+    if (!claim -> slot -> claim.compare_exchange_strong(expected, renewed, std::memory_order_acq_rel)) return false;
+
+    claim -> claim = renewed;
+    return true;
+}
+
+
+static bool publish_slot(TileCache *cache, TileClaim *claim, TileKey key, const int *iters, int count) {
+    // Claimer that was taken for stuck lost the slot to another render, which writes the same tile itself. Fresh claim
+    // keeps this one from being taken over during the copy unless it stalls for TILE_CACHE_CLAIM_AGE inside it
+    if (!renew_claim(claim)) return false;
+
+    TileSlot *slot = claim -> slot;
+
+    slot -> check = key.check;
+    slot -> count = (uint32_t) count;
+    memcpy(slot -> iters, iters, (size_t) count * sizeof(int));
+
+    slot -> state.store(SLOT_READY, std::memory_order_release);
+    cache -> header -> stored.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+
+static void store_claimed(TileCache *cache, const DeepView *view, const SampleGrid *grid, const uint8_t *status,
+                          int wanted, TileClaim *claimed, int *tile, const int *iters, bool failed,
+                          TileCacheStats *cache_stats) {
+    const int tiles_x = (view -> width + TILE_CACHE_SIZE - 1) / TILE_CACHE_SIZE;
+    const int tiles = cache_stats -> tiles;
+
+    for (int i = 0; i < tiles; i++) {
+        if (status[i] != wanted) continue;
+
+        TileRect rect = tile_rect(view, i % tiles_x, i / tiles_x);
+        bool glitched = false;
+
+        for (int row = 0; row < rect.height; row++) {
+            const int *source = iters + (size_t) (rect.y + row) * view -> width + rect.x;
+            memcpy(tile + row * rect.width, source, (size_t) rect.width * sizeof(int));
+
+            for (int col = 0; col < rect.width; col++) glitched |= (source[col] == PIXEL_GLITCHED);
+        }
+
+        // Pixels left glitched would be corrected by the next render, such tiles are not final
+        // Slot that was taken over belongs to its new claimer, which may have stored it already
+        if (failed || glitched) {
+            if (renew_claim(&claimed[i])) claimed[i].slot -> state.store(SLOT_ABANDONED, std::memory_order_release);
+            continue;
+        }
+
+        TileKey key = tile_cache_key(view, grid, i % tiles_x, i / tiles_x);
+        if (publish_slot(cache, &claimed[i], key, tile, rect.width * rect.height)) cache_stats -> stored++;
+    }
+}
+
+
+static void wait_pending(TileCache *cache, const DeepView *view, const SampleGrid *grid, uint8_t *status,
+                         TileClaim *claimed, int *tile, int *iters, PerturbControl *control, TileCacheStats *cache_stats) {
+    const int tiles_x = (view -> width + TILE_CACHE_SIZE - 1) / TILE_CACHE_SIZE;
+    const int tiles = cache_stats -> tiles;
+    const double deadline = get_seconds() + TILE_CACHE_WAIT;
+    double next_check = get_seconds() + TILE_CACHE_CHECK_INTERVAL;
+
+    for (;;) {
+        int left = 0;
+
+        // Claimers are checked less often than slots are polled, every check is a syscall per tile
+        bool check = get_seconds() > next_check;
+        if (check) next_check = get_seconds() + TILE_CACHE_CHECK_INTERVAL;
+
+        for (int i = 0; i < tiles; i++) {
+            if (status[i] != TILE_PENDING) continue;
+
+            TileKey key = tile_cache_key(view, grid, i % tiles_x, i / tiles_x);
+            TileRect rect = tile_rect(view, i % tiles_x, i / tiles_x);
+
+            TileSlot *slot = find_slot(cache, key);
+            uint32_t state = (slot) ? slot -> state.load(std::memory_order_acquire) : (uint32_t) SLOT_ABANDONED;
+
+            if (state == SLOT_READY && slot -> check == key.check && slot -> count == (uint32_t) (rect.width * rect.height)) {
+                memcpy(tile, slot -> iters, (size_t) (rect.width * rect.height) * sizeof(int));
+                copy_tile(view, &rect, tile, iters);
+
+                cache -> header -> hits.fetch_add(1, std::memory_order_relaxed);
+                status[i] = TILE_CACHED;
+                cache_stats -> waited++;
+            }
+            else if (state == SLOT_READY || state == SLOT_ABANDONED) status[i] = TILE_LATE;
+            else if (check && take_over(slot, &claimed[i].claim)) {
+                claimed[i].slot = slot;
+                status[i] = TILE_TAKEN;
+            }
+            else left++;
+        }
+
+        if (!left) return;
+
+        bool cancelled = control && control -> cancel.load(std::memory_order_relaxed);
+
+        if (cancelled || get_seconds() > deadline) {
+            for (int i = 0; i < tiles; i++)
+                if (status[i] == TILE_PENDING) status[i] = TILE_LATE;
+
+            return;
+        }
+
+        usleep(TILE_CACHE_POLL_US);
+    }
+}
+
+
+static int list_pixels(const DeepView *view, const uint8_t *status, int mask, int *pixels) {
+    const int tiles_x = (view -> width + TILE_CACHE_SIZE - 1) / TILE_CACHE_SIZE;
+    int count = 0;
+
+    for (int y = 0; y < view -> height; y++) {
+        const uint8_t *row = status + (y / TILE_CACHE_SIZE) * tiles_x;
+
+        for (int x = 0; x < view -> width; x++)
+            if (mask & (1 << row[x / TILE_CACHE_SIZE])) pixels[count++] = y * view -> width + x;
+    }
+
+    return count;
+}
+
+
+static TileRect tile_rect(const DeepView *view, int x, int y) {
+    TileRect rect = {x * TILE_CACHE_SIZE, y * TILE_CACHE_SIZE, TILE_CACHE_SIZE, TILE_CACHE_SIZE};
+
+    if (rect.x + rect.width > view -> width) rect.width = view -> width - rect.x;
+    if (rect.y + rect.height > view -> height) rect.height = view -> height - rect.y;
+
+    return rect;
+}
+
+
+static void copy_tile(const DeepView *view, const TileRect *rect, const int *tile, int *iters) {
+    for (int row = 0; row < rect -> height; row++)
+        memcpy(iters + (size_t) (rect -> y + row) * view -> width + rect -> x, tile + row * rect -> width,
+               (size_t) rect -> width * sizeof(int));
+}
+
+
+static void hash_word(TileHasher *hasher, uint64_t word) {
+    // Multiply and xorshift rounds of splitmix64 finalizer
+    uint64_t values[2] = {hasher -> hash ^ word, hasher -> check ^ (word * TILE_HASH_SEED)};
+
+    for (int i = 0; i < 2; i++) {
+        values[i] ^= values[i] >> 30;
+        values[i] *= 0xbf58476d1ce4e5b9;
+        values[i] ^= values[i] >> 27;
+        values[i] *= 0x94d049bb133111eb;
+        values[i] ^= values[i] >> 31;
+    }
+
+    hasher -> hash = values[0];
+    hasher -> check = values[1];
+}
+
+
+static void hash_bignum(TileHasher *hasher, const BigNum *num) {
+    hash_word(hasher, (uint64_t) num -> sign << 32 | (uint32_t) num -> size);
+
+    for (int i = 0; i < num -> size; i++) hash_word(hasher, num -> limbs[i]);
+}
+
+
+static void hash_floatexp(TileHasher *hasher, FloatExp value) {
+    uint64_t mantissa = 0;
+    memcpy(&mantissa, &value.mantissa, sizeof(mantissa));
+
+    hash_word(hasher, mantissa);
+    hash_word(hasher, (uint64_t) value.exponent);
+}
+
+
+static void hash_anchor(TileHasher *hasher, const BigNum *anchor, int64_t exponent) {
+    int64_t lowest = (exponent + 32 * (int64_t) (anchor -> size - 1)) / 32;
+
+    hash_word(hasher, (uint64_t) anchor -> sign);
+
+    for (int64_t i = anchor -> size - 1; i >= 0 && i >= lowest; i--) hash_word(hasher, anchor -> limbs[i]);
+}
+
+
+static uint64_t cache_layout(void) {
+    return TILE_CACHE_MAGIC ^ ((uint64_t) TILE_CACHE_SLOTS << 32) ^ ((uint64_t) TILE_CACHE_SIZE << 16) ^ sizeof(TileSlot);
+}
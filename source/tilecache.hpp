@@ -0,0 +1,146 @@
+/**
+ * \file
+ * \brief Header file for tile cache shared by all processes of the host through memory mapped hash table
+ * \note Table uses open addressing with linear probing. Slot is claimed by compare and swap of its key and
+ * published by release store of its state, so lookups and insertions never lock. Stored tiles are never
+ * evicted, when probe sequence is full the tile is just not stored. Render claims slots of missing tiles
+ * before it renders them, so concurrent renders wait for each other's tiles instead of rendering them again.
+ * Claim of a process that died or of one older than TILE_CACHE_CLAIM_AGE is taken over by the next render.
+ * Claimer compares and swaps its own claim word before it stores or abandons the slot, so a slow claimer that lost
+ * the slot drops its write
+*/
+
+#ifndef TILECACHE_HPP
+#define TILECACHE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "configs.hpp"
+#include "perturb.hpp"
+#include "grid.hpp"
+#include "pool.hpp"
+
+
+/// Slot states
+typedef enum {
+    SLOT_EMPTY          = 0,        ///< Key is not claimed yet
+    SLOT_WRITING        = 1,        ///< Key is claimed, iterations are written now
+    SLOT_READY          = 2,        ///< Iterations can be read
+    SLOT_ABANDONED      = 3,        ///< Claimer did not finish the tile, next render can claim it again
+} TileSlotState;
+
+
+/// Identity of tile contents, two independent hashes of view, tile position and limit
+typedef struct {
+    uint64_t hash = 0;                          ///< Slot key, never zero
+    uint64_t check = 0;                         ///< Checked on lookup, so key collisions are not hits
+} TileKey;
+
+
+/// Cached tile, lives in shared memory and is never constructed
+typedef struct {
+    std::atomic<uint64_t> key;                  ///< Zero for free slot
+    std::atomic<uint32_t> state;                ///< TileSlotState
+    uint32_t count;                             ///< Number of stored iteration numbers
+    uint64_t check;                             ///< Second hash of the key
+    std::atomic<uint64_t> claim;                ///< Claim time in monotonic seconds in high half, claimer pid in low half
+    int32_t iters[TILE_CACHE_SIZE * TILE_CACHE_SIZE];   ///< Iteration numbers in row order of the tile
+} TileSlot;
+
+
+/// Beginning of shared memory, counters are shared by all processes
+typedef struct {
+    std::atomic<uint64_t> layout;               ///< Layout id set by the first process, others check it
+    std::atomic<uint64_t> stored;               ///< Number of stored tiles
+    std::atomic<uint64_t> hits;                 ///< Number of found tiles
+    std::atomic<uint64_t> misses;               ///< Number of tiles that were not found
+    std::atomic<uint64_t> dropped;              ///< Tiles not stored because probe sequence was full
+} TileCacheHeader;
+
+
+/// Mapped cache of one process
+typedef struct {
+    TileCacheHeader *header = nullptr;          ///< Shared header
+    TileSlot *slots = nullptr;                  ///< Shared slots
+    size_t size = 0;                            ///< Mapped bytes
+} TileCache;
+
+
+/// Cache use of one render
+typedef struct {
+    int tiles = 0;                              ///< Number of view tiles
+    int hits = 0;                               ///< Tiles taken from cache
+    int waited = 0;                             ///< Tiles taken from cache after another render finished them
+    int stored = 0;                             ///< Rendered tiles stored into cache
+    long samples = 0;                           ///< Pixels of the view
+    long reused = 0;                            ///< Pixels taken from cache
+} TileCacheStats;
+
+
+/**
+ * \brief Attaches to shared cache, the first process creates it
+ * \param [out] cache   Cache to map
+ * \param [in]  name    Shared memory object name like "/mandelbrot-tiles"
+ * \return Non zero value means error
+*/
+int tile_cache_open(TileCache *cache, const char *name);
+
+
+/**
+ * \brief Detaches from shared cache, it stays for other processes
+ * \return Non zero value means error
+*/
+int tile_cache_close(TileCache *cache);
+
+
+/**
+ * \brief Returns key of view tile
+ * \param [in] view    View the tile belongs to
+ * \param [in] grid    Sample grid of the view, tiles of views on the same grid share keys. Null means key of this view only
+ * \param [in] x       Tile column in tiles
+ * \param [in] y       Tile row in tiles
+*/
+TileKey tile_cache_key(const DeepView *view, const SampleGrid *grid, int x, int y);
+
+
+/**
+ * \brief Copies cached tile
+ * \param [in]  cache   Cache
+ * \param [in]  key     Tile key
+ * \param [out] iters   Buffer of count iteration numbers
+ * \param [in]  count   Number of tile pixels
+ * \return True if the tile was found
+*/
+bool tile_cache_lookup(TileCache *cache, TileKey key, int *iters, int count);
+
+
+/**
+ * \brief Stores tile unless it is already stored or its probe sequence is full
+ * \param [in] cache   Cache
+ * \param [in] key     Tile key
+ * \param [in] iters   Iteration numbers
+ * \param [in] count   Number of tile pixels
+ * \return True if the tile was stored by this call
+*/
+bool tile_cache_insert(TileCache *cache, TileKey key, const int *iters, int count);
+
+
+/**
+ * \brief Renders view taking tiles that any process has already rendered from cache and storing the others
+ * \note Tiles with pixels left glitched are not stored
+ * \param [in,out] cache       Cache
+ * \param [in]     view        View to render
+ * \param [in]     grid        Sample grid of tile aligned view, can be null
+ * \param [out]    iters       Iteration numbers buffer of width * height
+ * \param [in,out] pool        Worker pool
+ * \param [out]    stats       Glitch correction results, can be null
+ * \param [in,out] control     Progress to update and cancel flag to check, can be null
+ * \param [out]    cache_stats Cache use, can be null
+ * \return Non zero value means error, CANCELLED if cancel flag was set
+*/
+int tile_cache_render(TileCache *cache, const DeepView *view, const SampleGrid *grid, int *iters, WorkerPool *pool,
+                      PerturbStats *stats, PerturbControl *control, TileCacheStats *cache_stats);
+
+
+#endif
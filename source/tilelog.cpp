@@ -0,0 +1,437 @@
+/**
+ * \file
+ * \brief Source file for access log of cached tiles
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "configs.hpp"
+#include "utils.hpp"
+#include "tilelog.hpp"
+
+
+const uint64_t TILE_LOG_MAGIC = 0x4d414e44544c4f47;    ///< "MANDTLOG"
+const int TILE_LOG_TABLE_SIZE = 4 * TILE_LOG_MAX_TILES; ///< Index slots, power of two, so probe sequences stay short
+
+
+/// Beginning of log file, grids and then entries follow it
+typedef struct {
+    uint64_t magic = TILE_LOG_MAGIC;            ///< File signature
+    int32_t tile = TILE_CACHE_SIZE;             ///< Tile side, keys of other sides do not match the cache
+    int32_t grids = 0;                          ///< Number of grids
+    int32_t entries = 0;                        ///< Number of entries
+    int32_t reserved = 0;                       ///< Keeps entries aligned
+} TileLogHeader;
+
+
+/// Entry with its popularity at one moment
+typedef struct {
+    double score = 0;                           ///< Decayed access count
+    int entry = 0;                              ///< Entry index
+} TileLogRank;
+
+
+/**
+ * \brief Reads log file
+ * \return Non zero value means error, missing file is not an error
+*/
+static int tile_log_read(TileLog *log);
+
+
+/**
+ * \brief Returns index of grid, adds new grid
+ * \return Grid index or -1 on allocation error
+*/
+static int tile_log_grid(TileLog *log, const GridView *snapped);
+
+
+/**
+ * \brief Returns index slot of the key, it holds the key entry or is free
+*/
+static int tile_log_slot(const TileLog *log, TileKey key);
+
+
+/**
+ * \brief Rebuilds index of entries
+*/
+static void tile_log_index(TileLog *log);
+
+
+/**
+ * \brief Sorts entries by popularity at the given time, the most popular first
+ * \param [in]  log     Log
+ * \param [in]  now     Unix time
+ * \param [out] ranks   Buffer of entries_count ranks
+*/
+static void tile_log_rank(const TileLog *log, double now, TileLogRank *ranks);
+
+
+/**
+ * \brief Forgets the less popular half of entries and grids no entry uses
+ * \return Non zero value means error
+*/
+static int tile_log_prune(TileLog *log, double now);
+
+
+/**
+ * \brief Compares ranks for qsort, higher score goes first
+*/
+static int cmp_ranks(const void *a, const void *b);
+
+
+
+
+int tile_log_open(TileLog *log, const char *path) {
+    ASSERT(log, INVALID_ARG, "Can't open null log!\n");
+    ASSERT(path, INVALID_ARG, "Can't open log without path!\n");
+
+    log -> path = path;
+    log -> grids = nullptr;
+    log -> grids_count = 0;
+    log -> grids_capacity = 0;
+    log -> entries_count = 0;
+    log -> table_size = TILE_LOG_TABLE_SIZE;
+    log -> changed = false;
+
+    log -> entries = (TileLogEntry *) calloc(TILE_LOG_MAX_TILES, sizeof(TileLogEntry));
+    log -> table = (int *) calloc(TILE_LOG_TABLE_SIZE, sizeof(int));
+
+    if (!log -> entries || !log -> table) {
+        tile_log_close(log);
+
+        printf("Can't allocate access log!\n");
+        return ALLOC_FAIL;
+    }
+
+    int result = tile_log_read(log);
+    if (result) {
+        tile_log_close(log);
+        return result;
+    }
+
+    tile_log_index(log);
+
+    printf("Access log %s: %d tiles on %d grids\n", path, log -> entries_count, log -> grids_count);
+
+    return OK;
+}
+
+
+int tile_log_close(TileLog *log) {
+    ASSERT(log, INVALID_ARG, "Can't close null log!\n");
+
+    free(log -> grids);
+    free(log -> entries);
+    free(log -> table);
+
+    log -> grids = nullptr;
+    log -> entries = nullptr;
+    log -> table = nullptr;
+    log -> grids_count = 0;
+    log -> grids_capacity = 0;
+    log -> entries_count = 0;
+    log -> table_size = 0;
+
+    return OK;
+}
+
+
+int tile_log_record(TileLog *log, const GridView *snapped) {
+    ASSERT(log && log -> entries, INVALID_ARG, "Can't record into closed log!\n");
+    ASSERT(snapped, INVALID_ARG, "Can't record null view!\n");
+
+    std::lock_guard<std::mutex> guard(log -> lock);
+
+    double now = (double) time(nullptr);
+
+    int grid = tile_log_grid(log, snapped);
+    ASSERT(grid >= 0, ALLOC_FAIL, "Can't allocate access log grid!\n");
+
+    int tiles_x = snapped -> view.width / TILE_CACHE_SIZE, tiles_y = snapped -> view.height / TILE_CACHE_SIZE;
+
+    for (int y = 0; y < tiles_y; y++) {
+        for (int x = 0; x < tiles_x; x++) {
+            TileKey key = tile_cache_key(&snapped -> view, &snapped -> grid, x, y);
+            int slot = tile_log_slot(log, key);
+
+            if (log -> table[slot] < 0) {
+                if (log -> entries_count == TILE_LOG_MAX_TILES) {
+                    int result = tile_log_prune(log, now);
+                    if (result) return result;
+
+                    // Pruning drops grids nobody uses and renumbers the rest, the current one is used by its tiles
+                    grid = tile_log_grid(log, snapped);
+                    ASSERT(grid >= 0, ALLOC_FAIL, "Can't allocate access log grid!\n");
+
+                    slot = tile_log_slot(log, key);
+                }
+
+                TileLogEntry *entry = log -> entries + log -> entries_count;
+                *entry = {};
+                entry -> key = key;
+                entry -> grid = grid;
+                entry -> x = snapped -> grid.first_x / TILE_CACHE_SIZE + x;
+                entry -> y = snapped -> grid.first_y / TILE_CACHE_SIZE + y;
+                entry -> last = now;
+
+                log -> table[slot] = log -> entries_count++;
+            }
+
+            TileLogEntry *entry = log -> entries + log -> table[slot];
+            entry -> score = entry -> score * exp2((entry -> last - now) / TILE_LOG_HALF_LIFE) + 1;
+            entry -> last = now;
+            entry -> count++;
+        }
+    }
+
+    log -> changed = true;
+
+    return OK;
+}
+
+
+int tile_log_save(TileLog *log) {
+    ASSERT(log && log -> entries, INVALID_ARG, "Can't save closed log!\n");
+
+    std::lock_guard<std::mutex> guard(log -> lock);
+
+    if (!log -> changed) return OK;
+
+    size_t length = strlen(log -> path);
+    char *temp = (char *) calloc(length + sizeof(".tmp"), sizeof(char));
+    ASSERT(temp, ALLOC_FAIL, "Can't allocate log file name!\n");
+
+    memcpy(temp, log -> path, length);
+    memcpy(temp + length, ".tmp", sizeof(".tmp"));
+
+    FILE *file = fopen(temp, "wb");
+    if (!file) {
+        printf("Can't write access log %s!\n", temp);
+        free(temp);
+
+        return FILE_NOT_FOUND;
+    }
+
+    TileLogHeader header = {};
+    header.grids = log -> grids_count;
+    header.entries = log -> entries_count;
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(log -> grids, sizeof(TileLogGrid), (size_t) log -> grids_count, file);
+    fwrite(log -> entries, sizeof(TileLogEntry), (size_t) log -> entries_count, file);
+
+    // Readers see either the old log or the whole new one, log of a killed daemon is never half written
+    int result = OK;
+    bool failed = ferror(file);
+    if (fclose(file)) failed = true;
+
+    if (failed || rename(temp, log -> path)) {
+        printf("Can't write access log %s!\n", log -> path);
+        remove(temp);
+
+        result = FILE_NOT_FOUND;
+    }
+    else {
+        log -> changed = false;
+    }
+
+    free(temp);
+
+    return result;
+}
+
+
+int tile_log_hottest(TileLog *log, GridView *tiles, int limit) {
+    assert(log && log -> entries && "Can't search closed log!\n");
+    assert(tiles && "Can't write tiles into null buffer!\n");
+
+    std::lock_guard<std::mutex> guard(log -> lock);
+
+    if (!log -> entries_count || limit <= 0) return 0;
+
+    TileLogRank *ranks = (TileLogRank *) calloc((size_t) log -> entries_count, sizeof(TileLogRank));
+    if (!ranks) return 0;
+
+    tile_log_rank(log, (double) time(nullptr), ranks);
+
+    int count = (limit < log -> entries_count) ? limit : log -> entries_count;
+
+    for (int i = 0; i < count; i++) {
+        const TileLogEntry *entry = log -> entries + ranks[i].entry;
+        const TileLogGrid *grid = log -> grids + entry -> grid;
+
+        grid_tile(&grid -> grid, entry -> x, entry -> y, grid -> nmax, tiles + i);
+    }
+
+    free(ranks);
+
+    return count;
+}
+
+
+static int tile_log_read(TileLog *log) {
+    FILE *file = fopen(log -> path, "rb");
+    if (!file) return OK;
+
+    TileLogHeader header = {};
+    int result = OK;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != TILE_LOG_MAGIC || header.tile != TILE_CACHE_SIZE ||
+        header.grids < 0 || header.entries < 0 || header.entries > TILE_LOG_MAX_TILES) {
+        printf("Access log %s is not a log of this daemon!\n", log -> path);
+        result = INVALID_FORMAT;
+    }
+
+    if (!result && header.grids) {
+        log -> grids = (TileLogGrid *) calloc((size_t) header.grids, sizeof(TileLogGrid));
+        log -> grids_capacity = header.grids;
+
+        if (!log -> grids) {
+            printf("Can't allocate access log grids!\n");
+            result = ALLOC_FAIL;
+        }
+    }
+
+    if (!result && (fread(log -> grids, sizeof(TileLogGrid), (size_t) header.grids, file) != (size_t) header.grids ||
+                    fread(log -> entries, sizeof(TileLogEntry), (size_t) header.entries, file) != (size_t) header.entries)) {
+        printf("Access log %s is truncated!\n", log -> path);
+        result = INVALID_FORMAT;
+    }
+
+    for (int i = 0; !result && i < header.entries; i++) {
+        if (log -> entries[i].grid < 0 || log -> entries[i].grid >= header.grids) {
+            printf("Access log %s has tile of unknown grid!\n", log -> path);
+            result = INVALID_FORMAT;
+        }
+    }
+
+    fclose(file);
+
+    if (!result) {
+        log -> grids_count = header.grids;
+        log -> entries_count = header.entries;
+    }
+
+    return result;
+}
+
+
+static int tile_log_grid(TileLog *log, const GridView *snapped) {
+    SampleGrid origin = snapped -> grid;
+    origin.first_x = 0;
+    origin.first_y = 0;
+
+    TileKey id = tile_cache_key(&snapped -> view, &origin, 0, 0);
+
+    // New grids are appended, views of one exploration usually share the last one
+    for (int i = log -> grids_count - 1; i >= 0; i--)
+        if (log -> grids[i].id.hash == id.hash && log -> grids[i].id.check == id.check) return i;
+
+    if (log -> grids_count == log -> grids_capacity) {
+        int capacity = (log -> grids_capacity) ? 2 * log -> grids_capacity : 16;
+
+        TileLogGrid *grids = (TileLogGrid *) realloc(log -> grids, (size_t) capacity * sizeof(TileLogGrid));
+        if (!grids) return -1;
+
+        log -> grids = grids;
+        log -> grids_capacity = capacity;
+    }
+
+    TileLogGrid *grid = log -> grids + log -> grids_count;
+    grid -> grid = origin;
+    grid -> nmax = snapped -> view.nmax;
+    grid -> id = id;
+
+    return log -> grids_count++;
+}
+
+
+static int tile_log_slot(const TileLog *log, TileKey key) {
+    int mask = log -> table_size - 1;
+
+    // Table is four times larger than max number of entries, so a free slot is always found
+    for (int slot = (int) (key.hash & (uint64_t) mask);; slot = (slot + 1) & mask) {
+        int entry = log -> table[slot];
+        if (entry < 0) return slot;
+
+        const TileLogEntry *stored = log -> entries + entry;
+        if (stored -> key.hash == key.hash && stored -> key.check == key.check) return slot;
+    }
+}
+
+
+static void tile_log_index(TileLog *log) {
+    for (int i = 0; i < log -> table_size; i++) log -> table[i] = -1;
+
+    for (int i = 0; i < log -> entries_count; i++) log -> table[tile_log_slot(log, log -> entries[i].key)] = i;
+}
+
+
+static void tile_log_rank(const TileLog *log, double now, TileLogRank *ranks) {
+    for (int i = 0; i < log -> entries_count; i++) {
+        const TileLogEntry *entry = log -> entries + i;
+
+        ranks[i].score = entry -> score * exp2((entry -> last - now) / TILE_LOG_HALF_LIFE);
+        ranks[i].entry = i;
+    }
+
+    qsort(ranks, (size_t) log -> entries_count, sizeof(TileLogRank), cmp_ranks);
+}
+
+
+static int tile_log_prune(TileLog *log, double now) {
+    TileLogRank *ranks = (TileLogRank *) calloc((size_t) log -> entries_count, sizeof(TileLogRank));
+    TileLogEntry *kept = (TileLogEntry *) calloc(TILE_LOG_MAX_TILES, sizeof(TileLogEntry));
+    int *grids = (int *) calloc((size_t) log -> grids_count, sizeof(int));
+
+    if (!ranks || !kept || !grids) {
+        free(ranks);
+        free(kept);
+        free(grids);
+
+        printf("Can't allocate access log pruning buffers!\n");
+        return ALLOC_FAIL;
+    }
+
+    tile_log_rank(log, now, ranks);
+
+    int count = log -> entries_count / 2;
+    for (int i = 0; i < count; i++) {
+        kept[i] = log -> entries[ranks[i].entry];
+        grids[kept[i].grid] = 1;
+    }
+
+    // Grids keep their order, new index of a grid is the number of used grids before it
+    int grids_count = 0;
+    for (int i = 0; i < log -> grids_count; i++) {
+        if (!grids[i]) continue;
+
+        log -> grids[grids_count] = log -> grids[i];
+        grids[i] = grids_count++;
+    }
+
+    for (int i = 0; i < count; i++) kept[i].grid = grids[kept[i].grid];
+
+    free(log -> entries);
+    log -> entries = kept;
+    log -> entries_count = count;
+    log -> grids_count = grids_count;
+
+    tile_log_index(log);
+
+    free(ranks);
+    free(grids);
+
+    return OK;
+}
+
+
+static int cmp_ranks(const void *a, const void *b) {
+    double score_a = ((const TileLogRank *) a) -> score, score_b = ((const TileLogRank *) b) -> score;
+
+    return (score_a < score_b) - (score_a > score_b);
+}
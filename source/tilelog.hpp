@@ -0,0 +1,100 @@
+/**
+ * \file
+ * \brief Header file for access log of cached tiles, it remembers which tiles are popular across daemon restarts
+ * \note Every tile of a snapped render is counted with its grid, so the tile can be rendered again without the
+ * request that asked for it. Popularity is access count decayed with TILE_LOG_HALF_LIFE, so recent accesses
+ * weigh more. Log is kept in memory and saved to file as a whole, file is replaced atomically
+*/
+
+#ifndef TILELOG_HPP
+#define TILELOG_HPP
+
+#include <stdint.h>
+#include <mutex>
+#include "configs.hpp"
+#include "grid.hpp"
+#include "tilecache.hpp"
+
+
+/// Grid and limit shared by logged tiles
+typedef struct {
+    SampleGrid grid = {};                       ///< Sample grid, first sample is zero
+    int nmax = 0;                               ///< Max iteration number
+    TileKey id = {};                            ///< Key of tile (0, 0) of the grid, tells grids apart
+} TileLogGrid;
+
+
+/// Logged tile
+typedef struct {
+    TileKey key = {};                           ///< Tile cache key
+    int grid = 0;                               ///< Grid index
+    int64_t x = 0;                              ///< Tile column on the grid
+    int64_t y = 0;                              ///< Tile row on the grid
+    long count = 0;                             ///< Number of accesses
+    double score = 0;                           ///< Decayed number of accesses at the time of the last one
+    double last = 0;                            ///< Unix time of the last access
+} TileLogEntry;
+
+
+/// Access log of one daemon
+typedef struct {
+    std::mutex lock = {};                       ///< Protects the whole log, record and save are called from runners
+    const char *path = nullptr;                 ///< Log file
+    TileLogGrid *grids = nullptr;               ///< Known grids
+    int grids_count = 0;                        ///< Number of grids
+    int grids_capacity = 0;                     ///< Allocated grids
+    TileLogEntry *entries = nullptr;            ///< Logged tiles
+    int entries_count = 0;                      ///< Number of tiles
+    int *table = nullptr;                       ///< Open addressing index of entries by key, negative is free slot
+    int table_size = 0;                         ///< Index slots, power of two above twice TILE_LOG_MAX_TILES
+    bool changed = false;                       ///< Log has accesses that are not saved
+} TileLog;
+
+
+/**
+ * \brief Opens access log, reads its file if it exists
+ * \param [out] log     Log to open
+ * \param [in]  path    Log file, must live until the log is closed
+ * \return Non zero value means error
+*/
+int tile_log_open(TileLog *log, const char *path);
+
+
+/**
+ * \brief Frees log, accesses that are not saved are lost
+ * \return Non zero value means error
+*/
+int tile_log_close(TileLog *log);
+
+
+/**
+ * \brief Counts access to every tile of the snapped view
+ * \note When log is full, least popular half of tiles is forgotten
+ * \param [in,out] log     Log
+ * \param [in]     snapped View snapped to sample grid
+ * \return Non zero value means error
+*/
+int tile_log_record(TileLog *log, const GridView *snapped);
+
+
+/**
+ * \brief Writes log to temporary file and renames it over the log file, log without new accesses is not written
+ * \note Log is locked while it is written, so it is saved from its own thread rather than from renders
+ * \param [in,out] log     Log
+ * \return Non zero value means error
+*/
+int tile_log_save(TileLog *log);
+
+
+/**
+ * \brief Makes views of the most popular tiles at the current time
+ * \note Views are copies, so the log can change while they are rendered
+ * \param [in,out] log     Log
+ * \param [out]    tiles   Tile views with their grids, the most popular first
+ * \param [in]     limit   Max number of tiles
+ * \return Number of tiles
+*/
+int tile_log_hottest(TileLog *log, GridView *tiles, int limit);
+
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * \file
+ * \brief Source file for common helpers
+*/
+
+#include <time.h>
+#include "utils.hpp"
+
+
+
+
+double get_seconds(void) {
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + 1e-9 * (double) now.tv_nsec;
+}
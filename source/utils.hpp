@@ -0,0 +1,38 @@
+/**
+ * \file
+ * \brief Common exit codes and helper macros
+*/
+
+#ifndef UTILS_HPP
+#define UTILS_HPP
+
+#include <stdio.h>
+
+
+/// Possible functions exit codes
+typedef enum {
+    OK                  = 0,        ///< OK
+    INVALID_ARG         = 1,        ///< Invalid argument passed to the function
+    ALLOC_FAIL          = 2,        ///< Allocation failed
+    FILE_NOT_FOUND      = 3,        ///< File not found
+    INVALID_FORMAT      = 4,        ///< Color table file has invalid format
+    CANCELLED           = 5,        ///< Work was cancelled before it finished
+} EXIT_CODES;
+
+
+#define ASSERT(condition, exit_code, ...)       \
+do {                                            \
+    if (!(condition)) {                         \
+        printf(__VA_ARGS__);                    \
+        return exit_code;                       \
+    }                                           \
+} while (0)                                     \
+
+
+/**
+ * \brief Returns monotonic time in seconds
+*/
+double get_seconds(void);
+
+
+#endif